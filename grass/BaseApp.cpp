@@ -1,4 +1,5 @@
 #include "BaseApp.h"
+#include "GrassDump.h"
 #include "Input.h"
 #include <iostream>
 #include <cmath>
@@ -35,6 +36,8 @@ bool BaseApp::Initialize()
 	mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	mCamera.SetPosition(0.0f, 2.0f, -15.0f);
 
+	mThreadPool = make_unique<ThreadPool>();
+
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
 	Build();
@@ -75,10 +78,65 @@ void BaseApp::Update(const Timer& gt)
 		CloseHandle(eventHandle);
 	}
 
+	// The CPU bones go stale while the GPU integrates; pick up where it left off. The other
+	// way round needs nothing, the CPU path overwrites mGrassBuffer every frame.
+	if (mCpuGrassSyncRequested)
+	{
+		SyncCpuGrass();
+	}
+
+	if (mStreamGrassTiles)
+	{
+		UpdateGrassTiles();
+	}
+	else if (!mLoadedGrassTiles.empty())
+	{
+		mLoadedGrassTiles.clear();
+		LoadGrassRoots(mGrassRoots);
+	}
+
 	// AnimateGrass(gt);
+	mGrassStepCount = mGrassTimestep.Advance(gt.GetDeltaTime());
+	// The simulation works in the grass field's own frame.
+	Float3 eyePos = RelativePosition(mCamera.GetWorldPosition(), mGrassOrigin);
+	// On the GPU path the CPU bones are never stepped; seed sway chains and put chunks to
+	// sleep from what the CS reported when this frame resource was last used, a few frames
+	// ago.
+	bool grassReport = mCurrFrameResource->GrassReadbackWritten;
+	if (grassReport)
+	{
+		ReadbackMapped(mCurrFrameResource->GrassSeedReadback.Get(), mGrassSeedBones.data(), mGrassSeedBones.size() * sizeof(Bone));
+		ReadbackMapped(mCurrFrameResource->GrassSettledReadback.Get(), mGrassSettledChunks.data(),
+			mGrassSettledChunks.size() * sizeof(uint32_t));
+		mCurrFrameResource->GrassReadbackWritten = false;
+	}
+	mGrassSimulation.UpdateLod(XMFLOAT3(eyePos.x, eyePos.y, eyePos.z), mGrassLod,
+		mCpuGrass ? nullptr : mGrassSeedBones.data());
+
+	mCameraCollider.A = eyePos;
+	mCameraCollider.B = mCameraCollider.A;
+	mGrassColliders.Update(mCameraColliderId, mCameraCollider);
+	mGrassSimulation.UpdateColliders(mGrassColliders.Colliders());
+	mWindField.Update(gt.GetTotalTime(), mWind ? 1.0f : 0.0f);
+
+	if (!mCpuGrass)
+	{
+		GrassStepParams sleepParams;
+		sleepParams.Wind = &mWindField;
+		mGrassSimulation.UpdateGpuSleep(grassReport ? mGrassSettledChunks.data() : nullptr, sleepParams);
+	}
+
 	UpdateInstanceBuffer(gt);
 	UpdateWindCB(gt);
 	UpdateMainPassCB(gt);
+	UpdateTerrain(gt);
+
+	if (mGpuCheckRequested && !mCpuGrass)
+	{
+		RunGpuCheck();
+		// The check borrowed this frame's wind buffers.
+		UpdateWindCB(gt);
+	}
 }
 
 void BaseApp::Draw(const Timer& gt)
@@ -97,7 +155,11 @@ void BaseApp::Draw(const Timer& gt)
 	auto passCB = mCurrFrameResource->PassCB->Resource();
 	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
 
+	auto windCB = mCurrFrameResource->WindCB->Resource();
+	mCommandList->SetGraphicsRootConstantBufferView(2, windCB->GetGPUVirtualAddress());
+
 	mCommandList->SetGraphicsRootUnorderedAccessView(3, mGrassBuffer->GetGPUVirtualAddress());
+	mCommandList->SetGraphicsRootShaderResourceView(4, mGrassPrevBuffer->GetGPUVirtualAddress());
 
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
@@ -118,6 +180,9 @@ void BaseApp::Draw(const Timer& gt)
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	mCommandList->SetPipelineState(mPSOs["terrain" + psoSuffix].Get());
+	DrawTerrain(mCommandList.Get());
+
 	mCommandList->SetPipelineState(mPSOs["grass" + psoSuffix].Get());
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Grass]);
 
@@ -177,6 +242,20 @@ void BaseApp::OnKeyboardInput(const Timer& gt)
 
 	mWireFrameMode = !(GetAsyncKeyState('1') & 0x8000);
 	mWind = (GetAsyncKeyState('2') & 0x8000);
+	bool cpuGrass = (GetAsyncKeyState('3') & 0x8000) != 0;
+	mCpuGrassSyncRequested = cpuGrass && !mCpuGrass;
+	mCpuGrass = cpuGrass;
+
+	bool gpuCheckKey = (GetAsyncKeyState('G') & 0x8000) != 0;
+	mGpuCheckRequested = gpuCheckKey && !mGpuCheckKeyDown;
+	mGpuCheckKeyDown = gpuCheckKey;
+
+	bool streamKey = (GetAsyncKeyState('T') & 0x8000) != 0;
+	if (streamKey && !mStreamGrassTilesKeyDown)
+	{
+		mStreamGrassTiles = !mStreamGrassTiles;
+	}
+	mStreamGrassTilesKeyDown = streamKey;
 
 	if (GetAsyncKeyState('W') & 0x8000)
 	{
@@ -208,28 +287,426 @@ void BaseApp::OnKeyboardInput(const Timer& gt)
 
 void BaseApp::AnimateGrass(const Timer& gt)
 {
-	static int i = 0;
+	UINT byteSize = (UINT)(GrassFieldUtil::BoneCount(mGrassField) * sizeof(Bone));
 
-	// if (i < 1)
+	if (mCpuGrass)
 	{
-		auto cmdListAlloc = mCurrFrameResource->CmdListAlloc;
+		GrassStepParams params;
+		params.Wind = &mWindField;
+		params.DeltaTime = mGrassTimestep.StepDeltaTime();
+
+		for (uint32_t i = 0; i < mGrassStepCount; ++i)
+		{
+			if (i + 1 == mGrassStepCount)
+			{
+				mGrassSimulation.SavePose();
+			}
+
+			mGrassSimulation.Step(params, mThreadPool.get());
+		}
 
-		auto objectCB = mCurrFrameResource->ObjectCB->Resource();
-		auto windCB = mCurrFrameResource->WindCB->Resource();
-		auto passCB = mCurrFrameResource->PassCB->Resource();
-		// mCommandList->SetComputeRootSignature(mGrassCSRootSignature.Get());
-		mCommandList->SetComputeRootSignature(mRootSignature.Get());
-		mCommandList->SetComputeRootConstantBufferView(0, objectCB->GetGPUVirtualAddress());
-		mCommandList->SetComputeRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
-		mCommandList->SetComputeRootConstantBufferView(2, windCB->GetGPUVirtualAddress());
-		mCommandList->SetComputeRootUnorderedAccessView(3, mGrassBuffer->GetGPUVirtualAddress());
+		// Interpolated here, so UpdateWindCB tells the GS not to blend again.
+		auto grassBones = mCurrFrameResource->GrassBones.get();
+		mGrassSimulation.CopyBonesInterpolated(grassBones->MappedData(), mGrassTimestep.Alpha());
 
-		mCommandList->Dispatch(1, 1, 1);
+		auto toCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+		mCommandList->ResourceBarrier(1, &toCopyDest);
+
+		mCommandList->CopyBufferRegion(mGrassBuffer.Get(), 0, grassBones->Resource(), 0, byteSize);
+
+		auto toUA = CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		mCommandList->ResourceBarrier(1, &toUA);
+
+		return;
+	}
+
+	if (mGrassStepCount == 0)
+	{
+		return;
+	}
+
+	// Far chunks follow a shared sway chain that is cheap enough to step on the CPU.
+	GrassStepParams swayParams;
+	swayParams.Wind = &mWindField;
+	swayParams.DeltaTime = mGrassTimestep.StepDeltaTime();
+
+	for (uint32_t i = 0; i < mGrassStepCount; ++i)
+	{
+		mGrassSimulation.StepSwayChains(swayParams);
+	}
+
+	auto chunkTable = mCurrFrameResource->GrassChunkTable.get();
+	auto swayBones = mCurrFrameResource->GrassSwayBones.get();
+	auto colliders = mCurrFrameResource->GrassColliders.get();
+
+	uint32_t swayChunkCount = 0;
+	uint32_t integratedChunkCount = mGrassSimulation.BuildDispatchTable(chunkTable->MappedData(), swayChunkCount);
+
+	const vector<Bone>& sway = mGrassSimulation.SwayBones();
+	memcpy(swayBones->MappedData(), sway.data(), sway.size() * sizeof(Bone));
+
+	const vector<GrassCollider>& colliderRefs = mGrassSimulation.ColliderRefs();
+	memcpy(colliders->MappedData(), colliderRefs.data(), colliderRefs.size() * sizeof(GrassCollider));
+
+	BindGrassCompute(mCommandList.Get());
+
+	for (uint32_t i = 0; i < mGrassStepCount; ++i)
+	{
+		// The GS blends from the state before the last step of the frame.
+		if (i + 1 == mGrassStepCount)
+		{
+			CD3DX12_RESOURCE_BARRIER toCopy[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+					D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE),
+				CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+					D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST)
+			};
+			mCommandList->ResourceBarrier(_countof(toCopy), toCopy);
+
+			mCommandList->CopyBufferRegion(mGrassPrevBuffer.Get(), 0, mGrassBuffer.Get(), 0, byteSize);
+
+			CD3DX12_RESOURCE_BARRIER fromCopy[] =
+			{
+				CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+					D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+				CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+					D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+			};
+			mCommandList->ResourceBarrier(_countof(fromCopy), fromCopy);
+		}
+
+		// One group per awake Full or Root chunk; Sway chunks cost nothing per step.
+		if (integratedChunkCount > 0)
+		{
+			mCommandList->Dispatch(integratedChunkCount, 1, 1);
+
+			auto uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(mGrassBuffer.Get());
+			mCommandList->ResourceBarrier(1, &uavBarrier);
+		}
+	}
+
+	if (swayChunkCount > 0)
+	{
+		mCommandList->SetComputeRoot32BitConstant(7, integratedChunkCount, 0);
+		mCommandList->Dispatch(swayChunkCount, 1, 1);
 
 		auto uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(mGrassBuffer.Get());
 		mCommandList->ResourceBarrier(1, &uavBarrier);
+	}
+
+	CD3DX12_RESOURCE_BARRIER reportToCopy[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSettledBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE)
+	};
+	mCommandList->ResourceBarrier(_countof(reportToCopy), reportToCopy);
+
+	mCommandList->CopyBufferRegion(mCurrFrameResource->GrassSeedReadback.Get(), 0, mGrassSeedBuffer.Get(), 0,
+		mGrassSeedBones.size() * sizeof(Bone));
+	mCommandList->CopyBufferRegion(mCurrFrameResource->GrassSettledReadback.Get(), 0, mGrassSettledBuffer.Get(), 0,
+		mGrassSettledChunks.size() * sizeof(uint32_t));
+
+	CD3DX12_RESOURCE_BARRIER reportToUA[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSettledBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+	};
+	mCommandList->ResourceBarrier(_countof(reportToUA), reportToUA);
+	mCurrFrameResource->GrassReadbackWritten = true;
+}
+
+void BaseApp::BindGrassCompute(ID3D12GraphicsCommandList* cmdList)
+{
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto windCB = mCurrFrameResource->WindCB->Resource();
+	auto passCB = mCurrFrameResource->PassCB->Resource();
+	auto chunkTable = mCurrFrameResource->GrassChunkTable->Resource();
+	auto swayBones = mCurrFrameResource->GrassSwayBones->Resource();
+	auto windGrid = mCurrFrameResource->WindGrid->Resource();
+	auto colliders = mCurrFrameResource->GrassColliders->Resource();
+
+	// cmdList->SetComputeRootSignature(mGrassCSRootSignature.Get());
+	cmdList->SetComputeRootSignature(mRootSignature.Get());
+	cmdList->SetComputeRootConstantBufferView(0, objectCB->GetGPUVirtualAddress());
+	cmdList->SetComputeRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
+	cmdList->SetComputeRootConstantBufferView(2, windCB->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(3, mGrassBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootShaderResourceView(4, mGrassPrevBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootShaderResourceView(5, chunkTable->GetGPUVirtualAddress());
+	cmdList->SetComputeRootShaderResourceView(6, swayBones->GetGPUVirtualAddress());
+	cmdList->SetComputeRoot32BitConstant(7, 0, 0);
+	cmdList->SetComputeRootShaderResourceView(8, windGrid->GetGPUVirtualAddress());
+	cmdList->SetComputeRootShaderResourceView(9, colliders->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(11, mGrassSeedBuffer->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(12, mGrassSettledBuffer->GetGPUVirtualAddress());
+}
+
+void BaseApp::ReadbackMapped(ID3D12Resource* readback, void* dest, size_t byteSize)
+{
+	void* data = nullptr;
+	D3D12_RANGE readRange = { 0, byteSize };
+	ThrowIfFailed(readback->Map(0, &readRange, &data));
+	memcpy(dest, data, byteSize);
+	D3D12_RANGE writtenRange = { 0, 0 };
+	readback->Unmap(0, &writtenRange);
+}
 
-		++i;
+void BaseApp::ReadbackGrassBones(vector<Bone>& bones)
+{
+	size_t boneCount = GrassFieldUtil::BoneCount(mGrassField);
+	UINT64 byteSize = boneCount * sizeof(Bone);
+
+	if (mGrassReadbackBuffer == nullptr)
+	{
+		auto readbackHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+		auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+		ThrowIfFailed(md3dDevice->CreateCommittedResource(
+			&readbackHeap,
+			D3D12_HEAP_FLAG_NONE,
+			&readbackDesc,
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			nullptr,
+			IID_PPV_ARGS(mGrassReadbackBuffer.GetAddressOf())));
+	}
+
+	// Between frames the command list is closed and, once the queue is flushed, the
+	// start-up allocator is free to record on.
+	FlushCommandQueue();
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	auto toCopySource = CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	mCommandList->ResourceBarrier(1, &toCopySource);
+
+	mCommandList->CopyBufferRegion(mGrassReadbackBuffer.Get(), 0, mGrassBuffer.Get(), 0, byteSize);
+
+	auto toUA = CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mCommandList->ResourceBarrier(1, &toUA);
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	FlushCommandQueue();
+
+	bones.resize(boneCount);
+	ReadbackMapped(mGrassReadbackBuffer.Get(), bones.data(), (size_t)byteSize);
+}
+
+void BaseApp::SyncCpuGrass()
+{
+	vector<Bone> bones;
+	ReadbackGrassBones(bones);
+	mGrassSimulation.SetBones(bones.data());
+}
+
+void BaseApp::UpdateGrassTiles()
+{
+	mGrassTiles.Update(mCamera.GetWorldPosition());
+
+	// Reloading stalls the queue, so wait for the tiles in flight instead of reloading as
+	// each one lands.
+	const vector<const GrassTile*>& tiles = mGrassTiles.VisibleTiles();
+	if (tiles.empty() || mGrassTiles.Stats().PendingTiles != 0)
+	{
+		return;
+	}
+
+	vector<pair<int32_t, int32_t>> loaded;
+	loaded.reserve(tiles.size());
+	for (const GrassTile* tile : tiles)
+	{
+		loaded.emplace_back(tile->X, tile->Z);
+	}
+	if (loaded == mLoadedGrassTiles)
+	{
+		return;
+	}
+
+	// Nearest tiles first, so the blades that don't fit are the farthest ones.
+	vector<Float3> roots;
+	roots.reserve(mGrassField.BladeCount);
+	for (const GrassTile* tile : tiles)
+	{
+		Float3 offset = RelativePosition(tile->Origin, mGrassOrigin);
+		for (const Float3& root : tile->Roots)
+		{
+			if (roots.size() == mGrassField.BladeCount)
+			{
+				break;
+			}
+			roots.push_back(offset + root);
+		}
+	}
+
+	mLoadedGrassTiles = move(loaded);
+	LoadGrassRoots(roots);
+}
+
+void BaseApp::LoadGrassRoots(const vector<Float3>& roots)
+{
+	assert(!roots.empty());
+	uint32_t drawnCount = roots.size() < mGrassField.BladeCount ? (uint32_t)roots.size() : mGrassField.BladeCount;
+
+	// BLADE_COUNT is compiled into the shaders and the chunks are sized from it, so every
+	// blade still needs a root; the ones past drawnCount sit on the last root, undrawn.
+	vector<Float3> bladeRoots(roots.begin(), roots.begin() + drawnCount);
+	bladeRoots.resize(mGrassField.BladeCount, bladeRoots.back());
+
+	vector<Bone> bones = GrassSimulation::BuildBones(mGrassField.BladeCount, mGrassField.BonesPerBlade,
+		mGrassField.BoneLength, mGrassField.BoneMass);
+	GrassSimulation::SetBladeRoots(bones, bladeRoots);
+	mGrassSimulation.Initialize(bones, mGrassField.BonesPerBlade, bladeRoots, mGrassField.BladesPerChunk);
+
+	// Whatever the CS reported is about the old blades.
+	mGrassSeedBones = mGrassSimulation.SwayBones();
+	fill(mGrassSettledChunks.begin(), mGrassSettledChunks.end(), 0u);
+	for (auto& frameResource : mFrameResources)
+	{
+		frameResource->GrassReadbackWritten = false;
+	}
+
+	vector<GrassVertex> vertices = GrassFieldUtil::BuildVertices(mGrassField, bladeRoots);
+	MeshGeometry* geo = mGeometries["grassGeo"].get();
+	UINT vbByteSize = (UINT)vertices.size() * sizeof(GrassVertex);
+	assert(vbByteSize == geo->VertexBufferByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	mGrassRitem->IndexCount = drawnCount;
+
+	// The start-up upload buffers are still around and sized for exactly these copies.
+	UINT boneByteSize = (UINT)bones.size() * sizeof(Bone);
+	UINT seedByteSize = (UINT)mGrassSeedBones.size() * sizeof(Bone);
+	FlushCommandQueue();
+
+	void* data = nullptr;
+	ThrowIfFailed(mGrassUploadBuffer->Map(0, nullptr, &data));
+	memcpy(data, bones.data(), boneByteSize);
+	mGrassUploadBuffer->Unmap(0, nullptr);
+	ThrowIfFailed(mGrassSeedUploadBuffer->Map(0, nullptr, &data));
+	memcpy(data, mGrassSeedBones.data(), seedByteSize);
+	mGrassSeedUploadBuffer->Unmap(0, nullptr);
+	ThrowIfFailed(geo->VertexBufferUploader->Map(0, nullptr, &data));
+	memcpy(data, vertices.data(), vbByteSize);
+	geo->VertexBufferUploader->Unmap(0, nullptr);
+
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+
+	CD3DX12_RESOURCE_BARRIER toCopyDest[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+			D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST),
+		CD3DX12_RESOURCE_BARRIER::Transition(geo->VertexBufferGPU.Get(),
+			D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST)
+	};
+	mCommandList->ResourceBarrier(_countof(toCopyDest), toCopyDest);
+
+	mCommandList->CopyBufferRegion(mGrassBuffer.Get(), 0, mGrassUploadBuffer.Get(), 0, boneByteSize);
+	mCommandList->CopyBufferRegion(mGrassPrevBuffer.Get(), 0, mGrassUploadBuffer.Get(), 0, boneByteSize);
+	mCommandList->CopyBufferRegion(mGrassSeedBuffer.Get(), 0, mGrassSeedUploadBuffer.Get(), 0, seedByteSize);
+	mCommandList->CopyBufferRegion(geo->VertexBufferGPU.Get(), 0, geo->VertexBufferUploader.Get(), 0, vbByteSize);
+
+	CD3DX12_RESOURCE_BARRIER toRead[] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(geo->VertexBufferGPU.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ)
+	};
+	mCommandList->ResourceBarrier(_countof(toRead), toRead);
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	FlushCommandQueue();
+}
+
+void BaseApp::RunGpuCheck()
+{
+	const uint32_t CheckSteps = 60;
+	const Float3 CheckWind = { 5.0f, 0.0f, 0.0f };
+	const float MaxError = 1e-4f;
+	float deltaTime = mGrassTimestep.StepDeltaTime();
+
+	GrassDump start;
+	start.BladeCount = mGrassField.BladeCount;
+	start.BonesPerBlade = mGrassField.BonesPerBlade;
+	ReadbackGrassBones(start.Bones);
+
+	// The CPU reference knows a uniform wind only, so the grid is zeroed and the wind goes
+	// in as the offset on top of it. Every chunk is integrated in full, without colliders.
+	WindConstants windCB;
+	windCB.Velocity = XMFLOAT3(CheckWind.x, CheckWind.y, CheckWind.z);
+	windCB.StepDeltaTime = deltaTime;
+	const WindFieldDesc& windDesc = mWindField.Desc();
+	windCB.GridOrigin = XMFLOAT2(windDesc.OriginX, windDesc.OriginZ);
+	windCB.GridInvCellSize = 1.0f / windDesc.CellSize;
+	windCB.GridWidth = windDesc.Width;
+	windCB.GridHeight = windDesc.Height;
+	mCurrFrameResource->WindCB->CopyData(0, windCB);
+	memset(mCurrFrameResource->WindGrid->MappedData(), 0, 2 * mWindField.NodeCount() * sizeof(float));
+
+	const vector<GrassChunk>& chunks = mGrassSimulation.Chunks();
+	GrassChunkDispatch* table = mCurrFrameResource->GrassChunkTable->MappedData();
+	for (uint32_t i = 0; i < (uint32_t)chunks.size(); ++i)
+	{
+		GrassChunkDispatch dispatch;
+		dispatch.BladeBegin = chunks[i].BladeBegin;
+		dispatch.BladeEnd = chunks[i].BladeEnd;
+		dispatch.Lod = (uint32_t)GrassLod::Full;
+		dispatch.SwayIndex = i;
+		table[i] = dispatch;
+	}
+
+	ThrowIfFailed(mDirectCmdListAlloc->Reset());
+	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), mPSOs["grassCS"].Get()));
+	BindGrassCompute(mCommandList.Get());
+
+	for (uint32_t i = 0; i < CheckSteps; ++i)
+	{
+		mCommandList->Dispatch((UINT)chunks.size(), 1, 1);
+
+		auto uavBarrier = CD3DX12_RESOURCE_BARRIER::UAV(mGrassBuffer.Get());
+		mCommandList->ResourceBarrier(1, &uavBarrier);
+	}
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+	mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+	GrassDump gpu = start;
+	gpu.StepCount = CheckSteps;
+	gpu.DeltaTime = deltaTime;
+	gpu.WindVelocity = CheckWind;
+	ReadbackGrassBones(gpu.Bones);
+
+	GrassDump expected = GrassDumpUtil::Replay(start, CheckSteps, deltaTime, CheckWind);
+	GrassDumpDiff diff = GrassDumpUtil::Compare(expected, gpu, UINT32_MAX - 1);
+	bool ok = diff.LayoutMatches && diff.MaxAbsError <= MaxError;
+
+	bool written = GrassDumpUtil::Write("grass_gpu_start.bin", start) && GrassDumpUtil::Write("grass_gpu.bin", gpu);
+
+	cout << "GPU check: " << CheckSteps << " steps, max error " << diff.MaxAbsError << " (" << diff.MaxUlpDistance
+		<< " ulp) " << (ok ? "PASS" : "FAIL") << endl;
+	if (written)
+	{
+		cout << "wrote grass_gpu_start.bin and grass_gpu.bin for GrassBench gpu-verify" << endl;
 	}
 }
 
@@ -237,18 +714,27 @@ void BaseApp::UpdateInstanceBuffer(const Timer& gt)
 {
 	auto currInstanceBuffer = mCurrFrameResource->ObjectCB.get();
 
+	// Camera-relative, the render origin moves with the camera and every World is rebased
+	// every frame.
+	bool rebase = mCamera.IsCameraRelative();
+	Double3 renderOrigin = mCamera.GetRenderOrigin();
+
 	for (auto& e : mAllRitems)
 	{
-		if (e->NumFramesDirty > 0)
+		if (e->NumFramesDirty > 0 || rebase)
 		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
+			Float3 offset = RelativePosition(e->Origin, renderOrigin);
+			XMMATRIX world = XMLoadFloat4x4(&e->World) * XMMatrixTranslation(offset.x, offset.y, offset.z);
 
 			ObjectData objData;
 			XMStoreFloat4x4(&objData.World, XMMatrixTranspose(world));
 
 			currInstanceBuffer->CopyData(e->ObjCBIndex, objData);
 
-			e->NumFramesDirty--;
+			if (e->NumFramesDirty > 0)
+			{
+				e->NumFramesDirty--;
+			}
 		}
 	}
 }
@@ -257,26 +743,34 @@ void BaseApp::UpdateWindCB(const Timer& gt)
 {
 	auto currWindBuffer = mCurrFrameResource->WindCB.get();
 
+	// The grid carries the wind; Velocity is a uniform offset on top of it.
 	WindConstants windCB;
-	auto wind = mWind ? 10.0f : 0.0f;
-	// auto wind = 0.0f;
-	windCB.Velocity = XMFLOAT3(wind, 0.0f, 0.0f);
+	windCB.Velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	windCB.StepDeltaTime = mGrassTimestep.StepDeltaTime();
+	windCB.InterpolationAlpha = mCpuGrass ? 1.0f : mGrassTimestep.Alpha();
+
+	const WindFieldDesc& windDesc = mWindField.Desc();
+	windCB.GridOrigin = XMFLOAT2(windDesc.OriginX, windDesc.OriginZ);
+	windCB.GridInvCellSize = 1.0f / windDesc.CellSize;
+	windCB.GridWidth = windDesc.Width;
+	windCB.GridHeight = windDesc.Height;
 
 	currWindBuffer->CopyData(0, windCB);
+
+	size_t nodeCount = mWindField.NodeCount();
+	float* windGrid = mCurrFrameResource->WindGrid->MappedData();
+	memcpy(windGrid, mWindField.VelocityX(), nodeCount * sizeof(float));
+	memcpy(windGrid + nodeCount, mWindField.VelocityZ(), nodeCount * sizeof(float));
 }
 
 void BaseApp::UpdateMainPassCB(const Timer& gt)
 {
 	XMMATRIX view = mCamera.GetView();
 	XMMATRIX proj = mCamera.GetProj();
-
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	auto detView = XMMatrixDeterminant(view);
-	auto detProj = XMMatrixDeterminant(proj);
-	auto detViewProj = XMMatrixDeterminant(viewProj);
-	XMMATRIX invView = XMMatrixInverse(&detView, view);
-	XMMATRIX invProj = XMMatrixInverse(&detProj, proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&detViewProj, viewProj);
+	XMMATRIX viewProj = mCamera.GetViewProj();
+	XMMATRIX invView = mCamera.GetInvView();
+	XMMATRIX invProj = mCamera.GetInvProj();
+	XMMATRIX invViewProj = mCamera.GetInvViewProj();
 
 	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
 	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
@@ -284,7 +778,8 @@ void BaseApp::UpdateMainPassCB(const Timer& gt)
 	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
 	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
 	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
-	mMainPassCB.EyePosW = mCamera.GetPosition3f();
+	Float3 eyePos = RelativePosition(mCamera.GetWorldPosition(), mCamera.GetRenderOrigin());
+	mMainPassCB.EyePosW = XMFLOAT3(eyePos.x, eyePos.y, eyePos.z);
 	mMainPassCB.RenderTargetSize = XMFLOAT2((float)mClientWidth, (float)mClientHeight);
 	mMainPassCB.InvRenderTargetSize = XMFLOAT2(1.0f / mClientWidth, 1.0f / mClientHeight);
 	mMainPassCB.NearZ = 1.0f;
@@ -305,6 +800,29 @@ void BaseApp::UpdateMainPassCB(const Timer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+void BaseApp::UpdateTerrain(const Timer& gt)
+{
+	if (mTerrainRitem == nullptr)
+	{
+		return;
+	}
+
+	// Selection runs in the terrain's own frame.
+	Float3 camera = RelativePosition(mCamera.GetWorldPosition(), mTerrainRitem->Origin);
+	FrustumPlanes frustum = mCamera.GetFrustum().Translated(RelativePosition(mTerrainRitem->Origin, mCamera.GetRenderOrigin()));
+
+	mTerrainPatches.clear();
+	mTerrain.Select(camera, frustum, (float)mClientHeight, mCamera.GetFovY(), mTerrainPatches);
+
+	if (mTerrainPatches.size() > MaxTerrainPatches)
+	{
+		mTerrainPatches.resize(MaxTerrainPatches);
+	}
+
+	auto currTerrainPatches = mCurrFrameResource->TerrainPatches.get();
+	memcpy(currTerrainPatches->MappedData(), mTerrainPatches.data(), mTerrainPatches.size() * sizeof(TerrainPatch));
+}
+
 void BaseApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const vector<RenderItem*>& ritems)
 {
 	UINT objCBByteSize = D3DUtil::CalcConstantBufferByteSize(sizeof(ObjectData));
@@ -326,7 +844,53 @@ void BaseApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const vector<R
 		// cmdList->SetGraphicsRootShaderResourceView(0, objCBAddress);
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if (ri->IndexRanges.empty())
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+		else
+		{
+			for (const auto& range : ri->IndexRanges)
+			{
+				cmdList->DrawIndexedInstanced(range.IndexCount, 1, range.StartIndex, range.BaseVertex, 0);
+			}
+		}
+	}
+}
+
+void BaseApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+	if (mTerrainRitem == nullptr || mTerrainPatches.empty())
+	{
+		return;
+	}
+
+	UINT objCBByteSize = D3DUtil::CalcConstantBufferByteSize(sizeof(ObjectData));
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto terrainPatches = mCurrFrameResource->TerrainPatches->Resource();
+	auto ri = mTerrainRitem;
+
+	auto vertexBufferView = ri->Geo->VertexBufferView();
+	auto indexBufferView = ri->Geo->IndexBufferView();
+	cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+	cmdList->IASetIndexBuffer(&indexBufferView);
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + ri->ObjCBIndex * objCBByteSize;
+	cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+	cmdList->SetGraphicsRootShaderResourceView(10, terrainPatches->GetGPUVirtualAddress());
+
+	UINT patchCount = (UINT)mTerrainPatches.size();
+	if (ri->IndexRanges.empty())
+	{
+		cmdList->DrawIndexedInstanced(ri->IndexCount, patchCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+	}
+	else
+	{
+		for (const auto& range : ri->IndexRanges)
+		{
+			cmdList->DrawIndexedInstanced(range.IndexCount, patchCount, range.StartIndex, range.BaseVertex, 0);
+		}
 	}
 }
 
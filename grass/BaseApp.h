@@ -6,6 +6,14 @@
 #include "Camera.h"
 #include "FrustumCulling.h"
 #include "CubeRenderTarget.h"
+#include "FixedTimestep.h"
+#include "GrassColliders.h"
+#include "GrassChunks.h"
+#include "GrassField.h"
+#include "GrassTiles.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+#include "WindField.h"
 
 const UINT CubeMapSize = 512;
 
@@ -33,11 +41,32 @@ public:
 
 	virtual void AnimateMaterials(const Timer& gt) {}
 	void AnimateGrass(const Timer& gt);
+	// Root signature and buffers of the grass CS for the current frame resource.
+	void BindGrassCompute(ID3D12GraphicsCommandList* cmdList);
+	// Loads the GPU's bones into mGrassSimulation when the CPU path takes over. Flushes the queue.
+	void SyncCpuGrass();
+	// Copies byteSize bytes out of a READBACK buffer the GPU has finished writing.
+	void ReadbackMapped(ID3D12Resource* readback, void* dest, size_t byteSize);
+	// Streams the nearest visible tiles into the grass once their generation has settled.
+	void UpdateGrassTiles();
+	// Replaces every blade: the vertex buffer, both bone buffers, the seed buffer and
+	// mGrassSimulation start over at rest on roots (field frame). Roots past BladeCount are
+	// dropped and only roots.size() blades are drawn. Flushes the queue.
+	void LoadGrassRoots(const vector<Float3>& roots);
+	// Copies mGrassBuffer through a READBACK heap. Debug only: it flushes the queue.
+	void ReadbackGrassBones(vector<Bone>& bones);
+	// Debug ('G', GPU path): steps every chunk of mGrassBuffer at Full LOD with a constant
+	// wind, checks the result against the CPU reference from the same start and writes
+	// both dumps for GrassBench gpu-verify. The grass jumps ahead by the steps taken.
+	void RunGpuCheck();
 	void UpdateInstanceBuffer(const Timer& gt);
 	void UpdateWindCB(const Timer& gt);
 	void UpdateMainPassCB(const Timer& gt);
+	void UpdateTerrain(const Timer& gt);
 
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const vector<RenderItem*>& ritems);
+	// Every terrain patch selected this frame, as instances of the terrain item's grid.
+	void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
 
 	void BuildWireFramePSOs();
 
@@ -49,6 +78,12 @@ protected:
 protected:
 	bool mWireFrameMode = false;
 	bool mWind = false;
+	bool mCpuGrass = false;
+	bool mCpuGrassSyncRequested = false;
+	bool mGpuCheckKeyDown = false;
+	bool mGpuCheckRequested = false;
+	bool mStreamGrassTiles = false;
+	bool mStreamGrassTilesKeyDown = false;
 
 	vector<unique_ptr<FrameResource>> mFrameResources;
 	FrameResource* mCurrFrameResource = nullptr;
@@ -63,6 +98,49 @@ protected:
 
 	ComPtr<ID3D12Resource> mGrassUploadBuffer = nullptr;
 	ComPtr<ID3D12Resource> mGrassBuffer = nullptr;
+	ComPtr<ID3D12Resource> mGrassPrevBuffer = nullptr;
+	ComPtr<ID3D12Resource> mGrassReadbackBuffer = nullptr;
+	// What the grass CS reports back, and its latest readback: seed blades for chunks entering
+	// sway LOD (GrassChunkSimulation::UpdateLod) and settled flags for UpdateGpuSleep.
+	ComPtr<ID3D12Resource> mGrassSeedBuffer = nullptr;
+	ComPtr<ID3D12Resource> mGrassSeedUploadBuffer = nullptr;
+	ComPtr<ID3D12Resource> mGrassSettledBuffer = nullptr;
+	vector<Bone> mGrassSeedBones;
+	vector<uint32_t> mGrassSettledChunks;
+
+	GrassLodDesc mGrassLod;
+
+	FixedTimestep mGrassTimestep;
+	uint32_t mGrassStepCount = 0;
+
+	// Selections past this many patches are cut short.
+	static const UINT MaxTerrainPatches = 4096;
+
+	TerrainQuadtree mTerrain;
+	RenderItem* mTerrainRitem = nullptr;
+	vector<TerrainPatch> mTerrainPatches;
+
+	GrassFieldDesc mGrassField;
+	// Where the grass field's frame sits in the world: the simulation, colliders and LOD
+	// all work relative to it.
+	Double3 mGrassOrigin;
+	// The field's own scatter, reloaded when tile streaming is switched off.
+	vector<Float3> mGrassRoots;
+	RenderItem* mGrassRitem = nullptr;
+	WindField mWindField;
+
+	// Debug ('T'): grass roots streamed around the camera instead of the fixed field. The
+	// blade count, and so the buffers and chunks, stay the field's; the nearest tiles fill
+	// it. Every change of the tile set reloads all blades, a hitch of its own.
+	GrassTileCache mGrassTiles;
+	vector<pair<int32_t, int32_t>> mLoadedGrassTiles;
+
+	unique_ptr<ThreadPool> mThreadPool;
+	GrassChunkSimulation mGrassSimulation;
+
+	GrassColliderRegistry mGrassColliders;
+	GrassCollider mCameraCollider;
+	uint32_t mCameraColliderId = 0;
 
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
 	ComPtr<ID3D12RootSignature> mGrassCSRootSignature = nullptr;
@@ -0,0 +1,177 @@
+#include "BatchCulling.h"
+#include "SimdMath.h"
+#include <cassert>
+
+FrustumPlanes FrustumPlanes::FromViewProj(const Float4x4& viewProj)
+{
+	const auto& m = viewProj.m;
+
+	// Clip-space coordinate j of p * M is the dot of (p, 1) with column j.
+	auto column = [&m](int j) { return Float4(m[0][j], m[1][j], m[2][j], m[3][j]); };
+	auto add = [](const Float4& a, const Float4& b) { return Float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); };
+	auto sub = [](const Float4& a, const Float4& b) { return Float4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); };
+
+	Float4 x = column(0);
+	Float4 y = column(1);
+	Float4 z = column(2);
+	Float4 w = column(3);
+
+	FrustumPlanes frustum;
+	frustum.Planes[0] = add(w, x);
+	frustum.Planes[1] = sub(w, x);
+	frustum.Planes[2] = add(w, y);
+	frustum.Planes[3] = sub(w, y);
+	frustum.Planes[4] = z;
+	frustum.Planes[5] = sub(w, z);
+
+	for (auto& plane : frustum.Planes)
+	{
+		float invLength = 1.0f / sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		plane = Float4(plane.x * invLength, plane.y * invLength, plane.z * invLength, plane.w * invLength);
+	}
+
+	return frustum;
+}
+
+FrustumPlanes FrustumPlanes::Translated(const Float3& offset) const
+{
+	// Dot(n, q + offset) + d: only the distance term moves.
+	FrustumPlanes frustum;
+	for (int i = 0; i < 6; ++i)
+	{
+		const Float4& plane = Planes[i];
+		frustum.Planes[i] = Float4(plane.x, plane.y, plane.z, plane.w + plane.x * offset.x + plane.y * offset.y + plane.z * offset.z);
+	}
+	return frustum;
+}
+
+void BoundsSoA::Resize(uint32_t count)
+{
+	mCount = count;
+
+	size_t padded = ((size_t)count + SimdWidth - 1) / SimdWidth * SimdWidth;
+	mCenterX.resize(padded, 0.0f);
+	mCenterY.resize(padded, 0.0f);
+	mCenterZ.resize(padded, 0.0f);
+	mExtentX.resize(padded, 0.0f);
+	mExtentY.resize(padded, 0.0f);
+	mExtentZ.resize(padded, 0.0f);
+}
+
+void BoundsSoA::Set(uint32_t index, const Float3& center, const Float3& extents)
+{
+	mCenterX[index] = center.x;
+	mCenterY[index] = center.y;
+	mCenterZ[index] = center.z;
+	mExtentX[index] = extents.x;
+	mExtentY[index] = extents.y;
+	mExtentZ[index] = extents.z;
+}
+
+void BoundsSoA::SetTransformed(uint32_t index, const Float3& localCenter, const Float3& localExtents, const Float4x4& world)
+{
+	const auto& m = world.m;
+
+	// Each world extent is the local extents projected onto that axis (Arvo).
+	Float3 extents(
+		fabsf(m[0][0]) * localExtents.x + fabsf(m[1][0]) * localExtents.y + fabsf(m[2][0]) * localExtents.z,
+		fabsf(m[0][1]) * localExtents.x + fabsf(m[1][1]) * localExtents.y + fabsf(m[2][1]) * localExtents.z,
+		fabsf(m[0][2]) * localExtents.x + fabsf(m[1][2]) * localExtents.y + fabsf(m[2][2]) * localExtents.z);
+
+	Set(index, TransformPoint(localCenter, world), extents);
+}
+
+bool BatchCulling::IsBoxVisible(const FrustumPlanes& frustum, const Float3& center, const Float3& extents)
+{
+	for (const auto& plane : frustum.Planes)
+	{
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint32_t BatchCulling::CullScalar(const FrustumPlanes& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		Float3 center(bounds.CenterX()[i], bounds.CenterY()[i], bounds.CenterZ()[i]);
+		Float3 extents(bounds.ExtentX()[i], bounds.ExtentY()[i], bounds.ExtentZ()[i]);
+
+		if (IsBoxVisible(frustum, center, extents))
+		{
+			visible[visibleCount++] = i;
+		}
+	}
+
+	return visibleCount;
+}
+
+uint32_t BatchCulling::Cull(const FrustumPlanes& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible)
+{
+	assert(begin % SimdWidth == 0 && end <= bounds.Count());
+
+	SimdFloat planeX[6];
+	SimdFloat planeY[6];
+	SimdFloat planeZ[6];
+	SimdFloat planeW[6];
+	SimdFloat absX[6];
+	SimdFloat absY[6];
+	SimdFloat absZ[6];
+
+	for (int p = 0; p < 6; ++p)
+	{
+		const Float4& plane = frustum.Planes[p];
+		planeX[p] = SimdSplat(plane.x);
+		planeY[p] = SimdSplat(plane.y);
+		planeZ[p] = SimdSplat(plane.z);
+		planeW[p] = SimdSplat(plane.w);
+		absX[p] = SimdSplat(fabsf(plane.x));
+		absY[p] = SimdSplat(fabsf(plane.y));
+		absZ[p] = SimdSplat(fabsf(plane.z));
+	}
+
+	SimdFloat zero = SimdZero();
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = begin; i < end; i += SimdWidth)
+	{
+		SimdFloat cx = SimdLoad(bounds.CenterX() + i);
+		SimdFloat cy = SimdLoad(bounds.CenterY() + i);
+		SimdFloat cz = SimdLoad(bounds.CenterZ() + i);
+		SimdFloat ex = SimdLoad(bounds.ExtentX() + i);
+		SimdFloat ey = SimdLoad(bounds.ExtentY() + i);
+		SimdFloat ez = SimdLoad(bounds.ExtentZ() + i);
+
+		SimdFloat distance = cx * planeX[0] + cy * planeY[0] + cz * planeZ[0] + planeW[0];
+		SimdFloat radius = ex * absX[0] + ey * absY[0] + ez * absZ[0];
+		SimdMask outside = distance + radius < zero;
+
+		for (int p = 1; p < 6; ++p)
+		{
+			distance = cx * planeX[p] + cy * planeY[p] + cz * planeZ[p] + planeW[p];
+			radius = ex * absX[p] + ey * absY[p] + ez * absZ[p];
+			outside = outside | (distance + radius < zero);
+		}
+
+		uint32_t lanes = end - i < (uint32_t)SimdWidth ? end - i : (uint32_t)SimdWidth;
+		uint32_t inside = ~(uint32_t)MaskBits(outside) & ((1u << lanes) - 1);
+
+		// Branch-free compaction: every lane writes, only visible lanes advance the cursor.
+		for (uint32_t k = 0; k < (uint32_t)SimdWidth; ++k)
+		{
+			visible[visibleCount] = i + k;
+			visibleCount += (inside >> k) & 1;
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include "AlignedAllocator.h"
+#include "SimMath.h"
+
+using namespace std;
+
+// A view frustum as six normalized planes facing inwards: a point p is inside plane
+// (n, d) when Dot(n, p) + d >= 0.
+struct FrustumPlanes
+{
+	// Left, right, bottom, top, near, far.
+	Float4 Planes[6];
+
+	// D3D conventions: row vectors (p * viewProj) and clip-space z in [0, w].
+	static FrustumPlanes FromViewProj(const Float4x4& viewProj);
+
+	// The same frustum for coordinates whose origin sits at offset in this one's, e.g. a
+	// render item's frame seen from a camera-relative frustum.
+	FrustumPlanes Translated(const Float3& offset) const;
+};
+
+// World-space AABBs as centre and extent streams, padded to a whole number of SIMD groups.
+class BoundsSoA
+{
+public:
+	void Resize(uint32_t count);
+
+	void Set(uint32_t index, const Float3& center, const Float3& extents);
+	// The world AABB enclosing a local box under a row-vector world matrix.
+	void SetTransformed(uint32_t index, const Float3& localCenter, const Float3& localExtents, const Float4x4& world);
+
+	uint32_t Count() const { return mCount; }
+
+	const float* CenterX() const { return mCenterX.data(); }
+	const float* CenterY() const { return mCenterY.data(); }
+	const float* CenterZ() const { return mCenterZ.data(); }
+	const float* ExtentX() const { return mExtentX.data(); }
+	const float* ExtentY() const { return mExtentY.data(); }
+	const float* ExtentZ() const { return mExtentZ.data(); }
+
+private:
+	uint32_t mCount = 0;
+	AlignedVector<float> mCenterX;
+	AlignedVector<float> mCenterY;
+	AlignedVector<float> mCenterZ;
+	AlignedVector<float> mExtentX;
+	AlignedVector<float> mExtentY;
+	AlignedVector<float> mExtentZ;
+};
+
+// Frustum culling of many boxes at once. A box is outside when it lies entirely behind any
+// one plane; the SIMD path tests SimdWidth boxes against all six planes per iteration and
+// appends the survivors to a compact index list.
+class BatchCulling
+{
+public:
+	// Writes the indices of the boxes in [begin, end) that touch the frustum, in order, and
+	// returns how many. begin must be a multiple of SimdWidth; visible needs room for
+	// end - begin indices rounded up to a multiple of SimdWidth.
+	static uint32_t Cull(const FrustumPlanes& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible);
+	static uint32_t Cull(const FrustumPlanes& frustum, const BoundsSoA& bounds, uint32_t* visible)
+	{
+		return Cull(frustum, bounds, 0, bounds.Count(), visible);
+	}
+
+	// One box at a time; same results as Cull.
+	static uint32_t CullScalar(const FrustumPlanes& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible);
+
+	static bool IsBoxVisible(const FrustumPlanes& frustum, const Float3& center, const Float3& extents);
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace std;
+
+class BenchTimer
+{
+public:
+	BenchTimer() { Reset(); }
+
+	void Reset()
+	{
+		mStart = chrono::steady_clock::now();
+	}
+
+	double ElapsedSeconds() const
+	{
+		return chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+	}
+
+	double ElapsedMilliseconds() const
+	{
+		return ElapsedSeconds() * 1000.0;
+	}
+
+private:
+	chrono::steady_clock::time_point mStart;
+};
+
+// Positional arguments after the command name; missing arguments fall back to the default.
+class BenchArgs
+{
+public:
+	BenchArgs(int argc, char** argv) : mArgc(argc), mArgv(argv) {}
+
+	int Count() const { return mArgc; }
+
+	string GetString(int index, const string& defaultValue) const
+	{
+		return index < mArgc ? string(mArgv[index]) : defaultValue;
+	}
+
+	uint64_t GetUInt(int index, uint64_t defaultValue) const
+	{
+		return index < mArgc ? (uint64_t)strtod(mArgv[index], nullptr) : defaultValue;
+	}
+
+	float GetFloat(int index, float defaultValue) const
+	{
+		return index < mArgc ? strtof(mArgv[index], nullptr) : defaultValue;
+	}
+
+private:
+	int mArgc = 0;
+	char** mArgv = nullptr;
+};
+
+int RunBoneThroughputBench(const BenchArgs& args);
+int RunSoABench(const BenchArgs& args);
+int RunScalingBench(const BenchArgs& args);
+int RunStressBench(const BenchArgs& args);
+int RunSleepBench(const BenchArgs& args);
+int RunTimestepBench(const BenchArgs& args);
+int RunLodBench(const BenchArgs& args);
+int RunWindBench(const BenchArgs& args);
+int RunColliderBench(const BenchArgs& args);
+int RunScatterBench(const BenchArgs& args);
+int RunTileBench(const BenchArgs& args);
+int RunIndexBench(const BenchArgs& args);
+int RunCullBench(const BenchArgs& args);
+int RunBvhBench(const BenchArgs& args);
+int RunCullScalingBench(const BenchArgs& args);
+int RunCoherenceBench(const BenchArgs& args);
+int RunOcclusionBench(const BenchArgs& args);
+int RunCameraBench(const BenchArgs& args);
+int RunLargeWorldBench(const BenchArgs& args);
+int RunTerrainBench(const BenchArgs& args);
+int RunLandBench(const BenchArgs& args);
+int RunHeightmapBench(const BenchArgs& args);
+int RunWavesBench(const BenchArgs& args);
+int RunWavesPartitionBench(const BenchArgs& args);
+int RunWavesStepsBench(const BenchArgs& args);
+int RunGoldenWrite(const BenchArgs& args);
+int RunGoldenVerify(const BenchArgs& args);
+int RunGpuVerify(const BenchArgs& args);
@@ -0,0 +1,70 @@
+#include "Bench.h"
+#include <cstring>
+
+struct BenchCommand
+{
+	const char* Name;
+	const char* Usage;
+	int (*Run)(const BenchArgs& args);
+};
+
+static const BenchCommand gCommands[] =
+{
+	{ "bones", "bones [maxBones=1e7] [minSeconds=0.5]", RunBoneThroughputBench },
+	{ "soa", "soa [maxBones=1e7] [minSeconds=0.5] [maxError=1e-5]", RunSoABench },
+	{ "scaling", "scaling [blades=1e6] [maxThreads=hw] [minSeconds=0.5]", RunScalingBench },
+	{ "stress", "stress [maxBlades=1e6] [bonesPerBlade=5]", RunStressBench },
+	{ "sleep", "sleep [blades=1e5] [seconds=10]", RunSleepBench },
+	{ "timestep", "timestep [blades=1e4] [stepRate=60]", RunTimestepBench },
+	{ "lod", "lod [blades=1e6] [minSeconds=0.5]", RunLodBench },
+	{ "wind", "wind [width=256] [height=256] [blades=1e5] [minSeconds=0.5]", RunWindBench },
+	{ "colliders", "colliders [colliders=2000] [blades=1e6] [minSeconds=0.5]", RunColliderBench },
+	{ "scatter", "scatter [blades=1e7] [spacing=0.05] [threads=hw]", RunScatterBench },
+	{ "tiles", "tiles [seconds=5] [speed=30] [radius=128] [budgetMB=64] [workers=2]", RunTileBench },
+	{ "indices", "indices [maxGrid=2048]", RunIndexBench },
+	{ "culling", "culling [maxInstances=1e6] [minSeconds=0.3]", RunCullBench },
+	{ "bvh", "bvh [maxInstances=1e6] [frames=120] [moving=0.1]", RunBvhBench },
+	{ "cull-scaling", "cull-scaling [instances=1e6] [sources=8] [maxThreads=32] [minSeconds=0.3]", RunCullScalingBench },
+	{ "coherence", "coherence [instances=1e5] [frames=600]", RunCoherenceBench },
+	{ "camera", "camera [frames=1e6]", RunCameraBench },
+	{ "occlusion", "occlusion [threads=4] [width=256] [height=128] [cells=64] [instances=200000] [dump=prefix]", RunOcclusionBench },
+	{ "large-world", "large-world [frames=240]", RunLargeWorldBench },
+	{ "terrain", "terrain [size=16384] [frames=600] [pixelError=2]", RunTerrainBench },
+	{ "land", "land [maxSamples=1e8] [threads=hw]", RunLandBench },
+	{ "heightmap", "heightmap [size=16384] [budgetMB=64] [file=heightmap.bin]", RunHeightmapBench },
+	{ "waves", "waves [maxSize=4096] [cellSteps=2e8] [maxError=1e-5]", RunWavesBench },
+	{ "waves-partition", "waves-partition [maxSize=4096] [threads=hw] [pin=0]", RunWavesPartitionBench },
+	{ "waves-steps", "waves-steps [size=1024] [surfaces=16] [threads=hw]", RunWavesStepsBench },
+	{ "golden-write", "golden-write <file> [blades=32] [steps=240]", RunGoldenWrite },
+	{ "golden-verify", "golden-verify <file> [maxUlps=0]", RunGoldenVerify },
+	{ "gpu-verify", "gpu-verify <start> <gpu> [maxError=1e-4]", RunGpuVerify },
+};
+
+static void PrintUsage()
+{
+	printf("usage: GrassBench <command> [args]\n");
+	for (const auto& command : gCommands)
+	{
+		printf("  %s\n", command.Usage);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for (const auto& command : gCommands)
+	{
+		if (strcmp(argv[1], command.Name) == 0)
+		{
+			return command.Run(BenchArgs(argc - 2, argv + 2));
+		}
+	}
+
+	PrintUsage();
+	return 1;
+}
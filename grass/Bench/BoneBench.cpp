@@ -0,0 +1,228 @@
+#include "Bench.h"
+#include "BoneSoA.h"
+#include "GrassSimulation.h"
+#include "GrassDump.h"
+
+static const uint32_t BenchBonesPerBlade = 5;
+static const float BenchDeltaTime = 1.0f / 60.0f;
+static const Float3 BenchWind = { 10.0f, 0.0f, 0.0f };
+
+int RunBoneThroughputBench(const BenchArgs& args)
+{
+	uint64_t maxBones = args.GetUInt(0, 10000000);
+	double minSeconds = args.GetFloat(1, 0.5f);
+
+	GrassStepParams params;
+	params.WindVelocity = BenchWind;
+	params.DeltaTime = BenchDeltaTime;
+
+	printf("%12s %12s %8s %14s\n", "bones", "blades", "steps", "bones/sec");
+
+	for (uint64_t boneCount = 1000; boneCount <= maxBones; boneCount *= 10)
+	{
+		uint32_t bladeCount = (uint32_t)(boneCount / BenchBonesPerBlade);
+		vector<Bone> bones = GrassSimulation::BuildBones(bladeCount, BenchBonesPerBlade);
+
+		// Warm up so the first timed step doesn't pay for page faults.
+		GrassSimulation::Simulate(bones, bladeCount, BenchBonesPerBlade, params);
+
+		uint32_t steps = 0;
+		BenchTimer timer;
+		do
+		{
+			GrassSimulation::Simulate(bones, bladeCount, BenchBonesPerBlade, params);
+			++steps;
+		} while (steps < 3 || timer.ElapsedSeconds() < minSeconds);
+
+		double seconds = timer.ElapsedSeconds();
+		double bonesPerSecond = (double)bones.size() * steps / seconds;
+
+		printf("%12zu %12u %8u %14.4g\n", bones.size(), bladeCount, steps, bonesPerSecond);
+	}
+
+	return 0;
+}
+
+int RunSoABench(const BenchArgs& args)
+{
+	uint64_t maxBones = args.GetUInt(0, 10000000);
+	double minSeconds = args.GetFloat(1, 0.5f);
+	float maxError = args.GetFloat(2, 1e-5f);
+
+	GrassStepParams params;
+	params.WindVelocity = BenchWind;
+	params.DeltaTime = BenchDeltaTime;
+
+	// The two paths are bit-identical only when the compiler keeps multiplies and adds
+	// separate; where it contracts them into FMAs (e.g. -mfma -ffp-contract=fast) each path
+	// rounds differently. So they are checked against an absolute tolerance; ulps are shown
+	// too, but near zero they say little.
+	printf("simd width %d, tolerance %g\n", SimdWidth, maxError);
+	printf("%12s %14s %14s %8s %10s %10s %6s\n", "bones", "aos bones/s", "soa bones/s", "speedup", "max ulp", "max error", "check");
+	bool ok = true;
+
+	for (uint64_t boneCount = 1000; boneCount <= maxBones; boneCount *= 10)
+	{
+		uint32_t bladeCount = (uint32_t)(boneCount / BenchBonesPerBlade);
+		vector<Bone> bones = GrassSimulation::BuildBones(bladeCount, BenchBonesPerBlade);
+
+		BoneSoA soa;
+		soa.FromBones(bones.data(), bladeCount, BenchBonesPerBlade);
+
+		uint32_t aosSteps = 0;
+		BenchTimer aosTimer;
+		do
+		{
+			GrassSimulation::Simulate(bones, bladeCount, BenchBonesPerBlade, params);
+			++aosSteps;
+		} while (aosSteps < 3 || aosTimer.ElapsedSeconds() < minSeconds);
+		double aosRate = (double)bones.size() * aosSteps / aosTimer.ElapsedSeconds();
+
+		uint32_t soaSteps = 0;
+		BenchTimer soaTimer;
+		do
+		{
+			GrassSimulation::Simulate(soa, params);
+			++soaSteps;
+		} while (soaSteps < aosSteps || soaTimer.ElapsedSeconds() < minSeconds);
+		double soaRate = (double)soa.BoneCount() * soaSteps / soaTimer.ElapsedSeconds();
+
+		// Bring both paths to the same step count before comparing them.
+		for (uint32_t i = aosSteps; i < soaSteps; ++i)
+		{
+			GrassSimulation::Simulate(bones, bladeCount, BenchBonesPerBlade, params);
+		}
+
+		GrassDump expected;
+		expected.BladeCount = bladeCount;
+		expected.BonesPerBlade = BenchBonesPerBlade;
+		expected.Bones = move(bones);
+
+		GrassDump actual = expected;
+		soa.ToBones(actual.Bones.data());
+
+		GrassDumpDiff diff = GrassDumpUtil::Compare(expected, actual, UINT32_MAX - 1);
+
+		bool match = diff.LayoutMatches && diff.MaxAbsError <= maxError;
+		ok = ok && match;
+
+		printf("%12zu %14.4g %14.4g %7.2fx %10u %10.3g %6s\n", soa.BoneCount(), aosRate, soaRate, soaRate / aosRate,
+			diff.MaxUlpDistance, diff.MaxAbsError, match ? "PASS" : "FAIL");
+	}
+
+	return ok ? 0 : 1;
+}
+
+// The golden scenario is fully described by the dump header: bones start at rest and are
+// stepped StepCount times with a constant wind and delta time.
+static GrassDump RunGoldenScenario(uint32_t bladeCount, uint32_t bonesPerBlade, uint32_t steps, float deltaTime, const Float3& wind)
+{
+	GrassDump rest;
+	rest.BladeCount = bladeCount;
+	rest.BonesPerBlade = bonesPerBlade;
+	rest.Bones = GrassSimulation::BuildBones(bladeCount, bonesPerBlade);
+
+	return GrassDumpUtil::Replay(rest, steps, deltaTime, wind);
+}
+
+int RunGoldenWrite(const BenchArgs& args)
+{
+	if (args.Count() < 1)
+	{
+		printf("golden-write: missing output file\n");
+		return 1;
+	}
+
+	string filename = args.GetString(0, "");
+	uint32_t bladeCount = (uint32_t)args.GetUInt(1, 32);
+	uint32_t steps = (uint32_t)args.GetUInt(2, 240);
+
+	GrassDump dump = RunGoldenScenario(bladeCount, BenchBonesPerBlade, steps, BenchDeltaTime, BenchWind);
+
+	if (!GrassDumpUtil::Write(filename, dump))
+	{
+		printf("golden-write: failed to write %s\n", filename.c_str());
+		return 1;
+	}
+
+	printf("wrote %s: %u blades x %u bones, %u steps\n", filename.c_str(), bladeCount, BenchBonesPerBlade, steps);
+	return 0;
+}
+
+int RunGoldenVerify(const BenchArgs& args)
+{
+	if (args.Count() < 1)
+	{
+		printf("golden-verify: missing input file\n");
+		return 1;
+	}
+
+	string filename = args.GetString(0, "");
+	uint32_t maxUlps = (uint32_t)args.GetUInt(1, 0);
+
+	GrassDump golden;
+	if (!GrassDumpUtil::Read(filename, golden))
+	{
+		printf("golden-verify: failed to read %s\n", filename.c_str());
+		return 1;
+	}
+
+	GrassDump actual = RunGoldenScenario(golden.BladeCount, golden.BonesPerBlade,
+		golden.StepCount, golden.DeltaTime, golden.WindVelocity);
+
+	GrassDumpDiff diff = GrassDumpUtil::Compare(golden, actual, maxUlps);
+
+	if (!diff.LayoutMatches)
+	{
+		printf("FAIL: layout mismatch\n");
+		return 1;
+	}
+
+	printf("%s: %zu mismatched floats (max %u ulp, tolerance %u)\n",
+		diff.Matches() ? "PASS" : "FAIL", diff.MismatchedFloats, diff.MaxUlpDistance, maxUlps);
+
+	if (!diff.Matches())
+	{
+		printf("first mismatch at bone %zu\n", diff.FirstMismatchedBone);
+		return 1;
+	}
+
+	return 0;
+}
+
+// Checks a GPU dump written by BaseApp's GPU check ('G') against the CPU reference run
+// from the dump taken before the GPU steps.
+int RunGpuVerify(const BenchArgs& args)
+{
+	if (args.Count() < 2)
+	{
+		printf("gpu-verify: missing start or GPU dump\n");
+		return 1;
+	}
+
+	string startFilename = args.GetString(0, "");
+	string gpuFilename = args.GetString(1, "");
+	float maxError = args.GetFloat(2, 1e-4f);
+
+	GrassDump start;
+	GrassDump gpu;
+	if (!GrassDumpUtil::Read(startFilename, start) || !GrassDumpUtil::Read(gpuFilename, gpu))
+	{
+		printf("gpu-verify: failed to read %s or %s\n", startFilename.c_str(), gpuFilename.c_str());
+		return 1;
+	}
+
+	GrassDump expected = GrassDumpUtil::Replay(start, gpu.StepCount, gpu.DeltaTime, gpu.WindVelocity);
+	GrassDumpDiff diff = GrassDumpUtil::Compare(expected, gpu, UINT32_MAX - 1);
+
+	if (!diff.LayoutMatches)
+	{
+		printf("FAIL: layout mismatch\n");
+		return 1;
+	}
+
+	bool ok = diff.MaxAbsError <= maxError;
+	printf("%s: %u blades x %u bones, %u steps, max error %.3g (max %u ulp, tolerance %g)\n", ok ? "PASS" : "FAIL",
+		gpu.BladeCount, gpu.BonesPerBlade, gpu.StepCount, diff.MaxAbsError, diff.MaxUlpDistance, maxError);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "InstanceBvh.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <numeric>
+
+// A camera turning on the spot while a fraction of the instances drift, so every frame
+// refits the tree above the moved instances and culls it against a new frustum.
+int RunBvhBench(const BenchArgs& args)
+{
+	uint32_t maxInstances = (uint32_t)args.GetUInt(0, 1000000);
+	uint32_t frameCount = (uint32_t)args.GetUInt(1, 120);
+	float movingFraction = args.GetFloat(2, 0.1f);
+
+	printf("%10s %8s %9s %9s %9s %9s %9s %9s %9s %8s  %s\n",
+		"instances", "build", "refit", "linear", "bvh", "visited", "inside", "outside", "tested", "rebuilds", "check");
+
+	bool ok = true;
+
+	for (uint32_t instanceCount = 10000; instanceCount <= maxInstances; instanceCount *= 10)
+	{
+		CullScene scene = BuildScene(instanceCount, 2000.0f);
+		BoundsSoA bounds;
+		BuildSceneBounds(scene, bounds);
+
+		BenchTimer buildTimer;
+		InstanceBvh bvh;
+		bvh.Build(bounds);
+		double buildMs = buildTimer.ElapsedMilliseconds();
+
+		uint32_t movingCount = (uint32_t)(movingFraction * instanceCount);
+		minstd_rand rng(11);
+		uniform_real_distribution<float> drift(-0.5f, 0.5f);
+		vector<uint32_t> moved(movingCount);
+		iota(moved.begin(), moved.end(), 0u);
+		vector<Float3> velocities(movingCount);
+		for (auto& velocity : velocities)
+		{
+			velocity = Float3(drift(rng), 0.0f, drift(rng));
+		}
+
+		vector<uint32_t> linear(instanceCount + SimdWidth);
+		vector<uint32_t> tree(instanceCount);
+		double refitMs = 0.0;
+		double linearMs = 0.0;
+		double bvhMs = 0.0;
+		uint32_t rebuilds = 0;
+		BvhCullStats stats;
+		bool same = true;
+
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			// The first movingCount instances drift; their boxes are rewritten in place.
+			for (uint32_t i = 0; i < movingCount; ++i)
+			{
+				Float4x4& world = scene.Worlds[i];
+				world.m[3][0] += velocities[i].x;
+				world.m[3][2] += velocities[i].z;
+				bounds.SetTransformed(i, scene.LocalCenter, scene.LocalExtents, world);
+			}
+
+			BenchTimer refitTimer;
+			bvh.Refit(bounds, moved.data(), movingCount);
+			if (bvh.NeedsRebuild())
+			{
+				bvh.Build(bounds);
+				++rebuilds;
+			}
+			refitMs += refitTimer.ElapsedMilliseconds();
+
+			float yaw = 6.2831853f * frame / frameCount;
+			FrustumPlanes frustum = BuildSceneFrustum(Float3(0.0f, 20.0f, 0.0f), Float3(sinf(yaw), -0.2f, cosf(yaw)));
+
+			BenchTimer linearTimer;
+			uint32_t linearCount = BatchCulling::Cull(frustum, bounds, linear.data());
+			linearMs += linearTimer.ElapsedMilliseconds();
+
+			BenchTimer bvhTimer;
+			uint32_t treeCount = bvh.Cull(frustum, tree.data(), &stats);
+			bvhMs += bvhTimer.ElapsedMilliseconds();
+
+			// Same boxes and planes, so the tree has to find exactly the linear set.
+			sort(tree.begin(), tree.begin() + treeCount);
+			same &= treeCount == linearCount && equal(tree.begin(), tree.begin() + treeCount, linear.begin());
+		}
+
+		ok &= same;
+
+		printf("%10u %5.1f ms %6.3f ms %6.3f ms %6.3f ms %9llu %9llu %9llu %9llu %8u  %s\n",
+			instanceCount, buildMs, refitMs / frameCount, linearMs / frameCount, bvhMs / frameCount,
+			(unsigned long long)(stats.NodesVisited / frameCount), (unsigned long long)(stats.NodesInside / frameCount),
+			(unsigned long long)(stats.NodesOutside / frameCount), (unsigned long long)(stats.InstancesTested / frameCount),
+			rebuilds, same ? "PASS" : "FAIL (bvh != linear)");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include "Bench.h"
+#include "CameraMatrices.h"
+#include "CullScene.h"
+#include <algorithm>
+
+// General 4x4 inverse by cofactors, as XMMatrixInverse computes it; also returns the
+// determinant like XMMatrixDeterminant.
+static Float4x4 GeneralInverse(const Float4x4& matrix, float& determinant)
+{
+	const auto& m = matrix.m;
+
+	float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+	float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+	float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+	float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+	float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+	float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+	float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+	float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+	float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+	float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+	float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+	float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+	determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	float invDet = 1.0f / determinant;
+
+	Float4x4 r;
+	r.m[0][0] = (m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * invDet;
+	r.m[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * invDet;
+	r.m[0][2] = (m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * invDet;
+	r.m[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * invDet;
+
+	r.m[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * invDet;
+	r.m[1][1] = (m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * invDet;
+	r.m[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * invDet;
+	r.m[1][3] = (m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * invDet;
+
+	r.m[2][0] = (m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * invDet;
+	r.m[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * invDet;
+	r.m[2][2] = (m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * invDet;
+	r.m[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * invDet;
+
+	r.m[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * invDet;
+	r.m[3][1] = (m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * invDet;
+	r.m[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * invDet;
+	r.m[3][3] = (m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * invDet;
+	return r;
+}
+
+// Largest difference from the identity of a * b.
+static float IdentityError(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 product = Multiply(a, b);
+	float error = 0.0f;
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			error = max(error, fabsf(product.m[i][j] - (i == j ? 1.0f : 0.0f)));
+		}
+	}
+	return error;
+}
+
+// Orbiting the origin while bobbing, so every frame has a new view.
+static void OrbitPose(uint32_t frame, Float3& position, Float3& right, Float3& up, Float3& look)
+{
+	float angle = 0.01f * frame;
+	position = Float3(200.0f * sinf(angle), 30.0f + 5.0f * sinf(3.0f * angle), -200.0f * cosf(angle));
+	look = Normalize(Float3(0.0f, 10.0f, 0.0f) - position);
+	right = Normalize(Cross(Float3(0.0f, 1.0f, 0.0f), look));
+	up = Cross(look, right);
+}
+
+int RunCameraBench(const BenchArgs& args)
+{
+	uint32_t frameCount = (uint32_t)args.GetUInt(0, 1000000);
+
+	const float FovY = 0.25f * 3.14159265f;
+	const float Aspect = 16.0f / 9.0f;
+
+	// Poses are computed up front so only the camera's matrix work is timed.
+	const uint32_t PoseCount = 1024;
+	struct Pose
+	{
+		Float3 Position, Right, Up, Look;
+	};
+	vector<Pose> poses(PoseCount);
+	for (uint32_t i = 0; i < PoseCount; ++i)
+	{
+		OrbitPose(i, poses[i].Position, poses[i].Right, poses[i].Up, poses[i].Look);
+	}
+
+	// Keeps the compiler from dropping work whose results go unused.
+	float sink = 0.0f;
+
+	// What the frame used to do: the view from the basis, the product, then a general inverse
+	// (and determinant) of each of the three.
+	Float4x4 proj = BuildProj(FovY, Aspect, 1.0f, 1000.0f);
+	BenchTimer recomputeTimer;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		const Pose& pose = poses[frame % PoseCount];
+
+		Float4x4 view = BuildView(pose.Position, pose.Look);
+		Float4x4 viewProj = Multiply(view, proj);
+		float detView, detProj, detViewProj;
+		Float4x4 invView = GeneralInverse(view, detView);
+		Float4x4 invProj = GeneralInverse(proj, detProj);
+		Float4x4 invViewProj = GeneralInverse(viewProj, detViewProj);
+		FrustumPlanes frustum = FrustumPlanes::FromViewProj(viewProj);
+
+		sink += invView.m[3][0] + invProj.m[2][3] + invViewProj.m[3][3] + frustum.Planes[5].w;
+	}
+	double recomputeNs = recomputeTimer.ElapsedSeconds() * 1e9 / frameCount;
+
+	CameraMatrices matrices;
+	matrices.SetLens(FovY, Aspect, 1.0f, 1000.0f);
+
+	BenchTimer movingTimer;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		const Pose& pose = poses[frame % PoseCount];
+
+		matrices.SetView(pose.Position, pose.Right, pose.Up, pose.Look);
+		matrices.Update();
+
+		sink += matrices.InvView().m[3][0] + matrices.InvProj().m[2][3] + matrices.InvViewProj().m[3][3] +
+			matrices.Frustum().Planes[5].w;
+	}
+	double movingNs = movingTimer.ElapsedSeconds() * 1e9 / frameCount;
+
+	// A camera that did not move.
+	BenchTimer stillTimer;
+	for (uint32_t frame = 0; frame < frameCount; ++frame)
+	{
+		matrices.Update();
+
+		sink += matrices.InvView().m[3][0] + matrices.InvProj().m[2][3] + matrices.InvViewProj().m[3][3] +
+			matrices.Frustum().Planes[5].w;
+	}
+	double stillNs = stillTimer.ElapsedSeconds() * 1e9 / frameCount;
+
+	// The cached inverses must invert, as well as general inverses do.
+	float cachedError = 0.0f;
+	float generalError = 0.0f;
+	for (const Pose& pose : poses)
+	{
+		matrices.SetView(pose.Position, pose.Right, pose.Up, pose.Look);
+		matrices.Update();
+
+		cachedError = max(cachedError, IdentityError(matrices.View(), matrices.InvView()));
+		cachedError = max(cachedError, IdentityError(matrices.Proj(), matrices.InvProj()));
+		cachedError = max(cachedError, IdentityError(matrices.ViewProj(), matrices.InvViewProj()));
+
+		float determinant;
+		generalError = max(generalError, IdentityError(matrices.View(), GeneralInverse(matrices.View(), determinant)));
+		generalError = max(generalError, IdentityError(matrices.Proj(), GeneralInverse(matrices.Proj(), determinant)));
+		generalError = max(generalError, IdentityError(matrices.ViewProj(), GeneralInverse(matrices.ViewProj(), determinant)));
+	}
+
+	bool ok = cachedError <= max(1e-4f, 2.0f * generalError);
+
+	printf("%u frames (checksum %g)\n", frameCount, sink);
+	printf("recompute (3 general inverses)  %8.1f ns/frame\n", recomputeNs);
+	printf("cached, camera moving           %8.1f ns/frame  %.1fx\n", movingNs, recomputeNs / movingNs);
+	printf("cached, camera still            %8.1f ns/frame  %.1fx\n", stillNs, recomputeNs / stillNs);
+	printf("max |M * inverse - I|: cached %.2e, general %.2e  %s\n", cachedError, generalError, ok ? "PASS" : "FAIL");
+
+	return ok ? 0 : 1;
+}
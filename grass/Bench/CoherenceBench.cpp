@@ -0,0 +1,103 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "CullingCoherence.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+// A recorded camera path: position and look direction at frame f of frameCount, 60 fps.
+struct CameraPath
+{
+	const char* Name;
+	void (*Pose)(uint32_t frame, Float3& eye, Float3& look);
+};
+
+static const float PathDeltaTime = 1.0f / 60.0f;
+
+static const CameraPath gCameraPaths[] =
+{
+	{ "still", [](uint32_t, Float3& eye, Float3& look)
+		{
+			eye = Float3(0.0f, 20.0f, 0.0f);
+			look = Float3(0.3f, -0.2f, 1.0f);
+		} },
+	// Walking pace straight ahead.
+	{ "walk", [](uint32_t frame, Float3& eye, Float3& look)
+		{
+			eye = Float3(0.0f, 20.0f, 1.5f * PathDeltaTime * frame);
+			look = Float3(0.3f, -0.2f, 1.0f);
+		} },
+	// Running while slowly turning, 20 degrees a second.
+	{ "run-turn", [](uint32_t frame, Float3& eye, Float3& look)
+		{
+			float yaw = 0.35f * PathDeltaTime * frame;
+			eye = Float3(0.0f, 20.0f, 6.0f * PathDeltaTime * frame);
+			look = Float3(sinf(yaw), -0.2f, cosf(yaw));
+		} },
+	// Fast look-around, 90 degrees a second.
+	{ "pan", [](uint32_t frame, Float3& eye, Float3& look)
+		{
+			float yaw = 1.57f * PathDeltaTime * frame;
+			eye = Float3(0.0f, 20.0f, 0.0f);
+			look = Float3(sinf(yaw), -0.2f, cosf(yaw));
+		} },
+};
+
+int RunCoherenceBench(const BenchArgs& args)
+{
+	uint32_t instanceCount = (uint32_t)args.GetUInt(0, 100000);
+	uint32_t frameCount = (uint32_t)args.GetUInt(1, 600);
+
+	CullScene scene = BuildScene(instanceCount, 2000.0f);
+	BoundsSoA bounds;
+	BuildSceneBounds(scene, bounds);
+
+	vector<uint32_t> expected(instanceCount + SimdWidth);
+	vector<uint32_t> visible(instanceCount + SimdWidth);
+
+	// Timed against the SIMD pass the cache stands in for. "SIMD frames" are the frames the
+	// cache handed back to that pass because too little was being reused.
+	printf("%u instances, %u frames per path\n", instanceCount, frameCount);
+	printf("%-9s %12s %8s %12s %10s %10s %8s  %s\n", "path", "plane tests", "reused", "SIMD frames", "SIMD", "coherent",
+		"speedup", "check");
+
+	bool ok = true;
+
+	for (const auto& path : gCameraPaths)
+	{
+		CullingCoherence coherence;
+		coherence.Reset(bounds);
+
+		CoherenceStats stats;
+		double coherentMs = 0.0;
+		double simdMs = 0.0;
+		bool same = true;
+
+		for (uint32_t frame = 0; frame < frameCount; ++frame)
+		{
+			Float3 eye;
+			Float3 look;
+			path.Pose(frame, eye, look);
+			FrustumPlanes frustum = BuildSceneFrustum(eye, look);
+
+			BenchTimer simdTimer;
+			uint32_t expectedCount = BatchCulling::Cull(frustum, bounds, expected.data());
+			simdMs += simdTimer.ElapsedMilliseconds();
+
+			BenchTimer coherentTimer;
+			coherence.BeginFrame(frustum);
+			uint32_t visibleCount = coherence.Cull(bounds, 0, instanceCount, visible.data(), &stats);
+			coherentMs += coherentTimer.ElapsedMilliseconds();
+
+			same &= visibleCount == expectedCount && equal(visible.begin(), visible.begin() + visibleCount, expected.begin());
+		}
+
+		ok &= same;
+
+		printf("%-9s %12.1f %7.1f%% %11.1f%% %7.3f ms %7.3f ms %7.2fx  %s\n", path.Name,
+			(double)stats.PlaneTests / frameCount, 100.0 * stats.Reused / stats.Instances,
+			100.0 * stats.SimdCulled / stats.Instances, simdMs / frameCount,
+			coherentMs / frameCount, simdMs / coherentMs, same ? "PASS" : "FAIL (differs from SIMD)");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+#include "Bench.h"
+#include "GrassChunks.h"
+#include "GrassColliders.h"
+#include "GrassField.h"
+#include "ThreadPool.h"
+#include <cfloat>
+#include <cmath>
+#include <random>
+
+static const float ColliderBenchDeltaTime = 1.0f / 60.0f;
+
+// Spheres and capsules lying on the grass, each drifting in its own direction.
+struct BenchMover
+{
+	GrassCollider Start;
+	Float3 Drift;
+	uint32_t Id = 0;
+};
+
+static void MoveColliders(GrassColliderRegistry& registry, const vector<BenchMover>& movers, float time)
+{
+	for (const auto& mover : movers)
+	{
+		GrassCollider collider = mover.Start;
+		collider.A = collider.A + mover.Drift * time;
+		collider.B = collider.B + mover.Drift * time;
+		registry.Update(mover.Id, collider);
+	}
+}
+
+static double TimeSteps(GrassChunkSimulation& simulation, const GrassStepParams& params, ThreadPool& pool, double minSeconds)
+{
+	uint32_t steps = 0;
+	BenchTimer timer;
+	do
+	{
+		simulation.Step(params, &pool);
+		++steps;
+	} while (steps < 3 || timer.ElapsedSeconds() < minSeconds);
+
+	return timer.ElapsedMilliseconds() / steps;
+}
+
+int RunColliderBench(const BenchArgs& args)
+{
+	uint32_t colliderCount = (uint32_t)args.GetUInt(0, 2000);
+
+	GrassFieldDesc desc;
+	desc.BladeCount = (uint32_t)args.GetUInt(1, 1000000);
+	desc.FieldSize = 10.0f * sqrtf((float)desc.BladeCount / 32.0f);
+	double minSeconds = args.GetFloat(2, 0.5f);
+
+	ThreadPool pool;
+
+	vector<Float3> roots = GrassFieldUtil::BuildRoots(desc, 1);
+	vector<Bone> restBones = GrassSimulation::BuildBones(desc.BladeCount, desc.BonesPerBlade, desc.BoneLength, desc.BoneMass);
+	GrassSimulation::SetBladeRoots(restBones, roots);
+
+	GrassChunkSimulation simulation;
+	simulation.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+
+	GrassLodDesc fullLod;
+	fullLod.RootDistance = FLT_MAX;
+	fullLod.SwayDistance = FLT_MAX;
+	simulation.UpdateLod(Float3(0.0f, 0.0f, 0.0f), fullLod);
+
+	minstd_rand rng(7);
+	uniform_real_distribution<float> position(-0.5f * desc.FieldSize, 0.5f * desc.FieldSize);
+	uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	uniform_real_distribution<float> radius(0.3f, 1.0f);
+
+	GrassColliderRegistry registry;
+	vector<BenchMover> movers(colliderCount);
+	for (uint32_t i = 0; i < colliderCount; ++i)
+	{
+		BenchMover& mover = movers[i];
+		mover.Start.A = Float3(position(rng), 0.5f, position(rng));
+		mover.Start.B = i % 2 == 0 ? mover.Start.A : mover.Start.A + Float3(unit(rng), 0.0f, unit(rng));
+		mover.Start.Radius = radius(rng);
+		mover.Drift = Float3(2.0f * unit(rng), 0.0f, 2.0f * unit(rng));
+		mover.Id = registry.Add(mover.Start);
+	}
+
+	printf("%u colliders, %u blades over %.0f m x %.0f m, %zu chunks, %u threads\n",
+		colliderCount, desc.BladeCount, desc.FieldSize, desc.FieldSize, simulation.Chunks().size(), pool.ThreadCount());
+
+	// Calm air: let the whole field fall asleep first.
+	GrassStepParams params;
+	params.DeltaTime = ColliderBenchDeltaTime;
+	for (uint32_t i = 0; i <= GrassChunkSimulation::SleepSteps; ++i)
+	{
+		simulation.Step(params, &pool);
+	}
+
+	// Frames of moving colliders: registry update, collider-to-chunk mapping, step.
+	uint32_t frames = 0;
+	double mapSeconds = 0.0;
+	double stepSeconds = 0.0;
+	size_t disturbedBlades = 0;
+	BenchTimer totalTimer;
+	do
+	{
+		MoveColliders(registry, movers, frames * ColliderBenchDeltaTime);
+
+		BenchTimer timer;
+		simulation.UpdateColliders(registry.Colliders());
+		mapSeconds += timer.ElapsedSeconds();
+
+		timer.Reset();
+		simulation.Step(params, &pool);
+		stepSeconds += timer.ElapsedSeconds();
+
+		disturbedBlades += simulation.LastStepStats().DisturbedBlades;
+		++frames;
+	} while (frames < 10 || totalTimer.ElapsedSeconds() < minSeconds);
+
+	const GrassStepStats& stats = simulation.LastStepStats();
+	printf("mapping %.3f ms/frame, %zu collider refs, %u colliding chunks\n",
+		1e3 * mapSeconds / frames, simulation.ColliderRefs().size(), stats.CollidingChunks);
+	printf("sleeping field: %.3f ms/step, %zu disturbed blades/step (%.2f%% of the field)\n",
+		1e3 * stepSeconds / frames, disturbedBlades / frames, 100.0 * disturbedBlades / frames / desc.BladeCount);
+
+	// The same chunk mapping by testing every chunk against every collider.
+	float reach = desc.BonesPerBlade * desc.BoneLength;
+	size_t bruteRefs = 0;
+	BenchTimer bruteTimer;
+	for (const auto& chunk : simulation.Chunks())
+	{
+		for (const auto& collider : registry.Colliders())
+		{
+			Float3 colliderMin;
+			Float3 colliderMax;
+			GrassColliderRegistry::Bounds(collider, colliderMin, colliderMax);
+
+			if (colliderMax.x < chunk.BoundsMin.x - reach || colliderMin.x > chunk.BoundsMax.x + reach ||
+				colliderMax.y < chunk.BoundsMin.y || colliderMin.y > chunk.BoundsMax.y + reach ||
+				colliderMax.z < chunk.BoundsMin.z - reach || colliderMin.z > chunk.BoundsMax.z + reach)
+			{
+				continue;
+			}
+			++bruteRefs;
+		}
+	}
+	printf("brute force chunk mapping %.3f ms, %zu refs from chunk bounds\n", bruteTimer.ElapsedMilliseconds(), bruteRefs);
+
+	// Cost of the collision torque itself, with every blade awake in steady wind.
+	simulation.SetSleepEnabled(false);
+	params.WindVelocity = Float3(5.0f, 0.0f, 0.0f);
+
+	double collideMs = TimeSteps(simulation, params, pool, minSeconds);
+	simulation.UpdateColliders(vector<GrassCollider>());
+	double freeMs = TimeSteps(simulation, params, pool, minSeconds);
+
+	printf("awake field: %.2f ms/step without colliders, %.2f ms/step with (%.1f%% slower)\n",
+		freeMs, collideMs, 100.0 * (collideMs / freeMs - 1.0));
+
+	return 0;
+}
@@ -0,0 +1,100 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+// The per-instance path: bring the frustum into the instance's local space and test the
+// untransformed local box. Exact for the local box, but every instance pays for moving six
+// planes and a branchy early-out test.
+static uint32_t CullPerInstance(const FrustumPlanes& frustum, const CullScene& scene, uint32_t* visible)
+{
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = 0; i < (uint32_t)scene.Worlds.size(); ++i)
+	{
+		const auto& m = scene.Worlds[i].m;
+
+		FrustumPlanes local;
+		for (int p = 0; p < 6; ++p)
+		{
+			// p_world = p_local * W, so the local plane is W times the plane column.
+			const Float4& plane = frustum.Planes[p];
+			local.Planes[p] = Float4(
+				m[0][0] * plane.x + m[0][1] * plane.y + m[0][2] * plane.z,
+				m[1][0] * plane.x + m[1][1] * plane.y + m[1][2] * plane.z,
+				m[2][0] * plane.x + m[2][1] * plane.y + m[2][2] * plane.z,
+				m[3][0] * plane.x + m[3][1] * plane.y + m[3][2] * plane.z + plane.w);
+		}
+
+		if (BatchCulling::IsBoxVisible(local, scene.LocalCenter, scene.LocalExtents))
+		{
+			visible[visibleCount++] = i;
+		}
+	}
+
+	return visibleCount;
+}
+
+template <typename CullFunc>
+static double TimeCull(CullFunc cull, double minSeconds, uint32_t& visibleCount)
+{
+	uint32_t runs = 0;
+	BenchTimer timer;
+	do
+	{
+		visibleCount = cull();
+		++runs;
+	} while (runs < 3 || timer.ElapsedSeconds() < minSeconds);
+
+	return timer.ElapsedMilliseconds() / runs;
+}
+
+int RunCullBench(const BenchArgs& args)
+{
+	uint32_t maxInstances = (uint32_t)args.GetUInt(0, 1000000);
+	double minSeconds = args.GetFloat(1, 0.3f);
+
+	FrustumPlanes frustum = BuildSceneFrustum(Float3(0.0f, 20.0f, 0.0f), Float3(0.3f, -0.2f, 1.0f));
+
+	printf("SIMD width %d\n", SimdWidth);
+	printf("%10s %9s %14s %12s %12s %12s %9s  %s\n",
+		"instances", "visible", "per-instance", "bounds", "batch", "batch SIMD", "speedup", "check");
+
+	bool ok = true;
+
+	for (uint32_t instanceCount = 10000; instanceCount <= maxInstances; instanceCount *= 10)
+	{
+		CullScene scene = BuildScene(instanceCount, 2000.0f);
+
+		vector<uint32_t> exact(instanceCount);
+		vector<uint32_t> scalar(instanceCount);
+		vector<uint32_t> batch(instanceCount + SimdWidth);
+		uint32_t exactCount = 0;
+		uint32_t scalarCount = 0;
+		uint32_t batchCount = 0;
+
+		double perInstanceMs = TimeCull([&]() { return CullPerInstance(frustum, scene, exact.data()); }, minSeconds, exactCount);
+
+		BoundsSoA bounds;
+		BenchTimer boundsTimer;
+		BuildSceneBounds(scene, bounds);
+		double boundsMs = boundsTimer.ElapsedMilliseconds();
+
+		double scalarMs = TimeCull([&]() { return BatchCulling::CullScalar(frustum, bounds, 0, instanceCount, scalar.data()); },
+			minSeconds, scalarCount);
+		double batchMs = TimeCull([&]() { return BatchCulling::Cull(frustum, bounds, batch.data()); }, minSeconds, batchCount);
+
+		// SIMD and scalar batch agree exactly; the world AABBs may keep extra instances but
+		// must never drop one the exact local-space test keeps.
+		bool same = scalarCount == batchCount && equal(scalar.begin(), scalar.begin() + scalarCount, batch.begin());
+		bool conservative = includes(batch.begin(), batch.begin() + batchCount, exact.begin(), exact.begin() + exactCount);
+		ok &= same && conservative;
+
+		printf("%10u %9u %11.3f ms %9.3f ms %9.3f ms %9.3f ms %8.1fx  %s (+%u from AABBs)\n",
+			instanceCount, batchCount, perInstanceMs, boundsMs, scalarMs, batchMs, perInstanceMs / batchMs,
+			!same ? "FAIL (SIMD != scalar)" : (!conservative ? "FAIL (false negative)" : "PASS"),
+			batchCount - exactCount);
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "CullingPass.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+// Instances split across several sources like the render items of a frame; every other
+// source goes through a BVH. Each run culls all of them and gathers the visible world
+// matrices (transposed, as uploaded) into one preallocated array.
+int RunCullScalingBench(const BenchArgs& args)
+{
+	uint32_t instanceCount = (uint32_t)args.GetUInt(0, 1000000);
+	uint32_t sourceCount = max(1u, (uint32_t)args.GetUInt(1, 8));
+	uint32_t maxThreads = (uint32_t)args.GetUInt(2, 32);
+	double minSeconds = args.GetFloat(3, 0.3f);
+
+	CullScene scene = BuildScene(instanceCount, 2000.0f);
+	FrustumPlanes frustum = BuildSceneFrustum(Float3(0.0f, 20.0f, 0.0f), Float3(0.3f, -0.2f, 1.0f));
+
+	// Source s holds the instances [first[s], first[s + 1]).
+	vector<uint32_t> first(sourceCount + 1);
+	vector<BoundsSoA> bounds(sourceCount);
+	vector<InstanceBvh> bvhs(sourceCount);
+	vector<CullingSource> sources(sourceCount);
+
+	for (uint32_t s = 0; s < sourceCount; ++s)
+	{
+		first[s] = (uint32_t)((uint64_t)instanceCount * s / sourceCount);
+		first[s + 1] = (uint32_t)((uint64_t)instanceCount * (s + 1) / sourceCount);
+
+		bounds[s].Resize(first[s + 1] - first[s]);
+		for (uint32_t i = first[s]; i < first[s + 1]; ++i)
+		{
+			bounds[s].SetTransformed(i - first[s], scene.LocalCenter, scene.LocalExtents, scene.Worlds[i]);
+		}
+
+		sources[s].Bounds = &bounds[s];
+		if (s % 2 == 1)
+		{
+			bvhs[s].Build(bounds[s]);
+			sources[s].Bvh = &bvhs[s];
+		}
+	}
+
+	// The serial answer for every source.
+	vector<vector<uint32_t>> expected(sourceCount);
+	for (uint32_t s = 0; s < sourceCount; ++s)
+	{
+		expected[s].resize(bounds[s].Count() + SimdWidth);
+		uint32_t count = sources[s].Bvh ?
+			bvhs[s].Cull(frustum, expected[s].data()) :
+			BatchCulling::Cull(frustum, bounds[s], expected[s].data());
+		expected[s].resize(count);
+	}
+
+	printf("%u instances in %u sources, hardware threads %u\n", instanceCount, sourceCount, ThreadPool::HardwareThreadCount());
+	printf("%8s %6s %9s %11s %11s %8s  %s\n", "threads", "jobs", "visible", "cull", "gather", "speedup", "check");
+
+	bool ok = true;
+	double baseMs = 0.0;
+	vector<Float4x4> visibleWorlds;
+
+	for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount *= 2)
+	{
+		ThreadPool pool(threadCount);
+		CullingPass pass;
+
+		uint32_t runs = 0;
+		double cullMs = 0.0;
+		double gatherMs = 0.0;
+		BenchTimer timer;
+		do
+		{
+			BenchTimer cullTimer;
+			pass.Run(frustum, sources, &pool);
+			cullMs += cullTimer.ElapsedMilliseconds();
+
+			BenchTimer gatherTimer;
+			visibleWorlds.resize(pass.TotalVisible());
+			pass.ForEachVisible(&pool, [&](uint32_t s, uint32_t begin, uint32_t count)
+			{
+				const uint32_t* visible = pass.Visible(s);
+				Float4x4* out = visibleWorlds.data() + pass.VisibleOffset(s);
+				for (uint32_t i = begin; i < begin + count; ++i)
+				{
+					const Float4x4& world = scene.Worlds[first[s] + visible[i]];
+					for (int r = 0; r < 4; ++r)
+					{
+						for (int c = 0; c < 4; ++c)
+						{
+							out[i].m[r][c] = world.m[c][r];
+						}
+					}
+				}
+			});
+			gatherMs += gatherTimer.ElapsedMilliseconds();
+
+			++runs;
+		} while (runs < 3 || timer.ElapsedSeconds() < minSeconds);
+
+		bool same = true;
+		for (uint32_t s = 0; s < sourceCount; ++s)
+		{
+			same &= pass.VisibleCount(s) == expected[s].size() &&
+				equal(expected[s].begin(), expected[s].end(), pass.Visible(s));
+		}
+		ok &= same;
+
+		double totalMs = (cullMs + gatherMs) / runs;
+		if (threadCount == 1)
+		{
+			baseMs = totalMs;
+		}
+
+		printf("%8u %6u %9u %8.3f ms %8.3f ms %7.2fx  %s\n", threadCount, pass.JobCount(), pass.TotalVisible(),
+			cullMs / runs, gatherMs / runs, baseMs / totalMs, same ? "PASS" : "FAIL (differs from serial)");
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "BatchCulling.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Left-handed look-to view and perspective projection, as XMMatrixLookToLH and
+// XMMatrixPerspectiveFovLH build them.
+inline Float4x4 BuildView(const Float3& eye, const Float3& look)
+{
+	Float3 z = Normalize(look);
+	Float3 x = Normalize(Cross(Float3(0.0f, 1.0f, 0.0f), z));
+	Float3 y = Cross(z, x);
+
+	Float4x4 view = Float4x4::Identity();
+	view.m[0][0] = x.x; view.m[0][1] = y.x; view.m[0][2] = z.x;
+	view.m[1][0] = x.y; view.m[1][1] = y.y; view.m[1][2] = z.y;
+	view.m[2][0] = x.z; view.m[2][1] = y.z; view.m[2][2] = z.z;
+	view.m[3][0] = -Dot(x, eye);
+	view.m[3][1] = -Dot(y, eye);
+	view.m[3][2] = -Dot(z, eye);
+	return view;
+}
+
+inline Float4x4 BuildProj(float fovY, float aspect, float nearZ, float farZ)
+{
+	float yScale = 1.0f / tanf(0.5f * fovY);
+
+	Float4x4 proj;
+	proj.m[0][0] = yScale / aspect;
+	proj.m[1][1] = yScale;
+	proj.m[2][2] = farZ / (farZ - nearZ);
+	proj.m[2][3] = 1.0f;
+	proj.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+	return proj;
+}
+
+// Instances of one mesh, each with a random yaw, scale and position.
+struct CullScene
+{
+	Float3 LocalCenter;
+	Float3 LocalExtents;
+	vector<Float4x4> Worlds;
+};
+
+inline CullScene BuildScene(uint32_t instanceCount, float fieldSize)
+{
+	CullScene scene;
+	scene.LocalCenter = Float3(0.0f, 1.0f, 0.0f);
+	scene.LocalExtents = Float3(0.5f, 1.0f, 0.25f);
+	scene.Worlds.resize(instanceCount);
+
+	minstd_rand rng(3);
+	uniform_real_distribution<float> position(-0.5f * fieldSize, 0.5f * fieldSize);
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	for (auto& world : scene.Worlds)
+	{
+		float yaw = angle(rng);
+		float s = scale(rng);
+
+		world = Float4x4::Identity();
+		world.m[0][0] = s * cosf(yaw);
+		world.m[0][2] = -s * sinf(yaw);
+		world.m[1][1] = s;
+		world.m[2][0] = s * sinf(yaw);
+		world.m[2][2] = s * cosf(yaw);
+		world.m[3][0] = position(rng);
+		world.m[3][1] = 0.2f * position(rng);
+		world.m[3][2] = position(rng);
+	}
+
+	return scene;
+}
+
+// The camera the culling benches share: 45 degree fov, 16:9, 1 to 1000 metres.
+inline FrustumPlanes BuildSceneFrustum(const Float3& eye, const Float3& look)
+{
+	Float4x4 viewProj = Multiply(BuildView(eye, look), BuildProj(0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 1000.0f));
+	return FrustumPlanes::FromViewProj(viewProj);
+}
+
+inline void BuildSceneBounds(const CullScene& scene, BoundsSoA& bounds)
+{
+	bounds.Resize((uint32_t)scene.Worlds.size());
+	for (uint32_t i = 0; i < (uint32_t)scene.Worlds.size(); ++i)
+	{
+		bounds.SetTransformed(i, scene.LocalCenter, scene.LocalExtents, scene.Worlds[i]);
+	}
+}
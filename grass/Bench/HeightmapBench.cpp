@@ -0,0 +1,210 @@
+#include "Bench.h"
+#include "HeightmapTerrain.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+// Kilometre-scale swells with metre-scale detail, inside +-160 m.
+static float SwellHeight(float x, float z)
+{
+	return 120.0f * sinf(0.0009f * x) * cosf(0.0012f * z) +
+		30.0f * sinf(0.0067f * x + 0.6f) * sinf(0.0059f * z) +
+		6.0f * cosf(0.029f * x) * sinf(0.025f * z + 1.3f) +
+		1.0f * sinf(0.15f * x + 0.11f * z);
+}
+
+int RunHeightmapBench(const BenchArgs& args)
+{
+	uint32_t size = (uint32_t)args.GetUInt(0, 16384);
+	size_t budget = (size_t)args.GetUInt(1, 64) << 20;
+	string path = args.GetString(2, "heightmap.bin");
+
+	const uint32_t AccuracySamples = 100000;
+	const uint32_t WalkFrames = 600;
+	const uint32_t WindowSamples = 512;
+	const float WindowSpacing = 2.0f;
+	const uint32_t SweepStride = 2;
+
+	ThreadPool pool;
+
+	HeightmapDesc desc;
+	desc.Width = size;
+	desc.Height = size;
+	desc.MinX = -0.5f * size;
+	desc.MinZ = -0.5f * size;
+	desc.CellSize = 1.0f;
+	desc.MinHeight = -160.0f;
+	desc.MaxHeight = 160.0f;
+
+	BenchTimer writeTimer;
+	if (!HeightmapTerrain::Write(path, desc, SwellHeight, &pool))
+	{
+		printf("can't write %s\n", path.c_str());
+		return 1;
+	}
+	double writeSeconds = writeTimer.ElapsedSeconds();
+	uint64_t fileBytes = (uint64_t)ifstream(path, ios::binary | ios::ate).tellg();
+
+	HeightmapTerrain map;
+	if (!map.Open(path, budget))
+	{
+		printf("can't open %s\n", path.c_str());
+		return 1;
+	}
+
+	uint64_t level0Tiles = (uint64_t)((size - 2) / desc.TileSize + 1) * ((size - 2) / desc.TileSize + 1);
+	printf("%ux%u samples, %u levels, %llu level-0 tiles of %zu KB; wrote %.1f MB in %.2f s (%u threads)\n", size, size,
+		map.LevelCount(), (unsigned long long)level0Tiles, map.TileBytes() >> 10, fileBytes / 1048576.0, writeSeconds,
+		pool.ThreadCount());
+	printf("budget %.0f MB (%zu tiles)\n", budget / 1048576.0, max((size_t)1, budget / map.TileBytes()));
+
+	// Sample points must come back to within half a 16-bit step; points between samples
+	// also carry the bilinear error. Every coarser level must hold exactly the level-0
+	// sample under each of its own.
+	float step = (desc.MaxHeight - desc.MinHeight) / 65535.0f;
+	float extent = (float)(size - 1) * desc.CellSize;
+	minstd_rand rng(5);
+	uniform_int_distribution<uint32_t> sampleIndex(0, size - 1);
+	// Clear of the edges, where the normals' differences are clamped.
+	uniform_real_distribution<float> position(2.0f * desc.CellSize, extent - 2.0f * desc.CellSize);
+
+	float sampleError = 0.0f;
+	float pointError = 0.0f;
+	float normalError = 0.0f;
+	uint32_t mipMismatches = 0;
+	for (uint32_t k = 0; k < AccuracySamples; ++k)
+	{
+		float sx = desc.MinX + sampleIndex(rng) * desc.CellSize;
+		float sz = desc.MinZ + sampleIndex(rng) * desc.CellSize;
+		sampleError = max(sampleError, fabsf(map.GetHeight(sx, sz) - SwellHeight(sx, sz)));
+
+		float px = desc.MinX + position(rng);
+		float pz = desc.MinZ + position(rng);
+		pointError = max(pointError, fabsf(map.GetHeight(px, pz) - SwellHeight(px, pz)));
+
+		const float d = 0.01f;
+		Float3 analytic = Normalize(Float3((SwellHeight(px - d, pz) - SwellHeight(px + d, pz)) / (2.0f * d), 1.0f,
+			(SwellHeight(px, pz - d) - SwellHeight(px, pz + d)) / (2.0f * d)));
+		normalError = max(normalError, Length(map.GetNormal(px, pz) - analytic));
+
+		uint32_t level = 1 + k % (map.LevelCount() - 1);
+		uint32_t stride = 1u << level;
+		float mx = desc.MinX + min(sampleIndex(rng) / stride * stride, size - 1) * desc.CellSize;
+		float mz = desc.MinZ + min(sampleIndex(rng) / stride * stride, size - 1) * desc.CellSize;
+		mipMismatches += map.GetHeight(mx, mz, level) != map.GetHeight(mx, mz) ? 1 : 0;
+	}
+
+	printf("accuracy over %u points: samples %.4f m (half step %.4f m), between samples %.4f m, normals %.4f, "
+		"%u coarse samples off their level-0 sample\n", AccuracySamples, sampleError, 0.5f * step, pointError, normalError,
+		mipMismatches);
+
+	// A camera crossing the map corner to corner, sampling a window around itself each
+	// frame, rows spread over the pool.
+	vector<float> windowHeights((size_t)WindowSamples * WindowSamples);
+	double walkMs = 0.0;
+	double maxFrameMs = 0.0;
+	HeightmapStats beforeWalk = map.Stats();
+
+	for (uint32_t frame = 0; frame < WalkFrames; ++frame)
+	{
+		float t = (float)frame / (WalkFrames - 1);
+		float cx = desc.MinX + t * extent;
+		float cz = desc.MinZ + (0.5f + 0.4f * sinf(6.2831853f * t)) * extent;
+		float originX = cx - 0.5f * WindowSamples * WindowSpacing;
+		float originZ = cz - 0.5f * WindowSamples * WindowSpacing;
+
+		BenchTimer frameTimer;
+		pool.ParallelFor(WindowSamples, [&](uint32_t j)
+		{
+			float xs[WindowSamples];
+			float zs[WindowSamples];
+			for (uint32_t i = 0; i < WindowSamples; ++i)
+			{
+				xs[i] = originX + i * WindowSpacing;
+				zs[i] = originZ + j * WindowSpacing;
+			}
+			map.GetHeights(xs, zs, WindowSamples, &windowHeights[(size_t)j * WindowSamples]);
+		});
+		double frameMs = frameTimer.ElapsedMilliseconds();
+		walkMs += frameMs;
+		maxFrameMs = max(maxFrameMs, frameMs);
+	}
+
+	HeightmapStats afterWalk = map.Stats();
+	printf("walk: %u frames of %ux%u samples, %.3f ms mean, %.3f ms max (%.3g samples/s); %llu tile loads, "
+		"%llu evictions, %llu page faults\n", WalkFrames, WindowSamples, WindowSamples, walkMs / WalkFrames, maxFrameMs,
+		(double)WindowSamples * WindowSamples * WalkFrames / (walkMs * 0.001),
+		(unsigned long long)(afterWalk.TileLoads - beforeWalk.TileLoads),
+		(unsigned long long)(afterWalk.TileEvictions - beforeWalk.TileEvictions),
+		(unsigned long long)(afterWalk.PageFaults - beforeWalk.PageFaults));
+
+	// Every tile of level 0, a row at a time: far more than the budget passes through, the
+	// process's resident set must not grow by more than the budget.
+	ProcessMemoryCounters beforeSweep = MappedFile::QueryProcessMemory();
+	uint64_t peakResident = beforeSweep.ResidentBytes;
+	uint32_t sweepCount = (size + SweepStride - 1) / SweepStride;
+	vector<float> xs(sweepCount);
+	vector<float> zs(sweepCount);
+	vector<float> heights(sweepCount);
+	for (uint32_t i = 0; i < sweepCount; ++i)
+	{
+		xs[i] = desc.MinX + i * SweepStride * desc.CellSize;
+	}
+
+	BenchTimer sweepTimer;
+	for (uint32_t j = 0; j < sweepCount; ++j)
+	{
+		fill(zs.begin(), zs.end(), desc.MinZ + j * SweepStride * desc.CellSize);
+		map.GetHeights(xs.data(), zs.data(), sweepCount, heights.data());
+		if (j % 64 == 0)
+		{
+			peakResident = max(peakResident, MappedFile::QueryProcessMemory().ResidentBytes);
+		}
+	}
+	double sweepSeconds = sweepTimer.ElapsedSeconds();
+
+	HeightmapStats afterSweep = map.Stats();
+	uint64_t residentGrowth = peakResident - beforeSweep.ResidentBytes;
+	printf("sweep: %.3g samples in %.2f s (%.3g samples/s); %llu tile loads, %llu evictions, %llu page faults; "
+		"tiles peak %.1f MB, process resident set grew %.1f MB\n", (double)sweepCount * sweepCount, sweepSeconds,
+		(double)sweepCount * sweepCount / sweepSeconds, (unsigned long long)(afterSweep.TileLoads - afterWalk.TileLoads),
+		(unsigned long long)(afterSweep.TileEvictions - afterWalk.TileEvictions),
+		(unsigned long long)(afterSweep.PageFaults - afterWalk.PageFaults), afterSweep.PeakResidentBytes / 1048576.0,
+		residentGrowth / 1048576.0);
+
+	// The heightmap as a TerrainQuadtree's height source.
+	TerrainQuadtreeDesc terrainDesc;
+	terrainDesc.MinX = desc.MinX;
+	terrainDesc.MinZ = desc.MinZ;
+	terrainDesc.Size = 1.0f;
+	while (terrainDesc.Size * 2.0f <= extent)
+	{
+		terrainDesc.Size *= 2.0f;
+	}
+	terrainDesc.Height = [&map](float x, float z) { return map.GetHeight(x, z); };
+	terrainDesc.HeightBatch = [&map](const float* x, const float* z, size_t count, float* out)
+	{
+		map.GetHeights(x, z, count, out);
+	};
+
+	TerrainQuadtree terrain;
+	BenchTimer buildTimer;
+	terrain.Build(terrainDesc, &pool);
+	printf("quadtree over %.0f m: %u levels, leaf error %.3f m, built in %.1f ms\n", terrainDesc.Size, terrain.LodCount(),
+		terrain.LevelError(0), buildTimer.ElapsedMilliseconds());
+
+	HeightmapStats total = map.Stats();
+	bool ok = sampleError <= 0.5f * step + 1e-4f && pointError < 0.02f && normalError < 0.02f && mipMismatches == 0 &&
+		total.PeakResidentBytes <= max(budget, map.TileBytes()) && afterSweep.TileLoads >= level0Tiles &&
+		residentGrowth <= budget + (16ull << 20);
+	printf("peak %u tiles mapped (%.1f MB), %llu loads, %llu evictions in all\n", total.PeakResidentTiles,
+		total.PeakResidentBytes / 1048576.0, (unsigned long long)total.TileLoads, (unsigned long long)total.TileEvictions);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+
+	map.Close();
+	remove(path.c_str());
+	return ok ? 0 : 1;
+}
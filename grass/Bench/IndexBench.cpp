@@ -0,0 +1,93 @@
+#include "Bench.h"
+#include "MeshIndexUtil.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+// Triangle list of an m x n vertex grid, laid out like GeometryGenerator::CreateGrid.
+static vector<uint32_t> BuildGridIndices(uint32_t m, uint32_t n)
+{
+	vector<uint32_t> indices;
+	indices.reserve((size_t)(m - 1) * (n - 1) * 6);
+
+	for (uint32_t i = 0; i < m - 1; ++i)
+	{
+		for (uint32_t j = 0; j < n - 1; ++j)
+		{
+			indices.push_back(i * n + j);
+			indices.push_back(i * n + j + 1);
+			indices.push_back((i + 1) * n + j);
+
+			indices.push_back((i + 1) * n + j);
+			indices.push_back(i * n + j + 1);
+			indices.push_back((i + 1) * n + j + 1);
+		}
+	}
+
+	return indices;
+}
+
+static bool CheckPacking(const char* name, const vector<uint32_t>& indices, uint32_t vertexCount,
+	uint32_t primitiveSize, bool allowSplit, uint32_t expectedIndexSize)
+{
+	BenchTimer timer;
+	PackedMeshIndices packed = MeshIndexUtil::Pack(indices, primitiveSize, allowSplit);
+	double packMs = timer.ElapsedMilliseconds();
+
+	bool roundTrips = MeshIndexUtil::Unpack(packed) == indices;
+	bool ok = roundTrips && packed.IndexSize == expectedIndexSize;
+
+	printf("%-22s %10u %11zu %6u-bit %7zu %9.2f MB %9.2f MB %8.2f ms  %s\n",
+		name, vertexCount, indices.size(), packed.IndexSize * 8, packed.Ranges.size(),
+		packed.Bytes.size() / 1048576.0, indices.size() * 4 / 1048576.0, packMs,
+		ok ? "PASS" : (roundTrips ? "FAIL (format)" : "FAIL (indices)"));
+
+	return ok;
+}
+
+int RunIndexBench(const BenchArgs& args)
+{
+	uint32_t maxGrid = (uint32_t)args.GetUInt(0, 2048);
+
+	printf("%-22s %10s %11s %10s %7s %12s %12s %11s\n",
+		"mesh", "vertices", "indices", "format", "draws", "packed", "as 32-bit", "pack");
+
+	bool ok = true;
+
+	// The land grid as built today, then grids past the 16-bit limit.
+	ok &= CheckPacking("grid 50x50", BuildGridIndices(50, 50), 50 * 50, 3, true, 2);
+	ok &= CheckPacking("grid 256x256", BuildGridIndices(256, 256), 256 * 256, 3, true, 2);
+	ok &= CheckPacking("grid 257x257", BuildGridIndices(257, 257), 257 * 257, 3, true, 2);
+
+	char name[64];
+	snprintf(name, sizeof(name), "grid %ux%u", maxGrid, maxGrid);
+	ok &= CheckPacking(name, BuildGridIndices(maxGrid, maxGrid), maxGrid * maxGrid, 3, true, 2);
+
+	// Rows longer than 65536 vertices: a single triangle spans too much for 16 bits.
+	ok &= CheckPacking("grid 4x70000", BuildGridIndices(4, 70000), 4 * 70000, 3, true, 4);
+
+	// No locality: vertex ids shuffled, so ranges would be tiny.
+	{
+		uint32_t n = 512;
+		vector<uint32_t> indices = BuildGridIndices(n, n);
+		vector<uint32_t> remap(n * n);
+		iota(remap.begin(), remap.end(), 0);
+		shuffle(remap.begin(), remap.end(), minstd_rand(1));
+		for (auto& index : indices)
+		{
+			index = remap[index];
+		}
+		ok &= CheckPacking("shuffled grid 512x512", indices, n * n, 3, true, 4);
+	}
+
+	// Grass points are drawn in one call, so they switch to 32-bit past 65536 blades.
+	for (uint32_t blades : { 65536u, 65537u })
+	{
+		vector<uint32_t> indices(blades);
+		iota(indices.begin(), indices.end(), 0);
+		snprintf(name, sizeof(name), "grass points %u", blades);
+		ok &= CheckPacking(name, indices, blades, 1, false, blades <= MeshIndexUtil::MaxVertexSpan16 ? 2 : 4);
+	}
+
+	return ok ? 0 : 1;
+}
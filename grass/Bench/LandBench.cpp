@@ -0,0 +1,135 @@
+#include "Bench.h"
+#include "LandUtility.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// One pass over a grid of samples, a band of rows at a time so 1e8 samples don't need
+// gigabytes of output.
+struct LandBand
+{
+	vector<float> X;
+	vector<float> Z;
+	vector<float> Heights;
+	vector<float> NormalX;
+	vector<float> NormalY;
+	vector<float> NormalZ;
+
+	void Resize(size_t count)
+	{
+		for (auto* v : { &X, &Z, &Heights, &NormalX, &NormalY, &NormalZ })
+		{
+			v->resize(count);
+		}
+	}
+};
+
+int RunLandBench(const BenchArgs& args)
+{
+	uint64_t maxSamples = args.GetUInt(0, 100000000);
+	uint32_t threads = (uint32_t)args.GetUInt(1, 0);
+
+	// Samples spread over the same 8 km square at every size; the scalar path is timed (and
+	// the batch paths checked against it) over the first ScalarSamples of each.
+	const float Extent = 8192.0f;
+	const uint64_t ScalarSamples = 4000000;
+	const size_t BandSamples = 1 << 20;
+
+	ThreadPool pool(threads);
+	printf("heights + normals over %.0f m x %.0f m, %u threads\n", Extent, Extent, pool.ThreadCount());
+	printf("%10s  %14s  %14s  %14s  %12s  %12s\n", "samples", "scalar (M/s)", "span (M/s)", "grid (M/s)",
+		"height err", "normal err");
+
+	bool ok = true;
+	for (uint64_t samples = 1000000; samples <= maxSamples; samples *= 10)
+	{
+		uint32_t width = (uint32_t)ceil(sqrt((double)samples));
+		uint32_t height = (uint32_t)((samples + width - 1) / width);
+		float spacing = Extent / width;
+		float minX = -0.5f * Extent;
+		float minZ = -0.5f * Extent;
+		uint32_t bandRows = max(1u, (uint32_t)(BandSamples / width));
+
+		LandBand reference;
+		LandBand span;
+		LandBand grid;
+		reference.Resize((size_t)bandRows * width);
+		span.Resize((size_t)bandRows * width);
+		grid.Resize((size_t)bandRows * width);
+
+		double scalarSeconds = 0.0;
+		double spanSeconds = 0.0;
+		double gridSeconds = 0.0;
+		uint64_t scalarCount = 0;
+		// Height error relative to the size of the terms (0.3 |x| + 0.3 |z|), which bounds
+		// how far rounding in either path can move it.
+		float heightError = 0.0f;
+		float normalError = 0.0f;
+
+		for (uint32_t row = 0; row < height; row += bandRows)
+		{
+			uint32_t rows = min(bandRows, height - row);
+			size_t count = (size_t)rows * width;
+			float bandZ = minZ + row * spacing;
+
+			for (uint32_t j = 0; j < rows; ++j)
+			{
+				for (uint32_t i = 0; i < width; ++i)
+				{
+					span.X[(size_t)j * width + i] = minX + i * spacing;
+					span.Z[(size_t)j * width + i] = bandZ + j * spacing;
+				}
+			}
+
+			BenchTimer spanTimer;
+			LandUtility::GetHillsHeights(span.X.data(), span.Z.data(), count, span.Heights.data());
+			LandUtility::GetHillsNormals(span.X.data(), span.Z.data(), count, span.NormalX.data(), span.NormalY.data(),
+				span.NormalZ.data());
+			spanSeconds += spanTimer.ElapsedSeconds();
+
+			BenchTimer gridTimer;
+			LandUtility::GetHillsGrid(minX, bandZ, spacing, width, rows, grid.Heights.data(), grid.NormalX.data(),
+				grid.NormalY.data(), grid.NormalZ.data(), &pool);
+			gridSeconds += gridTimer.ElapsedSeconds();
+
+			if (scalarCount >= ScalarSamples)
+			{
+				continue;
+			}
+
+			BenchTimer scalarTimer;
+			for (size_t k = 0; k < count; ++k)
+			{
+				reference.Heights[k] = LandUtility::GetHillsHeight(span.X[k], span.Z[k]);
+				Float3 n = LandUtility::GetHillsNormal(span.X[k], span.Z[k]);
+				reference.NormalX[k] = n.x;
+				reference.NormalY[k] = n.y;
+				reference.NormalZ[k] = n.z;
+			}
+			scalarSeconds += scalarTimer.ElapsedSeconds();
+			scalarCount += count;
+
+			for (size_t k = 0; k < count; ++k)
+			{
+				float scale = 0.3f * (fabsf(span.X[k]) + fabsf(span.Z[k])) + 1.0f;
+				for (const LandBand* batch : { &span, &grid })
+				{
+					heightError = max(heightError, fabsf(batch->Heights[k] - reference.Heights[k]) / scale);
+					normalError = max(normalError, fabsf(batch->NormalX[k] - reference.NormalX[k]));
+					normalError = max(normalError, fabsf(batch->NormalY[k] - reference.NormalY[k]));
+					normalError = max(normalError, fabsf(batch->NormalZ[k] - reference.NormalZ[k]));
+				}
+			}
+		}
+
+		uint64_t total = (uint64_t)width * height;
+		ok = ok && heightError < 1e-6f && normalError < 1e-5f;
+		printf("%10llu  %14.1f  %14.1f  %14.1f  %12.2e  %12.2e\n", (unsigned long long)total,
+			scalarCount * 1e-6 / scalarSeconds, total * 1e-6 / spanSeconds, total * 1e-6 / gridSeconds, heightError,
+			normalError);
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "GrassScatter.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <unordered_map>
+
+static const float ScreenWidth = 1920.0f;
+static const float ScreenHeight = 1080.0f;
+
+// Pixel position of a clip-space point.
+static void ToPixels(double x, double y, double w, double& px, double& py)
+{
+	px = (0.5 + 0.5 * x / w) * ScreenWidth;
+	py = (0.5 - 0.5 * y / w) * ScreenHeight;
+}
+
+static void ProjectFloat(const Float3& p, const Float4x4& viewProj, double& px, double& py)
+{
+	const auto& m = viewProj.m;
+	float x = p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0];
+	float y = p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1];
+	float w = p.x * m[0][3] + p.y * m[1][3] + p.z * m[2][3] + m[3][3];
+	ToPixels(x, y, w, px, py);
+}
+
+// The same view taken entirely in double: the reference both float paths are held to.
+static void ProjectDouble(const Double3& p, const Double3& eye, const Float3& look, const Float4x4& proj, double& px, double& py)
+{
+	Float4x4 rotation = BuildView(Float3(), look);
+	Double3 d = p - eye;
+	double v[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		v[i] = d.x * rotation.m[0][i] + d.y * rotation.m[1][i] + d.z * rotation.m[2][i];
+	}
+	ToPixels(v[0] * proj.m[0][0], v[1] * proj.m[1][1], v[2], px, py);
+}
+
+// Pairs of roots closer than minSpacing, found through a grid of minSpacing cells.
+static uint32_t CountSpacingViolations(const vector<Float3>& roots, float minSpacing)
+{
+	unordered_map<uint64_t, vector<uint32_t>> cells;
+	auto key = [](int32_t x, int32_t z) { return (uint64_t)(uint32_t)x | ((uint64_t)(uint32_t)z << 32); };
+
+	for (uint32_t i = 0; i < (uint32_t)roots.size(); ++i)
+	{
+		cells[key((int32_t)floorf(roots[i].x / minSpacing), (int32_t)floorf(roots[i].z / minSpacing))].push_back(i);
+	}
+
+	uint32_t violations = 0;
+	float minSq = minSpacing * minSpacing * 0.999f;
+	for (uint32_t i = 0; i < (uint32_t)roots.size(); ++i)
+	{
+		int32_t cx = (int32_t)floorf(roots[i].x / minSpacing);
+		int32_t cz = (int32_t)floorf(roots[i].z / minSpacing);
+		for (int32_t z = cz - 1; z <= cz + 1; ++z)
+		{
+			for (int32_t x = cx - 1; x <= cx + 1; ++x)
+			{
+				auto cell = cells.find(key(x, z));
+				if (cell == cells.end())
+				{
+					continue;
+				}
+				for (uint32_t j : cell->second)
+				{
+					float dx = roots[j].x - roots[i].x;
+					float dz = roots[j].z - roots[i].z;
+					violations += (j > i && dx * dx + dz * dz < minSq) ? 1 : 0;
+				}
+			}
+		}
+	}
+	return violations;
+}
+
+int RunLargeWorldBench(const BenchArgs& args)
+{
+	uint32_t frames = (uint32_t)args.GetUInt(0, 240);
+
+	const uint32_t PointCount = 64;
+	const float FovY = 0.25f * 3.14159265f;
+	Float4x4 proj = BuildProj(FovY, ScreenWidth / ScreenHeight, 1.0f, 1000.0f);
+	Float3 look = Normalize(Float3(0.6f, -0.1f, 0.8f));
+	Float3 right = Normalize(Cross(Float3(0.0f, 1.0f, 0.0f), look));
+
+	// Points 2 to 60 metres ahead of a camera creeping along at 1 mm a frame. Error is the
+	// distance from where a double-precision view puts them; jitter is how much a point's
+	// frame-to-frame motion differs from the reference's.
+	printf("%u points, %u frames at %.0fx%.0f\n", PointCount, frames, ScreenWidth, ScreenHeight);
+	printf("%12s  %22s  %22s\n", "distance", "absolute err / jitter", "relative err / jitter");
+
+	bool ok = true;
+	for (double distance = 1e3; distance <= 1e7; distance *= 10.0)
+	{
+		Double3 base(distance * 0.8, 50.0, distance * 0.6);
+		minstd_rand rng(11);
+		uniform_real_distribution<float> ahead(2.0f, 60.0f);
+		uniform_real_distribution<float> side(-0.4f, 0.4f);
+
+		vector<Double3> points(PointCount);
+		for (auto& p : points)
+		{
+			float d = ahead(rng);
+			p = base + Double3(look * d + right * (side(rng) * d) + Float3(0.0f, side(rng) * 0.3f * d, 0.0f));
+		}
+
+		Float4x4 relativeViewProj = Multiply(BuildView(Float3(), look), proj);
+
+		double maxError[2] = {};
+		double maxJitter[2] = {};
+		vector<double> last(PointCount * 6);
+
+		for (uint32_t frame = 0; frame < frames; ++frame)
+		{
+			Double3 eye = base + Double3(look * (0.001f * frame));
+			Float4x4 absoluteViewProj = Multiply(BuildView(RelativePosition(eye, Double3()), look), proj);
+
+			for (uint32_t i = 0; i < PointCount; ++i)
+			{
+				double screen[6];
+				ProjectDouble(points[i], eye, look, proj, screen[0], screen[1]);
+				ProjectFloat(RelativePosition(points[i], Double3()), absoluteViewProj, screen[2], screen[3]);
+				ProjectFloat(RelativePosition(points[i], eye), relativeViewProj, screen[4], screen[5]);
+
+				for (int path = 0; path < 2; ++path)
+				{
+					double dx = screen[2 + 2 * path] - screen[0];
+					double dy = screen[3 + 2 * path] - screen[1];
+					maxError[path] = max(maxError[path], sqrt(dx * dx + dy * dy));
+
+					if (frame > 0)
+					{
+						double* prev = &last[i * 6];
+						double jx = (screen[2 + 2 * path] - prev[2 + 2 * path]) - (screen[0] - prev[0]);
+						double jy = (screen[3 + 2 * path] - prev[3 + 2 * path]) - (screen[1] - prev[1]);
+						maxJitter[path] = max(maxJitter[path], sqrt(jx * jx + jy * jy));
+					}
+				}
+				copy(screen, screen + 6, &last[i * 6]);
+			}
+		}
+
+		ok = ok && maxError[1] < 0.01 && maxJitter[1] < 0.01;
+		printf("%10.0f m  %10.3f / %7.3f px  %10.4f / %7.4f px\n", distance, maxError[0], maxJitter[0], maxError[1],
+			maxJitter[1]);
+	}
+
+	// Frustum culling of boxes far from the world origin: each set of bounds is relative to
+	// its item's origin, the frustum is moved there with FrustumPlanes::Translated. The
+	// reference rebases every box onto the camera in double before testing.
+	const uint32_t BoxCount = 100000;
+	const double FarOrigin = 1e6;
+	Double3 itemOrigin(FarOrigin, 0.0, FarOrigin);
+	Double3 eye = itemOrigin + Double3(3.25, 20.0, -150.0);
+
+	CullScene scene = BuildScene(BoxCount, 400.0f);
+	BoundsSoA local;
+	BoundsSoA rebased;
+	BoundsSoA absolute;
+	local.Resize(BoxCount);
+	rebased.Resize(BoxCount);
+	absolute.Resize(BoxCount);
+	for (uint32_t i = 0; i < BoxCount; ++i)
+	{
+		local.SetTransformed(i, scene.LocalCenter, scene.LocalExtents, scene.Worlds[i]);
+		Double3 center = itemOrigin + Double3(Float3(local.CenterX()[i], local.CenterY()[i], local.CenterZ()[i]));
+		Float3 extents(local.ExtentX()[i], local.ExtentY()[i], local.ExtentZ()[i]);
+		rebased.Set(i, RelativePosition(center, eye), extents);
+		absolute.Set(i, RelativePosition(center, Double3()), extents);
+	}
+
+	Float3 cullLook(0.0f, -0.1f, 1.0f);
+	FrustumPlanes relativeFrustum = FrustumPlanes::FromViewProj(Multiply(BuildView(Float3(), cullLook), proj));
+	FrustumPlanes absoluteFrustum = FrustumPlanes::FromViewProj(
+		Multiply(BuildView(RelativePosition(eye, Double3()), cullLook), proj));
+
+	vector<uint32_t> reference(BoxCount + SimdWidth);
+	vector<uint32_t> relative(BoxCount + SimdWidth);
+	vector<uint32_t> absoluteVisible(BoxCount + SimdWidth);
+	uint32_t referenceCount = BatchCulling::Cull(relativeFrustum, rebased, reference.data());
+	uint32_t relativeCount = BatchCulling::Cull(relativeFrustum.Translated(RelativePosition(itemOrigin, eye)), local,
+		relative.data());
+	uint32_t absoluteCount = BatchCulling::Cull(absoluteFrustum, absolute, absoluteVisible.data());
+
+	auto mismatches = [&](const vector<uint32_t>& visible, uint32_t count)
+	{
+		vector<uint32_t> difference;
+		set_symmetric_difference(reference.begin(), reference.begin() + referenceCount, visible.begin(),
+			visible.begin() + count, back_inserter(difference));
+		return (uint32_t)difference.size();
+	};
+	uint32_t relativeMismatches = mismatches(relative, relativeCount);
+	uint32_t absoluteMismatches = mismatches(absoluteVisible, absoluteCount);
+	ok = ok && relativeMismatches * 1000 <= referenceCount;
+
+	printf("culling %u boxes at %.0e m: %u visible; absolute %u differ, relative %u differ\n", BoxCount, FarOrigin,
+		referenceCount, absoluteMismatches, relativeMismatches);
+
+	// A streamed grass tile far out: roots relative to the tile keep their spacing, the same
+	// roots in absolute floats collapse onto the float grid.
+	const float MinSpacing = 0.05f;
+	GrassScatter scatter;
+	scatter.Initialize(MinSpacing, 7);
+
+	GrassScatterDesc desc;
+	desc.OriginX = FarOrigin;
+	desc.OriginZ = FarOrigin;
+	desc.MinX = 0.0f;
+	desc.MinZ = 0.0f;
+	desc.MaxX = 16.0f;
+	desc.MaxZ = 16.0f;
+	vector<Float3> roots = scatter.Scatter(desc);
+
+	vector<Float3> absoluteRoots(roots.size());
+	for (size_t i = 0; i < roots.size(); ++i)
+	{
+		absoluteRoots[i] = RelativePosition(Double3(FarOrigin, 0.0, FarOrigin) + Double3(roots[i]), Double3());
+	}
+
+	uint32_t relativeViolations = CountSpacingViolations(roots, MinSpacing);
+	uint32_t absoluteViolations = CountSpacingViolations(absoluteRoots, MinSpacing);
+	ok = ok && relativeViolations == 0 && !roots.empty();
+
+	printf("grass tile at %.0e m: %zu roots, pairs closer than %.2f m: absolute %u, relative %u\n", FarOrigin, roots.size(),
+		MinSpacing, absoluteViolations, relativeViolations);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "Bench.h"
+#include "GrassChunks.h"
+#include "GrassField.h"
+#include "ThreadPool.h"
+#include <cfloat>
+
+int RunLodBench(const BenchArgs& args)
+{
+	GrassFieldDesc desc;
+	desc.BladeCount = (uint32_t)args.GetUInt(0, 1000000);
+	desc.FieldSize = 10.0f * sqrtf((float)desc.BladeCount / 32.0f);
+	double minSeconds = args.GetFloat(1, 0.5f);
+
+	ThreadPool pool;
+
+	vector<Float3> roots = GrassFieldUtil::BuildRoots(desc, 1);
+	vector<Bone> restBones = GrassSimulation::BuildBones(desc.BladeCount, desc.BonesPerBlade, desc.BoneLength, desc.BoneMass);
+
+	GrassChunkSimulation simulation;
+	simulation.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+	// Constant wind would keep everything awake anyway; this measures LOD alone.
+	simulation.SetSleepEnabled(false);
+
+	GrassStepParams params;
+	params.WindVelocity = Float3(10.0f, 0.0f, 0.0f);
+	params.DeltaTime = 1.0f / 60.0f;
+
+	// Standing in the middle of the field at eye height.
+	Float3 eye(0.0f, 1.7f, 0.0f);
+
+	printf("%u blades over %.0f m x %.0f m, %zu chunks, %u threads\n",
+		desc.BladeCount, desc.FieldSize, desc.FieldSize, simulation.Chunks().size(), pool.ThreadCount());
+	printf("%10s %10s %6s %6s %6s %14s %10s %8s\n",
+		"root from", "sway from", "full", "root", "sway", "bones/step", "ms/step", "speedup");
+
+	// Sway distance sweeps out from the eye; root-only LOD starts at 40% of it.
+	const float swayDistances[] = { 10.0f, 20.0f, 40.0f, 80.0f, 160.0f, 320.0f, FLT_MAX };
+
+	double fullMs = 0.0;
+
+	for (int i = (int)(sizeof(swayDistances) / sizeof(swayDistances[0])) - 1; i >= 0; --i)
+	{
+		GrassLodDesc lod;
+		lod.SwayDistance = swayDistances[i];
+		lod.RootDistance = swayDistances[i] == FLT_MAX ? FLT_MAX : 0.4f * swayDistances[i];
+
+		simulation.UpdateLod(eye, lod);
+		simulation.Step(params, &pool);
+
+		uint32_t steps = 0;
+		BenchTimer timer;
+		do
+		{
+			simulation.Step(params, &pool);
+			++steps;
+		} while (steps < 3 || timer.ElapsedSeconds() < minSeconds);
+
+		double ms = timer.ElapsedMilliseconds() / steps;
+		if (swayDistances[i] == FLT_MAX)
+		{
+			fullMs = ms;
+		}
+
+		const GrassStepStats& stats = simulation.LastStepStats();
+
+		char rootFrom[16];
+		char swayFrom[16];
+		snprintf(rootFrom, sizeof(rootFrom), lod.RootDistance == FLT_MAX ? "off" : "%.0f m", lod.RootDistance);
+		snprintf(swayFrom, sizeof(swayFrom), lod.SwayDistance == FLT_MAX ? "off" : "%.0f m", lod.SwayDistance);
+
+		printf("%10s %10s %6u %6u %6u %14zu %10.2f %7.2fx\n", rootFrom, swayFrom,
+			stats.LodChunks[(int)GrassLod::Full], stats.LodChunks[(int)GrassLod::Root], stats.LodChunks[(int)GrassLod::Sway],
+			stats.IntegratedBones, ms, fullMs / ms);
+	}
+
+	return 0;
+}
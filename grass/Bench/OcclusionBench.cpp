@@ -0,0 +1,227 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "CullingPass.h"
+#include "InstanceBvh.h"
+#include "LandUtility.h"
+#include "OcclusionBuffer.h"
+#include "SimdMath.h"
+#include <algorithm>
+
+static const float OcclusionFieldSize = 512.0f;
+
+// Clip-space position of p, for telling whether a point is on screen.
+static Float4 ToClip(const Float3& p, const Float4x4& m)
+{
+	return Float4(
+		p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+		p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+		p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+		p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3]);
+}
+
+// Whether the segment from eye to p stays above the terrain, marched in 0.25 m steps and
+// stopping just short of p so the point's own ground does not count.
+static bool IsPointInSight(const Float3& eye, const Float3& p)
+{
+	Float3 delta = p - eye;
+	float length = Length(delta);
+	uint32_t steps = (uint32_t)(length / 0.25f);
+
+	for (uint32_t s = 1; s + 1 < steps; ++s)
+	{
+		Float3 q = eye + delta * ((float)s / steps);
+		if (q.y < LandUtility::GetHillsHeight(q.x, q.z))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// A box is seen when its centre, top centre or any corner (pulled in slightly) is on screen
+// and in sight of the eye. Sampled points can miss a sliver, so this only finds boxes that
+// certainly are visible.
+static bool IsBoxInSight(const Float3& eye, const Float4x4& viewProj, const Float3& center, const Float3& extents)
+{
+	Float3 points[10];
+	points[0] = center;
+	points[1] = Float3(center.x, center.y + 0.9f * extents.y, center.z);
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		points[2 + corner] = Float3(
+			center.x + ((corner & 1) ? 0.9f : -0.9f) * extents.x,
+			center.y + ((corner & 2) ? 0.9f : -0.9f) * extents.y,
+			center.z + ((corner & 4) ? 0.9f : -0.9f) * extents.z);
+	}
+
+	for (const Float3& p : points)
+	{
+		Float4 clip = ToClip(p, viewProj);
+		bool onScreen = clip.w > 0.0f && fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z >= 0.0f && clip.z <= clip.w;
+		if (onScreen && IsPointInSight(eye, p))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int RunOcclusionBench(const BenchArgs& args)
+{
+	uint32_t threadCount = (uint32_t)args.GetUInt(0, 4);
+	uint32_t width = (uint32_t)args.GetUInt(1, 256);
+	uint32_t height = (uint32_t)args.GetUInt(2, 128);
+	uint32_t terrainCells = max(1u, (uint32_t)args.GetUInt(3, 64));
+	uint32_t instanceCount = max(1u, (uint32_t)args.GetUInt(4, 200000));
+	string dumpPrefix = args.GetString(5, "");
+
+	const uint32_t Frames = 20;
+	const uint32_t MaxChecked = 2000;
+
+	float half = 0.5f * OcclusionFieldSize;
+	BenchTimer occluderTimer;
+	OccluderMesh terrain = OcclusionBuffer::BuildTerrainOccluder(LandUtility::GetHillsHeight, -half, -half, half, half,
+		terrainCells, terrainCells);
+	double occluderMs = occluderTimer.ElapsedMilliseconds();
+
+	// Bushes of 1 to 4 metres standing on the hills.
+	BoundsSoA bounds;
+	bounds.Resize(instanceCount);
+	minstd_rand rng(5);
+	uniform_real_distribution<float> position(-half, half);
+	uniform_real_distribution<float> size(0.5f, 2.0f);
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		float x = position(rng);
+		float z = position(rng);
+		float s = size(rng);
+		bounds.Set(i, Float3(x, LandUtility::GetHillsHeight(x, z) + s, z), Float3(0.5f * s, s, 0.5f * s));
+	}
+
+	// Low over the valley in the middle, looking across the field.
+	Float3 eye(-20.0f, LandUtility::GetHillsHeight(-20.0f, -180.0f) + 4.0f, -180.0f);
+	Float3 look(0.25f, -0.05f, 1.0f);
+	Float4x4 viewProj = Multiply(BuildView(eye, look), BuildProj(0.25f * 3.14159265f, 16.0f / 9.0f, 1.0f, 1000.0f));
+	FrustumPlanes frustum = FrustumPlanes::FromViewProj(viewProj);
+
+	vector<uint32_t> frustumVisible(instanceCount + SimdWidth);
+	uint32_t frustumCount = BatchCulling::Cull(frustum, bounds, frustumVisible.data());
+
+	ThreadPool pool(threadCount);
+	OcclusionBuffer occlusion;
+	occlusion.Initialize(width, height);
+
+	// The test is split into chunks over the pool as CullingPass does, each filtering its
+	// own slice; the survivors are then moved together.
+	const uint32_t ChunkSize = 4096;
+	uint32_t chunkCount = (frustumCount + ChunkSize - 1) / ChunkSize;
+	vector<uint32_t> chunkCounts(chunkCount);
+
+	// The same boxes culled hierarchically: the frustum and the occlusion buffer both test
+	// the tree's nodes before any instance box, so hidden subtrees are dropped whole.
+	InstanceBvh bvh;
+	bvh.Build(bounds);
+	vector<CullingSource> sources(1);
+	sources[0].Bounds = &bounds;
+	sources[0].Bvh = &bvh;
+	CullingPass pass;
+
+	vector<uint32_t> visible(frustumCount);
+	double renderMs = 0.0;
+	double testMs = 0.0;
+	double bvhMs = 0.0;
+	uint32_t visibleCount = 0;
+
+	for (uint32_t frame = 0; frame < Frames; ++frame)
+	{
+		BenchTimer renderTimer;
+		occlusion.BeginFrame(viewProj);
+		occlusion.AddOccluder(terrain);
+		occlusion.Render(&pool);
+		renderMs += renderTimer.ElapsedMilliseconds();
+
+		copy(frustumVisible.begin(), frustumVisible.begin() + frustumCount, visible.begin());
+		BenchTimer testTimer;
+		pool.ParallelFor(chunkCount, [&](uint32_t chunk)
+		{
+			uint32_t begin = chunk * ChunkSize;
+			chunkCounts[chunk] = occlusion.FilterVisible(bounds, visible.data() + begin, min(ChunkSize, frustumCount - begin));
+		});
+		visibleCount = 0;
+		for (uint32_t chunk = 0; chunk < chunkCount; ++chunk)
+		{
+			copy_n(visible.begin() + chunk * ChunkSize, chunkCounts[chunk], visible.begin() + visibleCount);
+			visibleCount += chunkCounts[chunk];
+		}
+		testMs += testTimer.ElapsedMilliseconds();
+
+		BenchTimer bvhTimer;
+		pass.Run(frustum, sources, &pool, &occlusion);
+		bvhMs += bvhTimer.ElapsedMilliseconds();
+	}
+
+	printf("%ux%u depth, %u levels, %u threads (hardware %u)\n", occlusion.Width(), occlusion.Height(), occlusion.LevelCount(),
+		threadCount, ThreadPool::HardwareThreadCount());
+	printf("terrain occluder: %zu triangles, built in %.1f ms\n", terrain.Indices.size() / 3, occluderMs);
+	printf("instances: %u, in frustum %u, not occluded %u (%.1f%% of the frustum's culled)\n", instanceCount, frustumCount,
+		visibleCount, 100.0 * (frustumCount - visibleCount) / max(1u, frustumCount));
+	double totalMs = (renderMs + testMs) / Frames;
+	printf("render %.3f ms, test %.3f ms, total %.3f ms per frame (%s the 1 ms budget)\n", renderMs / Frames, testMs / Frames,
+		totalMs, totalMs <= 1.0 ? "within" : "over");
+
+	// The tree only skips boxes whose node is already hidden, so it must keep the same set.
+	BvhCullStats bvhStats = pass.Stats();
+	vector<uint32_t> bvhVisible(pass.Visible(0), pass.Visible(0) + pass.VisibleCount(0));
+	sort(bvhVisible.begin(), bvhVisible.end());
+	vector<uint32_t> flatVisible(visible.begin(), visible.begin() + visibleCount);
+	sort(flatVisible.begin(), flatVisible.end());
+	bool same = bvhVisible == flatVisible;
+	double bvhTotalMs = (renderMs + bvhMs) / Frames;
+	printf("bvh: %llu nodes visited, %llu occluded, %llu instance boxes tested per frame\n",
+		(unsigned long long)(bvhStats.NodesVisited), (unsigned long long)(bvhStats.NodesOccluded),
+		(unsigned long long)(pass.OccludedStats().Tested));
+	printf("render %.3f ms, frustum + test %.3f ms, total %.3f ms per frame (%s the 1 ms budget)  %s\n", renderMs / Frames,
+		bvhMs / Frames, bvhTotalMs, bvhTotalMs <= 1.0 ? "within" : "over", same ? "PASS" : "FAIL (bvh != flat)");
+
+	// Every occluded box (or an even sample of them) must be out of sight of the eye.
+	vector<uint32_t> occluded;
+	sort(visible.begin(), visible.begin() + visibleCount);
+	for (uint32_t i = 0; i < frustumCount; ++i)
+	{
+		uint32_t index = frustumVisible[i];
+		if (!binary_search(visible.begin(), visible.begin() + visibleCount, index))
+		{
+			occluded.push_back(index);
+		}
+	}
+
+	uint32_t step = max(1u, (uint32_t)occluded.size() / MaxChecked);
+	uint32_t checked = 0;
+	uint32_t wrong = 0;
+	for (size_t i = 0; i < occluded.size(); i += step)
+	{
+		uint32_t index = occluded[i];
+		Float3 center(bounds.CenterX()[index], bounds.CenterY()[index], bounds.CenterZ()[index]);
+		Float3 extents(bounds.ExtentX()[index], bounds.ExtentY()[index], bounds.ExtentZ()[index]);
+		++checked;
+		wrong += IsBoxInSight(eye, viewProj, center, extents) ? 1 : 0;
+	}
+
+	printf("false occlusion: %u of %u occluded boxes checked by ray march (%.2f%%)  %s\n", wrong, checked,
+		100.0 * wrong / max(1u, checked), wrong == 0 ? "PASS" : "FAIL");
+
+	if (!dumpPrefix.empty())
+	{
+		for (uint32_t level = 0; level < occlusion.LevelCount(); ++level)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "_far%u.pgm", level);
+			occlusion.WriteImage(dumpPrefix + name, level);
+			snprintf(name, sizeof(name), "_near%u.pgm", level);
+			occlusion.WriteImage(dumpPrefix + name, level, true);
+		}
+		printf("wrote %s_far*.pgm and %s_near*.pgm\n", dumpPrefix.c_str(), dumpPrefix.c_str());
+	}
+
+	return wrong == 0 && same ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include "Bench.h"
+#include "GrassChunks.h"
+#include "GrassDump.h"
+#include "ThreadPool.h"
+
+static const uint32_t ScalingBonesPerBlade = 5;
+static const uint32_t ScalingBladesPerChunk = 1024;
+
+// Lays the blades out on a square grid, one unit apart, and returns them spatially sorted.
+static vector<Float3> BuildGridRoots(uint32_t bladeCount)
+{
+	uint32_t side = 1;
+	while (side * side < bladeCount)
+	{
+		++side;
+	}
+
+	vector<Float3> roots(bladeCount);
+	for (uint32_t i = 0; i < bladeCount; ++i)
+	{
+		roots[i] = Float3((float)(i % side), 0.0f, (float)(i / side));
+	}
+
+	GrassChunking::SortSpatially(roots, 1.0f);
+	return roots;
+}
+
+int RunScalingBench(const BenchArgs& args)
+{
+	uint32_t bladeCount = (uint32_t)args.GetUInt(0, 1000000);
+	uint32_t maxThreads = (uint32_t)args.GetUInt(1, ThreadPool::HardwareThreadCount());
+	double minSeconds = args.GetFloat(2, 0.5f);
+
+	GrassStepParams params;
+	params.WindVelocity = Float3(10.0f, 0.0f, 0.0f);
+	params.DeltaTime = 1.0f / 60.0f;
+
+	vector<Float3> roots = BuildGridRoots(bladeCount);
+	vector<Bone> restBones = GrassSimulation::BuildBones(bladeCount, ScalingBonesPerBlade);
+
+	printf("%u blades x %u bones, %zu chunks, simd width %d\n", bladeCount, ScalingBonesPerBlade,
+		GrassChunking::BuildChunks(roots, ScalingBladesPerChunk).size(), SimdWidth);
+	printf("%8s %8s %14s %8s %10s\n", "threads", "steps", "bones/sec", "speedup", "max ulp");
+
+	double baseRate = 0.0;
+	bool ok = true;
+
+	for (uint32_t threadCount = 1; threadCount <= maxThreads; threadCount = threadCount < 4 ? threadCount + 1 : threadCount * 2)
+	{
+		ThreadPool pool(threadCount);
+
+		GrassChunkSimulation simulation;
+		simulation.Initialize(restBones, ScalingBonesPerBlade, roots, ScalingBladesPerChunk);
+		simulation.Step(params, &pool);
+
+		uint32_t steps = 0;
+		BenchTimer timer;
+		do
+		{
+			simulation.Step(params, &pool);
+			++steps;
+		} while (steps < 3 || timer.ElapsedSeconds() < minSeconds);
+
+		double rate = (double)simulation.BoneCount() * steps / timer.ElapsedSeconds();
+		if (threadCount == 1)
+		{
+			baseRate = rate;
+		}
+
+		// Step a single-threaded copy as far to check that threading doesn't change the result.
+		GrassChunkSimulation expected;
+		expected.Initialize(restBones, ScalingBonesPerBlade, roots, ScalingBladesPerChunk);
+		for (uint32_t i = 0; i <= steps; ++i)
+		{
+			expected.Step(params, nullptr);
+		}
+
+		GrassDump expectedDump;
+		expectedDump.BladeCount = bladeCount;
+		expectedDump.BonesPerBlade = ScalingBonesPerBlade;
+		expectedDump.Bones.resize(simulation.BoneCount());
+		expected.CopyBones(expectedDump.Bones.data());
+
+		GrassDump actualDump = expectedDump;
+		simulation.CopyBones(actualDump.Bones.data());
+
+		GrassDumpDiff diff = GrassDumpUtil::Compare(expectedDump, actualDump, 0);
+		ok = ok && diff.MaxUlpDistance == 0;
+
+		printf("%8u %8u %14.4g %7.2fx %10u\n", threadCount, steps, rate, rate / baseRate, diff.MaxUlpDistance);
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
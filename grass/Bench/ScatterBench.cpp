@@ -0,0 +1,151 @@
+#include "Bench.h"
+#include "GrassScatter.h"
+#include "LandUtility.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+// Clearings and thick patches, a few tens of metres across.
+static GrassDensityMap BuildBenchDensityMap(float minX, float minZ, float size)
+{
+	GrassDensityMap density;
+	density.Width = 256;
+	density.Height = 256;
+	density.OriginX = minX;
+	density.OriginZ = minZ;
+	density.CellSize = size / (density.Width - 1);
+	density.Values.resize((size_t)density.Width * density.Height);
+
+	for (uint32_t j = 0; j < density.Height; ++j)
+	{
+		for (uint32_t i = 0; i < density.Width; ++i)
+		{
+			float x = minX + i * density.CellSize;
+			float z = minZ + j * density.CellSize;
+			float patches = sinf(0.11f * x) * cosf(0.07f * z) + 0.5f * sinf(0.23f * (x + z));
+			density.Values[(size_t)j * density.Width + i] = min(max(0.6f + 0.5f * patches, 0.0f), 1.0f);
+		}
+	}
+
+	return density;
+}
+
+// Closest pair of roots inside a window, found through a grid of spacing-sized cells.
+static float MinRootDistance(const vector<Float3>& roots, float minX, float minZ, float window, float spacing)
+{
+	unordered_map<uint64_t, vector<uint32_t>> cells;
+	auto cellKey = [](int64_t x, int64_t z) { return (uint64_t)(x & 0xffffffff) | ((uint64_t)z << 32); };
+
+	for (uint32_t i = 0; i < (uint32_t)roots.size(); ++i)
+	{
+		const Float3& r = roots[i];
+		if (r.x >= minX && r.x < minX + window && r.z >= minZ && r.z < minZ + window)
+		{
+			cells[cellKey((int64_t)floorf(r.x / spacing), (int64_t)floorf(r.z / spacing))].push_back(i);
+		}
+	}
+
+	float minDistanceSq = INFINITY;
+	for (const auto& cell : cells)
+	{
+		for (uint32_t a : cell.second)
+		{
+			int64_t cx = (int64_t)floorf(roots[a].x / spacing);
+			int64_t cz = (int64_t)floorf(roots[a].z / spacing);
+
+			for (int64_t dz = -1; dz <= 1; ++dz)
+			{
+				for (int64_t dx = -1; dx <= 1; ++dx)
+				{
+					auto neighbour = cells.find(cellKey(cx + dx, cz + dz));
+					if (neighbour == cells.end())
+					{
+						continue;
+					}
+
+					for (uint32_t b : neighbour->second)
+					{
+						if (b != a)
+						{
+							float x = roots[a].x - roots[b].x;
+							float z = roots[a].z - roots[b].z;
+							minDistanceSq = min(minDistanceSq, x * x + z * z);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return sqrtf(minDistanceSq);
+}
+
+int RunScatterBench(const BenchArgs& args)
+{
+	uint64_t targetBlades = args.GetUInt(0, 10000000);
+	float spacing = args.GetFloat(1, 0.05f);
+	uint32_t threadCount = (uint32_t)args.GetUInt(2, ThreadPool::HardwareThreadCount());
+
+	ThreadPool pool(threadCount);
+
+	BenchTimer patternTimer;
+	GrassScatter scatter;
+	scatter.Initialize(spacing, 1);
+	double patternMs = patternTimer.ElapsedMilliseconds();
+
+	// A square that holds about targetBlades at full density on flat ground.
+	float size = sqrtf((float)targetBlades / scatter.MaxDensity());
+
+	GrassScatterDesc desc;
+	desc.MinX = -0.5f * size;
+	desc.MinZ = -0.5f * size;
+	desc.MaxX = 0.5f * size;
+	desc.MaxZ = 0.5f * size;
+
+	printf("pattern: %zu points per %.2f m tile, spacing %.3f m, built in %.2f ms\n",
+		scatter.PointsPerTile(), scatter.TileSize(), spacing, patternMs);
+	printf("field %.0f m x %.0f m, %u threads\n", size, size, pool.ThreadCount());
+
+	BenchTimer flatTimer;
+	vector<Float3> flatRoots = scatter.Scatter(desc, &pool);
+	double flatMs = flatTimer.ElapsedMilliseconds();
+
+	printf("flat:              %10zu blades in %8.2f ms (%.3g blades/s)\n",
+		flatRoots.size(), flatMs, flatRoots.size() / (flatMs * 0.001));
+
+	// Check the blue-noise guarantee across several tile edges.
+	float window = 4.0f * scatter.TileSize();
+	float minDistance = MinRootDistance(flatRoots, desc.MinX, desc.MinZ, window, spacing);
+	vector<Float3>().swap(flatRoots);
+
+	GrassDensityMap density = BuildBenchDensityMap(desc.MinX, desc.MinZ, size);
+	desc.Density = &density;
+	desc.Height = LandUtility::GetHillsHeight;
+	desc.Normal = LandUtility::GetHillsNormal;
+	desc.MaxSlopeDegrees = 60.0f;
+
+	BenchTimer terrainTimer;
+	vector<Float3> terrainRoots = scatter.Scatter(desc, &pool);
+	double terrainMs = terrainTimer.ElapsedMilliseconds();
+
+	printf("density + terrain: %10zu blades in %8.2f ms (%.3g blades/s)\n",
+		terrainRoots.size(), terrainMs, terrainRoots.size() / (terrainMs * 0.001));
+	vector<Float3>().swap(terrainRoots);
+
+	desc.HeightBatch = LandUtility::GetHillsHeights;
+	desc.NormalBatch = LandUtility::GetHillsNormals;
+
+	BenchTimer batchTimer;
+	vector<Float3> batchRoots = scatter.Scatter(desc, &pool);
+	double batchMs = batchTimer.ElapsedMilliseconds();
+
+	printf("  batched terrain: %10zu blades in %8.2f ms (%.3g blades/s)\n",
+		batchRoots.size(), batchMs, batchRoots.size() / (batchMs * 0.001));
+
+	bool spacingOk = minDistance >= spacing * 0.999f;
+	printf("min root distance over %.0f m x %.0f m: %.4f m (spacing %.4f m) %s\n",
+		window, window, minDistance, spacing, spacingOk ? "PASS" : "FAIL");
+
+	return spacingOk ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include "Bench.h"
+#include "GrassChunks.h"
+#include "GrassField.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+static const float SleepBenchDeltaTime = 1.0f / 60.0f;
+
+// Calm, a one second gust, calm, a short gust, calm.
+static Float3 SleepBenchWind(float time)
+{
+	bool gust = (time >= 3.0f && time < 4.0f) || (time >= 7.0f && time < 7.5f);
+	return Float3(gust ? 10.0f : 0.0f, 0.0f, 0.0f);
+}
+
+static double RunSleepScene(GrassChunkSimulation& simulation, const GrassFieldDesc& desc, ThreadPool& pool,
+	uint32_t stepCount, bool printTimeline, size_t& skippedBlades)
+{
+	float walkerHalfSize = 1.0f;
+	size_t totalSkipped = 0;
+	size_t intervalSimulated = 0;
+	size_t intervalSkipped = 0;
+
+	BenchTimer timer;
+
+	for (uint32_t step = 0; step < stepCount; ++step)
+	{
+		float time = step * SleepBenchDeltaTime;
+
+		// Something walking diagonally across the field keeps the grass around it awake.
+		float walker = -0.5f * desc.FieldSize + fmodf(time * 2.0f, desc.FieldSize);
+		simulation.WakeRegion(Float3(walker - walkerHalfSize, 0.0f, walker - walkerHalfSize),
+			Float3(walker + walkerHalfSize, 0.0f, walker + walkerHalfSize));
+
+		GrassStepParams params;
+		params.WindVelocity = SleepBenchWind(time);
+		params.DeltaTime = SleepBenchDeltaTime;
+
+		simulation.Step(params, &pool);
+
+		const GrassStepStats& stats = simulation.LastStepStats();
+		totalSkipped += stats.SkippedBlades;
+		intervalSimulated += stats.SimulatedBlades;
+		intervalSkipped += stats.SkippedBlades;
+
+		if (printTimeline && (step + 1) % 30 == 0)
+		{
+			printf("%8.2f %8.1f %10u %10u %9.1f%%\n", time, params.WindVelocity.x, stats.ActiveChunks, stats.SleepingChunks,
+				100.0 * intervalSkipped / (intervalSimulated + intervalSkipped));
+			intervalSimulated = 0;
+			intervalSkipped = 0;
+		}
+	}
+
+	skippedBlades = totalSkipped;
+	return timer.ElapsedSeconds();
+}
+
+int RunSleepBench(const BenchArgs& args)
+{
+	GrassFieldDesc desc;
+	desc.BladeCount = (uint32_t)args.GetUInt(0, 100000);
+	desc.FieldSize = 10.0f * sqrtf((float)desc.BladeCount / 32.0f);
+	float seconds = args.GetFloat(1, 10.0f);
+	uint32_t stepCount = (uint32_t)(seconds / SleepBenchDeltaTime);
+
+	ThreadPool pool;
+
+	vector<Float3> roots = GrassFieldUtil::BuildRoots(desc, 1);
+	vector<Bone> restBones = GrassSimulation::BuildBones(desc.BladeCount, desc.BonesPerBlade, desc.BoneLength, desc.BoneMass);
+
+	GrassChunkSimulation sleeping;
+	sleeping.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+
+	GrassChunkSimulation awake;
+	awake.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+	awake.SetSleepEnabled(false);
+
+	printf("%u blades, %zu chunks, %.1f s at 60 Hz, %u threads\n",
+		desc.BladeCount, sleeping.Chunks().size(), seconds, pool.ThreadCount());
+	printf("%8s %8s %10s %10s %10s\n", "time", "wind", "active", "asleep", "skipped");
+
+	size_t skippedBlades = 0;
+	size_t unused = 0;
+	double sleepingSeconds = RunSleepScene(sleeping, desc, pool, stepCount, true, skippedBlades);
+	double awakeSeconds = RunSleepScene(awake, desc, pool, stepCount, false, unused);
+
+	// Sleeping freezes blades that are within the thresholds of rest instead of letting them
+	// decay further, so the two runs should end up close but not identical.
+	vector<Bone> sleepingBones(sleeping.BoneCount());
+	vector<Bone> awakeBones(awake.BoneCount());
+	sleeping.CopyBones(sleepingBones.data());
+	awake.CopyBones(awakeBones.data());
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < sleepingBones.size(); ++i)
+	{
+		maxError = fmaxf(maxError, Length(sleepingBones[i].Position - awakeBones[i].Position));
+	}
+
+	double skippedFraction = (double)skippedBlades / ((double)desc.BladeCount * stepCount);
+
+	printf("skipped %.1f%% of blade steps\n", 100.0 * skippedFraction);
+	printf("sleeping %.3f s, always awake %.3f s, speedup %.2fx\n", sleepingSeconds, awakeSeconds, awakeSeconds / sleepingSeconds);
+	printf("max bone position difference %.3g\n", maxError);
+
+	return 0;
+}
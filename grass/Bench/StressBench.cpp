@@ -0,0 +1,67 @@
+#include "Bench.h"
+#include "GrassChunks.h"
+#include "GrassField.h"
+
+// Frames in flight in BaseApp; each owns an upload copy of the bones for the CPU path.
+static const uint32_t StressFrameResourceCount = 3;
+
+static double ToMiB(size_t bytes)
+{
+	return (double)bytes / (1024.0 * 1024.0);
+}
+
+int RunStressBench(const BenchArgs& args)
+{
+	uint64_t maxBlades = args.GetUInt(0, 1000000);
+	uint32_t bonesPerBlade = (uint32_t)args.GetUInt(1, 5);
+
+	printf("%10s %6s %9s %9s %9s %9s %9s %10s %10s\n",
+		"blades", "bones", "roots ms", "bones ms", "soa ms", "mesh ms", "total ms", "gpu MiB", "cpu MiB");
+
+	for (uint64_t bladeCount = 1000; bladeCount <= maxBlades; bladeCount *= 10)
+	{
+		GrassFieldDesc desc;
+		desc.BladeCount = (uint32_t)bladeCount;
+		desc.BonesPerBlade = bonesPerBlade;
+		// Keep the density of the default 32-blade, 10 m field.
+		desc.FieldSize = 10.0f * sqrtf((float)bladeCount / 32.0f);
+
+		if (!GrassFieldUtil::IsValid(desc))
+		{
+			printf("stress: invalid field (%u blades x %u bones)\n", desc.BladeCount, desc.BonesPerBlade);
+			return 1;
+		}
+
+		BenchTimer timer;
+
+		vector<Float3> roots = GrassFieldUtil::BuildRoots(desc, 1);
+		double rootsMs = timer.ElapsedMilliseconds();
+
+		timer.Reset();
+		vector<Bone> bones = GrassSimulation::BuildBones(desc.BladeCount, desc.BonesPerBlade, desc.BoneLength, desc.BoneMass);
+		double bonesMs = timer.ElapsedMilliseconds();
+
+		timer.Reset();
+		GrassChunkSimulation simulation;
+		simulation.Initialize(bones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+		double soaMs = timer.ElapsedMilliseconds();
+
+		timer.Reset();
+		vector<GrassVertex> vertices = GrassFieldUtil::BuildVertices(desc, roots);
+		vector<uint32_t> indices = GrassFieldUtil::BuildIndices(desc);
+		double meshMs = timer.ElapsedMilliseconds();
+
+		size_t boneBytes = bones.size() * sizeof(Bone);
+		size_t meshBytes = vertices.size() * sizeof(GrassVertex) + indices.size() * sizeof(uint32_t);
+
+		// Default-heap bones + initial upload + per-frame CPU staging, and the point mesh.
+		size_t gpuBytes = boneBytes * (2 + StressFrameResourceCount) + meshBytes;
+		size_t cpuBytes = simulation.Bones().ByteSize() + simulation.Chunks().size() * sizeof(GrassChunk);
+
+		printf("%10u %6u %9.2f %9.2f %9.2f %9.2f %9.2f %10.2f %10.2f\n",
+			desc.BladeCount, desc.BonesPerBlade, rootsMs, bonesMs, soaMs, meshMs,
+			rootsMs + bonesMs + soaMs + meshMs, ToMiB(gpuBytes), ToMiB(cpuBytes));
+	}
+
+	return 0;
+}
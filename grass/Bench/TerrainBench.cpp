@@ -0,0 +1,236 @@
+#include "Bench.h"
+#include "CullScene.h"
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Rolling hills over kilometres with detail down to a few metres.
+static float RollingHeight(float x, float z)
+{
+	return 120.0f * sinf(0.0011f * x) * cosf(0.0013f * z) +
+		30.0f * sinf(0.0071f * x + 0.6f) * sinf(0.0063f * z) +
+		6.0f * cosf(0.031f * x) * sinf(0.027f * z + 1.3f) +
+		1.0f * sinf(0.17f * x + 0.11f * z);
+}
+
+// One side of an edge between two patches: the patch's morphed vertices along the line,
+// as (position along the line, height).
+static vector<pair<float, float>> EdgeProfile(const TerrainQuadtree& terrain, const TerrainPatch& patch, bool alongZ,
+	float line, const Float3& camera)
+{
+	uint32_t n = terrain.Desc().PatchResolution;
+	// Which of the patch's two edges on this axis lies on the line.
+	uint32_t fixed = fabsf((alongZ ? patch.X : patch.Z) - line) < 0.5f * patch.Size ? 0 : n;
+
+	vector<pair<float, float>> profile(n + 1);
+	for (uint32_t k = 0; k <= n; ++k)
+	{
+		Float3 p = alongZ ? terrain.MorphVertex(patch, fixed, k, camera) : terrain.MorphVertex(patch, k, fixed, camera);
+		profile[k] = { alongZ ? p.z : p.x, p.y };
+	}
+	return profile;
+}
+
+static float ProfileHeight(const vector<pair<float, float>>& profile, float t)
+{
+	for (size_t k = 0; k + 1 < profile.size(); ++k)
+	{
+		if (t <= profile[k + 1].first)
+		{
+			float length = profile[k + 1].first - profile[k].first;
+			float s = length > 0.0f ? (t - profile[k].first) / length : 0.0f;
+			return profile[k].second + s * (profile[k + 1].second - profile[k].second);
+		}
+	}
+	return profile.back().second;
+}
+
+struct SeamCheck
+{
+	uint32_t Edges = 0;
+	uint32_t LodJumps = 0;
+	uint32_t Cracks = 0;
+	float MaxGap = 0.0f;
+};
+
+// Walks every leaf-sized piece of edge between two different patches and compares where
+// each side puts it: a finer side must lie on the coarser side's edge exactly.
+static void CheckSeams(const TerrainQuadtree& terrain, const vector<TerrainPatch>& patches, const Float3& camera,
+	SeamCheck& check)
+{
+	const TerrainQuadtreeDesc& desc = terrain.Desc();
+	uint32_t cells = terrain.NodesPerSide(0);
+	vector<int32_t> owner((size_t)cells * cells, -1);
+
+	for (int32_t p = 0; p < (int32_t)patches.size(); ++p)
+	{
+		uint32_t x0 = (uint32_t)((patches[p].X - desc.MinX) / desc.LeafSize + 0.5f);
+		uint32_t z0 = (uint32_t)((patches[p].Z - desc.MinZ) / desc.LeafSize + 0.5f);
+		uint32_t n = (uint32_t)(patches[p].Size / desc.LeafSize + 0.5f);
+		for (uint32_t z = z0; z < z0 + n; ++z)
+		{
+			for (uint32_t x = x0; x < x0 + n; ++x)
+			{
+				owner[(size_t)z * cells + x] = p;
+			}
+		}
+	}
+
+	for (uint32_t z = 0; z < cells; ++z)
+	{
+		for (uint32_t x = 0; x < cells; ++x)
+		{
+			int32_t a = owner[(size_t)z * cells + x];
+			if (a < 0)
+			{
+				continue;
+			}
+
+			for (int axis = 0; axis < 2; ++axis)
+			{
+				bool alongZ = axis == 0;
+				uint32_t nx = alongZ ? x + 1 : x;
+				uint32_t nz = alongZ ? z : z + 1;
+				if (nx >= cells || nz >= cells)
+				{
+					continue;
+				}
+
+				int32_t b = owner[(size_t)nz * cells + nx];
+				if (b < 0 || b == a)
+				{
+					continue;
+				}
+
+				++check.Edges;
+				if (max(patches[a].Lod, patches[b].Lod) - min(patches[a].Lod, patches[b].Lod) > 1)
+				{
+					++check.LodJumps;
+				}
+
+				float line = alongZ ? desc.MinX + nx * desc.LeafSize : desc.MinZ + nz * desc.LeafSize;
+				float begin = alongZ ? desc.MinZ + z * desc.LeafSize : desc.MinX + x * desc.LeafSize;
+				float end = begin + desc.LeafSize;
+
+				auto profileA = EdgeProfile(terrain, patches[a], alongZ, line, camera);
+				auto profileB = EdgeProfile(terrain, patches[b], alongZ, line, camera);
+
+				float gap = 0.0f;
+				for (const auto* profile : { &profileA, &profileB })
+				{
+					for (const auto& vertex : *profile)
+					{
+						if (vertex.first >= begin && vertex.first <= end)
+						{
+							gap = max(gap, fabsf(ProfileHeight(profileA, vertex.first) - ProfileHeight(profileB, vertex.first)));
+						}
+					}
+				}
+
+				check.MaxGap = max(check.MaxGap, gap);
+				check.Cracks += gap > 1e-3f ? 1 : 0;
+			}
+		}
+	}
+}
+
+int RunTerrainBench(const BenchArgs& args)
+{
+	float size = args.GetFloat(0, 16384.0f);
+	uint32_t frames = (uint32_t)args.GetUInt(1, 600);
+	float pixelError = args.GetFloat(2, 2.0f);
+
+	const float ScreenHeight = 1080.0f;
+	const float FovY = 0.25f * 3.14159265f;
+	const uint32_t CheckEvery = 20;
+
+	TerrainQuadtreeDesc desc;
+	desc.Size = size;
+	desc.MinX = -0.5f * size;
+	desc.MinZ = -0.5f * size;
+	desc.LeafSize = 32.0f;
+	desc.PatchResolution = 32;
+	desc.Height = RollingHeight;
+	desc.MaxPixelError = pixelError;
+
+	ThreadPool pool;
+	TerrainQuadtree terrain;
+	BenchTimer buildTimer;
+	terrain.Build(desc, &pool);
+	double buildMs = buildTimer.ElapsedMilliseconds();
+
+	float ranges[TerrainQuadtree::MaxLods];
+	terrain.ComputeRanges(ScreenHeight, FovY, ranges);
+
+	printf("%.0f m terrain, %u levels, %ux%u quads per patch, built in %.1f ms (%u threads)\n", size, terrain.LodCount(),
+		desc.PatchResolution, desc.PatchResolution, buildMs, pool.ThreadCount());
+	printf("lod  node size  error (m)   range (m)\n");
+	for (uint32_t lod = 0; lod < terrain.LodCount(); ++lod)
+	{
+		printf("%3u %10.0f %10.3f %11.0f\n", lod, terrain.NodeSize(lod), terrain.LevelError(lod),
+			lod + 1 < terrain.LodCount() ? ranges[lod] : INFINITY);
+	}
+
+	Float4x4 proj = BuildProj(FovY, 16.0f / 9.0f, 1.0f, 0.75f * size);
+
+	// Everything passes: seams are checked all around the camera, not just in view.
+	FrustumPlanes everything;
+	for (auto& plane : everything.Planes)
+	{
+		plane = Float4(0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	vector<TerrainPatch> patches;
+	double totalSelectMs = 0.0;
+	double maxSelectMs = 0.0;
+	uint64_t totalPatches = 0;
+	uint64_t totalVisited = 0;
+	uint32_t maxPatches = 0;
+	SeamCheck seams;
+
+	// Low over the hills on a long curve across most of the terrain, looking ahead and a
+	// little down, with the view swinging side to side.
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		float t = (float)frame / max(1u, frames - 1);
+		float x = (t - 0.5f) * 0.8f * size;
+		float z = 0.2f * size * sinf(6.2831853f * t);
+		Float3 camera(x, RollingHeight(x, z) + 2.0f + 40.0f * (0.5f + 0.5f * sinf(20.0f * t)), z);
+		float heading = 0.8f * sinf(12.0f * t);
+		Float3 look(cosf(heading), -0.15f, sinf(heading));
+		FrustumPlanes frustum = FrustumPlanes::FromViewProj(Multiply(BuildView(camera, look), proj));
+
+		patches.clear();
+		TerrainSelectStats stats;
+		BenchTimer selectTimer;
+		terrain.Select(camera, frustum, ScreenHeight, FovY, patches, &stats);
+		double selectMs = selectTimer.ElapsedMilliseconds();
+
+		totalSelectMs += selectMs;
+		maxSelectMs = max(maxSelectMs, selectMs);
+		totalPatches += stats.Patches;
+		totalVisited += stats.NodesVisited;
+		maxPatches = max(maxPatches, stats.Patches);
+
+		if (frame % CheckEvery == 0)
+		{
+			patches.clear();
+			terrain.Select(camera, everything, ScreenHeight, FovY, patches);
+			CheckSeams(terrain, patches, camera, seams);
+		}
+	}
+
+	uint64_t quadsPerPatch = (uint64_t)desc.PatchResolution * desc.PatchResolution;
+	printf("%u frames: select %.4f ms mean, %.4f ms max; %.0f nodes visited, %.0f patches (%u max), %.0f triangles drawn\n",
+		frames, totalSelectMs / frames, maxSelectMs, (double)totalVisited / frames, (double)totalPatches / frames, maxPatches,
+		2.0 * quadsPerPatch * totalPatches / frames);
+	printf("uniform grid at the finest spacing: %.3g triangles\n",
+		2.0 * pow(size * desc.PatchResolution / desc.LeafSize, 2.0));
+
+	bool ok = seams.Cracks == 0 && seams.LodJumps == 0 && maxSelectMs < 0.5;
+	printf("seams (every %u frames, all around): %u edges, %u with levels more than one apart, %u cracks, max gap %.2e m\n",
+		CheckEvery, seams.Edges, seams.LodJumps, seams.Cracks, seams.MaxGap);
+	printf("%s\n", ok ? "PASS" : "FAIL");
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "GrassTiles.h"
+#include "LandUtility.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Flies a camera over hills terrain at a steady speed and 60 frames per second, streaming
+// grass tiles around it. The main thread's Update time is what a frame pays.
+int RunTileBench(const BenchArgs& args)
+{
+	double seconds = args.GetFloat(0, 5.0f);
+	float speed = args.GetFloat(1, 30.0f);
+
+	GrassTileCacheDesc desc;
+	desc.LoadRadius = args.GetFloat(2, 128.0f);
+	desc.MemoryBudget = (size_t)args.GetUInt(3, 64) << 20;
+	desc.WorkerCount = (uint32_t)args.GetUInt(4, 2);
+	desc.MinSpacing = 0.1f;
+	desc.Seed = 1;
+	desc.Height = LandUtility::GetHillsHeight;
+	desc.Normal = LandUtility::GetHillsNormal;
+	desc.MaxSlopeDegrees = 60.0f;
+
+	GrassTileCache cache;
+	cache.Initialize(desc);
+
+	printf("%.0f m tiles, %.0f m load radius, %zu MB budget, %u workers, camera %.0f m/s\n",
+		desc.TileSize, desc.LoadRadius, desc.MemoryBudget >> 20, desc.WorkerCount, speed);
+
+	const double frameSeconds = 1.0 / 60.0;
+	uint32_t frames = (uint32_t)(seconds / frameSeconds);
+	double totalUpdateMs = 0.0;
+	double maxUpdateMs = 0.0;
+	size_t minVisible = SIZE_MAX;
+	size_t maxResident = 0;
+
+	BenchTimer clock;
+	for (uint32_t frame = 0; frame < frames; ++frame)
+	{
+		// A wide circle, so old ground is left behind and some of it comes back.
+		float t = (float)(frame * frameSeconds);
+		float turn = speed * t / 600.0f;
+		Float3 camera(600.0f * sinf(turn), 0.0f, 600.0f * (1.0f - cosf(turn)));
+
+		BenchTimer updateTimer;
+		cache.Update(Double3(camera));
+		double updateMs = updateTimer.ElapsedMilliseconds();
+
+		totalUpdateMs += updateMs;
+		maxUpdateMs = max(maxUpdateMs, updateMs);
+		maxResident = max(maxResident, cache.Stats().ResidentBytes);
+
+		// Skip the first second while the cache fills for the first time.
+		if (frame >= 60)
+		{
+			minVisible = min(minVisible, cache.VisibleTiles().size());
+		}
+
+		double frameEnd = (frame + 1) * frameSeconds;
+		double remaining = frameEnd - clock.ElapsedSeconds();
+		if (remaining > 0.0)
+		{
+			this_thread::sleep_for(chrono::duration<double>(remaining));
+		}
+	}
+
+	const GrassTileStats& stats = cache.Stats();
+	uint64_t lookups = stats.Hits + stats.Misses;
+
+	printf("frames %u, update %.3f ms mean, %.3f ms max\n", frames, totalUpdateMs / frames, maxUpdateMs);
+	printf("hits %llu, misses %llu (%.2f%% hit rate)\n", (unsigned long long)stats.Hits,
+		(unsigned long long)stats.Misses, lookups > 0 ? 100.0 * stats.Hits / lookups : 0.0);
+	printf("generated %llu, evicted %llu, generation %.2f ms mean, %.2f ms max\n",
+		(unsigned long long)stats.Generated, (unsigned long long)stats.Evicted, stats.MeanGenerationMs, stats.MaxGenerationMs);
+	printf("request to resident %.2f ms mean, %.2f ms max\n", stats.MeanLatencyMs, stats.MaxLatencyMs);
+	printf("resident %zu tiles, %.1f MB (peak %.1f MB), fewest visible tiles after warm-up %zu\n",
+		stats.ResidentTiles, stats.ResidentBytes / 1048576.0, maxResident / 1048576.0, minVisible);
+
+	return 0;
+}
@@ -0,0 +1,187 @@
+#include "Bench.h"
+#include "FixedTimestep.h"
+#include "GrassChunks.h"
+#include "GrassDump.h"
+#include "GrassField.h"
+#include <cmath>
+#include <random>
+
+static const float TimestepBenchSeconds = 10.0f;
+
+// Wind is a function of simulated time so every frame pacing sees the same forcing.
+static Float3 TimestepBenchWind(float time)
+{
+	return Float3(fmodf(time, 4.0f) < 2.0f ? 10.0f : 0.0f, 0.0f, 0.0f);
+}
+
+// steady: fixed frameTime. Otherwise frames between 4 and 80 ms with a 250 ms hitch every
+// few seconds, the kind of pacing that used to feed the integrator huge deltas.
+static vector<float> BuildFrameTimes(float frameTime, bool jitter)
+{
+	minstd_rand generator(7);
+	uniform_real_distribution<float> distribution(0.004f, 0.080f);
+
+	vector<float> frameTimes;
+	float total = 0.0f;
+	while (total < TimestepBenchSeconds)
+	{
+		float dt = jitter ? distribution(generator) : frameTime;
+		if (jitter && frameTimes.size() % 97 == 96)
+		{
+			dt = 0.25f;
+		}
+
+		frameTimes.push_back(dt);
+		total += dt;
+	}
+
+	return frameTimes;
+}
+
+static bool IsFinite(const vector<Bone>& bones)
+{
+	for (const auto& bone : bones)
+	{
+		if (!isfinite(bone.LocalRotation.x) || !isfinite(bone.LocalRotation.y) ||
+			!isfinite(bone.LocalRotation.z) || !isfinite(bone.LocalRotation.w) ||
+			!isfinite(bone.Velocity.x) || !isfinite(bone.Velocity.y) || !isfinite(bone.Velocity.z))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static float MaxAngularSpeed(const GrassChunkSimulation& simulation)
+{
+	vector<Bone> bones(simulation.BoneCount());
+	simulation.CopyBones(bones.data());
+
+	float maxSpeed = 0.0f;
+	for (const auto& bone : bones)
+	{
+		maxSpeed = fmaxf(maxSpeed, Length(bone.Velocity));
+	}
+	return maxSpeed;
+}
+
+int RunTimestepBench(const BenchArgs& args)
+{
+	GrassFieldDesc desc;
+	desc.BladeCount = (uint32_t)args.GetUInt(0, 10000);
+	float stepRate = args.GetFloat(1, 60.0f);
+
+	vector<Float3> roots = GrassFieldUtil::BuildRoots(desc, 1);
+	vector<Bone> restBones = GrassSimulation::BuildBones(desc.BladeCount, desc.BonesPerBlade, desc.BoneLength, desc.BoneMass);
+
+	struct Pacing
+	{
+		const char* Name;
+		float FrameTime;
+		bool Jitter;
+	};
+
+	const Pacing pacings[] =
+	{
+		{ "30 fps", 1.0f / 30.0f, false },
+		{ "60 fps", 1.0f / 60.0f, false },
+		{ "144 fps", 1.0f / 144.0f, false },
+		{ "jitter", 0.0f, true },
+	};
+
+	printf("%u blades, %.0f Hz fixed step, %.0f s per run\n", desc.BladeCount, stepRate, TimestepBenchSeconds);
+	printf("%-8s %-6s %7s %7s %11s %10s %12s %10s\n",
+		"pacing", "mode", "frames", "steps", "steps/frame", "sim ms", "peak speed", "vs fixed");
+
+	for (const auto& pacing : pacings)
+	{
+		vector<float> frameTimes = BuildFrameTimes(pacing.FrameTime, pacing.Jitter);
+
+		// Raw frame delta, the way Grass.hlsl integrated before.
+		{
+			GrassChunkSimulation simulation;
+			simulation.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+
+			float time = 0.0f;
+			double ms = 0.0;
+			float peakSpeed = 0.0f;
+			for (float dt : frameTimes)
+			{
+				GrassStepParams params;
+				params.WindVelocity = TimestepBenchWind(time);
+				params.DeltaTime = dt;
+
+				BenchTimer timer;
+				simulation.Step(params, nullptr);
+				ms += timer.ElapsedMilliseconds();
+
+				peakSpeed = fmaxf(peakSpeed, MaxAngularSpeed(simulation));
+				time += dt;
+			}
+
+			vector<Bone> bones(simulation.BoneCount());
+			simulation.CopyBones(bones.data());
+
+			printf("%-8s %-6s %7zu %7zu %11.2f %10.1f %12.4g %10s\n", pacing.Name, "raw", frameTimes.size(), frameTimes.size(),
+				1.0, ms, peakSpeed, IsFinite(bones) ? "-" : "NaN");
+		}
+
+		// Fixed steps, compared against stepping the same count back to back.
+		{
+			FixedTimestep timestep(1.0f / stepRate);
+
+			GrassChunkSimulation simulation;
+			simulation.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+
+			double ms = 0.0;
+			float peakSpeed = 0.0f;
+			for (float dt : frameTimes)
+			{
+				uint32_t steps = timestep.Advance(dt);
+
+				BenchTimer timer;
+				for (uint32_t i = 0; i < steps; ++i)
+				{
+					GrassStepParams params;
+					params.WindVelocity = TimestepBenchWind(simulation.StepCount() * timestep.StepDeltaTime());
+					params.DeltaTime = timestep.StepDeltaTime();
+					simulation.Step(params, nullptr);
+				}
+				ms += timer.ElapsedMilliseconds();
+
+				peakSpeed = fmaxf(peakSpeed, MaxAngularSpeed(simulation));
+			}
+
+			GrassChunkSimulation reference;
+			reference.Initialize(restBones, desc.BonesPerBlade, roots, desc.BladesPerChunk);
+			for (uint64_t i = 0; i < timestep.TotalSteps(); ++i)
+			{
+				GrassStepParams params;
+				params.WindVelocity = TimestepBenchWind(reference.StepCount() * timestep.StepDeltaTime());
+				params.DeltaTime = timestep.StepDeltaTime();
+				reference.Step(params, nullptr);
+			}
+
+			GrassDump expected;
+			expected.BladeCount = desc.BladeCount;
+			expected.BonesPerBlade = desc.BonesPerBlade;
+			expected.Bones.resize(reference.BoneCount());
+			reference.CopyBones(expected.Bones.data());
+
+			GrassDump actual = expected;
+			simulation.CopyBones(actual.Bones.data());
+
+			GrassDumpDiff diff = GrassDumpUtil::Compare(expected, actual, 0);
+
+			char match[32];
+			snprintf(match, sizeof(match), "%u ulp", diff.MaxUlpDistance);
+
+			printf("%-8s %-6s %7zu %7llu %11.2f %10.1f %12.4g %10s\n", pacing.Name, "fixed", frameTimes.size(),
+				(unsigned long long)timestep.TotalSteps(), (double)timestep.TotalSteps() / frameTimes.size(),
+				ms, peakSpeed, match);
+		}
+	}
+
+	return 0;
+}
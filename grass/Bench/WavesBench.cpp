@@ -0,0 +1,154 @@
+#include "Bench.h"
+#include "GrassDump.h"
+#include "SimdMath.h"
+#include "Waves.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+static const float SpatialStep = 0.25f;
+static const float TimeStep = 0.03f;
+static const float Speed = 3.25f;
+static const float Damping = 0.4f;
+
+// Waves as it was before the height planes: whole vertices in the solution arrays of which
+// only y is used, the stencil and the normal pass as two sweeps. The reference the tiled
+// solver is held to.
+struct ReferenceWaves
+{
+	ReferenceWaves(int m, int n) : Rows(m), Cols(n), Prev((size_t)m * n), Curr((size_t)m * n),
+		Normals((size_t)m * n, Float3(0.0f, 1.0f, 0.0f)), Tangents((size_t)m * n, Float3(1.0f, 0.0f, 0.0f))
+	{
+		float d = Damping * TimeStep + 2.0f;
+		float e = (Speed * Speed) * (TimeStep * TimeStep) / (SpatialStep * SpatialStep);
+		K1 = (Damping * TimeStep - 2.0f) / d;
+		K2 = (4.0f - 8.0f * e) / d;
+		K3 = (2.0f * e) / d;
+	}
+
+	void Step()
+	{
+		for (int i = 1; i < Rows - 1; ++i)
+		{
+			for (int j = 1; j < Cols - 1; ++j)
+			{
+				Prev[i * Cols + j].y = K1 * Prev[i * Cols + j].y + K2 * Curr[i * Cols + j].y +
+					K3 * (Curr[(i + 1) * Cols + j].y + Curr[(i - 1) * Cols + j].y + Curr[i * Cols + j + 1].y +
+						Curr[i * Cols + j - 1].y);
+			}
+		}
+
+		swap(Prev, Curr);
+
+		for (int i = 1; i < Rows - 1; ++i)
+		{
+			for (int j = 1; j < Cols - 1; ++j)
+			{
+				float l = Curr[i * Cols + j - 1].y;
+				float r = Curr[i * Cols + j + 1].y;
+				float t = Curr[(i - 1) * Cols + j].y;
+				float b = Curr[(i + 1) * Cols + j].y;
+				Normals[i * Cols + j] = Normalize(Float3(-r + l, 2.0f * SpatialStep, b - t));
+				Tangents[i * Cols + j] = Normalize(Float3(2.0f * SpatialStep, r - l, 0.0f));
+			}
+		}
+	}
+
+	void Disturb(int i, int j, float magnitude)
+	{
+		float halfMag = 0.5f * magnitude;
+		Curr[i * Cols + j].y += magnitude;
+		Curr[i * Cols + j + 1].y += halfMag;
+		Curr[i * Cols + j - 1].y += halfMag;
+		Curr[(i + 1) * Cols + j].y += halfMag;
+		Curr[(i - 1) * Cols + j].y += halfMag;
+	}
+
+	int Rows;
+	int Cols;
+	float K1 = 0.0f;
+	float K2 = 0.0f;
+	float K3 = 0.0f;
+	vector<Float3> Prev;
+	vector<Float3> Curr;
+	vector<Float3> Normals;
+	vector<Float3> Tangents;
+};
+
+int RunWavesBench(const BenchArgs& args)
+{
+	int maxSize = (int)args.GetUInt(0, 4096);
+	double cellSteps = (double)args.GetUInt(1, 200000000);
+	float maxError = args.GetFloat(2, 1e-5f);
+
+	const int DisturbEvery = 25;
+
+	printf("%d-wide SIMD, %dx%d tiles, tolerance %g\n", SimdWidth, Waves::TileRows, Waves::TileColumns, maxError);
+	printf("%6s  %6s  %16s  %16s  %8s  %10s  %10s  %10s\n", "grid", "steps", "reference ms", "tiled ms", "speedup",
+		"height ulp", "height err", "normal err");
+
+	bool ok = true;
+	for (int size = 256; size <= maxSize; size *= 2)
+	{
+		int steps = max(4, (int)(cellSteps / ((double)size * size)));
+		Waves waves(size, size, SpatialStep, TimeStep, Speed, Damping);
+		ReferenceWaves reference(size, size);
+
+		// The same drops into both, a few at the start and one every DisturbEvery steps.
+		minstd_rand rng(size);
+		uniform_int_distribution<int> cell(2, size - 3);
+		uniform_real_distribution<float> magnitude(-1.0f, 1.0f);
+		auto disturb = [&]()
+		{
+			int i = cell(rng);
+			int j = cell(rng);
+			float m = magnitude(rng);
+			waves.Disturb(i, j, m);
+			reference.Disturb(i, j, m);
+		};
+
+		for (int k = 0; k < 8; ++k)
+		{
+			disturb();
+		}
+
+		double referenceMs = 0.0;
+		double tiledMs = 0.0;
+		for (int step = 0; step < steps; ++step)
+		{
+			if (step > 0 && step % DisturbEvery == 0)
+			{
+				disturb();
+			}
+
+			BenchTimer referenceTimer;
+			reference.Step();
+			referenceMs += referenceTimer.ElapsedMilliseconds();
+
+			BenchTimer tiledTimer;
+			waves.Update(TimeStep);
+			tiledMs += tiledTimer.ElapsedMilliseconds();
+		}
+
+		// Where the compiler contracts the stencil into FMAs the two round differently, and
+		// heights near zero are then millions of ulps apart; the check is on absolute error.
+		uint32_t heightUlps = 0;
+		float heightError = 0.0f;
+		float normalError = 0.0f;
+		for (int i = 0; i < waves.VertexCount(); ++i)
+		{
+			heightUlps = max(heightUlps, GrassDumpUtil::UlpDistance(waves.Height(i), reference.Curr[i].y));
+			heightError = max(heightError, fabsf(waves.Height(i) - reference.Curr[i].y));
+			normalError = max(normalError, Length(waves.Normal(i) - reference.Normals[i]));
+			normalError = max(normalError, Length(waves.TangentX(i) - reference.Tangents[i]));
+		}
+
+		// NaN fails both comparisons.
+		ok = ok && heightError <= maxError && normalError <= maxError;
+		printf("%4dx%-4d  %6d  %10.3f/step  %10.3f/step  %7.2fx  %10u  %10.2e  %10.2e\n", size, size, steps,
+			referenceMs / steps, tiledMs / steps, referenceMs / tiledMs, heightUlps, heightError, normalError);
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
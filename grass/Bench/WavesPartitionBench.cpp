@@ -0,0 +1,81 @@
+#include "Bench.h"
+#include "GrassDump.h"
+#include "ThreadPool.h"
+#include "Waves.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+
+static const float SpatialStep = 0.25f;
+static const float TimeStep = 0.03f;
+static const float Speed = 3.25f;
+static const float Damping = 0.4f;
+
+int RunWavesPartitionBench(const BenchArgs& args)
+{
+	int maxSize = (int)args.GetUInt(0, 4096);
+	uint32_t threads = (uint32_t)args.GetUInt(1, 0);
+	ThreadAffinity affinity = args.GetUInt(2, 0) != 0 ? ThreadAffinity::PinWorkers : ThreadAffinity::Any;
+
+	const double CellSteps = 2e8;
+	const int Drops = 16;
+	const WavesPartition Partitions[] = { WavesPartition::Rows, WavesPartition::Tiles, WavesPartition::Bands };
+
+	ThreadPool pool(threads, affinity);
+	printf("%u threads%s\n", pool.ThreadCount(), affinity == ThreadAffinity::PinWorkers ? ", workers pinned" : "");
+	printf("%9s  %6s  %12s  %12s  %12s  %12s  %10s\n", "grid", "steps", "serial ms", "rows ms", "tiles ms", "bands ms",
+		"height ulp");
+
+	bool ok = true;
+	for (int size = 256; size <= maxSize; size *= 2)
+	{
+		int steps = max(4, (int)(CellSteps / ((double)size * size)));
+
+		// The serial tiled update is the reference: however the grid is cut, every point is
+		// the same arithmetic on the same inputs.
+		auto run = [&](WavesPartition partition, ThreadPool* stepPool, double& ms)
+		{
+			auto waves = make_unique<Waves>(size, size, SpatialStep, TimeStep, Speed, Damping);
+			waves->SetPartition(partition);
+
+			minstd_rand rng(size);
+			uniform_int_distribution<int> cell(2, size - 3);
+			uniform_real_distribution<float> magnitude(-1.0f, 1.0f);
+			for (int k = 0; k < Drops; ++k)
+			{
+				int i = cell(rng);
+				int j = cell(rng);
+				waves->Disturb(i, j, magnitude(rng));
+			}
+
+			BenchTimer timer;
+			for (int step = 0; step < steps; ++step)
+			{
+				waves->Update(TimeStep, stepPool);
+			}
+			ms = timer.ElapsedMilliseconds() / steps;
+			return waves;
+		};
+
+		double serialMs = 0.0;
+		unique_ptr<Waves> serial = run(WavesPartition::Tiles, nullptr, serialMs);
+
+		double partitionMs[3] = {};
+		uint32_t heightUlps = 0;
+		for (int p = 0; p < 3; ++p)
+		{
+			unique_ptr<Waves> waves = run(Partitions[p], &pool, partitionMs[p]);
+			for (int i = 0; i < waves->VertexCount(); ++i)
+			{
+				heightUlps = max(heightUlps, GrassDumpUtil::UlpDistance(waves->Height(i), serial->Height(i)));
+			}
+		}
+
+		ok = ok && heightUlps == 0;
+		printf("%4dx%-4d  %6d  %12.3f  %12.3f  %12.3f  %12.3f  %10u\n", size, size, steps, serialMs, partitionMs[0],
+			partitionMs[1], partitionMs[2], heightUlps);
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
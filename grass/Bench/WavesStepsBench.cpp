@@ -0,0 +1,181 @@
+#include "Bench.h"
+#include "GrassDump.h"
+#include "ThreadPool.h"
+#include "Waves.h"
+#include <algorithm>
+#include <memory>
+#include <random>
+
+// A power of two, so whole multiples of it add up exactly in the accumulator.
+static const float TimeStep = 1.0f / 32.0f;
+static const float SpatialStep = 0.25f;
+static const float Speed = 3.25f;
+static const float Damping = 0.4f;
+
+static unique_ptr<Waves> MakeWaves(int size, uint32_t seed, int drops)
+{
+	auto waves = make_unique<Waves>(size, size, SpatialStep, TimeStep, Speed, Damping);
+
+	minstd_rand rng(seed);
+	uniform_int_distribution<int> cell(2, size - 3);
+	uniform_real_distribution<float> magnitude(-1.0f, 1.0f);
+	for (int k = 0; k < drops; ++k)
+	{
+		int i = cell(rng);
+		int j = cell(rng);
+		waves->Disturb(i, j, magnitude(rng));
+	}
+	return waves;
+}
+
+// Largest ulp distance between the heights, normals and tangents of two surfaces.
+static uint32_t MaxUlps(const Waves& a, const Waves& b)
+{
+	uint32_t ulps = 0;
+	for (int i = 0; i < a.VertexCount(); ++i)
+	{
+		Float3 na = a.Normal(i);
+		Float3 nb = b.Normal(i);
+		Float3 ta = a.TangentX(i);
+		Float3 tb = b.TangentX(i);
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(a.Height(i), b.Height(i)));
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(na.x, nb.x));
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(na.y, nb.y));
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(na.z, nb.z));
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(ta.x, tb.x));
+		ulps = max(ulps, GrassDumpUtil::UlpDistance(ta.y, tb.y));
+	}
+	return ulps;
+}
+
+int RunWavesStepsBench(const BenchArgs& args)
+{
+	int size = (int)args.GetUInt(0, 1024);
+	uint32_t surfaceCount = (uint32_t)args.GetUInt(1, 16);
+	uint32_t threads = (uint32_t)args.GetUInt(2, 0);
+
+	const int CheckSize = 128;
+	const int CheckFrames = 40;
+	const int BlockedSteps = 64;
+	const int SurfaceSize = 256;
+	const int SurfaceFrames = 32;
+
+	ThreadPool pool(threads);
+	bool ok = true;
+
+	// Two surfaces updated in turn at different rates must each come out as they would on
+	// their own: one a step per frame, the other three steps' worth of time per frame
+	// against a twin given the same time a step at a time.
+	unique_ptr<Waves> a = MakeWaves(CheckSize, 1, 8);
+	unique_ptr<Waves> b = MakeWaves(CheckSize, 2, 8);
+	unique_ptr<Waves> aAlone = MakeWaves(CheckSize, 1, 8);
+	unique_ptr<Waves> bStepped = MakeWaves(CheckSize, 2, 8);
+	int aSteps = 0;
+	int bSteps = 0;
+	for (int frame = 0; frame < CheckFrames; ++frame)
+	{
+		aSteps += a->Update(TimeStep);
+		bSteps += b->Update(3.0f * TimeStep);
+	}
+	for (int frame = 0; frame < CheckFrames; ++frame)
+	{
+		aAlone->Update(TimeStep);
+		for (int k = 0; k < 3; ++k)
+		{
+			bStepped->Update(TimeStep);
+		}
+	}
+	uint32_t aUlps = MaxUlps(*a, *aAlone);
+	uint32_t bUlps = MaxUlps(*b, *bStepped);
+
+	// A long stall is caught up only as far as the bound, and the rest forgotten.
+	unique_ptr<Waves> stalled = MakeWaves(CheckSize, 3, 8);
+	int stallSteps = stalled->Update(100.0f * TimeStep);
+	int afterStallSteps = stalled->Update(0.5f * TimeStep);
+
+	bool independent = aSteps == CheckFrames && bSteps == 3 * CheckFrames && aUlps == 0 && bUlps == 0;
+	bool bounded = stallSteps == stalled->MaxStepsPerUpdate() && afterStallSteps == 0;
+	ok = ok && independent && bounded;
+	printf("independence: %d and %d steps, %u and %u ulp from surfaces run alone; stall of 100 steps ran %d then %d: %s\n",
+		aSteps, bSteps, aUlps, bUlps, stallSteps, afterStallSteps, independent && bounded ? "ok" : "FAILED");
+
+	// Catching up several steps at a time, with and without stepping blocks several times
+	// per pass.
+	printf("%dx%d, %d steps caught up %d at a time, %u threads\n", size, size, BlockedSteps, Waves::MaxStepsPerPass,
+		pool.ThreadCount());
+	printf("%14s  %10s  %12s  %14s  %8s  %8s\n", "steps per pass", "ms/step", "steps/s", "cell steps/s", "speedup", "ulp");
+
+	unique_ptr<Waves> single;
+	double singleMs = 0.0;
+	for (int stepsPerPass = 1; stepsPerPass <= Waves::MaxStepsPerPass; stepsPerPass *= 2)
+	{
+		unique_ptr<Waves> waves = MakeWaves(size, 4, 32);
+		waves->SetMaxStepsPerUpdate(Waves::MaxStepsPerPass);
+		waves->SetStepsPerPass(stepsPerPass);
+
+		BenchTimer timer;
+		int steps = 0;
+		while (steps < BlockedSteps)
+		{
+			steps += waves->Update(Waves::MaxStepsPerPass * TimeStep, &pool);
+		}
+		double ms = timer.ElapsedMilliseconds() / steps;
+
+		uint32_t ulps = 0;
+		if (stepsPerPass == 1)
+		{
+			single = move(waves);
+			singleMs = ms;
+		}
+		else
+		{
+			ulps = MaxUlps(*waves, *single);
+		}
+
+		ok = ok && ulps == 0;
+		printf("%14d  %10.3f  %12.1f  %14.3g  %7.2fx  %8u\n", stepsPerPass, ms, 1000.0 / ms,
+			(double)size * size * 1000.0 / ms, singleMs / ms, ulps);
+	}
+
+	// Many small surfaces: one after another, and side by side on the pool.
+	vector<unique_ptr<Waves>> serialSurfaces;
+	vector<unique_ptr<Waves>> pooledSurfaces;
+	vector<Waves*> serialPointers;
+	vector<Waves*> pooledPointers;
+	for (uint32_t k = 0; k < surfaceCount; ++k)
+	{
+		serialSurfaces.push_back(MakeWaves(SurfaceSize, 10 + k, 8));
+		pooledSurfaces.push_back(MakeWaves(SurfaceSize, 10 + k, 8));
+		serialPointers.push_back(serialSurfaces.back().get());
+		pooledPointers.push_back(pooledSurfaces.back().get());
+	}
+
+	BenchTimer serialTimer;
+	for (int frame = 0; frame < SurfaceFrames; ++frame)
+	{
+		Waves::UpdateAll(serialPointers.data(), surfaceCount, TimeStep);
+	}
+	double serialSeconds = serialTimer.ElapsedSeconds();
+
+	BenchTimer pooledTimer;
+	for (int frame = 0; frame < SurfaceFrames; ++frame)
+	{
+		Waves::UpdateAll(pooledPointers.data(), surfaceCount, TimeStep, &pool);
+	}
+	double pooledSeconds = pooledTimer.ElapsedSeconds();
+
+	uint32_t surfaceUlps = 0;
+	for (uint32_t k = 0; k < surfaceCount; ++k)
+	{
+		surfaceUlps = max(surfaceUlps, MaxUlps(*serialSurfaces[k], *pooledSurfaces[k]));
+	}
+	ok = ok && surfaceUlps == 0;
+
+	double surfaceSteps = (double)surfaceCount * SurfaceFrames;
+	printf("%u surfaces of %dx%d: %.1f surface steps/s one after another, %.1f side by side (%.2fx), %u ulp apart\n",
+		surfaceCount, SurfaceSize, SurfaceSize, surfaceSteps / serialSeconds, surfaceSteps / pooledSeconds,
+		serialSeconds / pooledSeconds, surfaceUlps);
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
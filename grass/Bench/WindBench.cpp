@@ -0,0 +1,123 @@
+#include "Bench.h"
+#include "BoneSoA.h"
+#include "GrassField.h"
+#include "GrassSimulation.h"
+#include "WindField.h"
+#include <algorithm>
+#include <cmath>
+
+static const float WindBenchDeltaTime = 1.0f / 60.0f;
+static const float WindBenchTolerance = 1e-5f;
+
+static double TimeSimulate(BoneSoA& soa, const GrassStepParams& params, double minSeconds, uint32_t& steps)
+{
+	steps = 0;
+	BenchTimer timer;
+	do
+	{
+		GrassSimulation::Simulate(soa, params);
+		++steps;
+	} while (steps < 3 || timer.ElapsedSeconds() < minSeconds);
+
+	return (double)soa.BoneCount() * steps / timer.ElapsedSeconds();
+}
+
+int RunWindBench(const BenchArgs& args)
+{
+	WindFieldDesc windDesc;
+	windDesc.Width = (uint32_t)args.GetUInt(0, 256);
+	windDesc.Height = (uint32_t)args.GetUInt(1, 256);
+	uint32_t bladeCount = (uint32_t)args.GetUInt(2, 100000);
+	double minSeconds = args.GetFloat(3, 0.5f);
+
+	GrassFieldDesc fieldDesc;
+	fieldDesc.BladeCount = bladeCount;
+	fieldDesc.FieldSize = 10.0f * sqrtf((float)bladeCount / 32.0f);
+
+	windDesc.CellSize = fieldDesc.FieldSize / (windDesc.Width - 1);
+	windDesc.OriginX = -0.5f * fieldDesc.FieldSize;
+	windDesc.OriginZ = -0.5f * fieldDesc.FieldSize;
+
+	WindField wind;
+	wind.Initialize(windDesc);
+
+	printf("simd width %d, %ux%u nodes, %u blades\n", SimdWidth, windDesc.Width, windDesc.Height, bladeCount);
+
+	// Field update.
+	uint32_t updates = 0;
+	BenchTimer updateTimer;
+	do
+	{
+		wind.Update(updates * WindBenchDeltaTime, 1.0f);
+		++updates;
+	} while (updates < 10 || updateTimer.ElapsedSeconds() < minSeconds);
+	double updateMs = updateTimer.ElapsedMilliseconds() / updates;
+
+	printf("update: %.4f ms (%.2f ns/node), target < 0.2 ms, max speed %.2f m/s\n",
+		updateMs, 1e6 * updateMs / wind.NodeCount(), wind.MaxSpeed());
+
+	// Point sampling.
+	uint32_t sampleCount = 1 << 20;
+	float sum = 0.0f;
+	BenchTimer sampleTimer;
+	for (uint32_t i = 0; i < sampleCount; ++i)
+	{
+		float u = (float)(i & 1023) / 1023.0f;
+		float v = (float)(i >> 10) / 1023.0f;
+		sum += wind.Sample(windDesc.OriginX + u * fieldDesc.FieldSize, windDesc.OriginZ + v * fieldDesc.FieldSize).x;
+	}
+	printf("sample: %.2f ns (checksum %.1f)\n", 1e9 * sampleTimer.ElapsedSeconds() / sampleCount, sum);
+
+	// Bone kernel with the uniform vector only and with the field on top.
+	vector<Float3> roots = GrassFieldUtil::BuildRoots(fieldDesc, 1);
+	vector<Bone> bones = GrassSimulation::BuildBones(bladeCount, fieldDesc.BonesPerBlade);
+	GrassSimulation::SetBladeRoots(bones, roots);
+
+	BoneSoA soa;
+	soa.FromBones(bones.data(), bladeCount, fieldDesc.BonesPerBlade);
+
+	GrassStepParams params;
+	params.DeltaTime = WindBenchDeltaTime;
+	params.WindVelocity = Float3(windDesc.DirectionX * windDesc.BaseSpeed, 0.0f, windDesc.DirectionZ * windDesc.BaseSpeed);
+
+	uint32_t uniformSteps = 0;
+	double uniformRate = TimeSimulate(soa, params, minSeconds, uniformSteps);
+
+	soa.FromBones(bones.data(), bladeCount, fieldDesc.BonesPerBlade);
+	params.WindVelocity = Float3(0.0f, 0.0f, 0.0f);
+	params.Wind = &wind;
+
+	uint32_t fieldSteps = 0;
+	double fieldRate = TimeSimulate(soa, params, minSeconds, fieldSteps);
+
+	printf("kernel: uniform %.4g bones/s, field %.4g bones/s (%.1f%% slower)\n",
+		uniformRate, fieldRate, 100.0 * (1.0 - fieldRate / uniformRate));
+
+	// One step from rest on both paths: the SIMD gather must see the same wind as the
+	// per-blade sample. The paths round sin/cos differently, so once the wind has both x
+	// and z components the near-zero terms no longer match bit for bit; compare absolutely.
+	soa.FromBones(bones.data(), bladeCount, fieldDesc.BonesPerBlade);
+	GrassSimulation::Simulate(soa, params);
+	GrassSimulation::Simulate(bones, bladeCount, fieldDesc.BonesPerBlade, params);
+
+	vector<Bone> actual(bones.size());
+	soa.ToBones(actual.data());
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < bones.size(); ++i)
+	{
+		const Bone& e = bones[i];
+		const Bone& a = actual[i];
+		Float3 dPosition = e.Position - a.Position;
+		Float3 dVelocity = e.Velocity - a.Velocity;
+		Float4 dRotation(e.LocalRotation.x - a.LocalRotation.x, e.LocalRotation.y - a.LocalRotation.y,
+			e.LocalRotation.z - a.LocalRotation.z, e.LocalRotation.w - a.LocalRotation.w);
+
+		maxError = max(maxError, max(Length(dPosition), max(Length(dVelocity), sqrtf(Dot(dRotation, dRotation)))));
+	}
+
+	bool matches = maxError <= WindBenchTolerance;
+	printf("aos vs soa with field, one step: max error %g (tolerance %g) %s\n", maxError, WindBenchTolerance, matches ? "PASS" : "FAIL");
+
+	return matches ? 0 : 1;
+}
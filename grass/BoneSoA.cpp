@@ -0,0 +1,125 @@
+#include "BoneSoA.h"
+
+void BoneSoA::Resize(uint32_t bladeCount, uint32_t bonesPerBlade)
+{
+	BladeCount = bladeCount;
+	BonesPerBlade = bonesPerBlade;
+	Stride = (bladeCount + SimdWidth - 1) / SimdWidth * SimdWidth;
+
+	size_t count = (size_t)Stride * bonesPerBlade;
+
+	// Padding lanes are unit-length, unit-mass rest bones so they never divide by zero.
+	PositionX.assign(count, 0.0f);
+	PositionY.assign(count, 0.0f);
+	PositionZ.assign(count, 0.0f);
+	Mass.assign(count, 1.0f);
+	RotationX.assign(count, 0.0f);
+	RotationY.assign(count, 0.0f);
+	RotationZ.assign(count, 0.0f);
+	RotationW.assign(count, 1.0f);
+	VelocityX.assign(count, 0.0f);
+	VelocityY.assign(count, 0.0f);
+	VelocityZ.assign(count, 0.0f);
+	Length.assign(count, 1.0f);
+	ParentIndex.assign(count, -1);
+	LocalPositionX.assign(count, 0.0f);
+	LocalPositionY.assign(count, 0.0f);
+	LocalPositionZ.assign(count, 0.0f);
+	LocalRotationX.assign(count, 0.0f);
+	LocalRotationY.assign(count, 0.0f);
+	LocalRotationZ.assign(count, 0.0f);
+	LocalRotationW.assign(count, 1.0f);
+}
+
+void BoneSoA::FromBones(const Bone* bones, uint32_t bladeCount, uint32_t bonesPerBlade)
+{
+	Resize(bladeCount, bonesPerBlade);
+
+	for (uint32_t level = 0; level < bonesPerBlade; ++level)
+	{
+		const Bone* src = bones + (size_t)level * bladeCount;
+		size_t dst = Index(level, 0);
+
+		for (uint32_t i = 0; i < bladeCount; ++i, ++dst)
+		{
+			const Bone& bone = src[i];
+
+			PositionX[dst] = bone.Position.x;
+			PositionY[dst] = bone.Position.y;
+			PositionZ[dst] = bone.Position.z;
+			Mass[dst] = bone.Mass;
+			RotationX[dst] = bone.Rotation.x;
+			RotationY[dst] = bone.Rotation.y;
+			RotationZ[dst] = bone.Rotation.z;
+			RotationW[dst] = bone.Rotation.w;
+			VelocityX[dst] = bone.Velocity.x;
+			VelocityY[dst] = bone.Velocity.y;
+			VelocityZ[dst] = bone.Velocity.z;
+			Length[dst] = bone.Length;
+			ParentIndex[dst] = bone.ParentIndex;
+			LocalPositionX[dst] = bone.LocalPosition.x;
+			LocalPositionY[dst] = bone.LocalPosition.y;
+			LocalPositionZ[dst] = bone.LocalPosition.z;
+			LocalRotationX[dst] = bone.LocalRotation.x;
+			LocalRotationY[dst] = bone.LocalRotation.y;
+			LocalRotationZ[dst] = bone.LocalRotation.z;
+			LocalRotationW[dst] = bone.LocalRotation.w;
+		}
+	}
+}
+
+void BoneSoA::ToBones(Bone* bones) const
+{
+	for (uint32_t level = 0; level < BonesPerBlade; ++level)
+	{
+		Bone* dst = bones + (size_t)level * BladeCount;
+		size_t src = Index(level, 0);
+
+		for (uint32_t i = 0; i < BladeCount; ++i, ++src)
+		{
+			Bone& bone = dst[i];
+
+			bone.Position = Float3(PositionX[src], PositionY[src], PositionZ[src]);
+			bone.Mass = Mass[src];
+			bone.Rotation = Float4(RotationX[src], RotationY[src], RotationZ[src], RotationW[src]);
+			bone.Velocity = Float3(VelocityX[src], VelocityY[src], VelocityZ[src]);
+			bone.Length = Length[src];
+			bone.ParentIndex = ParentIndex[src];
+			bone.LocalPosition = Float3(LocalPositionX[src], LocalPositionY[src], LocalPositionZ[src]);
+			bone.LocalRotation = Float4(LocalRotationX[src], LocalRotationY[src], LocalRotationZ[src], LocalRotationW[src]);
+		}
+	}
+}
+
+void BoneSoA::ToBonesInterpolated(Bone* bones, const BonePoseSoA& previous, float alpha) const
+{
+	ToBones(bones);
+
+	for (uint32_t level = 0; level < BonesPerBlade; ++level)
+	{
+		Bone* dst = bones + (size_t)level * BladeCount;
+		size_t src = Index(level, 0);
+
+		for (uint32_t i = 0; i < BladeCount; ++i, ++src)
+		{
+			Bone& bone = dst[i];
+
+			Float3 previousPosition(previous.PositionX[src], previous.PositionY[src], previous.PositionZ[src]);
+			Float4 previousRotation(previous.RotationX[src], previous.RotationY[src], previous.RotationZ[src], previous.RotationW[src]);
+
+			bone.Position = Lerp(previousPosition, bone.Position, alpha);
+			bone.Rotation = QuaternionNlerp(previousRotation, bone.Rotation, alpha);
+		}
+	}
+}
+
+void BonePoseSoA::CopyFrom(const BoneSoA& bones)
+{
+	PositionX = bones.PositionX;
+	PositionY = bones.PositionY;
+	PositionZ = bones.PositionZ;
+	RotationX = bones.RotationX;
+	RotationY = bones.RotationY;
+	RotationZ = bones.RotationZ;
+	RotationW = bones.RotationW;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include "AlignedAllocator.h"
+#include "GrassSimulation.h"
+#include "SimdMath.h"
+
+struct BonePoseSoA;
+
+// Structure-of-arrays copy of the level-major Bone buffer. Every component gets its own
+// 32-byte aligned stream and every level is padded to a multiple of SimdWidth blades, so
+// the SIMD kernel integrates SimdWidth neighbouring blades per iteration with aligned loads.
+// Padding lanes hold rest bones and are simulated along with the real ones.
+struct BoneSoA
+{
+	void Resize(uint32_t bladeCount, uint32_t bonesPerBlade);
+
+	void FromBones(const Bone* bones, uint32_t bladeCount, uint32_t bonesPerBlade);
+	void ToBones(Bone* bones) const;
+	// Like ToBones, but position and rotation are blended from previous (alpha = 0) to the
+	// current state (alpha = 1).
+	void ToBonesInterpolated(Bone* bones, const BonePoseSoA& previous, float alpha) const;
+
+	size_t Index(uint32_t level, uint32_t blade) const { return (size_t)level * Stride + blade; }
+	size_t BoneCount() const { return (size_t)BladeCount * BonesPerBlade; }
+	size_t ByteSize() const { return (size_t)Stride * BonesPerBlade * StreamCount * sizeof(float); }
+
+	static const uint32_t StreamCount = 20;
+
+	uint32_t BladeCount = 0;
+	uint32_t BonesPerBlade = 0;
+	uint32_t Stride = 0;
+
+	AlignedVector<float> PositionX;
+	AlignedVector<float> PositionY;
+	AlignedVector<float> PositionZ;
+	AlignedVector<float> Mass;
+	AlignedVector<float> RotationX;
+	AlignedVector<float> RotationY;
+	AlignedVector<float> RotationZ;
+	AlignedVector<float> RotationW;
+	AlignedVector<float> VelocityX;
+	AlignedVector<float> VelocityY;
+	AlignedVector<float> VelocityZ;
+	AlignedVector<float> Length;
+	AlignedVector<int> ParentIndex;
+	AlignedVector<float> LocalPositionX;
+	AlignedVector<float> LocalPositionY;
+	AlignedVector<float> LocalPositionZ;
+	AlignedVector<float> LocalRotationX;
+	AlignedVector<float> LocalRotationY;
+	AlignedVector<float> LocalRotationZ;
+	AlignedVector<float> LocalRotationW;
+};
+
+// The position and rotation streams of a BoneSoA, kept from the step before the last one so
+// rendering can interpolate between fixed steps.
+struct BonePoseSoA
+{
+	void CopyFrom(const BoneSoA& bones);
+
+	AlignedVector<float> PositionX;
+	AlignedVector<float> PositionY;
+	AlignedVector<float> PositionZ;
+	AlignedVector<float> RotationX;
+	AlignedVector<float> RotationY;
+	AlignedVector<float> RotationZ;
+	AlignedVector<float> RotationW;
+};
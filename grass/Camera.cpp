@@ -11,26 +11,54 @@ Camera::~Camera()
 
 XMVECTOR Camera::GetPosition() const
 {
-	return XMLoadFloat3(&mPosition);
+	XMFLOAT3 position = GetPosition3f();
+	return XMLoadFloat3(&position);
 }
 
 XMFLOAT3 Camera::GetPosition3f() const
+{
+	return RelativePosition(mPosition, Double3());
+}
+
+const Double3& Camera::GetWorldPosition() const
 {
 	return mPosition;
 }
 
 void Camera::SetPosition(float x, float y, float z)
 {
-	mPosition = XMFLOAT3(x, y, z);
+	mPosition = Double3(x, y, z);
 	mViewDirty = true;
 }
 
 void Camera::SetPosition(const XMFLOAT3& v)
+{
+	mPosition = Double3(v.x, v.y, v.z);
+	mViewDirty = true;
+}
+
+void Camera::SetPosition(const Double3& v)
 {
 	mPosition = v;
 	mViewDirty = true;
 }
 
+void Camera::SetCameraRelative(bool relative)
+{
+	mCameraRelative = relative;
+	mViewDirty = true;
+}
+
+bool Camera::IsCameraRelative() const
+{
+	return mCameraRelative;
+}
+
+Double3 Camera::GetRenderOrigin() const
+{
+	return mCameraRelative ? mPosition : Double3();
+}
+
 XMVECTOR Camera::GetRight() const
 {
 	return XMLoadFloat3(&mRight);
@@ -117,8 +145,7 @@ void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 	mNearWindowHeight = 2.0f * mNearZ * tanf(0.5f * mFovY);
 	mFarWindowHeight = 2.0f * mFarZ * tanf(0.5f * mFovY);
 
-	XMMATRIX P = XMMatrixPerspectiveFovLH(mFovY, mAspect, mNearZ, mFarZ);
-	XMStoreFloat4x4(&mProj, P);
+	mMatrices.SetLens(mFovY, mAspect, mNearZ, mFarZ);
 }
 
 void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR up)
@@ -127,7 +154,9 @@ void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR up)
 	XMVECTOR R = XMVector3Normalize(XMVector3Cross(up, L));
 	XMVECTOR U = XMVector3Cross(L, R);
 
-	XMStoreFloat3(&mPosition, pos);
+	XMFLOAT3 position;
+	XMStoreFloat3(&position, pos);
+	mPosition = Double3(position.x, position.y, position.z);
 	XMStoreFloat3(&mLook, L);
 	XMStoreFloat3(&mRight, R);
 	XMStoreFloat3(&mUp, U);
@@ -149,52 +178,78 @@ void Camera::LookAt(const XMFLOAT3& pos, const XMFLOAT3& target, const XMFLOAT3&
 XMMATRIX Camera::GetView() const
 {
 	assert(!mViewDirty);
-	return XMLoadFloat4x4(&mView);
+	XMFLOAT4X4 view = mMatrices.View();
+	return XMLoadFloat4x4(&view);
 }
 
 XMMATRIX Camera::GetProj() const
 {
-	return XMLoadFloat4x4(&mProj);
+	XMFLOAT4X4 proj = mMatrices.Proj();
+	return XMLoadFloat4x4(&proj);
 }
 
 XMFLOAT4X4 Camera::GetView4x4f() const
 {
 	assert(!mViewDirty);
-	return mView;
+	return mMatrices.View();
 }
 
 XMFLOAT4X4 Camera::GetProj4x4f() const
 {
-	return mProj;
+	return mMatrices.Proj();
 }
 
-void Camera::Strafe(float d)
+XMMATRIX Camera::GetViewProj() const
+{
+	assert(!mViewDirty && !mMatrices.IsDirty());
+	XMFLOAT4X4 viewProj = mMatrices.ViewProj();
+	return XMLoadFloat4x4(&viewProj);
+}
+
+XMMATRIX Camera::GetInvView() const
 {
-	XMVECTOR s = XMVectorReplicate(d);
-	XMVECTOR r = XMLoadFloat3(&mRight);
-	XMVECTOR p = XMLoadFloat3(&mPosition);
+	assert(!mViewDirty);
+	XMFLOAT4X4 invView = mMatrices.InvView();
+	return XMLoadFloat4x4(&invView);
+}
+
+XMMATRIX Camera::GetInvProj() const
+{
+	XMFLOAT4X4 invProj = mMatrices.InvProj();
+	return XMLoadFloat4x4(&invProj);
+}
+
+XMMATRIX Camera::GetInvViewProj() const
+{
+	assert(!mViewDirty && !mMatrices.IsDirty());
+	XMFLOAT4X4 invViewProj = mMatrices.InvViewProj();
+	return XMLoadFloat4x4(&invViewProj);
+}
+
+const FrustumPlanes& Camera::GetFrustum() const
+{
+	assert(!mViewDirty && !mMatrices.IsDirty());
+	return mMatrices.Frustum();
+}
 
-	XMStoreFloat3(&mPosition, XMVectorMultiplyAdd(s, r, p));
+void Camera::Strafe(float d)
+{
+	// In double, so small steps still register far from the origin.
+	mPosition += Double3(mRight) * d;
 	mViewDirty = true;
 }
 
 void Camera::Walk(float d)
 {
-	XMVECTOR s = XMVectorReplicate(d);
-	XMVECTOR l = XMLoadFloat3(&mLook);
-	XMVECTOR p = XMLoadFloat3(&mPosition);
-
-	XMStoreFloat3(&mPosition, XMVectorMultiplyAdd(s, l, p));
+	// In double, so small steps still register far from the origin.
+	mPosition += Double3(mLook) * d;
 	mViewDirty = true;
 }
 
 void Camera::Rise(float d)
 {
-	XMVECTOR s = XMVectorReplicate(d);
-	XMVECTOR u = XMLoadFloat3(&mUp);
-	XMVECTOR p = XMLoadFloat3(&mPosition);
-
-	XMStoreFloat3(&mPosition, XMVectorMultiplyAdd(s, u, p));
+	// In double, so small steps still register far from the origin.
+	mPosition += Double3(mUp) * d;
 	mViewDirty = true;
 }
 
@@ -224,42 +279,20 @@ void Camera::UpdateViewMatrix()
 	if (mViewDirty)
 	{
 		XMVECTOR R = XMLoadFloat3(&mRight);
-		XMVECTOR U = XMLoadFloat3(&mUp);
 		XMVECTOR L = XMLoadFloat3(&mLook);
-		XMVECTOR P = XMLoadFloat3(&mPosition);
 
+		// Keep the basis orthonormal so the view stays rigid and its inverse closed-form.
 		L = XMVector3Normalize(L);
-		U = XMVector3Normalize(XMVector3Cross(L, R));
+		XMVECTOR U = XMVector3Normalize(XMVector3Cross(L, R));
 		R = XMVector3Cross(U, L);
 
-		float x = -XMVectorGetX(XMVector3Dot(P, R));
-		float y = -XMVectorGetX(XMVector3Dot(P, U));
-		float z = -XMVectorGetX(XMVector3Dot(P, L));
-
 		XMStoreFloat3(&mRight, R);
 		XMStoreFloat3(&mUp, U);
 		XMStoreFloat3(&mLook, L);
 
-		mView(0, 0) = mRight.x;
-		mView(1, 0) = mRight.y;
-		mView(2, 0) = mRight.z;
-		mView(3, 0) = x;
-
-		mView(0, 1) = mUp.x;
-		mView(1, 1) = mUp.y;
-		mView(2, 1) = mUp.z;
-		mView(3, 1) = y;
-
-		mView(0, 2) = mLook.x;
-		mView(1, 2) = mLook.y;
-		mView(2, 2) = mLook.z;
-		mView(3, 2) = z;
-
-		mView(0, 3) = 0.0f;
-		mView(1, 3) = 0.0f;
-		mView(2, 3) = 0.0f;
-		mView(3, 3) = 1.0f;
-
+		mMatrices.SetView(RelativePosition(mPosition, GetRenderOrigin()), mRight, mUp, mLook);
 		mViewDirty = false;
 	}
+
+	mMatrices.Update();
 }
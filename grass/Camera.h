@@ -1,6 +1,7 @@
 #pragma once
 
 #include "D3DUtil.h"
+#include "CameraMatrices.h"
 
 class Camera
 {
@@ -8,10 +9,20 @@ public:
 	Camera();
 	~Camera();
 
+	// Rounded to float; far from the origin use GetWorldPosition.
 	XMVECTOR GetPosition() const;
 	XMFLOAT3 GetPosition3f() const;
+	const Double3& GetWorldPosition() const;
 	void SetPosition(float x, float y, float z);
 	void SetPosition(const XMFLOAT3& v);
+	void SetPosition(const Double3& v);
+
+	// Camera-relative rendering for large worlds: the view (and so the frustum and every
+	// derived matrix) treats the camera as the origin, and world positions must be given
+	// relative to GetRenderOrigin. Off, the render origin is the world origin.
+	void SetCameraRelative(bool relative);
+	bool IsCameraRelative() const;
+	Double3 GetRenderOrigin() const;
 
 	XMVECTOR GetRight() const;
 	XMFLOAT3 GetRight3f() const;
@@ -42,6 +53,13 @@ public:
 	XMFLOAT4X4 GetView4x4f() const;
 	XMFLOAT4X4 GetProj4x4f() const;
 
+	// Cached by UpdateViewMatrix whenever the view or the lens changed.
+	XMMATRIX GetViewProj() const;
+	XMMATRIX GetInvView() const;
+	XMMATRIX GetInvProj() const;
+	XMMATRIX GetInvViewProj() const;
+	const FrustumPlanes& GetFrustum() const;
+
 	void Strafe(float d);
 	void Walk(float d);
 	void Rise(float d);
@@ -49,10 +67,11 @@ public:
 	void Pitch(float angle);
 	void RotateY(float angle);
 
+	// Rebuilds the view if the camera moved, then whatever derives from a changed view or lens.
 	void UpdateViewMatrix();
 
 private:
-	XMFLOAT3 mPosition = { 0.0f, 0.0f, 0.0f };
+	Double3 mPosition;
 	XMFLOAT3 mRight = { 1.0f, 0.0f, 0.0f };
 	XMFLOAT3 mUp = { 0.0f, 1.0f, 0.0f };
 	XMFLOAT3 mLook = { 0.0f, 0.0f, 1.0f };
@@ -65,7 +84,7 @@ private:
 	float mFarWindowHeight = 0.0f;
 
 	bool mViewDirty = true;
+	bool mCameraRelative = false;
 
-	XMFLOAT4X4 mView = MathHelper::Identity4x4();
-	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
+	CameraMatrices mMatrices;
 };
@@ -0,0 +1,65 @@
+#include "CameraMatrices.h"
+
+void CameraMatrices::SetLens(float fovY, float aspect, float nearZ, float farZ)
+{
+	float yScale = 1.0f / tanf(0.5f * fovY);
+	float xScale = yScale / aspect;
+	float zScale = farZ / (farZ - nearZ);
+	float zOffset = -nearZ * zScale;
+
+	mProj = Float4x4();
+	mProj.m[0][0] = xScale;
+	mProj.m[1][1] = yScale;
+	mProj.m[2][2] = zScale;
+	mProj.m[2][3] = 1.0f;
+	mProj.m[3][2] = zOffset;
+
+	// (x, y, z, w) * Proj = (x xScale, y yScale, z zScale + w zOffset, z), undone row by row.
+	mInvProj = Float4x4();
+	mInvProj.m[0][0] = 1.0f / xScale;
+	mInvProj.m[1][1] = 1.0f / yScale;
+	mInvProj.m[2][3] = 1.0f / zOffset;
+	mInvProj.m[3][2] = 1.0f;
+	mInvProj.m[3][3] = -zScale / zOffset;
+
+	mDirty = true;
+}
+
+void CameraMatrices::SetView(const Float3& position, const Float3& right, const Float3& up, const Float3& look)
+{
+	const Float3 axes[3] = { right, up, look };
+
+	// The view's rotation has the axes as columns; the inverse has them as rows and the
+	// position as translation.
+	mView = Float4x4::Identity();
+	mInvView = Float4x4::Identity();
+	for (int i = 0; i < 3; ++i)
+	{
+		mView.m[0][i] = axes[i].x;
+		mView.m[1][i] = axes[i].y;
+		mView.m[2][i] = axes[i].z;
+		mView.m[3][i] = -Dot(position, axes[i]);
+
+		mInvView.m[i][0] = axes[i].x;
+		mInvView.m[i][1] = axes[i].y;
+		mInvView.m[i][2] = axes[i].z;
+	}
+	mInvView.m[3][0] = position.x;
+	mInvView.m[3][1] = position.y;
+	mInvView.m[3][2] = position.z;
+
+	mDirty = true;
+}
+
+void CameraMatrices::Update()
+{
+	if (!mDirty)
+	{
+		return;
+	}
+
+	mViewProj = Multiply(mView, mProj);
+	mInvViewProj = Multiply(mInvProj, mInvView);
+	mFrustum = FrustumPlanes::FromViewProj(mViewProj);
+	mDirty = false;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "BatchCulling.h"
+#include "SimMath.h"
+
+// A camera's view and projection with everything derived from them cached: their product,
+// the three inverses and the world-space frustum. The view is rigid and the projection a
+// plain perspective, so both inverses are closed-form; nothing here takes a general 4x4
+// inverse. Portable so the headless tools can time it.
+class CameraMatrices
+{
+public:
+	// XMMatrixPerspectiveFovLH, and its inverse.
+	void SetLens(float fovY, float aspect, float nearZ, float farZ);
+	// right, up and look must be orthonormal.
+	void SetView(const Float3& position, const Float3& right, const Float3& up, const Float3& look);
+	// Recomputes ViewProj, InvViewProj and Frustum if SetLens or SetView ran since the last
+	// call; otherwise does nothing.
+	void Update();
+	bool IsDirty() const { return mDirty; }
+
+	const Float4x4& View() const { return mView; }
+	const Float4x4& Proj() const { return mProj; }
+	const Float4x4& ViewProj() const { return mViewProj; }
+	const Float4x4& InvView() const { return mInvView; }
+	const Float4x4& InvProj() const { return mInvProj; }
+	const Float4x4& InvViewProj() const { return mInvViewProj; }
+	const FrustumPlanes& Frustum() const { return mFrustum; }
+
+private:
+	Float4x4 mView = Float4x4::Identity();
+	Float4x4 mProj = Float4x4::Identity();
+	Float4x4 mViewProj = Float4x4::Identity();
+	Float4x4 mInvView = Float4x4::Identity();
+	Float4x4 mInvProj = Float4x4::Identity();
+	Float4x4 mInvViewProj = Float4x4::Identity();
+	FrustumPlanes mFrustum;
+	bool mDirty = true;
+};
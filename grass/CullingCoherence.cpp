@@ -0,0 +1,227 @@
+#include "CullingCoherence.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+void CullingCoherence::Reset(const BoundsSoA& bounds)
+{
+	uint32_t count = bounds.Count();
+
+	Float3 minCorner(FLT_MAX, FLT_MAX, FLT_MAX);
+	Float3 maxCorner(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		minCorner.x = min(minCorner.x, bounds.CenterX()[i]);
+		minCorner.y = min(minCorner.y, bounds.CenterY()[i]);
+		minCorner.z = min(minCorner.z, bounds.CenterZ()[i]);
+		maxCorner.x = max(maxCorner.x, bounds.CenterX()[i]);
+		maxCorner.y = max(maxCorner.y, bounds.CenterY()[i]);
+		maxCorner.z = max(maxCorner.z, bounds.CenterZ()[i]);
+	}
+
+	mOrigin = count > 0 ? (minCorner + maxCorner) * 0.5f : Float3(0.0f, 0.0f, 0.0f);
+	mRadius = 0.0f;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Include(bounds, i);
+	}
+
+	size_t groupCount = ((size_t)count + SimdWidth - 1) / SimdWidth;
+	mExpiry.assign(groupCount * SimdWidth, -1.0f);
+	mVisibleBits.assign(groupCount, 0);
+	mEpoch = mDrift;
+
+	mUseCache = true;
+	mRefreshing = true;
+	mSettledFrames = 0;
+	mProbeInterval = MinProbeInterval;
+	mFrameInstances = 0;
+	mFrameReused = 0;
+}
+
+void CullingCoherence::Include(const BoundsSoA& bounds, uint32_t index)
+{
+	Float3 center(bounds.CenterX()[index], bounds.CenterY()[index], bounds.CenterZ()[index]);
+	Float3 extents(bounds.ExtentX()[index], bounds.ExtentY()[index], bounds.ExtentZ()[index]);
+	mRadius = max(mRadius, Length(center - mOrigin) + Length(extents));
+}
+
+void CullingCoherence::Invalidate(const BoundsSoA& bounds, const uint32_t* indices, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Include(bounds, indices[i]);
+		mExpiry[indices[i]] = -1.0f;
+	}
+}
+
+void CullingCoherence::BeginFrame(const FrustumPlanes& frustum)
+{
+	// A plane's signed distance to a point p is n . (p - O) + (n . O + w). Between frames
+	// that changes by at most |dn| |p - O| + |d(n . O + w)|, and every box point has
+	// |p - O| <= mRadius. The box's nearest and farthest distances move no further.
+	if (mHasLastFrustum)
+	{
+		float movement = 0.0f;
+		for (int p = 0; p < 6; ++p)
+		{
+			const Float4& a = mLastFrustum.Planes[p];
+			const Float4& b = frustum.Planes[p];
+			Float3 dn(b.x - a.x, b.y - a.y, b.z - a.z);
+			float offset = Dot(dn, mOrigin) + (b.w - a.w);
+			movement = max(movement, Length(dn) * mRadius + fabsf(offset));
+		}
+		mDrift += movement;
+	}
+
+	if (mDrift - mEpoch > RebaseDrift)
+	{
+		float shift = (float)(mDrift - mEpoch);
+		for (float& expiry : mExpiry)
+		{
+			expiry -= shift;
+		}
+		mEpoch = mDrift;
+	}
+
+	mLastFrustum = frustum;
+	mHasLastFrustum = true;
+
+	// The drift above keeps adding up while the cache sits unused, so whatever it still
+	// holds when probing stays valid.
+	uint64_t instances = mFrameInstances.exchange(0, memory_order_relaxed);
+	uint64_t reused = mFrameReused.exchange(0, memory_order_relaxed);
+
+	if (!mUseCache)
+	{
+		if (--mFramesToProbe == 0)
+		{
+			mUseCache = true;
+			mRefreshing = true;
+		}
+	}
+	else if (mRefreshing)
+	{
+		mRefreshing = instances == 0;
+	}
+	else if (instances > 0)
+	{
+		if ((double)reused >= MinReuse * instances)
+		{
+			++mSettledFrames;
+		}
+		else
+		{
+			mProbeInterval = mSettledFrames < mProbeInterval ? min(2 * mProbeInterval, MaxProbeInterval) : MinProbeInterval;
+			mSettledFrames = 0;
+			mUseCache = false;
+			mFramesToProbe = mProbeInterval;
+		}
+	}
+}
+
+uint32_t CullingCoherence::Cull(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible, CoherenceStats* stats)
+{
+	const FrustumPlanes& frustum = mLastFrustum;
+
+	CoherenceStats counts;
+	counts.Instances = end - begin;
+
+	if (!mUseCache)
+	{
+		counts.SimdCulled = end - begin;
+		if (stats)
+		{
+			stats->Add(counts);
+		}
+		return BatchCulling::Cull(frustum, bounds, begin, end, visible);
+	}
+
+	assert(begin % SimdWidth == 0 && end <= bounds.Count());
+
+	SimdFloat planeX[6];
+	SimdFloat planeY[6];
+	SimdFloat planeZ[6];
+	SimdFloat planeW[6];
+	SimdFloat absX[6];
+	SimdFloat absY[6];
+	SimdFloat absZ[6];
+
+	for (int p = 0; p < 6; ++p)
+	{
+		const Float4& plane = frustum.Planes[p];
+		planeX[p] = SimdSplat(plane.x);
+		planeY[p] = SimdSplat(plane.y);
+		planeZ[p] = SimdSplat(plane.z);
+		planeW[p] = SimdSplat(plane.w);
+		absX[p] = SimdSplat(fabsf(plane.x));
+		absY[p] = SimdSplat(fabsf(plane.y));
+		absZ[p] = SimdSplat(fabsf(plane.z));
+	}
+
+	SimdFloat zero = SimdZero();
+	SimdFloat slack = SimdSplat(Slack);
+	SimdFloat drift = SimdSplat((float)(mDrift - mEpoch));
+	uint32_t visibleCount = 0;
+
+	for (uint32_t i = begin; i < end; i += SimdWidth)
+	{
+		uint32_t lanes = end - i < (uint32_t)SimdWidth ? end - i : (uint32_t)SimdWidth;
+		uint32_t laneBits = (1u << lanes) - 1;
+		uint8_t& visibleBits = mVisibleBits[i / SimdWidth];
+		SimdFloat expiry = SimdLoad(&mExpiry[i]);
+
+		if ((MaskBits(expiry <= drift) & laneBits) != 0)
+		{
+			SimdFloat cx = SimdLoad(bounds.CenterX() + i);
+			SimdFloat cy = SimdLoad(bounds.CenterY() + i);
+			SimdFloat cz = SimdLoad(bounds.CenterZ() + i);
+			SimdFloat ex = SimdLoad(bounds.ExtentX() + i);
+			SimdFloat ey = SimdLoad(bounds.ExtentY() + i);
+			SimdFloat ez = SimdLoad(bounds.ExtentZ() + i);
+
+			// Farthest signed distance of each box from each plane: negative means outside.
+			// A visible box stays visible while no plane passes it, so its margin is the
+			// smallest of these; a rejected box stays rejected while the plane it lies
+			// furthest behind stays in front of it. Either way the margin is |smallest|.
+			SimdFloat reach = cx * planeX[0] + cy * planeY[0] + cz * planeZ[0] + planeW[0] +
+				(ex * absX[0] + ey * absY[0] + ez * absZ[0]);
+			SimdMask outside = reach < zero;
+			SimdFloat nearest = reach;
+
+			for (int p = 1; p < 6; ++p)
+			{
+				reach = cx * planeX[p] + cy * planeY[p] + cz * planeZ[p] + planeW[p] + (ex * absX[p] + ey * absY[p] + ez * absZ[p]);
+				outside = outside | (reach < zero);
+				nearest = Min(nearest, reach);
+			}
+
+			SimdStore(&mExpiry[i], drift + Max(Abs(nearest) - slack, zero));
+			visibleBits = (uint8_t)(~(uint32_t)MaskBits(outside) & laneBits);
+			counts.PlaneTests += 6 * lanes;
+		}
+		else
+		{
+			counts.Reused += lanes;
+		}
+
+		// Branch-free compaction, as in BatchCulling::Cull.
+		uint32_t inside = visibleBits;
+		for (uint32_t k = 0; k < (uint32_t)SimdWidth; ++k)
+		{
+			visible[visibleCount] = i + k;
+			visibleCount += (inside >> k) & 1;
+		}
+	}
+
+	mFrameInstances.fetch_add(counts.Instances, memory_order_relaxed);
+	mFrameReused.fetch_add(counts.Reused, memory_order_relaxed);
+
+	if (stats)
+	{
+		stats->Add(counts);
+	}
+
+	return visibleCount;
+}
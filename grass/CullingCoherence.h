@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "BatchCulling.h"
+
+using namespace std;
+
+struct CoherenceStats
+{
+	uint64_t Instances = 0;
+	// Box against plane tests actually run.
+	uint64_t PlaneTests = 0;
+	// Instances whose last result was reused without any test.
+	uint64_t Reused = 0;
+	// Instances culled by the plain SIMD pass because too little was being reused.
+	uint64_t SimdCulled = 0;
+
+	void Add(const CoherenceStats& other)
+	{
+		Instances += other.Instances;
+		PlaneTests += other.PlaneTests;
+		Reused += other.Reused;
+		SimdCulled += other.SimdCulled;
+	}
+};
+
+// Frame-to-frame memory of culling results. For every instance it keeps a margin: how far
+// the frustum planes can move before the last result could change. BeginFrame bounds how
+// far any plane moved against any box since the previous frame; groups of SimdWidth
+// instances whose margins have not been used up yet keep their results with no test at
+// all, the others are tested against all six planes at once as in BatchCulling::Cull.
+//
+// The bound is exact for translation but grows with the distance from the boxes' centre
+// for rotation, so a turning camera retests most groups, a little slower than
+// BatchCulling::Cull would. Once a frame reuses less than MinReuse of its results the
+// following frames are culled by BatchCulling::Cull instead. After a while two frames go
+// through the cache again (the first to refresh it) to see whether the camera has
+// settled. The wait doubles, from MinProbeInterval up to MaxProbeInterval frames, each
+// time the cache stops paying off sooner than the last wait was long.
+class CullingCoherence
+{
+public:
+	static constexpr double MinReuse = 0.6;
+	static const uint32_t MinProbeInterval = 8;
+	static const uint32_t MaxProbeInterval = 128;
+
+	CullingCoherence() = default;
+	CullingCoherence(const CullingCoherence& rhs) = delete;
+	CullingCoherence& operator=(const CullingCoherence& rhs) = delete;
+
+	// Forgets every result; the next frame tests everything.
+	void Reset(const BoundsSoA& bounds);
+	// Forgets the results of instances whose boxes changed; bounds holds the new boxes.
+	void Invalidate(const BoundsSoA& bounds, const uint32_t* indices, uint32_t count);
+
+	// Sets the frustum the following Cull calls test against.
+	void BeginFrame(const FrustumPlanes& frustum);
+
+	// Same results as BatchCulling::Cull over [begin, end), with the same requirements on
+	// begin and visible. Ranges culled in the same frame must not overlap; they can run on
+	// different threads.
+	uint32_t Cull(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible, CoherenceStats* stats = nullptr);
+
+private:
+	// Margins are shortened by this much (metres) to cover rounding in the tests and in the
+	// float expiries.
+	static constexpr float Slack = 1e-3f;
+	// Expiries are kept relative to mEpoch as floats and rebased once the drift since it
+	// passes this, which keeps their rounding well inside Slack.
+	static constexpr double RebaseDrift = 256.0;
+
+	void Include(const BoundsSoA& bounds, uint32_t index);
+
+	// Everything Reset saw lies within mRadius of mOrigin.
+	Float3 mOrigin;
+	float mRadius = 0.0f;
+
+	// This frame's frustum once BeginFrame ran.
+	FrustumPlanes mLastFrustum;
+	bool mHasLastFrustum = false;
+	// Total plane movement so far; an instance's result holds while this stays below its
+	// expiry plus mEpoch.
+	double mDrift = 0.0;
+	double mEpoch = 0.0;
+
+	// Whether this frame goes through the cache, and whether it only refreshes it (right
+	// after a reset or when probing) so its reuse says nothing about the camera.
+	bool mUseCache = true;
+	bool mRefreshing = true;
+	uint32_t mFramesToProbe = 0;
+	uint32_t mProbeInterval = MinProbeInterval;
+	// Frames in a row that reused at least MinReuse.
+	uint32_t mSettledFrames = 0;
+	// This frame's counts over every range culled through the cache.
+	atomic<uint64_t> mFrameInstances{ 0 };
+	atomic<uint64_t> mFrameReused{ 0 };
+
+	// Padded to whole groups; a group's visible lanes as MaskBits would give them.
+	AlignedVector<float> mExpiry;
+	vector<uint8_t> mVisibleBits;
+};
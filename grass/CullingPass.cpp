@@ -0,0 +1,167 @@
+#include "CullingPass.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cstring>
+
+void CullingPass::Dispatch(ThreadPool* pool, uint32_t count, const function<void(uint32_t)>& body)
+{
+	if (pool == nullptr || pool->ThreadCount() == 1 || count <= 1)
+	{
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			body(i);
+		}
+		return;
+	}
+
+	pool->ParallelFor(count, body);
+}
+
+void CullingPass::Run(const FrustumPlanes& frustum, const vector<CullingSource>& sources, ThreadPool* pool,
+	const OcclusionBuffer* occlusion)
+{
+	uint32_t sourceCount = (uint32_t)sources.size();
+
+	// Cut every source into jobs; each source gets scratch for all of its instances, padded
+	// for the SIMD path's whole-group stores.
+	mJobs.clear();
+	mScratchOffsets.resize(sourceCount + 1);
+	uint32_t scratchSize = 0;
+
+	for (uint32_t s = 0; s < sourceCount; ++s)
+	{
+		const CullingSource& source = sources[s];
+		uint32_t instanceCount = source.Bounds->Count();
+
+		mScratchOffsets[s] = scratchSize;
+		scratchSize += (instanceCount + SimdWidth - 1) / SimdWidth * SimdWidth;
+
+		if (source.Bvh)
+		{
+			mSubtrees.clear();
+			source.Bvh->CollectSubtrees(GrainSize, mSubtrees);
+			for (uint32_t root : mSubtrees)
+			{
+				const BvhNode& node = source.Bvh->Nodes()[root];
+				mJobs.push_back({ s, node.First, node.First + node.Count, root });
+			}
+		}
+		else
+		{
+			for (uint32_t begin = 0; begin < instanceCount; begin += GrainSize)
+			{
+				mJobs.push_back({ s, begin, min(begin + GrainSize, instanceCount), UINT32_MAX });
+			}
+		}
+	}
+	mScratchOffsets[sourceCount] = scratchSize;
+
+	uint32_t jobCount = (uint32_t)mJobs.size();
+	mScratch.resize(scratchSize);
+	mJobCounts.resize(jobCount);
+	mJobStats.assign(jobCount, BvhCullStats());
+	mJobCoherenceStats.assign(jobCount, CoherenceStats());
+	mJobOcclusionStats.assign(jobCount, OcclusionStats());
+
+	Dispatch(pool, jobCount, [&](uint32_t j)
+	{
+		const Job& job = mJobs[j];
+		const CullingSource& source = sources[job.Source];
+		uint32_t* out = mScratch.data() + mScratchOffsets[job.Source] + job.Begin;
+		bool offset = source.Offset.x != 0.0f || source.Offset.y != 0.0f || source.Offset.z != 0.0f;
+		FrustumPlanes sourceFrustum = offset ? frustum.Translated(source.Offset) : frustum;
+
+		if (source.Bvh && occlusion)
+		{
+			// The tree tests the occlusion buffer against its clusters before their instances.
+			mJobCounts[j] = source.Bvh->CullSubtreeOccluded(sourceFrustum, *occlusion, job.Node, out, &mJobStats[j],
+				&mJobOcclusionStats[j], source.Offset);
+			return;
+		}
+
+		if (source.Bvh)
+		{
+			mJobCounts[j] = source.Bvh->CullSubtree(sourceFrustum, job.Node, out, &mJobStats[j]);
+		}
+		else if (source.Coherence)
+		{
+			mJobCounts[j] = source.Coherence->Cull(*source.Bounds, job.Begin, job.End, out, &mJobCoherenceStats[j]);
+		}
+		else
+		{
+			mJobCounts[j] = BatchCulling::Cull(sourceFrustum, *source.Bounds, job.Begin, job.End, out);
+		}
+
+		if (occlusion)
+		{
+			mJobCounts[j] = occlusion->FilterVisible(*source.Bounds, out, mJobCounts[j], &mJobOcclusionStats[j], source.Offset);
+		}
+	});
+
+	// Exclusive prefix sum: jobs are in source order, so a source's first job also gives
+	// where the source starts.
+	mJobOffsets.resize(jobCount);
+	mSourceOffsets.assign(sourceCount + 1, 0);
+	mStats = BvhCullStats();
+	mCoherenceStats = CoherenceStats();
+	mOcclusionStats = OcclusionStats();
+
+	uint32_t total = 0;
+	uint32_t nextSource = 0;
+	for (uint32_t j = 0; j < jobCount; ++j)
+	{
+		while (nextSource <= mJobs[j].Source)
+		{
+			mSourceOffsets[nextSource++] = total;
+		}
+
+		mJobOffsets[j] = total;
+		total += mJobCounts[j];
+		mStats.Add(mJobStats[j]);
+		mCoherenceStats.Add(mJobCoherenceStats[j]);
+		mOcclusionStats.Add(mJobOcclusionStats[j]);
+	}
+	while (nextSource <= sourceCount)
+	{
+		mSourceOffsets[nextSource++] = total;
+	}
+
+	mVisible.resize(total);
+
+	Dispatch(pool, jobCount, [&](uint32_t j)
+	{
+		const Job& job = mJobs[j];
+		const uint32_t* in = mScratch.data() + mScratchOffsets[job.Source] + job.Begin;
+		memcpy(mVisible.data() + mJobOffsets[j], in, mJobCounts[j] * sizeof(uint32_t));
+	});
+}
+
+void CullingPass::ForEachVisible(ThreadPool* pool, const function<void(uint32_t, uint32_t, uint32_t)>& body) const
+{
+	struct Piece
+	{
+		uint32_t Source;
+		uint32_t First;
+		uint32_t Count;
+	};
+
+	if (mSourceOffsets.empty())
+	{
+		return;
+	}
+
+	vector<Piece> pieces;
+	uint32_t sourceCount = (uint32_t)mSourceOffsets.size() - 1;
+	for (uint32_t s = 0; s < sourceCount; ++s)
+	{
+		for (uint32_t first = 0; first < VisibleCount(s); first += GrainSize)
+		{
+			pieces.push_back({ s, first, min(GrainSize, VisibleCount(s) - first) });
+		}
+	}
+
+	Dispatch(pool, (uint32_t)pieces.size(), [&](uint32_t p)
+	{
+		body(pieces[p].Source, pieces[p].First, pieces[p].Count);
+	});
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "BatchCulling.h"
+#include "CullingCoherence.h"
+#include "InstanceBvh.h"
+#include "OcclusionBuffer.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// One set of instance boxes to cull, e.g. the instances of one render item. With a Bvh
+// (built over Bounds) the set is culled through the tree; otherwise with Coherence (over
+// Bounds, BeginFrame already called with the source's frustum) last frame's results are
+// reused. Bounds are relative to Offset in the frustum's coordinates, see
+// FrustumPlanes::Translated.
+struct CullingSource
+{
+	const BoundsSoA* Bounds = nullptr;
+	const InstanceBvh* Bvh = nullptr;
+	CullingCoherence* Coherence = nullptr;
+	Float3 Offset;
+};
+
+// Culls many sources at once on a thread pool. Every source is cut into jobs of about
+// GrainSize instances (SIMD ranges, or BVH subtrees). A job writes its survivors into its
+// own span of a scratch buffer sized like its input, so jobs never share output; an
+// exclusive prefix sum over the job counts then places each job in the compact result.
+class CullingPass
+{
+public:
+	static const uint32_t GrainSize = 16384;
+
+	// With pool null everything runs on the calling thread. With occlusion (already rendered
+	// for the same view) each job also drops the survivors it hides, before the prefix sum;
+	// BVH jobs test it against clusters of the tree before any instance box in them.
+	void Run(const FrustumPlanes& frustum, const vector<CullingSource>& sources, ThreadPool* pool,
+		const OcclusionBuffer* occlusion = nullptr);
+
+	// Visible instance indices of source s, in the order Cull (or InstanceBvh::Cull) gives.
+	const uint32_t* Visible(uint32_t source) const { return mVisible.data() + mSourceOffsets[source]; }
+	uint32_t VisibleCount(uint32_t source) const { return mSourceOffsets[source + 1] - mSourceOffsets[source]; }
+	// Where source s starts in the concatenated result of all sources.
+	uint32_t VisibleOffset(uint32_t source) const { return mSourceOffsets[source]; }
+	uint32_t TotalVisible() const { return mSourceOffsets.empty() ? 0 : mSourceOffsets.back(); }
+
+	// Runs body(source, first, count) over GrainSize pieces of every source's visible list,
+	// for filling per-instance output in parallel once Run has sized it.
+	void ForEachVisible(ThreadPool* pool, const function<void(uint32_t, uint32_t, uint32_t)>& body) const;
+
+	uint32_t JobCount() const { return (uint32_t)mJobs.size(); }
+	// Tree work summed over every BVH job, and plane tests over every coherent one.
+	const BvhCullStats& Stats() const { return mStats; }
+	const CoherenceStats& CoherentStats() const { return mCoherenceStats; }
+	const OcclusionStats& OccludedStats() const { return mOcclusionStats; }
+
+private:
+	struct Job
+	{
+		uint32_t Source;
+		// Instance range for SIMD jobs, or the subtree's index range for BVH jobs; the
+		// job's scratch span is the same range of its source's scratch.
+		uint32_t Begin;
+		uint32_t End;
+		uint32_t Node;
+	};
+
+	static void Dispatch(ThreadPool* pool, uint32_t count, const function<void(uint32_t)>& body);
+
+	vector<Job> mJobs;
+	vector<uint32_t> mJobCounts;
+	vector<uint32_t> mJobOffsets;
+	vector<BvhCullStats> mJobStats;
+	vector<CoherenceStats> mJobCoherenceStats;
+	vector<OcclusionStats> mJobOcclusionStats;
+	vector<uint32_t> mSubtrees;
+
+	vector<uint32_t> mScratch;
+	vector<uint32_t> mScratchOffsets;
+
+	vector<uint32_t> mVisible;
+	vector<uint32_t> mSourceOffsets;
+	BvhCullStats mStats;
+	CoherenceStats mCoherenceStats;
+	OcclusionStats mOcclusionStats;
+};
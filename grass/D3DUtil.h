@@ -21,6 +21,7 @@
 #include <cassert>
 #include "D3DX12.h"
 #include "MathHelper.h"
+#include "MeshIndexUtil.h"
 
 extern const int gNumFrameResources;
 
@@ -107,6 +108,10 @@ struct SubmeshGeometry
 	UINT StartIndexLocation = 0;
 	INT BaseVertexLocation = 0;
 
+	// Set when 16-bit indices had to be cut into several draws; the fields above then
+	// describe the first of them and IndexCount the total.
+	std::vector<MeshIndexRange> Ranges;
+
 	DirectX::BoundingBox Bounds;
 };
 
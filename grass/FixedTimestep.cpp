@@ -0,0 +1,35 @@
+#include "FixedTimestep.h"
+
+FixedTimestep::FixedTimestep(float stepDeltaTime, uint32_t maxStepsPerFrame)
+	: mStepDeltaTime(stepDeltaTime), mMaxStepsPerFrame(maxStepsPerFrame)
+{
+}
+
+uint32_t FixedTimestep::Advance(float frameDeltaTime)
+{
+	if (frameDeltaTime > 0.0f)
+	{
+		mAccumulator += frameDeltaTime;
+	}
+
+	uint32_t steps = 0;
+	while (mAccumulator >= mStepDeltaTime && steps < mMaxStepsPerFrame)
+	{
+		mAccumulator -= mStepDeltaTime;
+		++steps;
+	}
+
+	if (mAccumulator >= mStepDeltaTime)
+	{
+		mAccumulator = 0.0;
+	}
+
+	mTotalSteps += steps;
+	return steps;
+}
+
+void FixedTimestep::Reset()
+{
+	mAccumulator = 0.0;
+	mTotalSteps = 0;
+}
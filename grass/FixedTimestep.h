@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+// Accumulator that turns variable frame times into a whole number of fixed steps. The
+// simulation always integrates StepDeltaTime, so results don't depend on the frame rate
+// and a long frame can't feed the stiff restore torque a huge dt. What's left over in the
+// accumulator becomes Alpha(), the blend between the last two simulated states.
+class FixedTimestep
+{
+public:
+	explicit FixedTimestep(float stepDeltaTime = 1.0f / 60.0f, uint32_t maxStepsPerFrame = 4);
+
+	// Adds a frame's worth of time and returns how many steps to run for it. Time beyond
+	// maxStepsPerFrame steps is dropped so a stall can't snowball into ever longer frames.
+	uint32_t Advance(float frameDeltaTime);
+
+	void Reset();
+
+	float StepDeltaTime() const { return mStepDeltaTime; }
+	uint32_t MaxStepsPerFrame() const { return mMaxStepsPerFrame; }
+	void SetMaxStepsPerFrame(uint32_t steps) { mMaxStepsPerFrame = steps; }
+
+	// 0 renders the state before the last step, 1 the state after it.
+	float Alpha() const { return (float)(mAccumulator / mStepDeltaTime); }
+
+	uint64_t TotalSteps() const { return mTotalSteps; }
+
+private:
+	float mStepDeltaTime = 0.0f;
+	uint32_t mMaxStepsPerFrame = 0;
+
+	// Accumulated in double so thousands of frames don't drift.
+	double mAccumulator = 0.0;
+	uint64_t mTotalSteps = 0;
+};
@@ -1,6 +1,7 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount,
+    UINT grassBoneCount, UINT grassChunkCount, UINT grassSwayBoneCount, UINT windNodeCount, UINT terrainPatchCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -9,6 +10,32 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectData>>(device, objectCount, true);
     WindCB = std::make_unique<UploadBuffer<WindConstants>>(device, 1, true);
+    GrassBones = std::make_unique<UploadBuffer<Bone>>(device, grassBoneCount, false);
+    GrassChunkTable = std::make_unique<UploadBuffer<GrassChunkDispatch>>(device, grassChunkCount, false);
+    GrassSwayBones = std::make_unique<UploadBuffer<Bone>>(device, grassSwayBoneCount, false);
+
+    auto readbackHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+    auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)grassSwayBoneCount * sizeof(Bone));
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &readbackDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(GrassSeedReadback.GetAddressOf())));
+
+    auto settledDesc = CD3DX12_RESOURCE_DESC::Buffer((UINT64)grassChunkCount * sizeof(uint32_t));
+    ThrowIfFailed(device->CreateCommittedResource(
+        &readbackHeap,
+        D3D12_HEAP_FLAG_NONE,
+        &settledDesc,
+        D3D12_RESOURCE_STATE_COPY_DEST,
+        nullptr,
+        IID_PPV_ARGS(GrassSettledReadback.GetAddressOf())));
+
+    WindGrid = std::make_unique<UploadBuffer<float>>(device, 2 * windNodeCount, false);
+    GrassColliders = std::make_unique<UploadBuffer<GrassCollider>>(device, GrassMaxColliderRefs, false);
+    TerrainPatches = std::make_unique<UploadBuffer<TerrainPatch>>(device, terrainPatchCount, false);
 }
 
 FrameResource::~FrameResource()
@@ -3,6 +3,8 @@
 #include "D3DUtil.h"
 #include "MathHelper.h"
 #include "UploadBuffer.h"
+#include "GrassChunks.h"
+#include "TerrainQuadtree.h"
 
 struct ObjectData
 {
@@ -39,7 +41,14 @@ struct PassConstants
 struct WindConstants
 {
 	XMFLOAT3 Velocity;
-	float Pad = 0.0f;
+	float StepDeltaTime = 0.0f;
+	float InterpolationAlpha = 1.0f;
+	// Wind grid (WindField) placement; see SampleWind in Grass.hlsl.
+	XMFLOAT2 GridOrigin = { 0.0f, 0.0f };
+	float GridInvCellSize = 0.0f;
+	UINT GridWidth = 0;
+	UINT GridHeight = 0;
+	XMFLOAT2 Pad = { 0.0f, 0.0f };
 };
 
 struct MaterialData
@@ -83,7 +92,8 @@ struct PointVertex
 
 struct FrameResource
 {
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount,
+		UINT grassBoneCount, UINT grassChunkCount, UINT grassSwayBoneCount, UINT windNodeCount, UINT terrainPatchCount);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
@@ -95,5 +105,26 @@ struct FrameResource
 	// unique_ptr<UploadBuffer<MaterialData>> MaterialBuffer = nullptr;
 	unique_ptr<UploadBuffer<WindConstants>> WindCB = nullptr;
 
+	// Staging for bones simulated on the CPU, copied into the grass UAV buffer each frame.
+	unique_ptr<UploadBuffer<Bone>> GrassBones = nullptr;
+
+	// Per-chunk LOD dispatch table and the sway chains of far chunks.
+	unique_ptr<UploadBuffer<GrassChunkDispatch>> GrassChunkTable = nullptr;
+	unique_ptr<UploadBuffer<Bone>> GrassSwayBones = nullptr;
+	// What the grass CS reports back at the end of the frame: a seed blade per chunk (laid
+	// out like GrassSwayBones) and a settled flag per chunk. Valid once GrassReadbackWritten.
+	ComPtr<ID3D12Resource> GrassSeedReadback = nullptr;
+	ComPtr<ID3D12Resource> GrassSettledReadback = nullptr;
+	bool GrassReadbackWritten = false;
+
+	// Wind grid velocities, the x plane followed by the z plane.
+	unique_ptr<UploadBuffer<float>> WindGrid = nullptr;
+
+	// Colliders referenced by the chunk dispatch table (GrassChunkSimulation::ColliderRefs).
+	unique_ptr<UploadBuffer<GrassCollider>> GrassColliders = nullptr;
+
+	// Terrain patches selected this frame, one instance each.
+	unique_ptr<UploadBuffer<TerrainPatch>> TerrainPatches = nullptr;
+
 	UINT64 Fence = 0;
 };
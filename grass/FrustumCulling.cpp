@@ -1,37 +1,249 @@
 #include "FrustumCulling.h"
+#include "SimdMath.h"
 
 void FrustumCulling::UpdateCameraFrustum(const Camera& camera)
 {
-	BoundingFrustum::CreateFromMatrix(mCameraFrustum, camera.GetProj());
+	mCameraFrustum = camera.GetFrustum();
+	mRenderOrigin = camera.GetRenderOrigin();
+
+	mFrameStats = BvhCullStats();
+	mFrameCoherenceStats = CoherenceStats();
+	mFrameOcclusionStats = OcclusionStats();
+	++mCameraFrame;
 }
 
-void FrustumCulling::CullRenderItems(const Camera& camera, const RenderItem* ritem, vector<ObjectData>& visibleRitems)
+Float3 FrustumCulling::ItemOffset(const RenderItem* ritem) const
+{
+	return RelativePosition(ritem->Origin, mRenderOrigin);
+}
+
+bool FrustumCulling::BeginCoherentFrame(InstanceCullState& state, const FrustumPlanes& frustum)
 {
-	XMMATRIX view = camera.GetView();
-	auto detView = XMMatrixDeterminant(view);
-	XMMATRIX invView = XMMatrixInverse(&detView, view);
+	if (!mFrustumCullingEnabled || !mTemporalCoherenceEnabled || state.Bvh.InstanceCount() > 0)
+	{
+		return false;
+	}
+
+	if (state.CoherenceFrame != mCameraFrame)
+	{
+		state.CoherenceFrame = mCameraFrame;
+		state.Coherence.BeginFrame(frustum);
+	}
+
+	return true;
+}
 
+void FrustumCulling::UpdateInstanceBounds(const RenderItem* ritem, InstanceCullState& state)
+{
 	const auto& instanceData = ritem->Instances;
+	UINT instanceCount = (UINT)instanceData.size();
+	bool useBvh = instanceCount >= BvhMinInstances;
+
+	// World-space AABBs of every instance. The world AABB encloses the rotated local box, so
+	// this is conservative, never stricter, than testing the local box in local space.
+	if (state.Bounds.Count() != instanceCount || state.Bvh.InstanceCount() != (useBvh ? instanceCount : 0))
+	{
+		state.Bounds.Resize(instanceCount);
+		for (UINT i = 0; i < instanceCount; ++i)
+		{
+			state.Bounds.SetTransformed(i, ritem->Bounds.Center, ritem->Bounds.Extents, instanceData[i].World);
+		}
+
+		state.Bvh = InstanceBvh();
+		if (useBvh)
+		{
+			state.Bvh.Build(state.Bounds);
+		}
+		state.Coherence.Reset(state.Bounds);
+		state.Version = ritem->InstancesVersion;
+		return;
+	}
+
+	if (state.Version == ritem->InstancesVersion)
+	{
+		return;
+	}
+	state.Version = ritem->InstancesVersion;
+
+	BoundsSoA& bounds = state.Bounds;
+	state.Moved.clear();
+	for (UINT i = 0; i < instanceCount; ++i)
+	{
+		Float3 center(bounds.CenterX()[i], bounds.CenterY()[i], bounds.CenterZ()[i]);
+		Float3 extents(bounds.ExtentX()[i], bounds.ExtentY()[i], bounds.ExtentZ()[i]);
+
+		bounds.SetTransformed(i, ritem->Bounds.Center, ritem->Bounds.Extents, instanceData[i].World);
+
+		if (center.x != bounds.CenterX()[i] || center.y != bounds.CenterY()[i] || center.z != bounds.CenterZ()[i] ||
+			extents.x != bounds.ExtentX()[i] || extents.y != bounds.ExtentY()[i] || extents.z != bounds.ExtentZ()[i])
+		{
+			state.Moved.push_back(i);
+		}
+	}
+
+	state.Coherence.Invalidate(bounds, state.Moved.data(), (uint32_t)state.Moved.size());
+
+	if (useBvh && !state.Moved.empty())
+	{
+		state.Bvh.Refit(bounds, state.Moved.data(), (uint32_t)state.Moved.size());
+		if (state.Bvh.NeedsRebuild())
+		{
+			state.Bvh.Build(bounds);
+		}
+	}
+}
+
+void FrustumCulling::CullRenderItems(const Camera& camera, const RenderItem* ritem, vector<ObjectData>& visibleRitems)
+{
+	const auto& instanceData = ritem->Instances;
+	UINT instanceCount = (UINT)instanceData.size();
+
+	InstanceCullState& state = mInstanceStates[ritem];
+	UpdateInstanceBounds(ritem, state);
+
+	state.Visible.resize(instanceCount + SimdWidth);
+	UINT visibleCount = instanceCount;
+
+	// The bounds are in the item's frame, so the frustum moves there instead.
+	Float3 offset = ItemOffset(ritem);
+	FrustumPlanes frustum = mCameraFrustum.Translated(offset);
+
+	if (!mFrustumCullingEnabled)
+	{
+		for (UINT i = 0; i < instanceCount; ++i)
+		{
+			state.Visible[i] = i;
+		}
+	}
+	else if (state.Bvh.InstanceCount() > 0)
+	{
+		visibleCount = state.Bvh.Cull(frustum, state.Visible.data(), &mFrameStats);
+	}
+	else if (BeginCoherentFrame(state, frustum))
+	{
+		visibleCount = state.Coherence.Cull(state.Bounds, 0, instanceCount, state.Visible.data(), &mFrameCoherenceStats);
+	}
+	else
+	{
+		visibleCount = BatchCulling::Cull(frustum, state.Bounds, state.Visible.data());
+	}
+
+	if (mFrustumCullingEnabled && mOcclusion)
+	{
+		visibleCount = mOcclusion->FilterVisible(state.Bounds, state.Visible.data(), visibleCount, &mFrameOcclusionStats,
+			offset);
+	}
 
-	for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+	XMMATRIX rebase = XMMatrixTranslation(offset.x, offset.y, offset.z);
+	for (UINT i = 0; i < visibleCount; ++i)
 	{
-		XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-		XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+		XMMATRIX world = XMLoadFloat4x4(&instanceData[state.Visible[i]].World) * rebase;
 
-		auto detWorld = XMMatrixDeterminant(world);
-		XMMATRIX invWorld = XMMatrixInverse(&detWorld, world);
+		ObjectData data;
+		XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+		visibleRitems.push_back(data);
+	}
+}
+
+void FrustumCulling::CullRenderLayers(const vector<RenderItem*>* layers, int layerCount, ThreadPool* pool)
+{
+	++mLayerPassIndex;
 
-		XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+	// Gather each render item once, even if it sits in several layers.
+	mLayerItems.clear();
+	mLayerStates.clear();
+	for (int layer = 0; layer < layerCount; ++layer)
+	{
+		for (const RenderItem* ritem : layers[layer])
+		{
+			InstanceCullState& state = mInstanceStates[ritem];
+			if (state.LayerPass != mLayerPassIndex)
+			{
+				state.LayerPass = mLayerPassIndex;
+				state.VisibleCount = 0;
+				mLayerItems.push_back(ritem);
+				mLayerStates.push_back(&state);
+			}
+		}
+	}
 
-		BoundingFrustum localSpaceFrustum;
-		mCameraFrustum.Transform(localSpaceFrustum, viewToLocal);
+	UINT itemCount = (UINT)mLayerItems.size();
 
-		if ((localSpaceFrustum.Contains(ritem->Bounds) != DISJOINT) || !mFrustumCullingEnabled)
+	// Items are independent, so their bounds (and refits) update in parallel too.
+	if (pool)
+	{
+		pool->ParallelFor(itemCount, [this](uint32_t i) { UpdateInstanceBounds(mLayerItems[i], *mLayerStates[i]); });
+	}
+	else
+	{
+		for (UINT i = 0; i < itemCount; ++i)
 		{
-			ObjectData data;
-			XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
-			// XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
-			visibleRitems.push_back(data);
+			UpdateInstanceBounds(mLayerItems[i], *mLayerStates[i]);
 		}
 	}
+
+	mLayerSources.resize(itemCount);
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		Float3 offset = ItemOffset(mLayerItems[i]);
+		mLayerSources[i].Bounds = &mLayerStates[i]->Bounds;
+		mLayerSources[i].Bvh = mLayerStates[i]->Bvh.InstanceCount() > 0 ? &mLayerStates[i]->Bvh : nullptr;
+		mLayerSources[i].Coherence = BeginCoherentFrame(*mLayerStates[i], mCameraFrustum.Translated(offset)) ?
+			&mLayerStates[i]->Coherence : nullptr;
+		mLayerSources[i].Offset = offset;
+	}
+
+	if (mFrustumCullingEnabled)
+	{
+		mLayerPass.Run(mCameraFrustum, mLayerSources, pool, mOcclusion);
+		mFrameStats.Add(mLayerPass.Stats());
+		mFrameCoherenceStats.Add(mLayerPass.CoherentStats());
+		mFrameOcclusionStats.Add(mLayerPass.OccludedStats());
+	}
+	else
+	{
+		// An empty frustum test: every plane passes every box.
+		FrustumPlanes everything;
+		for (auto& plane : everything.Planes)
+		{
+			plane = Float4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		mLayerPass.Run(everything, mLayerSources, pool);
+	}
+
+	// The output is sized once and filled in place: no push_back, no reallocation.
+	mVisibleObjects.resize(mLayerPass.TotalVisible());
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		mLayerStates[i]->VisibleOffset = mLayerPass.VisibleOffset(i);
+		mLayerStates[i]->VisibleCount = mLayerPass.VisibleCount(i);
+	}
+
+	mLayerPass.ForEachVisible(pool, [this](uint32_t item, uint32_t first, uint32_t count)
+	{
+		const auto& instanceData = mLayerItems[item]->Instances;
+		const uint32_t* visible = mLayerPass.Visible(item);
+		ObjectData* out = mVisibleObjects.data() + mLayerPass.VisibleOffset(item);
+		const Float3& offset = mLayerSources[item].Offset;
+		XMMATRIX rebase = XMMatrixTranslation(offset.x, offset.y, offset.z);
+
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&instanceData[visible[i]].World) * rebase;
+			XMStoreFloat4x4(&out[i].World, XMMatrixTranspose(world));
+		}
+	});
+}
+
+const ObjectData* FrustumCulling::VisibleInstances(const RenderItem* ritem, UINT& count) const
+{
+	auto it = mInstanceStates.find(ritem);
+	if (it == mInstanceStates.end() || it->second.LayerPass != mLayerPassIndex)
+	{
+		count = 0;
+		return nullptr;
+	}
+
+	count = it->second.VisibleCount;
+	return mVisibleObjects.data() + it->second.VisibleOffset;
 }
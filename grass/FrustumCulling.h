@@ -1,17 +1,88 @@
 #pragma once
 
+#include <unordered_map>
 #include "Camera.h"
 #include "RenderItem.h"
 #include "FrameResource.h"
+#include "BatchCulling.h"
+#include "InstanceBvh.h"
+#include "CullingPass.h"
+#include "ThreadPool.h"
 
 class FrustumCulling
 {
 public:
+	// Below this many instances one SIMD pass over every box beats walking a tree.
+	static const UINT BvhMinInstances = 65536;
+
+	// The planes are relative to the camera's render origin, so this has to run whenever
+	// the camera moves. Also starts a new frame of FrameStats. Each item is culled in its
+	// own frame (RenderItem::Origin) and its visible Worlds come out rebased onto the
+	// render origin.
 	void UpdateCameraFrustum(const Camera& camera);
 	void CullRenderItems(const Camera& camera, const RenderItem* ritem, vector<ObjectData>& visibleRitems);
+	// Culls the instances of every render item in the layers in one pass split across the
+	// pool; VisibleInstances then returns each item's share of the result.
+	void CullRenderLayers(const vector<RenderItem*>* layers, int layerCount, ThreadPool* pool);
+	const ObjectData* VisibleInstances(const RenderItem* ritem, UINT& count) const;
 	void SetFrustumCullingEnabled(bool enabled) { mFrustumCullingEnabled = enabled; }
+	// Items culled without a tree reuse last frame's results where the camera moved too
+	// little to change them (see CullingCoherence).
+	void SetTemporalCoherenceEnabled(bool enabled) { mTemporalCoherenceEnabled = enabled; }
+	// Instances that survive the frustum are also tested against this buffer, which must
+	// have been rendered for the current camera. Null turns occlusion culling off.
+	void SetOcclusionBuffer(const OcclusionBuffer* occlusion) { mOcclusion = occlusion; }
+
+	// Tree nodes visited and instances tested since the last UpdateCameraFrustum.
+	const BvhCullStats& FrameStats() const { return mFrameStats; }
+	// Plane tests run and results reused since the last UpdateCameraFrustum.
+	const CoherenceStats& FrameCoherenceStats() const { return mFrameCoherenceStats; }
+	// Instances tested against the occlusion buffer and hidden by it.
+	const OcclusionStats& FrameOcclusionStats() const { return mFrameOcclusionStats; }
 
 private:
-	BoundingFrustum mCameraFrustum;
+	// Instance bounds are kept between frames and only recomputed when the render item's
+	// InstancesVersion changes; the tree is refit over the instances that moved.
+	struct InstanceCullState
+	{
+		uint32_t Version = 0;
+		BoundsSoA Bounds;
+		InstanceBvh Bvh;
+		CullingCoherence Coherence;
+		// The camera frame Coherence last saw, so items in several layers begin it once.
+		uint64_t CoherenceFrame = 0;
+		vector<uint32_t> Moved;
+		vector<uint32_t> Visible;
+
+		// This item's range of mVisibleObjects after CullRenderLayers pass LayerPass.
+		uint64_t LayerPass = 0;
+		UINT VisibleOffset = 0;
+		UINT VisibleCount = 0;
+	};
+
+	void UpdateInstanceBounds(const RenderItem* ritem, InstanceCullState& state);
+	// Where the item's Origin is relative to the render origin.
+	Float3 ItemOffset(const RenderItem* ritem) const;
+	// Whether the item is culled through Coherence this frame; begins its frame with the
+	// item's frustum if so.
+	bool BeginCoherentFrame(InstanceCullState& state, const FrustumPlanes& frustum);
+
+	FrustumPlanes mCameraFrustum;
+	Double3 mRenderOrigin;
 	bool mFrustumCullingEnabled = true;
+	bool mTemporalCoherenceEnabled = true;
+	const OcclusionBuffer* mOcclusion = nullptr;
+	uint64_t mCameraFrame = 0;
+
+	unordered_map<const RenderItem*, InstanceCullState> mInstanceStates;
+	BvhCullStats mFrameStats;
+	CoherenceStats mFrameCoherenceStats;
+	OcclusionStats mFrameOcclusionStats;
+
+	CullingPass mLayerPass;
+	uint64_t mLayerPassIndex = 0;
+	vector<const RenderItem*> mLayerItems;
+	vector<InstanceCullState*> mLayerStates;
+	vector<CullingSource> mLayerSources;
+	vector<ObjectData> mVisibleObjects;
 };
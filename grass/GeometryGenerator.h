@@ -53,6 +53,8 @@ public:
 				mIndices16.resize(Indices32.size());
 				for (size_t i = 0; i < Indices32.size(); ++i)
 				{
+					// Larger meshes need MeshIndexUtil::Pack.
+					assert(Indices32[i] <= 0xffff);
 					mIndices16[i] = static_cast<uint16>(Indices32[i]);
 				}
 			}
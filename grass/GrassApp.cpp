@@ -1,17 +1,9 @@
 #include "BaseApp.h"
 #include "GeometryGenerator.h"
-
-struct Bone
-{
-	XMFLOAT3 Position;
-	float Mass;
-	XMFLOAT4 Rotation;
-	XMFLOAT3 Velocity;
-	float Length;
-	int ParentIndex;
-	XMFLOAT3 LocalPosition;
-	XMFLOAT4 LocalRotation;
-};
+#include "GrassScatter.h"
+#include "GrassSimulation.h"
+#include "LandUtility.h"
+#include "MeshUtil.h"
 
 class GrassApp : public BaseApp
 {
@@ -23,12 +15,16 @@ protected:
 	virtual void Build() override;
 
 private:
+	void ScatterGrassRoots();
 	void BuildGrassBuffer();
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
 	void BuildShadersAndInputLayout();
+	void BuildTerrain();
 	void BuildGeometry();
 	void BuildGrassGeometry();
+	void BuildGrassFeedbackBuffers();
+	void BuildGrassTiles();
 	void BuildRenderItems();
 	void BuildFrameResources();
 	void BuildPSOs();
@@ -75,37 +71,76 @@ void GrassApp::Build()
 	BuildGrassBuffer();
 	BuildRootSignature();
 	// BuildDescriptorHeaps();
+	BuildTerrain();
 	BuildShadersAndInputLayout();
 	BuildGeometry();
 	BuildGrassGeometry();
+	BuildGrassFeedbackBuffers();
+	BuildGrassTiles();
 	BuildRenderItems();
 	BuildFrameResources();
 	BuildPSOs();
 }
 
-void GrassApp::BuildGrassBuffer()
+void GrassApp::ScatterGrassRoots()
 {
-	UINT byteSize = 32 * 5 * sizeof(Bone);
-
-	vector<Bone> bones(32 * 5);
-	for (UINT i = 0; i < 5; ++i)
+	uint32_t seed = (uint32_t)rand();
+	float halfSize = 0.5f * mGrassField.FieldSize;
+
+	// The pattern scales with its spacing, so size it from a unit pattern to land near the
+	// requested blade count.
+	GrassScatter scatter;
+	scatter.Initialize(1.0f, seed);
+	float area = mGrassField.FieldSize * mGrassField.FieldSize;
+	scatter.Initialize(sqrtf(scatter.MaxDensity() * area / mGrassField.BladeCount), seed);
+
+	// Grass thins out towards the hilltops.
+	GrassDensityMap density;
+	density.Width = 64;
+	density.Height = 64;
+	density.OriginX = (float)mGrassOrigin.x - halfSize;
+	density.OriginZ = (float)mGrassOrigin.z - halfSize;
+	density.CellSize = mGrassField.FieldSize / (density.Width - 1);
+	density.Values.resize((size_t)density.Width * density.Height);
+
+	LandUtility::GetHillsGrid(density.OriginX, density.OriginZ, density.CellSize, density.Width, density.Height,
+		density.Values.data(), nullptr, nullptr, nullptr);
+	for (float& value : density.Values)
 	{
-		for (UINT j = 0; j < 32; ++j)
-		{
-			UINT index = i * 32 + j;
-
-			bones[index].Position = XMFLOAT3(0.0f, 0.0f, 0.0f);
-			bones[index].Rotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
-			bones[index].Velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
-			bones[index].LocalPosition = XMFLOAT3(0.0f, 0.0f, 0.0f);
-			bones[index].LocalRotation = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
-			bones[index].Mass = 1.0f;
-			bones[index].Length = 0.3f;
-			UINT parentIndex = MathHelper::Max<int>((i - 1) * 32 + j, -1);
-			bones[index].ParentIndex = parentIndex;
-		}
+		value = MathHelper::Clamp(1.0f - 0.05f * value, 0.2f, 1.0f);
 	}
 
+	// Roots come out in the field's own frame, see mGrassOrigin.
+	GrassScatterDesc scatterDesc;
+	scatterDesc.OriginX = mGrassOrigin.x;
+	scatterDesc.OriginZ = mGrassOrigin.z;
+	scatterDesc.MinX = -halfSize;
+	scatterDesc.MinZ = -halfSize;
+	scatterDesc.MaxX = halfSize;
+	scatterDesc.MaxZ = halfSize;
+	scatterDesc.Density = &density;
+	scatterDesc.Height = LandUtility::GetHillsHeight;
+	scatterDesc.Normal = LandUtility::GetHillsNormal;
+	scatterDesc.HeightBatch = LandUtility::GetHillsHeights;
+	scatterDesc.NormalBatch = LandUtility::GetHillsNormals;
+	scatterDesc.MaxSlopeDegrees = 50.0f;
+
+	mGrassRoots = scatter.Scatter(scatterDesc, mThreadPool.get());
+
+	// Everything downstream (buffers, shader defines, chunks) sizes itself from the field.
+	mGrassField.BladeCount = (uint32_t)mGrassRoots.size();
+}
+
+void GrassApp::BuildGrassBuffer()
+{
+	ScatterGrassRoots();
+	assert(GrassFieldUtil::IsValid(mGrassField));
+
+	vector<Bone> bones = GrassSimulation::BuildBones(mGrassField.BladeCount, mGrassField.BonesPerBlade,
+		mGrassField.BoneLength, mGrassField.BoneMass);
+	GrassSimulation::SetBladeRoots(bones, mGrassRoots);
+	UINT byteSize = (UINT)bones.size() * sizeof(Bone);
+
 	auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
 	auto uavDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 	// auto uavDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
@@ -118,6 +153,15 @@ void GrassApp::BuildGrassBuffer()
 		nullptr,
 		IID_PPV_ARGS(mGrassBuffer.GetAddressOf())));
 
+	auto prevDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&prevDesc,
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+		nullptr,
+		IID_PPV_ARGS(mGrassPrevBuffer.GetAddressOf())));
+
 	CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
 	auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
 	ThrowIfFailed(md3dDevice->CreateCommittedResource(
@@ -143,18 +187,37 @@ void GrassApp::BuildGrassBuffer()
 	auto toUA = CD3DX12_RESOURCE_BARRIER::Transition(mGrassBuffer.Get(),
 		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	mCommandList->ResourceBarrier(1, &toUA);
+
+	auto prevToCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+	mCommandList->ResourceBarrier(1, &prevToCopyDest);
+
+	mCommandList->CopyBufferRegion(mGrassPrevBuffer.Get(), 0, mGrassUploadBuffer.Get(), 0, byteSize);
+
+	auto prevToSrv = CD3DX12_RESOURCE_BARRIER::Transition(mGrassPrevBuffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	mCommandList->ResourceBarrier(1, &prevToSrv);
 }
 
 void GrassApp::BuildRootSignature()
 {
-	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+	CD3DX12_ROOT_PARAMETER slotRootParameter[13];
 
 	slotRootParameter[0].InitAsConstantBufferView(0);
 	slotRootParameter[1].InitAsConstantBufferView(1);
 	slotRootParameter[2].InitAsConstantBufferView(2);
 	slotRootParameter[3].InitAsUnorderedAccessView(0);
-
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	slotRootParameter[4].InitAsShaderResourceView(0);
+	slotRootParameter[5].InitAsShaderResourceView(1);
+	slotRootParameter[6].InitAsShaderResourceView(2);
+	slotRootParameter[7].InitAsConstants(1, 3);
+	slotRootParameter[8].InitAsShaderResourceView(3);
+	slotRootParameter[9].InitAsShaderResourceView(4);
+	slotRootParameter[10].InitAsShaderResourceView(5);
+	slotRootParameter[11].InitAsUnorderedAccessView(1);
+	slotRootParameter[12].InitAsUnorderedAccessView(2);
+
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(13, slotRootParameter,
 		0, nullptr,
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -213,10 +276,29 @@ void GrassApp::BuildShadersAndInputLayout()
 	mShaders["standardVS"] = D3DUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = D3DUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
 
-	mShaders["grassVS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["grassCS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", nullptr, "CS", "cs_5_1");
-	mShaders["grassGS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", nullptr, "GS", "gs_5_1");
-	mShaders["grassPS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", nullptr, "PS", "ps_5_1");
+	vector<pair<string, string>> grassDefineValues = GrassFieldUtil::ShaderDefines(mGrassField);
+
+	vector<D3D_SHADER_MACRO> grassDefines;
+	for (const auto& define : grassDefineValues)
+	{
+		grassDefines.push_back({ define.first.c_str(), define.second.c_str() });
+	}
+	grassDefines.push_back({ nullptr, nullptr });
+
+	mShaders["grassVS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", grassDefines.data(), "VS", "vs_5_1");
+	mShaders["grassCS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", grassDefines.data(), "CS", "cs_5_1");
+	mShaders["grassGS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", grassDefines.data(), "GS", "gs_5_1");
+	mShaders["grassPS"] = D3DUtil::CompileShader(L"Shaders\\Grass.hlsl", grassDefines.data(), "PS", "ps_5_1");
+
+	string patchResolution = to_string(mTerrain.Desc().PatchResolution);
+	const D3D_SHADER_MACRO terrainDefines[] =
+	{
+		{ "PATCH_RESOLUTION", patchResolution.c_str() },
+		{ nullptr, nullptr }
+	};
+
+	mShaders["terrainVS"] = D3DUtil::CompileShader(L"Shaders\\Terrain.hlsl", terrainDefines, "VS", "vs_5_1");
+	mShaders["terrainPS"] = D3DUtil::CompileShader(L"Shaders\\Terrain.hlsl", terrainDefines, "PS", "ps_5_1");
 
 	mStdInputLayout =
 	{
@@ -230,24 +312,52 @@ void GrassApp::BuildShadersAndInputLayout()
 	};
 }
 
-void GrassApp::BuildGeometry()
+void GrassApp::BuildTerrain()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+	// The height function must match HillsHeight in Terrain.hlsl.
+	TerrainQuadtreeDesc terrainDesc;
+	terrainDesc.Height = LandUtility::GetHillsHeight;
+	terrainDesc.HeightBatch = LandUtility::GetHillsHeights;
+	mTerrain.Build(terrainDesc, mThreadPool.get());
+}
 
-	vector<Vertex> vertices(grid.Vertices.size());
+void GrassApp::BuildGeometry()
+{
+	// Land is a quadtree of patches (TerrainQuadtree); every node draws this one grid over
+	// [0, 1] x [0, 1], which Terrain.hlsl scales, morphs and lifts onto the hills.
+	uint32_t resolution = mTerrain.Desc().PatchResolution;
+	vector<Vertex> vertices((size_t)(resolution + 1) * (resolution + 1));
+	vector<uint32_t> gridIndices;
+	gridIndices.reserve((size_t)resolution * resolution * 6);
+
+	for (uint32_t j = 0; j <= resolution; ++j)
+	{
+		for (uint32_t i = 0; i <= resolution; ++i)
+		{
+			float u = (float)i / resolution;
+			float v = (float)j / resolution;
+			vertices[(size_t)j * (resolution + 1) + i] = Vertex(u, 0.0f, v, 0.0f, 1.0f, 0.0f, u, v);
+		}
+	}
 
-	for (int i = 0; i < grid.Vertices.size(); ++i)
+	// Clockwise seen from above, split along the (i, j)-(i + 1, j + 1) diagonal.
+	for (uint32_t j = 0; j < resolution; ++j)
 	{
-		vertices[i].Pos = grid.Vertices[i].Position;
-		vertices[i].Normal = grid.Vertices[i].Normal;
-		vertices[i].TexC = grid.Vertices[i].TexC;
+		for (uint32_t i = 0; i < resolution; ++i)
+		{
+			uint32_t v00 = j * (resolution + 1) + i;
+			uint32_t v10 = v00 + 1;
+			uint32_t v01 = v00 + resolution + 1;
+			uint32_t v11 = v01 + 1;
+
+			gridIndices.insert(gridIndices.end(), { v00, v01, v11, v00, v11, v10 });
+		}
 	}
 
-	vector<uint16_t> indices = grid.GetIndices16();
+	// 16-bit while the grid allows it, in several draws if it has to be.
+	PackedMeshIndices indices = MeshIndexUtil::Pack(gridIndices);
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(uint16_t);
 
 	auto geo = make_unique<MeshGeometry>();
 	geo->Name = "landGeo";
@@ -255,61 +365,42 @@ void GrassApp::BuildGeometry()
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
 	geo->VertexBufferGPU = D3DUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = D3DUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	geo->DrawArgs["grid"] = submesh;
+	MeshUtil::SetIndices(geo.get(), indices, md3dDevice.Get(), mCommandList.Get());
+	geo->DrawArgs["patch"] = MeshUtil::GetSubmesh(indices, 0);
 
 	mGeometries[geo->Name] = move(geo);
 }
 
 void GrassApp::BuildGrassGeometry()
 {
-	struct GrassVertex
-	{
-		XMFLOAT3 Pos;
-		XMFLOAT2 Size;
-	};
-
-	static const int grassCount = 32;
-
-	vector<GrassVertex> vertices(grassCount);
-	for (int i = 0; i < grassCount; ++i)
-	{
-		float x = MathHelper::RandF(-5.0f, 05.0f);
-		float y = 0.0f;
-		float z = MathHelper::RandF(-5.0f, 05.0f);
-
-		vertices[i].Pos = XMFLOAT3(x, y, z);
-		vertices[i].Size = XMFLOAT2(0.1f, 0.3f);
-	}
-
-	vector<uint16_t> indices =
-	{
-		0, 1, 2, 3, 4, 5, 6, 7,
-		8, 9, 10, 11, 12, 13, 14, 15,
-		16, 17, 18, 19, 20, 21, 22, 23,
-		24, 25, 26, 27, 28, 29, 30, 31
-	};
+	vector<Bone> bones = GrassSimulation::BuildBones(mGrassField.BladeCount, mGrassField.BonesPerBlade,
+		mGrassField.BoneLength, mGrassField.BoneMass);
+	GrassSimulation::SetBladeRoots(bones, mGrassRoots);
+	mGrassSimulation.Initialize(bones, mGrassField.BonesPerBlade, mGrassRoots, mGrassField.BladesPerChunk);
+
+	// One wind grid stretched over the whole field.
+	WindFieldDesc windDesc;
+	windDesc.CellSize = mGrassField.FieldSize / (windDesc.Width - 1);
+	windDesc.OriginX = -0.5f * mGrassField.FieldSize;
+	windDesc.OriginZ = -0.5f * mGrassField.FieldSize;
+	mWindField.Initialize(windDesc);
+
+	// The camera pushes the grass aside when it flies low enough; moved every frame in Update.
+	mCameraCollider.Radius = 1.0f;
+	mCameraColliderId = mGrassColliders.Add(mCameraCollider);
+
+	vector<GrassVertex> vertices = GrassFieldUtil::BuildVertices(mGrassField, mGrassRoots);
+	// The GS finds a blade's bones through SV_PrimitiveID, so the points must stay one draw;
+	// 16-bit indices are only used while every blade fits under them.
+	PackedMeshIndices indices = MeshIndexUtil::Pack(GrassFieldUtil::BuildIndices(mGrassField), 1, false);
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(GrassVertex);
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(uint16_t);
 
 	auto geo = make_unique<MeshGeometry>();
 	geo->Name = "grassGeo";
@@ -317,33 +408,101 @@ void GrassApp::BuildGrassGeometry()
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
 	geo->VertexBufferGPU = D3DUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-	geo->IndexBufferGPU = D3DUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 	geo->VertexByteStride = sizeof(GrassVertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	geo->DrawArgs["points"] = submesh;
+	MeshUtil::SetIndices(geo.get(), indices, md3dDevice.Get(), mCommandList.Get());
+	geo->DrawArgs["points"] = MeshUtil::GetSubmesh(indices, 0);
 	mGeometries[geo->Name] = move(geo);
 }
 
+void GrassApp::BuildGrassFeedbackBuffers()
+{
+	// Starts as the chains Initialize seeded, so a chunk whose seed the CS has not written
+	// yet still gets a pose of its own blade.
+	const vector<Bone>& seeds = mGrassSimulation.SwayBones();
+	UINT byteSize = (UINT)seeds.size() * sizeof(Bone);
+
+	auto defaultHeap = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	auto uavDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&uavDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(mGrassSeedBuffer.GetAddressOf())));
+
+	CD3DX12_HEAP_PROPERTIES uploadHeap(D3D12_HEAP_TYPE_UPLOAD);
+	auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&uploadHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&uploadDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(mGrassSeedUploadBuffer.GetAddressOf())));
+
+	void* data = nullptr;
+	ThrowIfFailed(mGrassSeedUploadBuffer->Map(0, nullptr, &data));
+	memcpy(data, seeds.data(), byteSize);
+	mGrassSeedUploadBuffer->Unmap(0, nullptr);
+
+	auto toCopyDest = CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST);
+	mCommandList->ResourceBarrier(1, &toCopyDest);
+
+	mCommandList->CopyBufferRegion(mGrassSeedBuffer.Get(), 0, mGrassSeedUploadBuffer.Get(), 0, byteSize);
+
+	auto toUA = CD3DX12_RESOURCE_BARRIER::Transition(mGrassSeedBuffer.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	mCommandList->ResourceBarrier(1, &toUA);
+
+	mGrassSeedBones = seeds;
+
+	// Committed resources start zeroed: no chunk has reported settled yet.
+	auto settledDesc = CD3DX12_RESOURCE_DESC::Buffer(mGrassSimulation.Chunks().size() * sizeof(uint32_t),
+		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&defaultHeap,
+		D3D12_HEAP_FLAG_NONE,
+		&settledDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(mGrassSettledBuffer.GetAddressOf())));
+
+	mGrassSettledChunks.assign(mGrassSimulation.Chunks().size(), 0);
+}
+
+void GrassApp::BuildGrassTiles()
+{
+	// The load radius covers about the field's area, spaced so it holds about the field's
+	// blade count; the density map stays with the field.
+	GrassTileCacheDesc tileDesc;
+	tileDesc.LoadRadius = 0.5f * mGrassField.FieldSize;
+	tileDesc.Seed = (uint32_t)rand();
+	tileDesc.Height = LandUtility::GetHillsHeight;
+	tileDesc.Normal = LandUtility::GetHillsNormal;
+	tileDesc.HeightBatch = LandUtility::GetHillsHeights;
+	tileDesc.NormalBatch = LandUtility::GetHillsNormals;
+	tileDesc.MaxSlopeDegrees = 50.0f;
+
+	GrassScatter scatter;
+	scatter.Initialize(1.0f, tileDesc.Seed);
+	float area = MathHelper::Pi * tileDesc.LoadRadius * tileDesc.LoadRadius;
+	tileDesc.MinSpacing = sqrtf(scatter.MaxDensity() * area / mGrassField.BladeCount);
+
+	mGrassTiles.Initialize(tileDesc);
+}
+
 void GrassApp::BuildRenderItems()
 {
 	auto grassRitem = make_unique<RenderItem>();
 	grassRitem->World = MathHelper::Identity4x4();;
+	grassRitem->Origin = mGrassOrigin;
 	grassRitem->TexTransform = MathHelper::Identity4x4();
 	grassRitem->ObjCBIndex = 1;
 	grassRitem->Mat = nullptr;
@@ -353,6 +512,7 @@ void GrassApp::BuildRenderItems()
 	grassRitem->StartIndexLocation = grassRitem->Geo->DrawArgs["points"].StartIndexLocation;
 	grassRitem->BaseVertexLocation = grassRitem->Geo->DrawArgs["points"].BaseVertexLocation;
 
+	mGrassRitem = grassRitem.get();
 	mRitemLayer[(int)RenderLayer::Grass].push_back(grassRitem.get());
 	mAllRitems.push_back(move(grassRitem));
 
@@ -363,11 +523,13 @@ void GrassApp::BuildRenderItems()
 	landRitem->Mat = nullptr;
 	landRitem->Geo = mGeometries["landGeo"].get();
 	landRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	landRitem->IndexCount = landRitem->Geo->DrawArgs["grid"].IndexCount;
-	landRitem->StartIndexLocation = landRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	landRitem->BaseVertexLocation = landRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
+	landRitem->IndexCount = landRitem->Geo->DrawArgs["patch"].IndexCount;
+	landRitem->StartIndexLocation = landRitem->Geo->DrawArgs["patch"].StartIndexLocation;
+	landRitem->BaseVertexLocation = landRitem->Geo->DrawArgs["patch"].BaseVertexLocation;
+	landRitem->IndexRanges = landRitem->Geo->DrawArgs["patch"].Ranges;
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(landRitem.get());
+	mTerrainRitem = landRitem.get();
+	mRitemLayer[(int)RenderLayer::Terrain].push_back(landRitem.get());
 	mAllRitems.push_back(move(landRitem));
 }
 
@@ -376,7 +538,9 @@ void GrassApp::BuildFrameResources()
 	for (int i = 0; i < gNumFrameResources; ++i)
 	{
 		mFrameResources.push_back(make_unique<FrameResource>(md3dDevice.Get(),
-			1, (UINT)mAllRitems.size(), 0));
+			1, (UINT)mAllRitems.size(), 0, (UINT)mGrassSimulation.BoneCount(),
+			(UINT)mGrassSimulation.Chunks().size(), (UINT)mGrassSimulation.SwayBones().size(),
+			(UINT)mWindField.NodeCount(), MaxTerrainPatches));
 	}
 }
 
@@ -443,6 +607,20 @@ void GrassApp::BuildPSOs()
 	grassCSPsoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
 	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&grassCSPsoDesc, IID_PPV_ARGS(&mPSOs["grassCS"])));
 
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC terrainPsoDesc = opaquePsoDesc;
+	terrainPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["terrainVS"]->GetBufferPointer()),
+		mShaders["terrainVS"]->GetBufferSize()
+	};
+	terrainPsoDesc.PS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["terrainPS"]->GetBufferPointer()),
+		mShaders["terrainPS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&terrainPsoDesc, IID_PPV_ARGS(&mPSOs["terrain"])));
+
 	mPsoDescs["opaque"] = opaquePsoDesc;
+	mPsoDescs["terrain"] = terrainPsoDesc;
 	mPsoDescs["grass"] = grassPsoDesc;
 }
\ No newline at end of file
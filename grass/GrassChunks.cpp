@@ -0,0 +1,667 @@
+#include "GrassChunks.h"
+#include "ThreadPool.h"
+#include "WindField.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace
+{
+	uint32_t SpreadBits(uint32_t v)
+	{
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
+}
+
+uint32_t GrassChunking::MortonKey(uint32_t x, uint32_t z)
+{
+	return SpreadBits(x) | (SpreadBits(z) << 1);
+}
+
+void GrassChunking::SortSpatially(vector<Float3>& roots, float cellSize)
+{
+	if (roots.empty())
+	{
+		return;
+	}
+
+	float minX = FLT_MAX;
+	float minZ = FLT_MAX;
+	for (const auto& root : roots)
+	{
+		minX = min(minX, root.x);
+		minZ = min(minZ, root.z);
+	}
+
+	float invCellSize = 1.0f / cellSize;
+
+	vector<pair<uint32_t, uint32_t>> keys(roots.size());
+	for (size_t i = 0; i < roots.size(); ++i)
+	{
+		uint32_t cx = (uint32_t)min((roots[i].x - minX) * invCellSize, 65535.0f);
+		uint32_t cz = (uint32_t)min((roots[i].z - minZ) * invCellSize, 65535.0f);
+		keys[i] = { MortonKey(cx, cz), (uint32_t)i };
+	}
+
+	sort(keys.begin(), keys.end());
+
+	vector<Float3> sorted(roots.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		sorted[i] = roots[keys[i].second];
+	}
+
+	roots.swap(sorted);
+}
+
+vector<GrassChunk> GrassChunking::BuildChunks(const vector<Float3>& roots, uint32_t bladesPerChunk)
+{
+	uint32_t bladeCount = (uint32_t)roots.size();
+	uint32_t chunkSize = max(GrassChunkAlignment,
+		(bladesPerChunk + GrassChunkAlignment - 1) / GrassChunkAlignment * GrassChunkAlignment);
+
+	vector<GrassChunk> chunks;
+
+	for (uint32_t begin = 0; begin < bladeCount; begin += chunkSize)
+	{
+		GrassChunk chunk;
+		chunk.BladeBegin = begin;
+		chunk.BladeEnd = min(begin + chunkSize, bladeCount);
+		chunk.BoundsMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		chunk.BoundsMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		for (uint32_t i = chunk.BladeBegin; i < chunk.BladeEnd; ++i)
+		{
+			chunk.BoundsMin = Float3(min(chunk.BoundsMin.x, roots[i].x), min(chunk.BoundsMin.y, roots[i].y), min(chunk.BoundsMin.z, roots[i].z));
+			chunk.BoundsMax = Float3(max(chunk.BoundsMax.x, roots[i].x), max(chunk.BoundsMax.y, roots[i].y), max(chunk.BoundsMax.z, roots[i].z));
+		}
+
+		chunks.push_back(chunk);
+	}
+
+	return chunks;
+}
+
+void GrassChunkSimulation::Initialize(const vector<Bone>& bones, uint32_t bonesPerBlade, const vector<Float3>& roots, uint32_t bladesPerChunk)
+{
+	uint32_t bladeCount = (uint32_t)roots.size();
+	assert(bones.size() == (size_t)bladeCount * bonesPerBlade);
+
+	mBones.FromBones(bones.data(), bladeCount, bonesPerBlade);
+	mChunks = GrassChunking::BuildChunks(roots, bladesPerChunk);
+
+	// A bent blade reaches at most its height away from its root.
+	float bladeHeight = 0.0f;
+	for (uint32_t level = 0; level < bonesPerBlade && bladeCount > 0; ++level)
+	{
+		bladeHeight += mBones.Length[mBones.Index(level, 0)];
+	}
+
+	uint32_t blockCount = (bladeCount + GrassChunkAlignment - 1) / GrassChunkAlignment;
+
+	// Cells of about the area of one block on average.
+	Float3 fieldMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Float3 fieldMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (const auto& root : roots)
+	{
+		fieldMin = Float3(min(fieldMin.x, root.x), min(fieldMin.y, root.y), min(fieldMin.z, root.z));
+		fieldMax = Float3(max(fieldMax.x, root.x), max(fieldMax.y, root.y), max(fieldMax.z, root.z));
+	}
+
+	float fieldArea = bladeCount > 0 ? (fieldMax.x - fieldMin.x) * (fieldMax.z - fieldMin.z) : 0.0f;
+	float cellSize = max(sqrtf(fieldArea / max(blockCount, 1u)), 0.1f);
+
+	// Split each block into runs no wider than a cell.
+	vector<Float3> runMin;
+	vector<Float3> runMax;
+	mHashBlocks.clear();
+
+	Float3 reach(bladeHeight, 0.0f, bladeHeight);
+	Float3 reachUp(bladeHeight, bladeHeight, bladeHeight);
+
+	for (uint32_t b = 0; b < blockCount; ++b)
+	{
+		uint32_t begin = b * GrassChunkAlignment;
+		uint32_t end = min(begin + GrassChunkAlignment, bladeCount);
+
+		Float3 boxMin = roots[begin];
+		Float3 boxMax = roots[begin];
+
+		for (uint32_t i = begin + 1; i <= end; ++i)
+		{
+			if (i < end)
+			{
+				Float3 grownMin(min(boxMin.x, roots[i].x), min(boxMin.y, roots[i].y), min(boxMin.z, roots[i].z));
+				Float3 grownMax(max(boxMax.x, roots[i].x), max(boxMax.y, roots[i].y), max(boxMax.z, roots[i].z));
+
+				if (grownMax.x - grownMin.x <= cellSize && grownMax.z - grownMin.z <= cellSize)
+				{
+					boxMin = grownMin;
+					boxMax = grownMax;
+					continue;
+				}
+			}
+
+			runMin.push_back(boxMin - reach);
+			runMax.push_back(boxMax + reachUp);
+			mHashBlocks.push_back(b);
+
+			if (i < end)
+			{
+				boxMin = roots[i];
+				boxMax = roots[i];
+			}
+		}
+	}
+
+	mBlockHash.Build(runMin, runMax, cellSize);
+
+	mBlockChunks.resize(blockCount);
+	for (uint32_t c = 0; c < (uint32_t)mChunks.size(); ++c)
+	{
+		for (uint32_t i = mChunks[c].BladeBegin; i < mChunks[c].BladeEnd; i += GrassChunkAlignment)
+		{
+			mBlockChunks[i / GrassChunkAlignment] = c;
+		}
+	}
+
+	mBlockSettledSteps.assign(blockCount, UINT32_MAX);
+	mColliderRefs.clear();
+
+	mSwayBones.resize(mChunks.size() * bonesPerBlade);
+	for (uint32_t i = 0; i < (uint32_t)mChunks.size(); ++i)
+	{
+		SeedSwayChain(i, nullptr);
+	}
+}
+
+void GrassChunkSimulation::UpdateLod(const Float3& eye, const GrassLodDesc& desc, const Bone* seedBones)
+{
+	for (uint32_t i = 0; i < (uint32_t)mChunks.size(); ++i)
+	{
+		GrassChunk& chunk = mChunks[i];
+
+		// Distance from the eye to the chunk's bounds.
+		float dx = max(max(chunk.BoundsMin.x - eye.x, eye.x - chunk.BoundsMax.x), 0.0f);
+		float dy = max(max(chunk.BoundsMin.y - eye.y, eye.y - chunk.BoundsMax.y), 0.0f);
+		float dz = max(max(chunk.BoundsMin.z - eye.z, eye.z - chunk.BoundsMax.z), 0.0f);
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+		GrassLod lod = GrassLod::Full;
+		if (distance >= desc.SwayDistance)
+		{
+			lod = GrassLod::Sway;
+		}
+		else if (distance >= desc.RootDistance)
+		{
+			lod = GrassLod::Root;
+		}
+
+		// Start the shared chain from one of the chunk's own blades so the switch doesn't pop,
+		// and hand its velocities back to the blades when they resume integrating.
+		if (lod == GrassLod::Sway && chunk.Lod != GrassLod::Sway)
+		{
+			SeedSwayChain(i, seedBones);
+			// Sway chunks are never stepped blade by blade.
+			ClearDisturbedBlocks(chunk);
+		}
+		else if (lod != GrassLod::Sway && chunk.Lod == GrassLod::Sway)
+		{
+			CopySwayChain(i, false);
+		}
+
+		chunk.Lod = lod;
+	}
+}
+
+void GrassChunkSimulation::UpdateColliders(const vector<GrassCollider>& colliders)
+{
+	mColliderHits.clear();
+
+	for (uint32_t c = 0; c < (uint32_t)colliders.size(); ++c)
+	{
+		Float3 boundsMin;
+		Float3 boundsMax;
+		GrassColliderRegistry::Bounds(colliders[c], boundsMin, boundsMax);
+
+		mColliderQuery.clear();
+		mBlockHash.Query(boundsMin, boundsMax, mColliderQuery);
+
+		for (uint32_t run : mColliderQuery)
+		{
+			uint32_t block = mHashBlocks[run];
+			mColliderHits.push_back({ mBlockChunks[block], c, block });
+		}
+	}
+
+	// Group the hits by chunk. The sort is stable, so each chunk's hits stay in collider order.
+	uint32_t chunkCount = (uint32_t)mChunks.size();
+	mChunkHitStart.assign((size_t)chunkCount + 1, 0);
+	for (const auto& hit : mColliderHits)
+	{
+		++mChunkHitStart[hit[0] + 1];
+	}
+	for (uint32_t i = 0; i < chunkCount; ++i)
+	{
+		mChunkHitStart[i + 1] += mChunkHitStart[i];
+	}
+
+	mSortedHits.resize(mColliderHits.size());
+	for (const auto& hit : mColliderHits)
+	{
+		mSortedHits[mChunkHitStart[hit[0]]++] = hit;
+	}
+	mColliderHits.swap(mSortedHits);
+
+	for (auto& chunk : mChunks)
+	{
+		chunk.ColliderBegin = 0;
+		chunk.ColliderCount = 0;
+	}
+
+	mColliderRefs.clear();
+
+	for (size_t first = 0; first < mColliderHits.size();)
+	{
+		uint32_t chunkIndex = mColliderHits[first][0];
+
+		size_t last = first;
+		while (last < mColliderHits.size() && mColliderHits[last][0] == chunkIndex)
+		{
+			++last;
+		}
+
+		GrassChunk& chunk = mChunks[chunkIndex];
+		if (chunk.Lod != GrassLod::Sway)
+		{
+			chunk.ColliderBegin = (uint32_t)mColliderRefs.size();
+
+			// Hits are sorted by collider within the chunk; a collider reaching several blocks
+			// is copied once.
+			for (size_t i = first; i < last && mColliderRefs.size() < GrassMaxColliderRefs; ++i)
+			{
+				if (i == first || mColliderHits[i][1] != mColliderHits[i - 1][1])
+				{
+					mColliderRefs.push_back(colliders[mColliderHits[i][1]]);
+				}
+			}
+
+			chunk.ColliderCount = (uint32_t)mColliderRefs.size() - chunk.ColliderBegin;
+
+			if (chunk.Asleep && chunk.ColliderCount > 0)
+			{
+				for (size_t i = first; i < last; ++i)
+				{
+					uint32_t& settledSteps = mBlockSettledSteps[mColliderHits[i][2]];
+					chunk.DisturbedBlocks += settledSteps == UINT32_MAX ? 1 : 0;
+					settledSteps = 0;
+				}
+			}
+		}
+
+		first = last;
+	}
+}
+
+void GrassChunkSimulation::StepSwayChains(const GrassStepParams& params)
+{
+	for (uint32_t i = 0; i < (uint32_t)mChunks.size(); ++i)
+	{
+		if (mChunks[i].Lod == GrassLod::Sway)
+		{
+			StepSwayChain(i, params);
+		}
+	}
+}
+
+void GrassChunkSimulation::UpdateGpuSleep(const uint32_t* settled, const GrassStepParams& params)
+{
+	float windSpeed = Length(params.WindVelocity) + (params.Wind != nullptr ? params.Wind->MaxSpeed() : 0.0f);
+	bool calm = mSleepEnabled && windSpeed <= WakeWindSpeed;
+
+	for (uint32_t i = 0; i < (uint32_t)mChunks.size(); ++i)
+	{
+		GrassChunk& chunk = mChunks[i];
+
+		// Sway chunks cost one copy per frame, not worth a sleep of their own.
+		if (!calm || chunk.ColliderCount > 0 || chunk.Lod == GrassLod::Sway)
+		{
+			if (chunk.Asleep || chunk.SettledSteps > 0)
+			{
+				Wake(chunk);
+			}
+			continue;
+		}
+
+		// A report is a few frames old; a sleeping chunk was settled then and has not been
+		// stepped since.
+		if (chunk.Asleep || settled == nullptr)
+		{
+			continue;
+		}
+
+		chunk.SettledSteps = settled[i] != 0 ? chunk.SettledSteps + 1 : 0;
+		chunk.Asleep = chunk.SettledSteps >= SleepSteps;
+	}
+}
+
+uint32_t GrassChunkSimulation::BuildDispatchTable(GrassChunkDispatch* table, uint32_t& swayCount) const
+{
+	uint32_t integratedCount = 0;
+	for (const auto& chunk : mChunks)
+	{
+		if (chunk.Lod != GrassLod::Sway && !chunk.Asleep)
+		{
+			++integratedCount;
+		}
+	}
+
+	uint32_t integratedIndex = 0;
+	uint32_t swayIndex = integratedCount;
+
+	for (uint32_t i = 0; i < (uint32_t)mChunks.size(); ++i)
+	{
+		const GrassChunk& chunk = mChunks[i];
+
+		if (chunk.Lod != GrassLod::Sway && chunk.Asleep)
+		{
+			continue;
+		}
+
+		GrassChunkDispatch& entry = table[chunk.Lod == GrassLod::Sway ? swayIndex++ : integratedIndex++];
+		entry.BladeBegin = chunk.BladeBegin;
+		entry.BladeEnd = chunk.BladeEnd;
+		entry.Lod = (uint32_t)chunk.Lod;
+		entry.SwayIndex = i;
+		entry.ColliderBegin = chunk.ColliderBegin;
+		entry.ColliderCount = chunk.ColliderCount;
+	}
+
+	swayCount = swayIndex - integratedCount;
+	return integratedCount;
+}
+
+void GrassChunkSimulation::Step(const GrassStepParams& params, ThreadPool* pool)
+{
+	uint32_t chunkCount = (uint32_t)mChunks.size();
+
+	// Any wind bends settled blades, so only a calm step may leave chunks asleep.
+	float windSpeed = Length(params.WindVelocity) + (params.Wind != nullptr ? params.Wind->MaxSpeed() : 0.0f);
+	bool calm = mSleepEnabled && windSpeed <= WakeWindSpeed;
+
+	++mStepCount;
+
+	mStats = GrassStepStats();
+	for (const auto& chunk : mChunks)
+	{
+		size_t bladeCount = chunk.BladeEnd - chunk.BladeBegin;
+		size_t simulatedCount = bladeCount;
+
+		if (calm && chunk.Asleep)
+		{
+			// Only blocks disturbed by a collider are stepped.
+			simulatedCount = min((size_t)chunk.DisturbedBlocks * GrassChunkAlignment, bladeCount);
+			++mStats.SleepingChunks;
+			mStats.SkippedBlades += bladeCount - simulatedCount;
+			mStats.DisturbedBlades += simulatedCount;
+		}
+		else
+		{
+			++mStats.ActiveChunks;
+			++mStats.LodChunks[(int)chunk.Lod];
+		}
+
+		mStats.SimulatedBlades += simulatedCount;
+		mStats.CollidingChunks += chunk.ColliderCount > 0 ? 1 : 0;
+
+		switch (chunk.Lod)
+		{
+		case GrassLod::Full:
+			mStats.IntegratedBones += simulatedCount * mBones.BonesPerBlade;
+			break;
+		case GrassLod::Root:
+			mStats.IntegratedBones += simulatedCount;
+			break;
+		case GrassLod::Sway:
+			mStats.IntegratedBones += simulatedCount > 0 ? mBones.BonesPerBlade : 0;
+			break;
+		}
+	}
+
+	if (pool == nullptr || pool->ThreadCount() == 1)
+	{
+		for (uint32_t i = 0; i < chunkCount; ++i)
+		{
+			StepChunk(i, params, calm);
+		}
+	}
+	else
+	{
+		pool->ParallelFor(chunkCount, [this, &params, calm](uint32_t i)
+			{
+				StepChunk(i, params, calm);
+			});
+	}
+}
+
+void GrassChunkSimulation::SetBones(const Bone* bones)
+{
+	mBones.FromBones(bones, mBones.BladeCount, mBones.BonesPerBlade);
+	mPreviousPose.CopyFrom(mBones);
+	WakeAll();
+}
+
+void GrassChunkSimulation::CopyBonesInterpolated(Bone* bones, float alpha) const
+{
+	if (mPreviousPose.PositionX.size() != mBones.PositionX.size())
+	{
+		mBones.ToBones(bones);
+		return;
+	}
+
+	mBones.ToBonesInterpolated(bones, mPreviousPose, alpha);
+}
+
+void GrassChunkSimulation::SetSleepEnabled(bool enabled)
+{
+	mSleepEnabled = enabled;
+
+	if (!enabled)
+	{
+		WakeAll();
+	}
+}
+
+void GrassChunkSimulation::WakeAll()
+{
+	for (auto& chunk : mChunks)
+	{
+		Wake(chunk);
+	}
+}
+
+void GrassChunkSimulation::WakeRegion(const Float3& boundsMin, const Float3& boundsMax)
+{
+	for (auto& chunk : mChunks)
+	{
+		if (chunk.BoundsMax.x < boundsMin.x || chunk.BoundsMin.x > boundsMax.x ||
+			chunk.BoundsMax.z < boundsMin.z || chunk.BoundsMin.z > boundsMax.z)
+		{
+			continue;
+		}
+
+		Wake(chunk);
+	}
+}
+
+void GrassChunkSimulation::Wake(GrassChunk& chunk)
+{
+	chunk.Asleep = false;
+	chunk.SettledSteps = 0;
+	ClearDisturbedBlocks(chunk);
+}
+
+void GrassChunkSimulation::ClearDisturbedBlocks(GrassChunk& chunk)
+{
+	if (chunk.DisturbedBlocks == 0)
+	{
+		return;
+	}
+
+	for (uint32_t i = chunk.BladeBegin; i < chunk.BladeEnd; i += GrassChunkAlignment)
+	{
+		mBlockSettledSteps[i / GrassChunkAlignment] = UINT32_MAX;
+	}
+	chunk.DisturbedBlocks = 0;
+}
+
+void GrassChunkSimulation::StepDisturbedBlocks(GrassChunk& chunk, const GrassStepParams& params)
+{
+	for (uint32_t i = chunk.BladeBegin; i < chunk.BladeEnd && chunk.DisturbedBlocks > 0; i += GrassChunkAlignment)
+	{
+		uint32_t& settledSteps = mBlockSettledSteps[i / GrassChunkAlignment];
+		if (settledSteps == UINT32_MAX)
+		{
+			continue;
+		}
+
+		uint32_t end = min(i + GrassChunkAlignment, chunk.BladeEnd);
+		bool settled = GrassSimulation::SimulateBlades(mBones, i, end, params, chunk.Lod);
+		settledSteps = settled ? settledSteps + 1 : 0;
+
+		if (settledSteps >= SleepSteps)
+		{
+			settledSteps = UINT32_MAX;
+			--chunk.DisturbedBlocks;
+		}
+	}
+}
+
+void GrassChunkSimulation::StepChunk(uint32_t chunkIndex, const GrassStepParams& params, bool calm)
+{
+	GrassChunk& chunk = mChunks[chunkIndex];
+
+	if (!calm)
+	{
+		Wake(chunk);
+	}
+
+	GrassStepParams chunkParams = params;
+	chunkParams.Colliders = chunk.ColliderCount > 0 ? &mColliderRefs[chunk.ColliderBegin] : nullptr;
+	chunkParams.ColliderCount = chunk.ColliderCount;
+
+	if (chunk.Asleep)
+	{
+		StepDisturbedBlocks(chunk, chunkParams);
+		return;
+	}
+
+	bool settled = false;
+	if (chunk.Lod == GrassLod::Sway)
+	{
+		settled = StepSwayChain(chunkIndex, params);
+		CopySwayChain(chunkIndex, true);
+	}
+	else
+	{
+		settled = GrassSimulation::SimulateBlades(mBones, chunk.BladeBegin, chunk.BladeEnd, chunkParams, chunk.Lod);
+	}
+
+	chunk.SettledSteps = settled ? chunk.SettledSteps + 1 : 0;
+	chunk.Asleep = calm && chunk.SettledSteps >= SleepSteps;
+}
+
+bool GrassChunkSimulation::StepSwayChain(uint32_t chunkIndex, const GrassStepParams& params)
+{
+	uint32_t bonesPerBlade = mBones.BonesPerBlade;
+	Bone* chain = &mSwayBones[(size_t)chunkIndex * bonesPerBlade];
+
+	GrassSimulation::SimulateBlade(chain, 0, 1, bonesPerBlade, params);
+
+	for (uint32_t level = 0; level < bonesPerBlade; ++level)
+	{
+		const Bone& bone = chain[level];
+		Float3 bend(bone.LocalRotation.x, bone.LocalRotation.y, bone.LocalRotation.z);
+
+		if (Length(bone.Velocity) > GrassSimulation::SleepSpeed || Length(bend) > GrassSimulation::SleepRotation)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void GrassChunkSimulation::SeedSwayChain(uint32_t chunkIndex, const Bone* seedBones)
+{
+	uint32_t bonesPerBlade = mBones.BonesPerBlade;
+	uint32_t blade = mChunks[chunkIndex].BladeBegin;
+	Bone* chain = &mSwayBones[(size_t)chunkIndex * bonesPerBlade];
+
+	if (seedBones)
+	{
+		const Bone* seed = &seedBones[(size_t)chunkIndex * bonesPerBlade];
+		for (uint32_t level = 0; level < bonesPerBlade; ++level)
+		{
+			chain[level] = seed[level];
+			chain[level].ParentIndex = (int)level - 1;
+		}
+		return;
+	}
+
+	for (uint32_t level = 0; level < bonesPerBlade; ++level)
+	{
+		size_t i = mBones.Index(level, blade);
+		Bone& bone = chain[level];
+
+		bone.Position = Float3(mBones.PositionX[i], mBones.PositionY[i], mBones.PositionZ[i]);
+		bone.Mass = mBones.Mass[i];
+		bone.Rotation = Float4(mBones.RotationX[i], mBones.RotationY[i], mBones.RotationZ[i], mBones.RotationW[i]);
+		bone.Velocity = Float3(mBones.VelocityX[i], mBones.VelocityY[i], mBones.VelocityZ[i]);
+		bone.Length = mBones.Length[i];
+		// The chain is laid out like a one-blade field.
+		bone.ParentIndex = (int)level - 1;
+		bone.LocalPosition = Float3(mBones.LocalPositionX[i], mBones.LocalPositionY[i], mBones.LocalPositionZ[i]);
+		bone.LocalRotation = Float4(mBones.LocalRotationX[i], mBones.LocalRotationY[i], mBones.LocalRotationZ[i], mBones.LocalRotationW[i]);
+	}
+}
+
+void GrassChunkSimulation::CopySwayChain(uint32_t chunkIndex, bool poseOnly)
+{
+	const GrassChunk& chunk = mChunks[chunkIndex];
+	uint32_t bonesPerBlade = mBones.BonesPerBlade;
+	const Bone* chain = &mSwayBones[(size_t)chunkIndex * bonesPerBlade];
+
+	for (uint32_t level = 0; level < bonesPerBlade; ++level)
+	{
+		const Bone& bone = chain[level];
+		size_t begin = mBones.Index(level, chunk.BladeBegin);
+		size_t end = mBones.Index(level, chunk.BladeEnd);
+
+		fill(&mBones.PositionX[begin], &mBones.PositionX[0] + end, bone.Position.x);
+		fill(&mBones.PositionY[begin], &mBones.PositionY[0] + end, bone.Position.y);
+		fill(&mBones.PositionZ[begin], &mBones.PositionZ[0] + end, bone.Position.z);
+		fill(&mBones.RotationX[begin], &mBones.RotationX[0] + end, bone.Rotation.x);
+		fill(&mBones.RotationY[begin], &mBones.RotationY[0] + end, bone.Rotation.y);
+		fill(&mBones.RotationZ[begin], &mBones.RotationZ[0] + end, bone.Rotation.z);
+		fill(&mBones.RotationW[begin], &mBones.RotationW[0] + end, bone.Rotation.w);
+
+		if (poseOnly)
+		{
+			continue;
+		}
+
+		fill(&mBones.VelocityX[begin], &mBones.VelocityX[0] + end, bone.Velocity.x);
+		fill(&mBones.VelocityY[begin], &mBones.VelocityY[0] + end, bone.Velocity.y);
+		fill(&mBones.VelocityZ[begin], &mBones.VelocityZ[0] + end, bone.Velocity.z);
+		fill(&mBones.LocalRotationX[begin], &mBones.LocalRotationX[0] + end, bone.LocalRotation.x);
+		fill(&mBones.LocalRotationY[begin], &mBones.LocalRotationY[0] + end, bone.LocalRotation.y);
+		fill(&mBones.LocalRotationZ[begin], &mBones.LocalRotationZ[0] + end, bone.LocalRotation.z);
+		fill(&mBones.LocalRotationW[begin], &mBones.LocalRotationW[0] + end, bone.LocalRotation.w);
+	}
+}
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "BoneSoA.h"
+#include "GrassColliders.h"
+#include "GrassSimulation.h"
+#include "SimMath.h"
+
+using namespace std;
+
+class ThreadPool;
+
+// Chunk boundaries are multiples of this many blades: one 64-byte cache line of each SoA
+// stream, which is also a whole number of SIMD groups. Neighbouring chunks therefore never
+// write the same cache line.
+const uint32_t GrassChunkAlignment = 16;
+
+// A contiguous range of blades that are also close together in space.
+struct GrassChunk
+{
+	uint32_t BladeBegin = 0;
+	uint32_t BladeEnd = 0;
+
+	Float3 BoundsMin;
+	Float3 BoundsMax;
+
+	// A chunk goes to sleep after SleepSteps consecutive steps in which every blade settled,
+	// and is skipped until wind or WakeRegion wakes it.
+	bool Asleep = false;
+	uint32_t SettledSteps = 0;
+
+	GrassLod Lod = GrassLod::Full;
+
+	// Range of GrassChunkSimulation::ColliderRefs() that can reach this chunk's blades.
+	uint32_t ColliderBegin = 0;
+	uint32_t ColliderCount = 0;
+
+	// Blocks of a sleeping chunk that a collider has reached. They are stepped on their own
+	// until they settle again, without waking the rest of the chunk.
+	uint32_t DisturbedBlocks = 0;
+};
+
+// Chunks closer to the eye than RootDistance simulate every bone, closer than SwayDistance
+// only the root, and the rest follow their chunk's sway chain.
+struct GrassLodDesc
+{
+	float RootDistance = 30.0f;
+	float SwayDistance = 80.0f;
+};
+
+// One compute thread group's work; must match struct ChunkDispatch in Grass.hlsl.
+struct GrassChunkDispatch
+{
+	uint32_t BladeBegin = 0;
+	uint32_t BladeEnd = 0;
+	uint32_t Lod = 0;
+	// Chunk index, used to find the sway chain of Sway chunks.
+	uint32_t SwayIndex = 0;
+	// Range of the frame's collider buffer that touches this chunk.
+	uint32_t ColliderBegin = 0;
+	uint32_t ColliderCount = 0;
+	uint32_t Pad[2] = {};
+};
+
+struct GrassStepStats
+{
+	uint32_t ActiveChunks = 0;
+	uint32_t SleepingChunks = 0;
+	size_t SimulatedBlades = 0;
+	size_t SkippedBlades = 0;
+
+	// Bones actually run through the integrator, the measure of LOD savings.
+	size_t IntegratedBones = 0;
+	uint32_t LodChunks[3] = {};
+
+	uint32_t CollidingChunks = 0;
+	// Blades of sleeping chunks stepped because a collider disturbed them.
+	size_t DisturbedBlades = 0;
+};
+
+class GrassChunking
+{
+public:
+	// Interleaves the low 16 bits of x and z.
+	static uint32_t MortonKey(uint32_t x, uint32_t z);
+
+	// Reorders blade roots along a Morton curve over cellSize cells so that any contiguous
+	// range of blades covers a compact area.
+	static void SortSpatially(vector<Float3>& roots, float cellSize);
+
+	// Cuts the (spatially sorted) blades into chunks of about bladesPerChunk blades.
+	static vector<GrassChunk> BuildChunks(const vector<Float3>& roots, uint32_t bladesPerChunk);
+};
+
+// Runs the SIMD bone kernel chunk by chunk. A blade's whole bone chain is integrated
+// root-to-tip inside its chunk's task, so chunks can run on any thread without locking.
+class GrassChunkSimulation
+{
+public:
+	static constexpr uint32_t SleepSteps = 30;
+	// Wind at or below this speed can't wake a settled chunk.
+	static constexpr float WakeWindSpeed = 0.01f;
+
+	void Initialize(const vector<Bone>& bones, uint32_t bonesPerBlade, const vector<Float3>& roots, uint32_t bladesPerChunk);
+
+	// pool may be null to step every chunk on the calling thread.
+	void Step(const GrassStepParams& params, ThreadPool* pool);
+
+	void CopyBones(Bone* bones) const { mBones.ToBones(bones); }
+	// Replaces every blade with bones laid out like CopyBones, e.g. what the GPU integrated
+	// while these were not stepped. Wakes every chunk and drops the saved pose.
+	void SetBones(const Bone* bones);
+
+	// Keeps the current pose for CopyBonesInterpolated; call it before the last step of a frame.
+	void SavePose() { mPreviousPose.CopyFrom(mBones); }
+	void CopyBonesInterpolated(Bone* bones, float alpha) const;
+
+	void SetSleepEnabled(bool enabled);
+	void WakeAll();
+	// Wakes every chunk whose blade roots overlap the box on the xz plane.
+	void WakeRegion(const Float3& boundsMin, const Float3& boundsMax);
+
+	// A chunk entering Sway LOD starts its chain from its first blade so the switch doesn't
+	// pop. When the blades are integrated elsewhere (on the GPU) the CPU bones are stale, so
+	// seedBones gives that blade per chunk instead, laid out like SwayBones().
+	void UpdateLod(const Float3& eye, const GrassLodDesc& desc, const Bone* seedBones = nullptr);
+
+	// Maps colliders to the blade blocks (GrassChunkAlignment blades) they can reach and
+	// copies them into ColliderRefs() chunk by chunk. In a sleeping chunk only the reached
+	// blocks are disturbed. Call after UpdateLod; Sway chunks ignore colliders.
+	void UpdateColliders(const vector<GrassCollider>& colliders);
+	const vector<GrassCollider>& ColliderRefs() const { return mColliderRefs; }
+
+	// Steps only the sway chains of Sway chunks, for when the blades themselves are
+	// integrated on the GPU.
+	void StepSwayChains(const GrassStepParams& params);
+	// Bones of every chunk's sway chain, BonesPerBlade per chunk, root first.
+	const vector<Bone>& SwayBones() const { return mSwayBones; }
+
+	// For when the blades are integrated on the GPU, which reports per chunk whether every
+	// blade ended its last step settled (settled is indexed by chunk, null when no report
+	// arrived). A Full or Root chunk goes to sleep after SleepSteps consecutive settled
+	// reports on calm steps; wind or a collider reaching it wakes it again. Call after
+	// UpdateColliders.
+	void UpdateGpuSleep(const uint32_t* settled, const GrassStepParams& params);
+
+	// Fills table with the awake Full and Root chunks first, then Sway chunks; sleeping
+	// chunks are left out. Returns the number of integrated chunks; swayCount entries of
+	// Sway chunks follow them.
+	uint32_t BuildDispatchTable(GrassChunkDispatch* table, uint32_t& swayCount) const;
+
+	const GrassStepStats& LastStepStats() const { return mStats; }
+	uint64_t StepCount() const { return mStepCount; }
+
+	uint32_t BladeCount() const { return mBones.BladeCount; }
+	uint32_t BonesPerBlade() const { return mBones.BonesPerBlade; }
+	size_t BoneCount() const { return mBones.BoneCount(); }
+
+	const BoneSoA& Bones() const { return mBones; }
+	const vector<GrassChunk>& Chunks() const { return mChunks; }
+
+private:
+	void Wake(GrassChunk& chunk);
+	void ClearDisturbedBlocks(GrassChunk& chunk);
+	void StepDisturbedBlocks(GrassChunk& chunk, const GrassStepParams& params);
+	void StepChunk(uint32_t chunkIndex, const GrassStepParams& params, bool calm);
+	bool StepSwayChain(uint32_t chunkIndex, const GrassStepParams& params);
+	void SeedSwayChain(uint32_t chunkIndex, const Bone* seedBones);
+	// poseOnly writes just position and rotation, which is all rendering reads; the full
+	// state is written when the chunk leaves Sway LOD.
+	void CopySwayChain(uint32_t chunkIndex, bool poseOnly);
+
+private:
+	BoneSoA mBones;
+	BonePoseSoA mPreviousPose;
+	vector<GrassChunk> mChunks;
+	vector<Bone> mSwayBones;
+
+	// Blocks of GrassChunkAlignment blades. The Morton order can jump across the field
+	// inside a block, so the hash holds compact runs of each block's blades, grown by the
+	// distance a blade can reach.
+	GrassSpatialHash mBlockHash;
+	vector<uint32_t> mHashBlocks;
+	vector<uint32_t> mBlockChunks;
+	// Consecutive settled steps of each disturbed block; UINT32_MAX when not disturbed.
+	vector<uint32_t> mBlockSettledSteps;
+
+	vector<GrassCollider> mColliderRefs;
+	vector<uint32_t> mColliderQuery;
+	// (chunk, collider, block) for every collider reaching a block.
+	vector<array<uint32_t, 3>> mColliderHits;
+	vector<array<uint32_t, 3>> mSortedHits;
+	vector<uint32_t> mChunkHitStart;
+
+	bool mSleepEnabled = true;
+	GrassStepStats mStats;
+	uint64_t mStepCount = 0;
+};
@@ -0,0 +1,161 @@
+#include "GrassColliders.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Buckets are kept at least this many times the number of (cell, item) pairs.
+	const uint32_t BucketsPerEntry = 2;
+}
+
+uint32_t GrassColliderRegistry::Add(const GrassCollider& collider)
+{
+	uint32_t id;
+	if (!mFreeIds.empty())
+	{
+		id = mFreeIds.back();
+		mFreeIds.pop_back();
+	}
+	else
+	{
+		id = (uint32_t)mSlots.size();
+		mSlots.push_back(0);
+	}
+
+	mSlots[id] = (uint32_t)mColliders.size();
+	mColliders.push_back(collider);
+	mIds.push_back(id);
+
+	return id;
+}
+
+void GrassColliderRegistry::Update(uint32_t id, const GrassCollider& collider)
+{
+	mColliders[mSlots[id]] = collider;
+}
+
+void GrassColliderRegistry::Remove(uint32_t id)
+{
+	uint32_t slot = mSlots[id];
+	uint32_t last = (uint32_t)mColliders.size() - 1;
+
+	mColliders[slot] = mColliders[last];
+	mIds[slot] = mIds[last];
+	mSlots[mIds[slot]] = slot;
+
+	mColliders.pop_back();
+	mIds.pop_back();
+	mFreeIds.push_back(id);
+}
+
+void GrassColliderRegistry::Bounds(const GrassCollider& collider, Float3& boundsMin, Float3& boundsMax)
+{
+	float r = collider.Radius;
+	boundsMin = Float3(min(collider.A.x, collider.B.x) - r, min(collider.A.y, collider.B.y) - r, min(collider.A.z, collider.B.z) - r);
+	boundsMax = Float3(max(collider.A.x, collider.B.x) + r, max(collider.A.y, collider.B.y) + r, max(collider.A.z, collider.B.z) + r);
+}
+
+int32_t GrassSpatialHash::Cell(float x) const
+{
+	return (int32_t)floorf(x * mInvCellSize);
+}
+
+uint32_t GrassSpatialHash::Bucket(int32_t cx, int32_t cz) const
+{
+	return (((uint32_t)cx * 73856093u) ^ ((uint32_t)cz * 19349663u)) & mBucketMask;
+}
+
+template <typename Body>
+void GrassSpatialHash::ForEachBucket(const Float3& boundsMin, const Float3& boundsMax, Body&& body) const
+{
+	int32_t x0 = Cell(boundsMin.x);
+	int32_t z0 = Cell(boundsMin.z);
+	int32_t x1 = Cell(boundsMax.x);
+	int32_t z1 = Cell(boundsMax.z);
+
+	for (int32_t cz = z0; cz <= z1; ++cz)
+	{
+		for (int32_t cx = x0; cx <= x1; ++cx)
+		{
+			body(Bucket(cx, cz));
+		}
+	}
+}
+
+void GrassSpatialHash::Build(const vector<Float3>& boundsMin, const vector<Float3>& boundsMax, float cellSize)
+{
+	assert(boundsMin.size() == boundsMax.size());
+
+	mCellSize = cellSize;
+	mInvCellSize = 1.0f / cellSize;
+	size_t itemCount = boundsMin.size();
+	mItemCount = itemCount;
+
+	// First pass sizes the table from the number of (cell, item) pairs.
+	size_t pairCount = 0;
+	for (size_t i = 0; i < itemCount; ++i)
+	{
+		ForEachBucket(boundsMin[i], boundsMax[i], [&pairCount](uint32_t) { ++pairCount; });
+	}
+
+	uint32_t bucketCount = 1;
+	while (bucketCount < pairCount * BucketsPerEntry)
+	{
+		bucketCount <<= 1;
+	}
+	mBucketMask = bucketCount - 1;
+
+	// Counting sort of the pairs by bucket.
+	mBucketStart.assign((size_t)bucketCount + 1, 0);
+	mEntries.resize(pairCount);
+
+	for (size_t i = 0; i < itemCount; ++i)
+	{
+		ForEachBucket(boundsMin[i], boundsMax[i], [this](uint32_t bucket) { ++mBucketStart[bucket + 1]; });
+	}
+
+	for (uint32_t b = 0; b < bucketCount; ++b)
+	{
+		mBucketStart[b + 1] += mBucketStart[b];
+	}
+
+	vector<uint32_t> cursor(mBucketStart.begin(), mBucketStart.end() - 1);
+	for (size_t i = 0; i < itemCount; ++i)
+	{
+		Entry entry = { boundsMin[i], (uint32_t)i, boundsMax[i] };
+		ForEachBucket(boundsMin[i], boundsMax[i], [this, &cursor, &entry](uint32_t bucket) { mEntries[cursor[bucket]++] = entry; });
+	}
+}
+
+void GrassSpatialHash::Query(const Float3& boundsMin, const Float3& boundsMax, vector<uint32_t>& indices) const
+{
+	if (mEntries.empty())
+	{
+		return;
+	}
+
+	size_t first = indices.size();
+
+	ForEachBucket(boundsMin, boundsMax, [&](uint32_t bucket)
+		{
+			for (uint32_t e = mBucketStart[bucket]; e < mBucketStart[bucket + 1]; ++e)
+			{
+				const Entry& entry = mEntries[e];
+
+				// Buckets are shared by unrelated cells, so test the real bounds.
+				if (entry.BoundsMax.x < boundsMin.x || entry.BoundsMin.x > boundsMax.x ||
+					entry.BoundsMax.y < boundsMin.y || entry.BoundsMin.y > boundsMax.y ||
+					entry.BoundsMax.z < boundsMin.z || entry.BoundsMin.z > boundsMax.z)
+				{
+					continue;
+				}
+
+				indices.push_back(entry.Item);
+			}
+		});
+
+	// An item covering several of the queried cells was found once per cell.
+	sort(indices.begin() + first, indices.end());
+	indices.erase(unique(indices.begin() + first, indices.end()), indices.end());
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "SimMath.h"
+
+using namespace std;
+
+// Collider references copied into a frame's dispatch, CPU and GPU alike; the rest are dropped.
+const uint32_t GrassMaxColliderRefs = 8192;
+
+// A capsule from A to B; a sphere when A == B. Must match struct Collider in Grass.hlsl.
+struct GrassCollider
+{
+	Float3 A;
+	float Radius = 0.0f;
+	Float3 B;
+	float Pad = 0.0f;
+};
+
+static_assert(sizeof(GrassCollider) == 32, "GrassCollider must match the structured buffer stride used by Grass.hlsl");
+
+// Colliders that push grass (the camera, characters, props). Ids stay valid until removed;
+// Colliders() is dense and its order changes on Remove.
+class GrassColliderRegistry
+{
+public:
+	uint32_t Add(const GrassCollider& collider);
+	void Update(uint32_t id, const GrassCollider& collider);
+	void Remove(uint32_t id);
+
+	const vector<GrassCollider>& Colliders() const { return mColliders; }
+
+	static void Bounds(const GrassCollider& collider, Float3& boundsMin, Float3& boundsMax);
+
+private:
+	vector<GrassCollider> mColliders;
+	// Dense slot of each id, and id of each slot.
+	vector<uint32_t> mSlots;
+	vector<uint32_t> mIds;
+	vector<uint32_t> mFreeIds;
+};
+
+// Uniform grid over the xz plane, hashed into a fixed table so the world needs no bounds.
+// Items are boxes; Build is a counting sort of (cell, item) pairs and a query walks the cells
+// under a box and tests the items it finds there. Both cost one step per cell covered, so
+// the cell size should be close to the size of the items and of the query boxes.
+class GrassSpatialHash
+{
+public:
+	void Build(const vector<Float3>& boundsMin, const vector<Float3>& boundsMax, float cellSize);
+
+	// Appends, in ascending order and once each, every item whose bounds overlap the box.
+	// Safe to call from several threads at once.
+	void Query(const Float3& boundsMin, const Float3& boundsMax, vector<uint32_t>& indices) const;
+
+	size_t ItemCount() const { return mItemCount; }
+	float CellSize() const { return mCellSize; }
+
+private:
+	uint32_t Bucket(int32_t cx, int32_t cz) const;
+	int32_t Cell(float x) const;
+
+	template <typename Body>
+	void ForEachBucket(const Float3& boundsMin, const Float3& boundsMax, Body&& body) const;
+
+private:
+	float mCellSize = 1.0f;
+	float mInvCellSize = 1.0f;
+	uint32_t mBucketMask = 0;
+
+	size_t mItemCount = 0;
+
+	// Bounds are copied into every entry so a query touches no memory outside the bucket.
+	struct Entry
+	{
+		Float3 BoundsMin;
+		uint32_t Item;
+		Float3 BoundsMax;
+	};
+
+	// Entries of bucket b are mEntries[mBucketStart[b] .. mBucketStart[b + 1]).
+	vector<uint32_t> mBucketStart;
+	vector<Entry> mEntries;
+};
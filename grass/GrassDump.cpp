@@ -0,0 +1,178 @@
+#include "GrassDump.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	const uint32_t DumpMagic = 0x42535247; // "GRSB"
+	const uint32_t DumpVersion = 1;
+
+	struct DumpHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t BladeCount;
+		uint32_t BonesPerBlade;
+		uint32_t StepCount;
+		float DeltaTime;
+		Float3 WindVelocity;
+	};
+
+	const int FloatsPerBone = sizeof(Bone) / sizeof(float);
+	const int ParentIndexSlot = offsetof(Bone, ParentIndex) / sizeof(float);
+}
+
+bool GrassDumpUtil::Write(const string& filename, const GrassDump& dump)
+{
+	ofstream fout(filename, ios::binary);
+
+	if (!fout)
+	{
+		return false;
+	}
+
+	DumpHeader header;
+	header.Magic = DumpMagic;
+	header.Version = DumpVersion;
+	header.BladeCount = dump.BladeCount;
+	header.BonesPerBlade = dump.BonesPerBlade;
+	header.StepCount = dump.StepCount;
+	header.DeltaTime = dump.DeltaTime;
+	header.WindVelocity = dump.WindVelocity;
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(dump.Bones.data()), dump.Bones.size() * sizeof(Bone));
+
+	return (bool)fout;
+}
+
+bool GrassDumpUtil::Read(const string& filename, GrassDump& dump)
+{
+	ifstream fin(filename, ios::binary);
+
+	if (!fin)
+	{
+		return false;
+	}
+
+	DumpHeader header;
+	fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!fin || header.Magic != DumpMagic || header.Version != DumpVersion)
+	{
+		return false;
+	}
+
+	dump.BladeCount = header.BladeCount;
+	dump.BonesPerBlade = header.BonesPerBlade;
+	dump.StepCount = header.StepCount;
+	dump.DeltaTime = header.DeltaTime;
+	dump.WindVelocity = header.WindVelocity;
+
+	dump.Bones.resize((size_t)header.BladeCount * header.BonesPerBlade);
+	fin.read(reinterpret_cast<char*>(dump.Bones.data()), dump.Bones.size() * sizeof(Bone));
+
+	return (bool)fin;
+}
+
+GrassDumpDiff GrassDumpUtil::Compare(const GrassDump& expected, const GrassDump& actual, uint32_t maxUlps)
+{
+	GrassDumpDiff diff;
+
+	if (expected.BladeCount != actual.BladeCount ||
+		expected.BonesPerBlade != actual.BonesPerBlade ||
+		expected.Bones.size() != actual.Bones.size())
+	{
+		diff.LayoutMatches = false;
+		return diff;
+	}
+
+	for (size_t i = 0; i < expected.Bones.size(); ++i)
+	{
+		float e[FloatsPerBone];
+		float a[FloatsPerBone];
+		memcpy(e, &expected.Bones[i], sizeof(Bone));
+		memcpy(a, &actual.Bones[i], sizeof(Bone));
+
+		for (int k = 0; k < FloatsPerBone; ++k)
+		{
+			uint32_t distance = 0;
+
+			if (k == ParentIndexSlot)
+			{
+				distance = expected.Bones[i].ParentIndex == actual.Bones[i].ParentIndex ? 0 : UINT32_MAX;
+			}
+			else
+			{
+				distance = UlpDistance(e[k], a[k]);
+				// A NaN on either side counts as an infinite error.
+				float error = distance == UINT32_MAX ? INFINITY : fabsf(e[k] - a[k]);
+				diff.MaxAbsError = max(diff.MaxAbsError, error);
+			}
+
+			if (distance > diff.MaxUlpDistance)
+			{
+				diff.MaxUlpDistance = distance;
+			}
+
+			if (distance > maxUlps)
+			{
+				if (diff.MismatchedFloats == 0)
+				{
+					diff.FirstMismatchedBone = i;
+				}
+				++diff.MismatchedFloats;
+			}
+		}
+	}
+
+	return diff;
+}
+
+uint32_t GrassDumpUtil::UlpDistance(float a, float b)
+{
+	if (a != a || b != b)
+	{
+		return UINT32_MAX;
+	}
+
+	int32_t ia;
+	int32_t ib;
+	memcpy(&ia, &a, sizeof(float));
+	memcpy(&ib, &b, sizeof(float));
+
+	// Map the sign-magnitude encoding onto a monotonic integer line so +0 and -0 are adjacent.
+	if (ia < 0)
+	{
+		ia = INT32_MIN - ia;
+	}
+	if (ib < 0)
+	{
+		ib = INT32_MIN - ib;
+	}
+
+	int64_t d = (int64_t)ia - (int64_t)ib;
+	return (uint32_t)(d < 0 ? -d : d);
+}
+
+GrassDump GrassDumpUtil::Replay(const GrassDump& start, uint32_t steps, float deltaTime, const Float3& wind)
+{
+	GrassDump dump = start;
+	dump.StepCount = steps;
+	dump.DeltaTime = deltaTime;
+	dump.WindVelocity = wind;
+
+	GrassStepParams params;
+	params.WindVelocity = wind;
+	params.DeltaTime = deltaTime;
+
+	for (uint32_t i = 0; i < steps; ++i)
+	{
+		GrassSimulation::Simulate(dump.Bones, dump.BladeCount, dump.BonesPerBlade, params);
+	}
+
+	return dump;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GrassSimulation.h"
+
+using namespace std;
+
+// Raw snapshot of a bone buffer. The payload is the structured buffer contents exactly
+// as the GPU sees them; BaseApp's GPU check writes readbacks of mGrassBuffer in this format.
+// StepCount, DeltaTime and WindVelocity say how the bones were stepped from their start:
+// the rest pose for the golden scenario, the dump taken before the steps for a GPU check.
+struct GrassDump
+{
+	uint32_t BladeCount = 0;
+	uint32_t BonesPerBlade = 0;
+	uint32_t StepCount = 0;
+	float DeltaTime = 0.0f;
+	Float3 WindVelocity;
+
+	vector<Bone> Bones;
+};
+
+struct GrassDumpDiff
+{
+	size_t MismatchedFloats = 0;
+	size_t FirstMismatchedBone = 0;
+	uint32_t MaxUlpDistance = 0;
+	// Largest absolute difference; ulps blow up for values near zero, this does not.
+	float MaxAbsError = 0.0f;
+	bool LayoutMatches = true;
+
+	bool Matches() const { return LayoutMatches && MismatchedFloats == 0; }
+};
+
+class GrassDumpUtil
+{
+public:
+	static bool Write(const string& filename, const GrassDump& dump);
+	static bool Read(const string& filename, GrassDump& dump);
+
+	// Compares every float in the two bone buffers; values further apart than maxUlps
+	// (0 means bit-exact) are counted as mismatches. ParentIndex must match exactly.
+	static GrassDumpDiff Compare(const GrassDump& expected, const GrassDump& actual, uint32_t maxUlps = 0);
+
+	static uint32_t UlpDistance(float a, float b);
+
+	// start's bones stepped on the CPU reference with a constant wind; the result's header
+	// records the steps. This is what a GPU run of the same steps is checked against.
+	static GrassDump Replay(const GrassDump& start, uint32_t steps, float deltaTime, const Float3& wind);
+};
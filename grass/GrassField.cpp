@@ -0,0 +1,71 @@
+#include "GrassField.h"
+#include "GrassChunks.h"
+#include <random>
+
+bool GrassFieldUtil::IsValid(const GrassFieldDesc& desc)
+{
+	return desc.BladeCount > 0 &&
+		desc.BonesPerBlade > 0 &&
+		desc.BonesPerBlade <= GrassMaxBonesPerBlade &&
+		desc.BoneLength > 0.0f &&
+		desc.BoneMass > 0.0f &&
+		BoneCount(desc) <= INT32_MAX;
+}
+
+vector<Float3> GrassFieldUtil::BuildRoots(const GrassFieldDesc& desc, uint32_t seed)
+{
+	minstd_rand generator(seed);
+	uniform_real_distribution<float> distribution(-0.5f * desc.FieldSize, 0.5f * desc.FieldSize);
+
+	vector<Float3> roots(desc.BladeCount);
+	for (auto& root : roots)
+	{
+		float x = distribution(generator);
+		float z = distribution(generator);
+		root = Float3(x, 0.0f, z);
+	}
+
+	// Blade i owns bone column i, so sorting keeps each simulation chunk compact. Aim for a
+	// handful of blades per cell.
+	float cellSize = desc.FieldSize / sqrtf((float)desc.BladeCount / 4.0f + 1.0f);
+	GrassChunking::SortSpatially(roots, cellSize);
+
+	return roots;
+}
+
+vector<GrassVertex> GrassFieldUtil::BuildVertices(const GrassFieldDesc& desc, const vector<Float3>& roots)
+{
+	vector<GrassVertex> vertices(roots.size());
+
+	for (size_t i = 0; i < roots.size(); ++i)
+	{
+		vertices[i].Pos = roots[i];
+		vertices[i].Width = desc.BladeWidth;
+		vertices[i].Height = desc.BoneLength * desc.BonesPerBlade;
+	}
+
+	return vertices;
+}
+
+vector<uint32_t> GrassFieldUtil::BuildIndices(const GrassFieldDesc& desc)
+{
+	vector<uint32_t> indices(desc.BladeCount);
+
+	for (uint32_t i = 0; i < desc.BladeCount; ++i)
+	{
+		indices[i] = i;
+	}
+
+	return indices;
+}
+
+vector<pair<string, string>> GrassFieldUtil::ShaderDefines(const GrassFieldDesc& desc)
+{
+	return
+	{
+		{ "BLADE_COUNT", to_string(desc.BladeCount) },
+		{ "BONES_PER_BLADE", to_string(desc.BonesPerBlade) },
+		{ "GRASS_GROUP_SIZE", to_string(GrassThreadGroupSize) },
+		{ "GRASS_MAX_VERTEX_COUNT", to_string(MaxVertexCount(desc)) },
+	};
+}
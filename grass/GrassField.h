@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "SimMath.h"
+
+using namespace std;
+
+// Threads per group of the bone compute shader (GRASS_GROUP_SIZE in Grass.hlsl). Each group
+// walks one chunk's blades with this stride.
+const uint32_t GrassThreadGroupSize = 64;
+
+// The grass GS emits 2 + 2 * bonesPerBlade vertices of 13 floats each and D3D caps a GS
+// invocation at 1024 output scalars.
+const uint32_t GrassMaxBonesPerBlade = 38;
+
+// Everything that sizes a grass field. Buffer sizes, the index list, the dispatch size and
+// the shader defines are all derived from one of these so they can't drift apart.
+struct GrassFieldDesc
+{
+	uint32_t BladeCount = 32;
+	uint32_t BonesPerBlade = 5;
+	float BoneLength = 0.3f;
+	float BoneMass = 1.0f;
+
+	float BladeWidth = 0.1f;
+	// Blades are scattered over a FieldSize x FieldSize square centred on the origin.
+	float FieldSize = 10.0f;
+
+	uint32_t BladesPerChunk = 1024;
+};
+
+// Matches mGrassInputLayout: POSITION at 0, SIZE at 12.
+struct GrassVertex
+{
+	Float3 Pos;
+	float Width = 0.0f;
+	float Height = 0.0f;
+};
+
+class GrassFieldUtil
+{
+public:
+	static bool IsValid(const GrassFieldDesc& desc);
+
+	static size_t BoneCount(const GrassFieldDesc& desc) { return (size_t)desc.BladeCount * desc.BonesPerBlade; }
+	static uint32_t MaxVertexCount(const GrassFieldDesc& desc) { return 2 + 2 * desc.BonesPerBlade; }
+
+	// Uniformly scattered, spatially sorted blade roots on the y = 0 plane.
+	static vector<Float3> BuildRoots(const GrassFieldDesc& desc, uint32_t seed);
+	static vector<GrassVertex> BuildVertices(const GrassFieldDesc& desc, const vector<Float3>& roots);
+	static vector<uint32_t> BuildIndices(const GrassFieldDesc& desc);
+
+	// Name/value pairs for the #defines Grass.hlsl expects.
+	static vector<pair<string, string>> ShaderDefines(const GrassFieldDesc& desc);
+};
@@ -0,0 +1,325 @@
+#include "GrassScatter.h"
+#include "GrassChunks.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <random>
+
+namespace
+{
+	// Candidates tried around each active sample before it is retired (Bridson's k).
+	const uint32_t PoissonCandidates = 30;
+	const float Pi = 3.14159265f;
+
+	uint32_t HashUInt(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// Uniform in [0, 1).
+	float HashUnit(uint32_t x)
+	{
+		return (float)(HashUInt(x) >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float WrapDelta(float d, float size)
+	{
+		if (d > 0.5f * size)
+		{
+			return d - size;
+		}
+		if (d < -0.5f * size)
+		{
+			return d + size;
+		}
+		return d;
+	}
+}
+
+float GrassDensityMap::Sample(float x, float z) const
+{
+	if (Values.empty())
+	{
+		return 1.0f;
+	}
+
+	float invCellSize = 1.0f / CellSize;
+
+	float u = min(max((x - OriginX) * invCellSize, 0.0f), (float)(Width - 1));
+	float v = min(max((z - OriginZ) * invCellSize, 0.0f), (float)(Height - 1));
+
+	uint32_t i0 = min((uint32_t)u, Width - 2);
+	uint32_t j0 = min((uint32_t)v, Height - 2);
+	float fu = u - i0;
+	float fv = v - j0;
+
+	size_t n00 = (size_t)j0 * Width + i0;
+	size_t n01 = n00 + Width;
+
+	float d0 = Values[n00] + (Values[n00 + 1] - Values[n00]) * fu;
+	float d1 = Values[n01] + (Values[n01 + 1] - Values[n01]) * fu;
+
+	return d0 + (d1 - d0) * fv;
+}
+
+void GrassScatter::Initialize(float minSpacing, uint32_t seed)
+{
+	assert(minSpacing > 0.0f);
+
+	mMinSpacing = minSpacing;
+	mTileSize = minSpacing * PatternCells;
+	mSeed = seed;
+	mPattern.clear();
+
+	// Background grid with cells small enough to hold at most one sample.
+	uint32_t gridSize = (uint32_t)ceilf(mTileSize / (minSpacing * 0.70710678f));
+	float cellSize = mTileSize / gridSize;
+	vector<int32_t> grid((size_t)gridSize * gridSize, -1);
+
+	minstd_rand generator(seed);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	auto cellOf = [&](float p) { return min((uint32_t)(p / cellSize), gridSize - 1); };
+
+	auto fits = [&](float x, float z)
+	{
+		int32_t cx = (int32_t)cellOf(x);
+		int32_t cz = (int32_t)cellOf(z);
+
+		// The tile wraps, so neighbours are looked up modulo the grid.
+		for (int32_t dz = -2; dz <= 2; ++dz)
+		{
+			for (int32_t dx = -2; dx <= 2; ++dx)
+			{
+				uint32_t nx = (uint32_t)(cx + dx + (int32_t)gridSize) % gridSize;
+				uint32_t nz = (uint32_t)(cz + dz + (int32_t)gridSize) % gridSize;
+				int32_t other = grid[(size_t)nz * gridSize + nx];
+
+				if (other >= 0)
+				{
+					float ox = WrapDelta(mPattern[other].X - x, mTileSize);
+					float oz = WrapDelta(mPattern[other].Z - z, mTileSize);
+					if (ox * ox + oz * oz < minSpacing * minSpacing)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		return true;
+	};
+
+	auto insert = [&](float x, float z)
+	{
+		grid[(size_t)cellOf(z) * gridSize + cellOf(x)] = (int32_t)mPattern.size();
+		mPattern.push_back({ x, z });
+	};
+
+	insert(unit(generator) * mTileSize, unit(generator) * mTileSize);
+	vector<uint32_t> active = { 0 };
+
+	while (!active.empty())
+	{
+		size_t slot = min((size_t)(unit(generator) * active.size()), active.size() - 1);
+		PatternPoint origin = mPattern[active[slot]];
+		bool found = false;
+
+		for (uint32_t k = 0; k < PoissonCandidates; ++k)
+		{
+			float angle = unit(generator) * 2.0f * Pi;
+			float radius = minSpacing * (1.0f + unit(generator));
+			float x = fmodf(origin.X + radius * cosf(angle) + mTileSize, mTileSize);
+			float z = fmodf(origin.Z + radius * sinf(angle) + mTileSize, mTileSize);
+
+			if (fits(x, z))
+			{
+				active.push_back((uint32_t)mPattern.size());
+				insert(x, z);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			active[slot] = active.back();
+			active.pop_back();
+		}
+	}
+
+	// Morton order over minSpacing cells, so each tile comes out spatially sorted.
+	float invSpacing = 1.0f / minSpacing;
+	sort(mPattern.begin(), mPattern.end(), [invSpacing](const PatternPoint& a, const PatternPoint& b)
+	{
+		uint32_t ka = GrassChunking::MortonKey(min((uint32_t)(a.X * invSpacing), PatternCells - 1), min((uint32_t)(a.Z * invSpacing), PatternCells - 1));
+		uint32_t kb = GrassChunking::MortonKey(min((uint32_t)(b.X * invSpacing), PatternCells - 1), min((uint32_t)(b.Z * invSpacing), PatternCells - 1));
+		return ka < kb;
+	});
+}
+
+void GrassScatter::ScatterTile(const GrassScatterDesc& desc, int32_t tileX, int32_t tileZ, vector<Float3>& roots) const
+{
+	// The tile's corner relative to the region's origin; the pattern stays in float.
+	float originX = (float)((double)tileX * mTileSize - desc.OriginX);
+	float originZ = (float)((double)tileZ * mTileSize - desc.OriginZ);
+	float minSlopeY = cosf(min(max(desc.MaxSlopeDegrees, 0.0f), 90.0f) * (Pi / 180.0f));
+	bool checkSlope = (desc.Normal != nullptr || desc.NormalBatch != nullptr) && desc.MaxSlopeDegrees < 90.0f;
+	bool batchSlope = checkSlope && desc.NormalBatch != nullptr;
+	bool batchHeight = desc.HeightBatch != nullptr;
+
+	// World positions of the roots left for the batch functions, from the end of roots.
+	vector<float> batchX;
+	vector<float> batchZ;
+
+	roots.reserve(mPattern.size());
+
+	uint32_t tileHash = HashUInt((uint32_t)tileX ^ HashUInt((uint32_t)tileZ ^ HashUInt(mSeed)));
+
+	for (uint32_t i = 0; i < (uint32_t)mPattern.size(); ++i)
+	{
+		float x = originX + mPattern[i].X;
+		float z = originZ + mPattern[i].Z;
+
+		if (x < desc.MinX || x >= desc.MaxX || z < desc.MinZ || z >= desc.MaxZ)
+		{
+			continue;
+		}
+
+		// The maps and terrain are sampled in world coordinates.
+		float worldX = (float)(desc.OriginX + x);
+		float worldZ = (float)(desc.OriginZ + z);
+
+		// Thinning by an independent coin per point keeps what's left at least minSpacing apart.
+		if (desc.Density != nullptr && HashUnit(tileHash + i) >= desc.Density->Sample(worldX, worldZ))
+		{
+			continue;
+		}
+
+		if (checkSlope && !batchSlope && desc.Normal(worldX, worldZ).y < minSlopeY)
+		{
+			continue;
+		}
+
+		float y = !batchHeight && desc.Height != nullptr ? desc.Height(worldX, worldZ) : 0.0f;
+		roots.push_back(Float3(x, y, z));
+
+		if (batchSlope || batchHeight)
+		{
+			batchX.push_back(worldX);
+			batchZ.push_back(worldZ);
+		}
+	}
+
+	if (batchX.empty())
+	{
+		return;
+	}
+
+	size_t count = batchX.size();
+	size_t first = roots.size() - count;
+	vector<float> heights(batchHeight ? count : 0);
+	vector<float> normalX(batchSlope ? count : 0);
+	vector<float> normalY(batchSlope ? count : 0);
+	vector<float> normalZ(batchSlope ? count : 0);
+
+	if (batchSlope)
+	{
+		desc.NormalBatch(batchX.data(), batchZ.data(), count, normalX.data(), normalY.data(), normalZ.data());
+	}
+	if (batchHeight)
+	{
+		desc.HeightBatch(batchX.data(), batchZ.data(), count, heights.data());
+	}
+
+	size_t kept = first;
+	for (size_t k = 0; k < count; ++k)
+	{
+		if (batchSlope && normalY[k] < minSlopeY)
+		{
+			continue;
+		}
+
+		Float3 root = roots[first + k];
+		root.y = batchHeight ? heights[k] : root.y;
+		roots[kept++] = root;
+	}
+	roots.resize(kept);
+}
+
+vector<Float3> GrassScatter::Scatter(const GrassScatterDesc& desc, ThreadPool* threadPool) const
+{
+	assert(!mPattern.empty());
+
+	if (desc.MaxX <= desc.MinX || desc.MaxZ <= desc.MinZ)
+	{
+		return {};
+	}
+
+	int32_t tileMinX = (int32_t)floor((desc.OriginX + desc.MinX) / mTileSize);
+	int32_t tileMinZ = (int32_t)floor((desc.OriginZ + desc.MinZ) / mTileSize);
+	uint32_t tilesX = (uint32_t)((int32_t)ceil((desc.OriginX + desc.MaxX) / mTileSize) - tileMinX);
+	uint32_t tilesZ = (uint32_t)((int32_t)ceil((desc.OriginZ + desc.MaxZ) / mTileSize) - tileMinZ);
+
+	// Visit tiles in Morton order; with each tile already sorted, the output is too.
+	vector<pair<uint32_t, uint32_t>> tiles((size_t)tilesX * tilesZ);
+	for (uint32_t z = 0; z < tilesZ; ++z)
+	{
+		for (uint32_t x = 0; x < tilesX; ++x)
+		{
+			tiles[(size_t)z * tilesX + x] = { GrassChunking::MortonKey(x, z), z * tilesX + x };
+		}
+	}
+	sort(tiles.begin(), tiles.end());
+
+	vector<vector<Float3>> tileRoots(tiles.size());
+	auto scatterTile = [&](uint32_t t)
+	{
+		uint32_t tile = tiles[t].second;
+		ScatterTile(desc, tileMinX + (int32_t)(tile % tilesX), tileMinZ + (int32_t)(tile / tilesX), tileRoots[t]);
+	};
+
+	if (threadPool != nullptr)
+	{
+		threadPool->ParallelFor((uint32_t)tiles.size(), scatterTile);
+	}
+	else
+	{
+		for (uint32_t t = 0; t < (uint32_t)tiles.size(); ++t)
+		{
+			scatterTile(t);
+		}
+	}
+
+	vector<size_t> offsets(tiles.size() + 1, 0);
+	for (size_t t = 0; t < tiles.size(); ++t)
+	{
+		offsets[t + 1] = offsets[t] + tileRoots[t].size();
+	}
+
+	vector<Float3> roots(offsets.back());
+	auto copyTile = [&](uint32_t t)
+	{
+		copy(tileRoots[t].begin(), tileRoots[t].end(), roots.begin() + offsets[t]);
+		vector<Float3>().swap(tileRoots[t]);
+	};
+
+	if (threadPool != nullptr)
+	{
+		threadPool->ParallelFor((uint32_t)tiles.size(), copyTile);
+	}
+	else
+	{
+		for (uint32_t t = 0; t < (uint32_t)tiles.size(); ++t)
+		{
+			copyTile(t);
+		}
+	}
+
+	return roots;
+}
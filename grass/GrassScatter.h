@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "SimMath.h"
+
+using namespace std;
+
+class ThreadPool;
+
+// Blade density in [0, 1] over the xz plane: 1 keeps every blade the Poisson pattern offers,
+// 0 keeps none. Values are row-major, Width nodes per row, node (0, 0) at (OriginX, OriginZ).
+// Both sizes must be >= 2 unless Values is empty.
+struct GrassDensityMap
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	float OriginX = 0.0f;
+	float OriginZ = 0.0f;
+	float CellSize = 1.0f;
+	vector<float> Values;
+
+	// Bilinear, clamped at the edges. An empty map is 1 everywhere.
+	float Sample(float x, float z) const;
+};
+
+typedef float (*GrassHeightFunc)(float x, float z);
+typedef Float3 (*GrassNormalFunc)(float x, float z);
+typedef void (*GrassHeightBatchFunc)(const float* x, const float* z, size_t count, float* heights);
+typedef void (*GrassNormalBatchFunc)(const float* x, const float* z, size_t count, float* normalX, float* normalY,
+	float* normalZ);
+
+struct GrassScatterDesc
+{
+	// Blades are generated in [MinX, MaxX) x [MinZ, MaxZ) relative to (OriginX, OriginZ),
+	// and the roots come out relative to it too, so a region far from the world origin keeps
+	// float precision. Regions scattered with the same GrassScatter join up seamlessly,
+	// whatever their origins.
+	double OriginX = 0.0;
+	double OriginZ = 0.0;
+	float MinX = -5.0f;
+	float MinZ = -5.0f;
+	float MaxX = 5.0f;
+	float MaxZ = 5.0f;
+
+	// Optional; null means no thinning.
+	const GrassDensityMap* Density = nullptr;
+
+	// Optional terrain. Roots are snapped to Height (y = 0 without it), and blades where
+	// Normal is steeper than MaxSlopeDegrees are dropped.
+	GrassHeightFunc Height = nullptr;
+	GrassNormalFunc Normal = nullptr;
+	// Optional batch forms (e.g. LandUtility::GetHillsHeights), used instead of the above
+	// over all of a tile's surviving blades at once.
+	GrassHeightBatchFunc HeightBatch = nullptr;
+	GrassNormalBatchFunc NormalBatch = nullptr;
+	float MaxSlopeDegrees = 90.0f;
+};
+
+// Blue-noise blade placement. Initialize builds one toroidal Poisson-disk pattern with
+// Bridson's algorithm; Scatter repeats it over the world in square tiles, so tiles are
+// independent and run in parallel while no two blades, even across tile edges, are closer
+// than the spacing. The density map thins each tile with a per-tile hash, so the pattern
+// only visibly repeats where the density is 1.
+class GrassScatter
+{
+public:
+	// The pattern tile is PatternCells * minSpacing on a side.
+	static constexpr uint32_t PatternCells = 64;
+
+	void Initialize(float minSpacing, uint32_t seed);
+
+	// Roots in Morton order over the tiles and over minSpacing cells inside each tile, so
+	// contiguous ranges are spatially compact (as GrassChunking::SortSpatially would give).
+	vector<Float3> Scatter(const GrassScatterDesc& desc, ThreadPool* threadPool = nullptr) const;
+
+	float MinSpacing() const { return mMinSpacing; }
+	float TileSize() const { return mTileSize; }
+	size_t PointsPerTile() const { return mPattern.size(); }
+	// Blades per square metre where the density is 1 and the terrain is flat.
+	float MaxDensity() const { return (float)mPattern.size() / (mTileSize * mTileSize); }
+
+private:
+	struct PatternPoint
+	{
+		float X;
+		float Z;
+	};
+
+	void ScatterTile(const GrassScatterDesc& desc, int32_t tileX, int32_t tileZ, vector<Float3>& roots) const;
+
+private:
+	float mMinSpacing = 0.0f;
+	float mTileSize = 0.0f;
+	uint32_t mSeed = 0;
+	// Offsets inside the tile, in Morton order.
+	vector<PatternPoint> mPattern;
+};
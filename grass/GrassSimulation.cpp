@@ -0,0 +1,474 @@
+#include "GrassSimulation.h"
+#include "BoneSoA.h"
+#include "GrassColliders.h"
+#include "SimdMath.h"
+#include "WindField.h"
+#include <algorithm>
+#include <cassert>
+
+// Capsule axes shorter than this are treated as spheres, and tips closer to the axis than
+// this have no direction to be pushed in.
+static const float CollisionEpsilon = 1e-8f;
+
+static Float3 BoneTip(const Bone& bone, const Float3& rootWorld)
+{
+	const Float3 upVec(0.0f, 1.0f, 0.0f);
+	Float3 oUpVec = Normalize(QuaternionRotateOptimized(bone.Rotation, upVec));
+	return rootWorld + bone.Position + oUpVec * bone.Length;
+}
+
+vector<Bone> GrassSimulation::BuildBones(uint32_t bladeCount, uint32_t bonesPerBlade, float boneLength, float boneMass)
+{
+	vector<Bone> bones((size_t)bladeCount * bonesPerBlade);
+
+	for (uint32_t i = 0; i < bonesPerBlade; ++i)
+	{
+		for (uint32_t j = 0; j < bladeCount; ++j)
+		{
+			size_t index = (size_t)i * bladeCount + j;
+
+			bones[index].Position = Float3(0.0f, 0.0f, 0.0f);
+			bones[index].Rotation = Float4(0.0f, 0.0f, 0.0f, 1.0f);
+			bones[index].Velocity = Float3(0.0f, 0.0f, 0.0f);
+			bones[index].LocalPosition = Float3(0.0f, 0.0f, 0.0f);
+			bones[index].LocalRotation = Float4(0.0f, 0.0f, 0.0f, 1.0f);
+			bones[index].Mass = boneMass;
+			bones[index].Length = boneLength;
+			bones[index].ParentIndex = i == 0 ? -1 : (int)((i - 1) * bladeCount + j);
+		}
+	}
+
+	return bones;
+}
+
+void GrassSimulation::SetBladeRoots(vector<Bone>& bones, const vector<Float3>& roots)
+{
+	assert(roots.size() <= bones.size());
+
+	for (size_t i = 0; i < roots.size(); ++i)
+	{
+		bones[i].LocalPosition = roots[i];
+	}
+}
+
+Float3 GrassSimulation::CollisionForce(const Float3& tip, const GrassCollider* colliders, uint32_t colliderCount)
+{
+	Float3 force(0.0f, 0.0f, 0.0f);
+
+	for (uint32_t c = 0; c < colliderCount; ++c)
+	{
+		const GrassCollider& collider = colliders[c];
+
+		Float3 ab = collider.B - collider.A;
+		float t = min(max(Dot(tip - collider.A, ab) / max(Dot(ab, ab), CollisionEpsilon), 0.0f), 1.0f);
+		Float3 d = tip - (collider.A + ab * t);
+		float distanceSq = Dot(d, d);
+
+		if (distanceSq < collider.Radius * collider.Radius && distanceSq > CollisionEpsilon)
+		{
+			float distance = sqrtf(distanceSq);
+			force += d * ((collider.Radius - distance) / distance * CollisionStiffness);
+		}
+	}
+
+	return force;
+}
+
+void GrassSimulation::ProcessBone(Bone& bone, const GrassStepParams& params)
+{
+	const Float3 upVec(0.0f, 1.0f, 0.0f);
+
+	Float3 oUpVec = Normalize(QuaternionRotateOptimized(bone.Rotation, upVec));
+	Float3 tailPos = oUpVec * bone.Length;
+
+	Float3 baseTorque = Cross(tailPos, params.WindVelocity);
+
+	Float3 localAxis(bone.LocalRotation.x, bone.LocalRotation.y, bone.LocalRotation.z);
+	Float3 restoreTorque = (-localAxis * RestoreStiffness) - (bone.Velocity * RestoreDamping);
+
+	Float3 torque = baseTorque + restoreTorque;
+
+	float I = (1.0f / 3.0f) * bone.Mass * bone.Length * bone.Length;
+
+	// torque = I * a
+	Float3 a = torque / I;
+
+	bone.Velocity += a * params.DeltaTime;
+
+	float speed = Length(bone.Velocity);
+
+	if (speed > MinAngularSpeed)
+	{
+		Float3 axis = bone.Velocity / speed;
+		float angle = speed * params.DeltaTime;
+
+		Float4 deltaRotation = AxisAngleToQuaternion(axis, angle);
+		bone.LocalRotation = Normalize(QuaternionMultiply(deltaRotation, bone.LocalRotation));
+	}
+
+	bone.Velocity *= VelocityDecay;
+}
+
+void GrassSimulation::ApplyParent(Bone& bone, const Bone& parentBone)
+{
+	const Float3 upVec(0.0f, 1.0f, 0.0f);
+
+	bone.Rotation = Normalize(QuaternionMultiply(parentBone.Rotation, bone.LocalRotation));
+
+	Float3 parentUpVec = Normalize(QuaternionRotateOptimized(parentBone.Rotation, upVec));
+	bone.Position = parentBone.Position + parentUpVec * parentBone.Length;
+}
+
+void GrassSimulation::SimulateBlade(Bone* bones, uint32_t blade, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& stepParams)
+{
+	Bone& root = bones[blade];
+
+	GrassStepParams params = stepParams;
+	if (params.Wind != nullptr)
+	{
+		params.WindVelocity += params.Wind->Sample(root.LocalPosition.x, root.LocalPosition.z);
+	}
+
+	// Collisions push each bone like extra wind on its own tip.
+	Float3 rootWorld = root.LocalPosition;
+	GrassStepParams boneParams = params;
+
+	if (params.ColliderCount > 0)
+	{
+		boneParams.WindVelocity = params.WindVelocity + CollisionForce(BoneTip(root, rootWorld), params.Colliders, params.ColliderCount);
+	}
+
+	ProcessBone(root, boneParams);
+	root.Rotation = root.LocalRotation;
+
+	for (uint32_t j = 1; j < bonesPerBlade; ++j)
+	{
+		Bone& child = bones[(size_t)j * bladeCount + blade];
+		assert(child.ParentIndex == (int)((j - 1) * bladeCount + blade));
+
+		ApplyParent(child, bones[child.ParentIndex]);
+
+		if (params.ColliderCount > 0)
+		{
+			boneParams.WindVelocity = params.WindVelocity + CollisionForce(BoneTip(child, rootWorld), params.Colliders, params.ColliderCount);
+		}
+
+		ProcessBone(child, boneParams);
+		// The shader composes the freshly integrated local rotation a second time without
+		// renormalizing; keep that so the reference stays bit-comparable.
+		child.Rotation = QuaternionMultiply(child.Rotation, child.LocalRotation);
+	}
+}
+
+void GrassSimulation::SimulateBlades(Bone* bones, uint32_t bladeBegin, uint32_t bladeEnd, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& params)
+{
+	for (uint32_t i = bladeBegin; i < bladeEnd; ++i)
+	{
+		SimulateBlade(bones, i, bladeCount, bonesPerBlade, params);
+	}
+}
+
+void GrassSimulation::Simulate(vector<Bone>& bones, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& params)
+{
+	assert(bones.size() == (size_t)bladeCount * bonesPerBlade);
+
+	SimulateBlades(bones.data(), 0, bladeCount, bladeCount, bonesPerBlade, params);
+}
+
+namespace
+{
+	struct SimdVec3
+	{
+		SimdFloat x, y, z;
+	};
+
+	struct SimdQuat
+	{
+		SimdFloat x, y, z, w;
+	};
+
+	SimdQuat QuaternionMultiply(const SimdQuat& a, const SimdQuat& b)
+	{
+		return {
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+			a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z };
+	}
+
+	SimdQuat Normalize(const SimdQuat& q)
+	{
+		SimdFloat invLength = SimdSplat(1.0f) / Sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		return { q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength };
+	}
+
+	SimdVec3 Normalize(const SimdVec3& v)
+	{
+		SimdFloat invLength = SimdSplat(1.0f) / Sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+		return { v.x * invLength, v.y * invLength, v.z * invLength };
+	}
+
+	// QuaternionRotateOptimized(q, (0, 1, 0)) with the zero terms folded away.
+	SimdVec3 RotateUp(const SimdQuat& q)
+	{
+		SimdFloat two = SimdSplat(2.0f);
+		return {
+			(q.y * q.x - q.z * q.w) * two,
+			SimdSplat(1.0f) + (-(q.z * q.z) - q.x * q.x) * two,
+			(q.x * q.w + q.y * q.z) * two };
+	}
+
+	SimdQuat LoadQuat(const AlignedVector<float>& x, const AlignedVector<float>& y,
+		const AlignedVector<float>& z, const AlignedVector<float>& w, size_t i)
+	{
+		return { SimdLoad(&x[i]), SimdLoad(&y[i]), SimdLoad(&z[i]), SimdLoad(&w[i]) };
+	}
+
+	void StoreQuat(AlignedVector<float>& x, AlignedVector<float>& y,
+		AlignedVector<float>& z, AlignedVector<float>& w, size_t i, const SimdQuat& q)
+	{
+		SimdStore(&x[i], q.x);
+		SimdStore(&y[i], q.y);
+		SimdStore(&z[i], q.z);
+		SimdStore(&w[i], q.w);
+	}
+
+	// Vector form of GrassSimulation::CollisionForce; lanes outside every collider add zero.
+	SimdVec3 CollisionForces(const SimdVec3& tip, const GrassCollider* colliders, uint32_t colliderCount)
+	{
+		SimdFloat zero = SimdZero();
+		SimdFloat epsilon = SimdSplat(CollisionEpsilon);
+		SimdFloat one = SimdSplat(1.0f);
+		SimdFloat stiffness = SimdSplat(GrassSimulation::CollisionStiffness);
+
+		SimdVec3 force = { zero, zero, zero };
+
+		for (uint32_t c = 0; c < colliderCount; ++c)
+		{
+			const GrassCollider& collider = colliders[c];
+
+			Float3 ab = collider.B - collider.A;
+			SimdFloat abLengthSq = SimdSplat(max(Dot(ab, ab), CollisionEpsilon));
+			SimdVec3 a = { SimdSplat(collider.A.x), SimdSplat(collider.A.y), SimdSplat(collider.A.z) };
+			SimdVec3 abv = { SimdSplat(ab.x), SimdSplat(ab.y), SimdSplat(ab.z) };
+
+			SimdVec3 ap = { tip.x - a.x, tip.y - a.y, tip.z - a.z };
+			SimdFloat t = Min(Max((ap.x * abv.x + ap.y * abv.y + ap.z * abv.z) / abLengthSq, zero), one);
+
+			SimdVec3 d = {
+				tip.x - (a.x + abv.x * t),
+				tip.y - (a.y + abv.y * t),
+				tip.z - (a.z + abv.z * t) };
+			SimdFloat distanceSq = d.x * d.x + d.y * d.y + d.z * d.z;
+
+			SimdFloat radius = SimdSplat(collider.Radius);
+			SimdMask inside = (distanceSq < radius * radius) & (distanceSq > epsilon);
+			if (!AnyLane(inside))
+			{
+				continue;
+			}
+
+			SimdFloat distance = Sqrt(Max(distanceSq, epsilon));
+			SimdFloat scale = Select(inside, (radius - distance) / distance * stiffness, zero);
+
+			force.x = force.x + d.x * scale;
+			force.y = force.y + d.y * scale;
+			force.z = force.z + d.z * scale;
+		}
+
+		return force;
+	}
+
+	// Vector form of GrassSimulation::ProcessBone; the branch on speed becomes a lane select.
+	void ProcessBones(const SimdQuat& rotation, SimdQuat& localRotation, SimdVec3& velocity,
+		SimdFloat mass, SimdFloat length, const SimdVec3& wind, SimdFloat dt)
+	{
+		SimdVec3 oUpVec = Normalize(RotateUp(rotation));
+		SimdVec3 tailPos = { oUpVec.x * length, oUpVec.y * length, oUpVec.z * length };
+
+		SimdVec3 baseTorque = {
+			tailPos.y * wind.z - tailPos.z * wind.y,
+			tailPos.z * wind.x - tailPos.x * wind.z,
+			tailPos.x * wind.y - tailPos.y * wind.x };
+
+		SimdFloat stiffness = SimdSplat(GrassSimulation::RestoreStiffness);
+		SimdFloat damping = SimdSplat(GrassSimulation::RestoreDamping);
+
+		SimdFloat I = SimdSplat(1.0f / 3.0f) * mass * length * length;
+
+		velocity.x = velocity.x + (baseTorque.x + (-localRotation.x * stiffness - velocity.x * damping)) / I * dt;
+		velocity.y = velocity.y + (baseTorque.y + (-localRotation.y * stiffness - velocity.y * damping)) / I * dt;
+		velocity.z = velocity.z + (baseTorque.z + (-localRotation.z * stiffness - velocity.z * damping)) / I * dt;
+
+		SimdFloat speed = Sqrt(velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z);
+		SimdMask moving = speed > SimdSplat(GrassSimulation::MinAngularSpeed);
+
+		if (AnyLane(moving))
+		{
+			SimdFloat safeSpeed = Select(moving, speed, SimdSplat(1.0f));
+			SimdFloat halfAngle = speed * dt * SimdSplat(0.5f);
+
+			SimdFloat s;
+			SimdFloat c;
+			SinCos(halfAngle, s, c);
+
+			SimdQuat deltaRotation = {
+				velocity.x / safeSpeed * s,
+				velocity.y / safeSpeed * s,
+				velocity.z / safeSpeed * s,
+				c };
+
+			SimdQuat integrated = Normalize(QuaternionMultiply(deltaRotation, localRotation));
+
+			localRotation.x = Select(moving, integrated.x, localRotation.x);
+			localRotation.y = Select(moving, integrated.y, localRotation.y);
+			localRotation.z = Select(moving, integrated.z, localRotation.z);
+			localRotation.w = Select(moving, integrated.w, localRotation.w);
+		}
+
+		SimdFloat decay = SimdSplat(GrassSimulation::VelocityDecay);
+		velocity.x = velocity.x * decay;
+		velocity.y = velocity.y * decay;
+		velocity.z = velocity.z * decay;
+	}
+}
+
+bool GrassSimulation::SimulateBlades(BoneSoA& bones, uint32_t bladeBegin, uint32_t bladeEnd, const GrassStepParams& params, GrassLod lod)
+{
+	assert(bladeBegin % SimdWidth == 0);
+	assert(bladeEnd <= bones.Stride);
+	assert(lod == GrassLod::Full || lod == GrassLod::Root);
+
+	bool rootOnly = lod == GrassLod::Root;
+
+	SimdVec3 wind = { SimdSplat(params.WindVelocity.x), SimdSplat(params.WindVelocity.y), SimdSplat(params.WindVelocity.z) };
+	SimdFloat dt = SimdSplat(params.DeltaTime);
+
+	SimdFloat sleepSpeedSq = SimdSplat(SleepSpeed * SleepSpeed);
+	SimdFloat sleepRotationSq = SimdSplat(SleepRotation * SleepRotation);
+	SimdMask awake = NoLanes();
+
+	for (uint32_t blade = bladeBegin; blade < bladeEnd; blade += SimdWidth)
+	{
+		if (params.Wind != nullptr)
+		{
+			// The field is a small grid; a scalar gather per lane is cheaper than the bone math.
+			alignas(32) float windX[SimdWidth];
+			alignas(32) float windZ[SimdWidth];
+			for (int k = 0; k < SimdWidth; ++k)
+			{
+				Float3 sample = params.Wind->Sample(bones.LocalPositionX[blade + k], bones.LocalPositionZ[blade + k]);
+				windX[k] = params.WindVelocity.x + sample.x;
+				windZ[k] = params.WindVelocity.z + sample.z;
+			}
+
+			wind.x = SimdLoad(windX);
+			wind.z = SimdLoad(windZ);
+		}
+
+		bool collide = params.ColliderCount > 0;
+		SimdVec3 rootWorld = { SimdLoad(&bones.LocalPositionX[blade]), SimdLoad(&bones.LocalPositionY[blade]), SimdLoad(&bones.LocalPositionZ[blade]) };
+
+		// Every level > 0 reads these after level 0 has written them.
+		SimdFloat zero = SimdZero();
+		SimdVec3 parentPosition = { zero, zero, zero };
+		SimdQuat parentRotation = { zero, zero, zero, zero };
+		SimdFloat parentLength = zero;
+
+		SimdQuat rootLocalRotation = { zero, zero, zero, zero };
+		SimdVec3 rootVelocity = { zero, zero, zero };
+
+		for (uint32_t level = 0; level < bones.BonesPerBlade; ++level)
+		{
+			size_t i = bones.Index(level, blade);
+
+			bool integrate = level == 0 || !rootOnly;
+
+			SimdQuat localRotation;
+			SimdVec3 velocity;
+			if (integrate)
+			{
+				localRotation = LoadQuat(bones.LocalRotationX, bones.LocalRotationY, bones.LocalRotationZ, bones.LocalRotationW, i);
+				velocity = { SimdLoad(&bones.VelocityX[i]), SimdLoad(&bones.VelocityY[i]), SimdLoad(&bones.VelocityZ[i]) };
+			}
+			else
+			{
+				localRotation = rootLocalRotation;
+				velocity = rootVelocity;
+			}
+
+			SimdFloat length = SimdLoad(&bones.Length[i]);
+
+			SimdQuat rotation;
+			SimdVec3 position;
+
+			if (level == 0)
+			{
+				rotation = LoadQuat(bones.RotationX, bones.RotationY, bones.RotationZ, bones.RotationW, i);
+				position = { SimdLoad(&bones.PositionX[i]), SimdLoad(&bones.PositionY[i]), SimdLoad(&bones.PositionZ[i]) };
+			}
+			else
+			{
+				rotation = Normalize(QuaternionMultiply(parentRotation, localRotation));
+
+				SimdVec3 parentUpVec = Normalize(RotateUp(parentRotation));
+				position.x = parentPosition.x + parentUpVec.x * parentLength;
+				position.y = parentPosition.y + parentUpVec.y * parentLength;
+				position.z = parentPosition.z + parentUpVec.z * parentLength;
+
+				SimdStore(&bones.PositionX[i], position.x);
+				SimdStore(&bones.PositionY[i], position.y);
+				SimdStore(&bones.PositionZ[i], position.z);
+			}
+
+			if (integrate)
+			{
+				SimdFloat mass = SimdLoad(&bones.Mass[i]);
+
+				SimdVec3 boneWind = wind;
+				if (collide)
+				{
+					SimdVec3 upVec = Normalize(RotateUp(rotation));
+					SimdVec3 tip = {
+						rootWorld.x + position.x + upVec.x * length,
+						rootWorld.y + position.y + upVec.y * length,
+						rootWorld.z + position.z + upVec.z * length };
+
+					SimdVec3 force = CollisionForces(tip, params.Colliders, params.ColliderCount);
+					boneWind = { wind.x + force.x, wind.y + force.y, wind.z + force.z };
+				}
+
+				ProcessBones(rotation, localRotation, velocity, mass, length, boneWind, dt);
+			}
+
+			if (level == 0)
+			{
+				rootLocalRotation = localRotation;
+				rootVelocity = velocity;
+			}
+
+			SimdFloat speedSq = velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z;
+			SimdFloat rotationSq = localRotation.x * localRotation.x + localRotation.y * localRotation.y + localRotation.z * localRotation.z;
+			awake = awake | (speedSq > sleepSpeedSq) | (rotationSq > sleepRotationSq);
+
+			rotation = level == 0 ? localRotation : QuaternionMultiply(rotation, localRotation);
+
+			StoreQuat(bones.RotationX, bones.RotationY, bones.RotationZ, bones.RotationW, i, rotation);
+			StoreQuat(bones.LocalRotationX, bones.LocalRotationY, bones.LocalRotationZ, bones.LocalRotationW, i, localRotation);
+			SimdStore(&bones.VelocityX[i], velocity.x);
+			SimdStore(&bones.VelocityY[i], velocity.y);
+			SimdStore(&bones.VelocityZ[i], velocity.z);
+
+			parentPosition = position;
+			parentRotation = rotation;
+			parentLength = length;
+		}
+	}
+
+	return !AnyLane(awake);
+}
+
+bool GrassSimulation::Simulate(BoneSoA& bones, const GrassStepParams& params)
+{
+	return SimulateBlades(bones, 0, bones.BladeCount, params);
+}
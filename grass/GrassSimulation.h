@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "SimMath.h"
+
+using namespace std;
+
+struct BoneSoA;
+struct GrassCollider;
+class WindField;
+
+// Must match struct Bone in Shaders/Grass.hlsl byte for byte.
+struct Bone
+{
+	Float3 Position;
+	float Mass;
+	Float4 Rotation;
+	Float3 Velocity;
+	float Length;
+	int ParentIndex;
+	Float3 LocalPosition;
+	Float4 LocalRotation;
+};
+
+static_assert(sizeof(Bone) == 80, "Bone must match the structured buffer stride used by Grass.hlsl");
+
+// How much of a blade's bone chain is integrated (GRASS_LOD_* in Grass.hlsl).
+enum class GrassLod : uint32_t
+{
+	// Every bone is integrated.
+	Full = 0,
+	// Only the root is integrated; every other joint copies the root's bend and velocity.
+	Root = 1,
+	// Nothing is integrated per blade; the chunk's shared sway chain is copied to each blade.
+	Sway = 2,
+};
+
+struct GrassStepParams
+{
+	Float3 WindVelocity = { 0.0f, 0.0f, 0.0f };
+	float DeltaTime = 0.0f;
+	// Optional; sampled at each blade's root (the root bone's LocalPosition) and added to WindVelocity.
+	const WindField* Wind = nullptr;
+	// Colliders that may touch the blades being stepped. GrassChunkSimulation sets these per
+	// chunk from UpdateColliders.
+	const GrassCollider* Colliders = nullptr;
+	uint32_t ColliderCount = 0;
+};
+
+// CPU reference of the bone update in Shaders/Grass.hlsl (ProcessBone, ApplyParent, CS).
+// Bones are stored level-major like mGrassBuffer: bone j of blade i lives at j * bladeCount + i.
+class GrassSimulation
+{
+public:
+	static constexpr float RestoreStiffness = 10.0f;
+	static constexpr float RestoreDamping = 1.0f;
+	static constexpr float VelocityDecay = 0.9f;
+	static constexpr float MinAngularSpeed = 0.001f;
+
+	// A bone is settled once both its angular speed and the axis part of its local rotation
+	// (about half the bend angle in radians) fall below these.
+	static constexpr float SleepSpeed = 0.001f;
+	static constexpr float SleepRotation = 0.001f;
+
+	// A bone tip inside a collider is pushed out like wind of this speed per metre of depth.
+	static constexpr float CollisionStiffness = 200.0f;
+
+	static vector<Bone> BuildBones(uint32_t bladeCount, uint32_t bonesPerBlade, float boneLength = 0.3f, float boneMass = 1.0f);
+	// Stores each blade's world root in its root bone's LocalPosition, where the wind field is sampled.
+	static void SetBladeRoots(vector<Bone>& bones, const vector<Float3>& roots);
+
+	// Push on a bone tip (world space) from every collider it is inside. Matches CollisionForce in Grass.hlsl.
+	static Float3 CollisionForce(const Float3& tip, const GrassCollider* colliders, uint32_t colliderCount);
+
+	static void ProcessBone(Bone& bone, const GrassStepParams& params);
+	static void ApplyParent(Bone& bone, const Bone& parentBone);
+
+	static void SimulateBlade(Bone* bones, uint32_t blade, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& params);
+	static void SimulateBlades(Bone* bones, uint32_t bladeBegin, uint32_t bladeEnd, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& params);
+	static void Simulate(vector<Bone>& bones, uint32_t bladeCount, uint32_t bonesPerBlade, const GrassStepParams& params);
+
+	// SIMD path: integrates SimdWidth blades per iteration. bladeBegin must be a multiple of
+	// SimdWidth; bladeEnd is rounded up into the padding of the last group.
+	// Returns true if every bone in the range ended the step settled. lod must be Full or Root.
+	static bool SimulateBlades(BoneSoA& bones, uint32_t bladeBegin, uint32_t bladeEnd, const GrassStepParams& params, GrassLod lod = GrassLod::Full);
+	static bool Simulate(BoneSoA& bones, const GrassStepParams& params);
+};
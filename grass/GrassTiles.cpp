@@ -0,0 +1,288 @@
+#include "GrassTiles.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+GrassTileCache::~GrassTileCache()
+{
+	StopWorkers();
+}
+
+void GrassTileCache::Initialize(const GrassTileCacheDesc& desc)
+{
+	assert(desc.TileSize > 0.0f && desc.WorkerCount > 0);
+
+	StopWorkers();
+
+	mDesc = desc;
+	mScatter.Initialize(desc.MinSpacing, desc.Seed);
+
+	mResident.clear();
+	mLru.clear();
+	mResidentBytes = 0;
+	mPending.clear();
+	mVisibleTiles.clear();
+	mFrame = 0;
+	mStats = GrassTileStats();
+	mTotalGenerationMs = 0.0;
+	mTotalLatencyMs = 0.0;
+	mLatencyCount = 0;
+
+	mRequests.clear();
+	mInFlight.clear();
+	mFinished.clear();
+	mStopping = false;
+
+	for (uint32_t i = 0; i < desc.WorkerCount; ++i)
+	{
+		mWorkers.emplace_back(&GrassTileCache::WorkerLoop, this);
+	}
+}
+
+void GrassTileCache::StopWorkers()
+{
+	{
+		lock_guard<mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWorkAvailable.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+	mWorkers.clear();
+}
+
+void GrassTileCache::WorkerLoop()
+{
+	while (true)
+	{
+		Request request;
+		{
+			unique_lock<mutex> lock(mMutex);
+			mWorkAvailable.wait(lock, [this]() { return mStopping || !mRequests.empty(); });
+
+			if (mStopping)
+			{
+				return;
+			}
+
+			request = mRequests.back();
+			mRequests.pop_back();
+			mInFlight.insert(request.Key);
+		}
+
+		auto start = chrono::steady_clock::now();
+
+		Double3 origin((double)request.X * mDesc.TileSize, 0.0, (double)request.Z * mDesc.TileSize);
+
+		GrassScatterDesc scatterDesc;
+		scatterDesc.OriginX = origin.x;
+		scatterDesc.OriginZ = origin.z;
+		scatterDesc.MinX = 0.0f;
+		scatterDesc.MinZ = 0.0f;
+		scatterDesc.MaxX = mDesc.TileSize;
+		scatterDesc.MaxZ = mDesc.TileSize;
+		scatterDesc.Density = mDesc.Density;
+		scatterDesc.Height = mDesc.Height;
+		scatterDesc.Normal = mDesc.Normal;
+		scatterDesc.HeightBatch = mDesc.HeightBatch;
+		scatterDesc.NormalBatch = mDesc.NormalBatch;
+		scatterDesc.MaxSlopeDegrees = mDesc.MaxSlopeDegrees;
+
+		Finished finished;
+		finished.Tile = make_unique<GrassTile>();
+		finished.Tile->X = request.X;
+		finished.Tile->Z = request.Z;
+		finished.Tile->Origin = origin;
+		finished.Tile->Roots = mScatter.Scatter(scatterDesc);
+		finished.GenerationMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+		lock_guard<mutex> lock(mMutex);
+		mInFlight.erase(request.Key);
+		mFinished.push_back(move(finished));
+	}
+}
+
+void GrassTileCache::Update(const Double3& cameraPos)
+{
+	++mFrame;
+
+	CollectFinished();
+
+	// Wanted tiles: every tile whose centre is inside the load radius.
+	double tileSize = mDesc.TileSize;
+	int32_t reach = (int32_t)ceilf(mDesc.LoadRadius / mDesc.TileSize) + 1;
+	int32_t cameraX = (int32_t)floor(cameraPos.x / tileSize);
+	int32_t cameraZ = (int32_t)floor(cameraPos.z / tileSize);
+	float radiusSq = mDesc.LoadRadius * mDesc.LoadRadius;
+
+	vector<pair<float, Request>> missing;
+	unordered_set<TileKey> missingKeys;
+	vector<pair<float, const GrassTile*>> visible;
+
+	for (int32_t z = cameraZ - reach; z <= cameraZ + reach; ++z)
+	{
+		for (int32_t x = cameraX - reach; x <= cameraX + reach; ++x)
+		{
+			// Differences in double first: the distances are small, the positions need not be.
+			float dx = (float)((x + 0.5) * tileSize - cameraPos.x);
+			float dz = (float)((z + 0.5) * tileSize - cameraPos.z);
+			float distanceSq = dx * dx + dz * dz;
+
+			if (distanceSq > radiusSq)
+			{
+				continue;
+			}
+
+			TileKey key = MakeKey(x, z);
+			auto resident = mResident.find(key);
+
+			if (resident != mResident.end())
+			{
+				++mStats.Hits;
+				resident->second.LastWantedFrame = mFrame;
+				mLru.splice(mLru.begin(), mLru, resident->second.LruPosition);
+				visible.push_back({ distanceSq, resident->second.Tile.get() });
+			}
+			else
+			{
+				++mStats.Misses;
+				Request request;
+				request.Key = key;
+				request.X = x;
+				request.Z = z;
+				missing.push_back({ distanceSq, request });
+				missingKeys.insert(key);
+			}
+		}
+	}
+
+	sort(visible.begin(), visible.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	mVisibleTiles.clear();
+	for (const auto& tile : visible)
+	{
+		mVisibleTiles.push_back(tile.second);
+	}
+
+	// Farthest first, so workers pop the nearest tile off the back.
+	sort(missing.begin(), missing.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+	auto now = chrono::steady_clock::now();
+
+	{
+		lock_guard<mutex> lock(mMutex);
+
+		// Tiles finished since CollectFinished are picked up next Update, not generated twice.
+		unordered_set<TileKey> finishedKeys;
+		for (const auto& tile : mFinished)
+		{
+			finishedKeys.insert(MakeKey(tile.Tile->X, tile.Tile->Z));
+		}
+
+		mRequests.clear();
+		for (const auto& tile : missing)
+		{
+			mPending.emplace(tile.second.Key, now);
+			if (mInFlight.count(tile.second.Key) == 0 && finishedKeys.count(tile.second.Key) == 0)
+			{
+				mRequests.push_back(tile.second);
+			}
+		}
+
+		// Forget requests that dropped out of range before a worker took them.
+		for (auto it = mPending.begin(); it != mPending.end();)
+		{
+			if (missingKeys.count(it->first) == 0 && mInFlight.count(it->first) == 0 && finishedKeys.count(it->first) == 0)
+			{
+				it = mPending.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	if (!mRequests.empty())
+	{
+		mWorkAvailable.notify_all();
+	}
+
+	EvictOverBudget();
+
+	mStats.ResidentTiles = mResident.size();
+	mStats.ResidentBytes = mResidentBytes;
+	mStats.PendingTiles = mPending.size();
+}
+
+void GrassTileCache::CollectFinished()
+{
+	vector<Finished> finished;
+	{
+		lock_guard<mutex> lock(mMutex);
+		finished.swap(mFinished);
+	}
+
+	auto now = chrono::steady_clock::now();
+
+	for (auto& tile : finished)
+	{
+		TileKey key = MakeKey(tile.Tile->X, tile.Tile->Z);
+
+		auto pending = mPending.find(key);
+		if (pending != mPending.end())
+		{
+			double latencyMs = chrono::duration<double, milli>(now - pending->second).count();
+			mTotalLatencyMs += latencyMs;
+			mStats.MaxLatencyMs = max(mStats.MaxLatencyMs, latencyMs);
+			++mLatencyCount;
+			mPending.erase(pending);
+		}
+
+		++mStats.Generated;
+		mTotalGenerationMs += tile.GenerationMs;
+		mStats.MaxGenerationMs = max(mStats.MaxGenerationMs, tile.GenerationMs);
+
+		if (mResident.count(key) != 0)
+		{
+			continue;
+		}
+
+		// Update moves the tile to the front again if it's still wanted.
+		mLru.push_front(key);
+
+		Resident& resident = mResident[key];
+		resident.Tile = move(tile.Tile);
+		resident.LruPosition = mLru.begin();
+		mResidentBytes += resident.Tile->Bytes();
+	}
+
+	if (mStats.Generated > 0)
+	{
+		mStats.MeanGenerationMs = mTotalGenerationMs / mStats.Generated;
+	}
+	if (mLatencyCount > 0)
+	{
+		mStats.MeanLatencyMs = mTotalLatencyMs / mLatencyCount;
+	}
+}
+
+void GrassTileCache::EvictOverBudget()
+{
+	while (mResidentBytes > mDesc.MemoryBudget && !mLru.empty())
+	{
+		auto resident = mResident.find(mLru.back());
+
+		// Wanted tiles sit at the front, so everything left was wanted this frame.
+		if (resident->second.LastWantedFrame == mFrame)
+		{
+			break;
+		}
+
+		mResidentBytes -= resident->second.Tile->Bytes();
+		mLru.pop_back();
+		mResident.erase(resident);
+		++mStats.Evicted;
+	}
+}
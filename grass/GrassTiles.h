@@ -0,0 +1,153 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "GrassScatter.h"
+
+using namespace std;
+
+struct GrassTileCacheDesc
+{
+	// Streamed tiles are TileSize x TileSize metres, tile (0, 0) starting at the origin.
+	float TileSize = 32.0f;
+	// Tiles whose centre is within this distance (xz) of the camera are wanted.
+	float LoadRadius = 128.0f;
+	// Least recently used tiles are evicted once the resident roots exceed this many bytes.
+	// Tiles wanted this frame are never evicted, so the budget should hold the load radius.
+	size_t MemoryBudget = 256ull << 20;
+	uint32_t WorkerCount = 2;
+
+	// Every tile is scattered from the same pattern, so a tile is a pure function of its
+	// coordinate and the tiles join up seamlessly.
+	float MinSpacing = 0.05f;
+	uint32_t Seed = 0;
+	const GrassDensityMap* Density = nullptr;
+	GrassHeightFunc Height = nullptr;
+	GrassNormalFunc Normal = nullptr;
+	GrassHeightBatchFunc HeightBatch = nullptr;
+	GrassNormalBatchFunc NormalBatch = nullptr;
+	float MaxSlopeDegrees = 90.0f;
+};
+
+struct GrassTile
+{
+	int32_t X = 0;
+	int32_t Z = 0;
+	// The tile's corner in the world. Roots are relative to it, so tiles far from the
+	// world origin keep full float precision; rebase them with RelativePosition.
+	Double3 Origin;
+	// Spatially sorted, see GrassScatter::Scatter.
+	vector<Float3> Roots;
+
+	size_t Bytes() const { return sizeof(GrassTile) + Roots.capacity() * sizeof(Float3); }
+};
+
+struct GrassTileStats
+{
+	// One lookup per wanted tile per Update.
+	uint64_t Hits = 0;
+	uint64_t Misses = 0;
+	uint64_t Generated = 0;
+	uint64_t Evicted = 0;
+	// Worker time spent scattering one tile.
+	double MeanGenerationMs = 0.0;
+	double MaxGenerationMs = 0.0;
+	// Time from a tile's first request to it being resident.
+	double MeanLatencyMs = 0.0;
+	double MaxLatencyMs = 0.0;
+
+	size_t ResidentTiles = 0;
+	size_t ResidentBytes = 0;
+	size_t PendingTiles = 0;
+};
+
+// Grass roots streamed around the camera. Update never waits for generation: it queues
+// the missing tiles nearest first for the cache's own worker threads (kept apart from the
+// simulation's ThreadPool so a ThreadPool::Wait on the main thread can't pick up a tile),
+// collects whatever has finished and evicts by LRU down to the budget.
+class GrassTileCache
+{
+public:
+	GrassTileCache() = default;
+	GrassTileCache(const GrassTileCache& rhs) = delete;
+	GrassTileCache& operator=(const GrassTileCache& rhs) = delete;
+	~GrassTileCache();
+
+	void Initialize(const GrassTileCacheDesc& desc);
+
+	// Tile selection runs in double, so it holds anywhere a Double3 reaches.
+	void Update(const Double3& cameraPos);
+
+	// Resident tiles within the load radius as of the last Update, nearest first.
+	const vector<const GrassTile*>& VisibleTiles() const { return mVisibleTiles; }
+
+	const GrassTileStats& Stats() const { return mStats; }
+	const GrassTileCacheDesc& Desc() const { return mDesc; }
+
+private:
+	typedef uint64_t TileKey;
+
+	static TileKey MakeKey(int32_t x, int32_t z) { return (uint64_t)(uint32_t)x | ((uint64_t)(uint32_t)z << 32); }
+
+	struct Resident
+	{
+		unique_ptr<GrassTile> Tile;
+		list<TileKey>::iterator LruPosition;
+		uint64_t LastWantedFrame = 0;
+	};
+
+	struct Request
+	{
+		TileKey Key = 0;
+		int32_t X = 0;
+		int32_t Z = 0;
+	};
+
+	struct Finished
+	{
+		unique_ptr<GrassTile> Tile;
+		double GenerationMs = 0.0;
+	};
+
+	void WorkerLoop();
+	void StopWorkers();
+	void CollectFinished();
+	void EvictOverBudget();
+
+private:
+	GrassTileCacheDesc mDesc;
+	GrassScatter mScatter;
+
+	// Main thread only.
+	unordered_map<TileKey, Resident> mResident;
+	// Front is the most recently wanted tile.
+	list<TileKey> mLru;
+	size_t mResidentBytes = 0;
+	// Requested and not yet collected, with the time of the first request.
+	unordered_map<TileKey, chrono::steady_clock::time_point> mPending;
+	vector<const GrassTile*> mVisibleTiles;
+	uint64_t mFrame = 0;
+	GrassTileStats mStats;
+	double mTotalGenerationMs = 0.0;
+	double mTotalLatencyMs = 0.0;
+	uint64_t mLatencyCount = 0;
+
+	// Shared with the workers under mMutex. mRequests is replaced wholesale each Update, so
+	// tiles that drift out of range before a worker reaches them are never generated.
+	mutex mMutex;
+	condition_variable mWorkAvailable;
+	// Farthest first; workers pop from the back.
+	vector<Request> mRequests;
+	unordered_set<TileKey> mInFlight;
+	vector<Finished> mFinished;
+	bool mStopping = false;
+	vector<thread> mWorkers;
+};
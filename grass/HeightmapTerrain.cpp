@@ -0,0 +1,419 @@
+#include "HeightmapTerrain.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+
+namespace
+{
+	const uint32_t HeightmapMagic = 0x50414d48; // "HMAP"
+	const uint32_t HeightmapVersion = 1;
+
+	struct HeightmapHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		HeightmapDesc Desc;
+		uint32_t LevelCount;
+		uint64_t LevelOffsets[HeightmapTerrain::MaxLevels];
+	};
+
+	struct LevelLayout
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t TilesX;
+		uint32_t TilesZ;
+		uint64_t Offset;
+	};
+
+	uint32_t TilesFor(uint32_t samples, uint32_t tileSize)
+	{
+		return max(1u, (samples - 1 + tileSize - 1) / tileSize);
+	}
+
+	uint64_t TileStride(size_t tileBytes)
+	{
+		return (tileBytes + MappedFile::ViewAlignment - 1) / MappedFile::ViewAlignment * MappedFile::ViewAlignment;
+	}
+
+	// Halves the resolution until a level fits in one tile. Every level's tiles are packed
+	// after the header, each at a view-aligned offset.
+	uint32_t ComputeLayout(const HeightmapDesc& desc, LevelLayout* levels)
+	{
+		uint64_t stride = TileStride((size_t)(desc.TileSize + 1) * (desc.TileSize + 1) * sizeof(uint16_t));
+		uint64_t offset = TileStride(sizeof(HeightmapHeader));
+		uint32_t width = desc.Width;
+		uint32_t height = desc.Height;
+		uint32_t count = 0;
+
+		while (count < HeightmapTerrain::MaxLevels)
+		{
+			LevelLayout& level = levels[count++];
+			level.Width = width;
+			level.Height = height;
+			level.TilesX = TilesFor(width, desc.TileSize);
+			level.TilesZ = TilesFor(height, desc.TileSize);
+			level.Offset = offset;
+			offset += (uint64_t)level.TilesX * level.TilesZ * stride;
+
+			if (level.TilesX == 1 && level.TilesZ == 1)
+			{
+				break;
+			}
+
+			// Half the cells, rounded up.
+			width = width / 2 + 1;
+			height = height / 2 + 1;
+		}
+
+		return count;
+	}
+}
+
+bool HeightmapTerrain::Write(const string& path, const HeightmapDesc& desc, const TerrainHeightFunc& height,
+	ThreadPool* pool)
+{
+	assert(desc.Width >= 2 && desc.Height >= 2 && desc.TileSize >= 2 && height);
+
+	LevelLayout levels[MaxLevels];
+	uint32_t levelCount = ComputeLayout(desc, levels);
+
+	const uint32_t T = desc.TileSize;
+	const size_t tileSamples = (size_t)(T + 1) * (T + 1);
+	const uint64_t stride = TileStride(tileSamples * sizeof(uint16_t));
+
+	fstream file(path, ios::in | ios::out | ios::binary | ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	float scale = desc.MaxHeight > desc.MinHeight ? 65535.0f / (desc.MaxHeight - desc.MinHeight) : 0.0f;
+	auto quantize = [&](float h)
+	{
+		return (uint16_t)min(max((h - desc.MinHeight) * scale + 0.5f, 0.0f), 65535.0f);
+	};
+
+	auto parallelFor = [pool](uint32_t count, const function<void(uint32_t)>& body)
+	{
+		if (pool != nullptr)
+		{
+			pool->ParallelFor(count, body);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				body(i);
+			}
+		}
+	};
+
+	vector<uint16_t> row;
+	vector<uint16_t> parents;
+
+	for (uint32_t l = 0; l < levelCount; ++l)
+	{
+		const LevelLayout& level = levels[l];
+		row.resize((size_t)level.TilesX * tileSamples);
+
+		for (uint32_t tz = 0; tz < level.TilesZ; ++tz)
+		{
+			// Level 0 samples the terrain; each coarser level keeps every other sample of the
+			// last, whose tile rows 2 tz and 2 tz + 1 cover this row (the second one's far
+			// border included).
+			uint32_t parentRow = 0;
+			uint32_t parentRows = 0;
+			if (l > 0)
+			{
+				const LevelLayout& parent = levels[l - 1];
+				parentRow = min(2 * tz, parent.TilesZ - 1);
+				parentRows = min(2 * tz + 1, parent.TilesZ - 1) - parentRow + 1;
+				parents.resize((size_t)parentRows * parent.TilesX * tileSamples);
+
+				file.seekg((streamoff)(parent.Offset + (uint64_t)parentRow * parent.TilesX * stride));
+				for (size_t t = 0; t < (size_t)parentRows * parent.TilesX; ++t)
+				{
+					file.read((char*)&parents[t * tileSamples], tileSamples * sizeof(uint16_t));
+					file.seekg((streamoff)(stride - tileSamples * sizeof(uint16_t)), ios::cur);
+				}
+			}
+
+			auto fillTile = [&](uint32_t tx)
+			{
+				uint16_t* tile = &row[(size_t)tx * tileSamples];
+				for (uint32_t j = 0; j <= T; ++j)
+				{
+					uint32_t gz = min(tz * T + j, level.Height - 1);
+					for (uint32_t i = 0; i <= T; ++i)
+					{
+						uint32_t gx = min(tx * T + i, level.Width - 1);
+						if (l == 0)
+						{
+							tile[(size_t)j * (T + 1) + i] = quantize(height(desc.MinX + gx * desc.CellSize,
+								desc.MinZ + gz * desc.CellSize));
+							continue;
+						}
+
+						const LevelLayout& parent = levels[l - 1];
+						uint32_t px = min(2 * gx, parent.Width - 1);
+						uint32_t pz = min(2 * gz, parent.Height - 1);
+						uint32_t ptx = min(px / T, parent.TilesX - 1);
+						uint32_t ptz = min(pz / T, parentRow + parentRows - 1);
+						const uint16_t* source = &parents[((size_t)(ptz - parentRow) * parent.TilesX + ptx) * tileSamples];
+						tile[(size_t)j * (T + 1) + i] = source[(size_t)(pz - ptz * T) * (T + 1) + (px - ptx * T)];
+					}
+				}
+			};
+
+			parallelFor(level.TilesX, fillTile);
+
+			for (uint32_t tx = 0; tx < level.TilesX; ++tx)
+			{
+				file.seekp((streamoff)(level.Offset + ((uint64_t)tz * level.TilesX + tx) * stride));
+				file.write((const char*)&row[(size_t)tx * tileSamples], tileSamples * sizeof(uint16_t));
+			}
+		}
+	}
+
+	HeightmapHeader header = {};
+	header.Magic = HeightmapMagic;
+	header.Version = HeightmapVersion;
+	header.Desc = desc;
+	header.LevelCount = levelCount;
+	for (uint32_t l = 0; l < levelCount; ++l)
+	{
+		header.LevelOffsets[l] = levels[l].Offset;
+	}
+
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	return (bool)file;
+}
+
+HeightmapTerrain::~HeightmapTerrain()
+{
+	Close();
+}
+
+bool HeightmapTerrain::Open(const string& path, size_t memoryBudget)
+{
+	Close();
+
+	HeightmapHeader header;
+	{
+		ifstream fin(path, ios::binary);
+		if (!fin || !fin.read((char*)&header, sizeof(header)))
+		{
+			return false;
+		}
+	}
+
+	if (header.Magic != HeightmapMagic || header.Version != HeightmapVersion)
+	{
+		return false;
+	}
+
+	LevelLayout levels[MaxLevels];
+	uint32_t levelCount = ComputeLayout(header.Desc, levels);
+	if (levelCount != header.LevelCount || !mFile.Open(path))
+	{
+		return false;
+	}
+
+	mDesc = header.Desc;
+	mLevelCount = levelCount;
+	mTileBytes = (size_t)(mDesc.TileSize + 1) * (mDesc.TileSize + 1) * sizeof(uint16_t);
+	mTileBudget = max(1u, (uint32_t)min(memoryBudget / mTileBytes, (size_t)UINT32_MAX));
+
+	for (uint32_t l = 0; l < levelCount; ++l)
+	{
+		Level& level = mLevels[l];
+		level.Width = levels[l].Width;
+		level.Height = levels[l].Height;
+		level.TilesX = levels[l].TilesX;
+		level.TilesZ = levels[l].TilesZ;
+		level.Offset = header.LevelOffsets[l];
+		level.Tiles = vector<Tile>((size_t)level.TilesX * level.TilesZ);
+	}
+
+	mStats = HeightmapStats();
+	mOpenCounters = MappedFile::QueryProcessMemory();
+	return true;
+}
+
+void HeightmapTerrain::Close()
+{
+	unique_lock<shared_mutex> lock(mMutex);
+
+	for (const auto& resident : mResident)
+	{
+		const Tile& tile = mLevels[resident.first].Tiles[resident.second];
+		mFile.Unmap(tile.Samples, mTileBytes);
+		tile.Samples = nullptr;
+	}
+	mResident.clear();
+
+	for (uint32_t l = 0; l < mLevelCount; ++l)
+	{
+		mLevels[l] = Level();
+	}
+	mLevelCount = 0;
+	mFile.Close();
+}
+
+HeightmapTerrain::Lookup HeightmapTerrain::Locate(float x, float z, uint32_t level) const
+{
+	assert(level < mLevelCount);
+
+	const Level& l = mLevels[level];
+	float invCell = 1.0f / LevelCellSize(level);
+	float u = min(max((x - mDesc.MinX) * invCell, 0.0f), (float)(l.Width - 1));
+	float v = min(max((z - mDesc.MinZ) * invCell, 0.0f), (float)(l.Height - 1));
+
+	uint32_t i = min((uint32_t)u, l.Width - 2);
+	uint32_t j = min((uint32_t)v, l.Height - 2);
+	uint32_t tx = min(i / mDesc.TileSize, l.TilesX - 1);
+	uint32_t tz = min(j / mDesc.TileSize, l.TilesZ - 1);
+
+	return { tz * l.TilesX + tx, i - tx * mDesc.TileSize, j - tz * mDesc.TileSize, u - i, v - j };
+}
+
+float HeightmapTerrain::Bilinear(const uint16_t* samples, const Lookup& lookup) const
+{
+	uint32_t pitch = mDesc.TileSize + 1;
+	const uint16_t* s = samples + (size_t)lookup.J * pitch + lookup.I;
+
+	float h0 = s[0] + lookup.U * ((float)s[1] - s[0]);
+	float h1 = s[pitch] + lookup.U * ((float)s[pitch + 1] - s[pitch]);
+	float h = h0 + lookup.V * (h1 - h0);
+
+	return mDesc.MinHeight + h * ((mDesc.MaxHeight - mDesc.MinHeight) / 65535.0f);
+}
+
+float HeightmapTerrain::Sample(uint32_t level, const Lookup& lookup) const
+{
+	{
+		shared_lock<shared_mutex> lock(mMutex);
+		const Tile& tile = mLevels[level].Tiles[lookup.TileIndex];
+		if (tile.Samples != nullptr)
+		{
+			uint64_t now = mClock.load(memory_order_relaxed);
+			if (tile.LastUse.load(memory_order_relaxed) != now)
+			{
+				tile.LastUse.store(now, memory_order_relaxed);
+			}
+			return Bilinear(tile.Samples, lookup);
+		}
+	}
+
+	// Sampled before letting go of the lock, so another thread's load can't evict the tile
+	// first however small the budget.
+	unique_lock<shared_mutex> lock(mMutex);
+	const uint16_t* samples = LoadTile(level, lookup.TileIndex);
+	return samples != nullptr ? Bilinear(samples, lookup) : mDesc.MinHeight;
+}
+
+const uint16_t* HeightmapTerrain::LoadTile(uint32_t level, uint32_t index) const
+{
+	const Tile& tile = mLevels[level].Tiles[index];
+	uint64_t now = mClock.fetch_add(1, memory_order_relaxed) + 1;
+	tile.LastUse.store(now, memory_order_relaxed);
+
+	if (tile.Samples != nullptr)
+	{
+		return tile.Samples;
+	}
+
+	if (mResident.size() >= mTileBudget)
+	{
+		size_t victim = 0;
+		for (size_t r = 1; r < mResident.size(); ++r)
+		{
+			const Tile& a = mLevels[mResident[r].first].Tiles[mResident[r].second];
+			const Tile& b = mLevels[mResident[victim].first].Tiles[mResident[victim].second];
+			if (a.LastUse.load(memory_order_relaxed) < b.LastUse.load(memory_order_relaxed))
+			{
+				victim = r;
+			}
+		}
+
+		const Tile& evicted = mLevels[mResident[victim].first].Tiles[mResident[victim].second];
+		mFile.Unmap(evicted.Samples, mTileBytes);
+		evicted.Samples = nullptr;
+		mResident[victim] = mResident.back();
+		mResident.pop_back();
+		++mStats.TileEvictions;
+	}
+
+	tile.Samples = (const uint16_t*)mFile.Map(mLevels[level].Offset + index * TileStride(mTileBytes), mTileBytes);
+	assert(tile.Samples != nullptr);
+	if (tile.Samples == nullptr)
+	{
+		return nullptr;
+	}
+
+	mResident.push_back({ level, index });
+	++mStats.TileLoads;
+	mStats.PeakResidentTiles = max(mStats.PeakResidentTiles, (uint32_t)mResident.size());
+	return tile.Samples;
+}
+
+float HeightmapTerrain::GetHeight(float x, float z, uint32_t level) const
+{
+	return Sample(level, Locate(x, z, level));
+}
+
+Float3 HeightmapTerrain::GetNormal(float x, float z, uint32_t level) const
+{
+	float d = LevelCellSize(level);
+	float left = GetHeight(x - d, z, level);
+	float right = GetHeight(x + d, z, level);
+	float down = GetHeight(x, z - d, level);
+	float up = GetHeight(x, z + d, level);
+
+	return Normalize(Float3((left - right) / (2.0f * d), 1.0f, (down - up) / (2.0f * d)));
+}
+
+void HeightmapTerrain::GetHeights(const float* x, const float* z, size_t count, float* heights, uint32_t level) const
+{
+	// One shared lock for the whole batch, dropped only to map a missing tile.
+	shared_lock<shared_mutex> lock(mMutex);
+	uint64_t now = mClock.load(memory_order_relaxed);
+
+	for (size_t k = 0; k < count; ++k)
+	{
+		Lookup lookup = Locate(x[k], z[k], level);
+		const Tile& tile = mLevels[level].Tiles[lookup.TileIndex];
+
+		if (tile.Samples == nullptr)
+		{
+			lock.unlock();
+			heights[k] = Sample(level, lookup);
+			lock.lock();
+			now = mClock.load(memory_order_relaxed);
+			continue;
+		}
+
+		if (tile.LastUse.load(memory_order_relaxed) != now)
+		{
+			tile.LastUse.store(now, memory_order_relaxed);
+		}
+		heights[k] = Bilinear(tile.Samples, lookup);
+	}
+}
+
+HeightmapStats HeightmapTerrain::Stats() const
+{
+	shared_lock<shared_mutex> lock(mMutex);
+
+	HeightmapStats stats = mStats;
+	stats.ResidentTiles = (uint32_t)mResident.size();
+	stats.ResidentBytes = mResident.size() * mTileBytes;
+	stats.PeakResidentBytes = stats.PeakResidentTiles * mTileBytes;
+	stats.PageFaults = MappedFile::QueryProcessMemory().PageFaults - mOpenCounters.PageFaults;
+	return stats;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+#include "LandUtility.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+class ThreadPool;
+
+struct HeightmapDesc
+{
+	// Samples per side of level 0, CellSize apart, sample (0, 0) at (MinX, MinZ).
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	float MinX = 0.0f;
+	float MinZ = 0.0f;
+	float CellSize = 1.0f;
+	// Heights are stored as 16-bit steps over [MinHeight, MaxHeight].
+	float MinHeight = 0.0f;
+	float MaxHeight = 1.0f;
+	// Cells per tile side. Tiles store one more sample each way so bilinear lookups never
+	// straddle two; the default makes a tile exactly two 64 KB views.
+	uint32_t TileSize = 255;
+};
+
+struct HeightmapStats
+{
+	uint64_t TileLoads = 0;
+	uint64_t TileEvictions = 0;
+	uint32_t ResidentTiles = 0;
+	uint32_t PeakResidentTiles = 0;
+	size_t ResidentBytes = 0;
+	size_t PeakResidentBytes = 0;
+	// Process-wide (see MappedFile::QueryProcessMemory), since Open.
+	uint64_t PageFaults = 0;
+};
+
+// Heightmap terrain on disk. The file holds a chain of levels, each half the resolution of
+// the one below (every other sample, so a coarse level's samples sit exactly on finer
+// ones), cut into square tiles at view-aligned offsets. Open maps nothing up front: a tile
+// is mapped on the first lookup that needs it and the least recently used tiles are
+// unmapped to stay inside the memory budget, so resident memory is bounded whatever the
+// size of the map.
+//
+// Lookups are bilinear and clamped at the edges, and are safe from any number of threads.
+class HeightmapTerrain
+{
+public:
+	static constexpr uint32_t MaxLevels = 16;
+
+	// Writes a heightmap of desc sampled from height, a row of tiles at a time. Coarser
+	// levels are read back from the file as they're built, so memory stays at a couple of
+	// rows of tiles.
+	static bool Write(const string& path, const HeightmapDesc& desc, const TerrainHeightFunc& height,
+		ThreadPool* pool = nullptr);
+
+	HeightmapTerrain() = default;
+	HeightmapTerrain(const HeightmapTerrain& rhs) = delete;
+	HeightmapTerrain& operator=(const HeightmapTerrain& rhs) = delete;
+	~HeightmapTerrain();
+
+	// At least one tile is kept mapped whatever memoryBudget says.
+	bool Open(const string& path, size_t memoryBudget = 64ull << 20);
+	void Close();
+
+	// Counterparts of LandUtility::GetHillsHeight and GetHillsNormal, on a given level.
+	float GetHeight(float x, float z, uint32_t level = 0) const;
+	Float3 GetNormal(float x, float z, uint32_t level = 0) const;
+	void GetHeights(const float* x, const float* z, size_t count, float* heights, uint32_t level = 0) const;
+
+	const HeightmapDesc& Desc() const { return mDesc; }
+	uint32_t LevelCount() const { return mLevelCount; }
+	uint32_t LevelWidth(uint32_t level) const { return mLevels[level].Width; }
+	uint32_t LevelHeight(uint32_t level) const { return mLevels[level].Height; }
+	float LevelCellSize(uint32_t level) const { return mDesc.CellSize * (float)(1u << level); }
+	size_t TileBytes() const { return mTileBytes; }
+
+	HeightmapStats Stats() const;
+
+private:
+	// Mapped and unmapped from const lookups.
+	struct Tile
+	{
+		mutable const uint16_t* Samples = nullptr;
+		// mClock when last used; the smallest is evicted first.
+		mutable atomic<uint64_t> LastUse{ 0 };
+	};
+
+	struct Level
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t TilesX = 0;
+		uint32_t TilesZ = 0;
+		uint64_t Offset = 0;
+		vector<Tile> Tiles;
+	};
+
+	// Where a lookup lands: a tile and the cell and fraction inside it.
+	struct Lookup
+	{
+		uint32_t TileIndex;
+		uint32_t I;
+		uint32_t J;
+		float U;
+		float V;
+	};
+
+	Lookup Locate(float x, float z, uint32_t level) const;
+	float Bilinear(const uint16_t* samples, const Lookup& lookup) const;
+	// Samples the tile, mapping it if needed; takes the lock itself.
+	float Sample(uint32_t level, const Lookup& lookup) const;
+	// With mMutex held exclusively.
+	const uint16_t* LoadTile(uint32_t level, uint32_t tile) const;
+
+	HeightmapDesc mDesc;
+	uint32_t mLevelCount = 0;
+	Level mLevels[MaxLevels];
+	size_t mTileBytes = 0;
+	uint32_t mTileBudget = 0;
+
+	mutable MappedFile mFile;
+	// Shared for lookups into mapped tiles, exclusive to map or unmap one.
+	mutable shared_mutex mMutex;
+	mutable atomic<uint64_t> mClock{ 0 };
+	mutable vector<pair<uint32_t, uint32_t>> mResident;
+	mutable HeightmapStats mStats;
+	ProcessMemoryCounters mOpenCounters;
+};
@@ -0,0 +1,546 @@
+#include "InstanceBvh.h"
+#include "OcclusionBuffer.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+	// Deep enough for any tree Build makes: past this depth nodes become leaves.
+	const uint32_t MaxDepth = 64;
+
+	struct Box
+	{
+		Float3 Min = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+		Float3 Max = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		void Grow(const Float3& p)
+		{
+			Min = Float3(min(Min.x, p.x), min(Min.y, p.y), min(Min.z, p.z));
+			Max = Float3(max(Max.x, p.x), max(Max.y, p.y), max(Max.z, p.z));
+		}
+
+		void Grow(const Box& b)
+		{
+			Grow(b.Min);
+			Grow(b.Max);
+		}
+
+		// Half the surface area, which is all SAH needs.
+		float HalfArea() const
+		{
+			if (Min.x > Max.x)
+			{
+				return 0.0f;
+			}
+			Float3 d = Max - Min;
+			return d.x * d.y + d.y * d.z + d.z * d.x;
+		}
+	};
+
+	float Axis(const Float3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	float NodeArea(const BvhNode& node)
+	{
+		const Float3& e = node.Extents;
+		return 4.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	// A node's share of the SAH cost before dividing by the root's area: one unit per visit,
+	// or per instance tested for leaves.
+	double WeightedArea(const BvhNode& node)
+	{
+		return (double)NodeArea(node) * (node.Right == 0 ? node.Count : 1u);
+	}
+
+	// Returns false if the box is outside one of the planes in mask; clears the planes the
+	// box is entirely inside, which its children then skip.
+	bool TestPlanes(const FrustumPlanes& frustum, const Float3& center, const Float3& extents, uint32_t& mask)
+	{
+		for (uint32_t p = 0; p < 6; ++p)
+		{
+			if ((mask & (1u << p)) == 0)
+			{
+				continue;
+			}
+
+			const Float4& plane = frustum.Planes[p];
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = fabsf(plane.x) * extents.x + fabsf(plane.y) * extents.y + fabsf(plane.z) * extents.z;
+
+			if (distance + radius < 0.0f)
+			{
+				return false;
+			}
+			if (distance - radius >= 0.0f)
+			{
+				mask &= ~(1u << p);
+			}
+		}
+
+		return true;
+	}
+
+	// The clusters CullSubtreeOccluded finds in the frustum, then the ones occlusion leaves.
+	thread_local vector<uint32_t> tClusters;
+}
+
+void InstanceBvh::Build(const BoundsSoA& bounds)
+{
+	uint32_t count = bounds.Count();
+
+	mItems.resize(count);
+	mSlotOf.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		mItems[i].Index = i;
+		mSlotOf[i] = i;
+		CopyItem(bounds, i);
+	}
+
+	mNodes.clear();
+	mNodes.reserve(max(1u, 2 * count));
+
+	mParents.clear();
+	mParents.reserve(max(1u, 2 * count));
+
+	struct Pending
+	{
+		uint32_t First;
+		uint32_t Count;
+		uint32_t Depth;
+		uint32_t Parent;
+		bool IsRight;
+	};
+	vector<Pending> pending = { { 0, count, 0, 0, false } };
+
+	while (!pending.empty())
+	{
+		Pending item = pending.back();
+		pending.pop_back();
+
+		uint32_t nodeIndex = (uint32_t)mNodes.size();
+		if (item.IsRight)
+		{
+			mNodes[item.Parent].Right = nodeIndex;
+		}
+
+		BvhNode node;
+		node.First = item.First;
+		node.Count = item.Count;
+		mNodes.push_back(node);
+		mParents.push_back(item.Parent);
+		UpdateNode(nodeIndex);
+
+		if (item.Count <= MaxLeafSize || item.Depth + 1 >= MaxDepth)
+		{
+			continue;
+		}
+
+		Box centroids;
+		for (uint32_t i = item.First; i < item.First + item.Count; ++i)
+		{
+			centroids.Grow(mItems[i].Center);
+		}
+
+		// The right child is pushed first so the left one is built next, right after its
+		// parent; Right is patched once the right child is reached.
+		uint32_t leftCount = SplitNode(mItems.data() + item.First, item.Count, centroids.Min, centroids.Max);
+		pending.push_back({ item.First + leftCount, item.Count - leftCount, item.Depth + 1, nodeIndex, true });
+		pending.push_back({ item.First, leftCount, item.Depth + 1, nodeIndex, false });
+	}
+
+	mIndices.resize(count);
+	mLeafOf.resize(count);
+	mItemBounds.Resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		mItemBounds.Set(i, mItems[i].Center, mItems[i].Extents);
+	}
+
+	for (uint32_t n = 0; n < (uint32_t)mNodes.size(); ++n)
+	{
+		const BvhNode& node = mNodes[n];
+		if (node.Right != 0)
+		{
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+		{
+			mIndices[i] = mItems[i].Index;
+			mSlotOf[mItems[i].Index] = i;
+			mLeafOf[mItems[i].Index] = n;
+		}
+	}
+
+	// Leaf boxes were computed before the final layout but not changed by it; internal
+	// nodes were too, so the weighted area is summed once here.
+	mWeightedArea = 0.0;
+	for (const auto& node : mNodes)
+	{
+		mWeightedArea += WeightedArea(node);
+	}
+
+	mDirty.assign(mNodes.size(), 0);
+	mBuildCost = Cost();
+
+	mClusterNodes.clear();
+	CollectSubtrees(OcclusionClusterSize, mClusterNodes);
+	mClusterBounds.Resize((uint32_t)mClusterNodes.size());
+	UpdateClusterBounds();
+}
+
+uint32_t InstanceBvh::SplitNode(Item* items, uint32_t count, const Float3& centroidMin, const Float3& centroidMax)
+{
+	Float3 size = centroidMax - centroidMin;
+	int axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+	float axisMin = Axis(centroidMin, axis);
+	float axisSize = Axis(size, axis);
+
+	// Every centroid in one spot: no plane separates them, so halve the list.
+	if (axisSize <= 0.0f)
+	{
+		return count / 2;
+	}
+
+	float binScale = BinCount / axisSize;
+
+	Box binBoxes[BinCount];
+	uint32_t binCounts[BinCount] = {};
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Float3 center = items[i].Center;
+		Float3 extents = items[i].Extents;
+		uint32_t bin = min(BinCount - 1, (uint32_t)((Axis(center, axis) - axisMin) * binScale));
+
+		Box& binBox = binBoxes[bin];
+		binBox.Min = Float3(min(binBox.Min.x, center.x - extents.x), min(binBox.Min.y, center.y - extents.y), min(binBox.Min.z, center.z - extents.z));
+		binBox.Max = Float3(max(binBox.Max.x, center.x + extents.x), max(binBox.Max.y, center.y + extents.y), max(binBox.Max.z, center.z + extents.z));
+		++binCounts[bin];
+	}
+
+	// Cost of splitting after bin b: area(left) * count(left) + area(right) * count(right).
+	float leftCosts[BinCount - 1];
+	Box sweep;
+	uint32_t sweepCount = 0;
+	for (uint32_t b = 0; b < BinCount - 1; ++b)
+	{
+		sweep.Grow(binBoxes[b]);
+		sweepCount += binCounts[b];
+		leftCosts[b] = sweep.HalfArea() * sweepCount;
+	}
+
+	float bestCost = FLT_MAX;
+	uint32_t bestBin = 0;
+	sweep = Box();
+	sweepCount = 0;
+	for (uint32_t b = BinCount - 1; b > 0; --b)
+	{
+		sweep.Grow(binBoxes[b]);
+		sweepCount += binCounts[b];
+		float cost = leftCosts[b - 1] + sweep.HalfArea() * sweepCount;
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestBin = b - 1;
+		}
+	}
+
+	float split = axisMin + (bestBin + 1) / binScale;
+	Item* middle = partition(items, items + count, [&](const Item& item) { return Axis(item.Center, axis) < split; });
+	uint32_t leftCount = (uint32_t)(middle - items);
+
+	// The first and last bins both hold a centroid, so this only guards rounding at the split.
+	if (leftCount == 0 || leftCount == count)
+	{
+		return count / 2;
+	}
+
+	return leftCount;
+}
+
+void InstanceBvh::CopyItem(const BoundsSoA& bounds, uint32_t index)
+{
+	uint32_t slot = mSlotOf[index];
+	Item& item = mItems[slot];
+	item.Center = Float3(bounds.CenterX()[index], bounds.CenterY()[index], bounds.CenterZ()[index]);
+	item.Extents = Float3(bounds.ExtentX()[index], bounds.ExtentY()[index], bounds.ExtentZ()[index]);
+
+	// Build fills these once the items have their final slots.
+	if (slot < mItemBounds.Count())
+	{
+		mItemBounds.Set(slot, item.Center, item.Extents);
+	}
+}
+
+void InstanceBvh::UpdateNode(uint32_t nodeIndex)
+{
+	BvhNode& node = mNodes[nodeIndex];
+	mWeightedArea -= WeightedArea(node);
+
+	Box box;
+	if (node.Right == 0)
+	{
+		for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+		{
+			box.Grow(mItems[i].Center - mItems[i].Extents);
+			box.Grow(mItems[i].Center + mItems[i].Extents);
+		}
+	}
+	else
+	{
+		for (uint32_t child : { nodeIndex + 1, node.Right })
+		{
+			const BvhNode& childNode = mNodes[child];
+			box.Grow(childNode.Center - childNode.Extents);
+			box.Grow(childNode.Center + childNode.Extents);
+		}
+	}
+
+	if (node.Count == 0)
+	{
+		box.Min = box.Max = Float3(0.0f, 0.0f, 0.0f);
+	}
+
+	node.Center = (box.Min + box.Max) * 0.5f;
+	node.Extents = (box.Max - box.Min) * 0.5f;
+	mWeightedArea += WeightedArea(node);
+}
+
+void InstanceBvh::Refit(const BoundsSoA& bounds)
+{
+	assert(bounds.Count() == mItems.size());
+
+	for (uint32_t i = 0; i < bounds.Count(); ++i)
+	{
+		CopyItem(bounds, i);
+	}
+
+	// Children always come after their parent.
+	for (size_t i = mNodes.size(); i-- > 0;)
+	{
+		UpdateNode((uint32_t)i);
+	}
+
+	UpdateClusterBounds();
+}
+
+void InstanceBvh::Refit(const BoundsSoA& bounds, const uint32_t* moved, uint32_t movedCount)
+{
+	assert(bounds.Count() == mItems.size());
+
+	// Mark the path from each moved instance's leaf to the root, stopping where another
+	// instance's path already went.
+	for (uint32_t i = 0; i < movedCount; ++i)
+	{
+		CopyItem(bounds, moved[i]);
+
+		uint32_t node = mLeafOf[moved[i]];
+		while (!mDirty[node])
+		{
+			mDirty[node] = 1;
+			if (node == 0)
+			{
+				break;
+			}
+			node = mParents[node];
+		}
+	}
+
+	for (size_t i = mNodes.size(); i-- > 0;)
+	{
+		if (mDirty[i])
+		{
+			UpdateNode((uint32_t)i);
+			mDirty[i] = 0;
+		}
+	}
+
+	UpdateClusterBounds();
+}
+
+void InstanceBvh::UpdateClusterBounds()
+{
+	for (uint32_t c = 0; c < (uint32_t)mClusterNodes.size(); ++c)
+	{
+		const BvhNode& node = mNodes[mClusterNodes[c]];
+		mClusterBounds.Set(c, node.Center, node.Extents);
+	}
+}
+
+float InstanceBvh::Cost() const
+{
+	float rootArea = mNodes.empty() ? 0.0f : NodeArea(mNodes[0]);
+	return rootArea > 0.0f ? (float)(mWeightedArea / rootArea) : 0.0f;
+}
+
+uint32_t InstanceBvh::CullSubtreeOccluded(const FrustumPlanes& frustum, const OcclusionBuffer& occlusion, uint32_t root,
+	uint32_t* visible, BvhCullStats* stats, OcclusionStats* occlusionStats, const Float3& offset) const
+{
+	BvhCullStats counts;
+
+	if (mItems.empty())
+	{
+		return 0;
+	}
+
+	// Clusters are in tree order, so the subtree's are the run covering its items.
+	const BvhNode& rootNode = mNodes[root];
+	auto firstItem = [this](uint32_t clusterNode, uint32_t first) { return mNodes[clusterNode].First < first; };
+	uint32_t begin = (uint32_t)(lower_bound(mClusterNodes.begin(), mClusterNodes.end(), rootNode.First, firstItem) - mClusterNodes.begin());
+	uint32_t end = (uint32_t)(lower_bound(mClusterNodes.begin() + begin, mClusterNodes.end(), rootNode.First + rootNode.Count, firstItem) -
+		mClusterNodes.begin());
+	assert(begin < end && mNodes[mClusterNodes[begin]].First == rootNode.First);
+
+	// BatchCulling starts on a whole SIMD group; clusters before the run are dropped again.
+	uint32_t alignedBegin = begin / SimdWidth * SimdWidth;
+	tClusters.resize(end - alignedBegin + SimdWidth);
+	uint32_t clusterCount = BatchCulling::Cull(frustum, mClusterBounds, alignedBegin, end, tClusters.data());
+	uint32_t skipped = (uint32_t)(lower_bound(tClusters.begin(), tClusters.begin() + clusterCount, begin) - tClusters.begin());
+	uint32_t* clusters = tClusters.data() + skipped;
+	clusterCount -= skipped;
+
+	counts.NodesVisited += end - begin;
+	counts.NodesOutside += end - begin - clusterCount;
+
+	uint32_t visibleClusterCount = occlusion.FilterVisible(mClusterBounds, clusters, clusterCount, occlusionStats, offset);
+	counts.NodesOccluded += clusterCount - visibleClusterCount;
+
+	// The visible clusters' instances in the frustum, as slots into mItems for now.
+	uint32_t slotCount = 0;
+	for (uint32_t c = 0; c < visibleClusterCount; ++c)
+	{
+		const BvhNode& node = mNodes[mClusterNodes[clusters[c]]];
+
+		uint32_t mask = 0x3f;
+		TestPlanes(frustum, node.Center, node.Extents, mask);
+		if (mask == 0)
+		{
+			++counts.NodesInside;
+			for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+			{
+				visible[slotCount++] = i;
+			}
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+		{
+			uint32_t instanceMask = mask;
+			visible[slotCount] = i;
+			slotCount += TestPlanes(frustum, mItems[i].Center, mItems[i].Extents, instanceMask) ? 1 : 0;
+		}
+		counts.InstancesTested += node.Count;
+	}
+
+	uint32_t visibleCount = occlusion.FilterVisible(mItemBounds, visible, slotCount, occlusionStats, offset);
+	for (uint32_t i = 0; i < visibleCount; ++i)
+	{
+		visible[i] = mIndices[visible[i]];
+	}
+
+	if (stats)
+	{
+		stats->Add(counts);
+	}
+
+	return visibleCount;
+}
+
+void InstanceBvh::CollectSubtrees(uint32_t maxCount, vector<uint32_t>& roots) const
+{
+	if (mItems.empty())
+	{
+		return;
+	}
+
+	uint32_t stack[MaxDepth + 1];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		uint32_t nodeIndex = stack[--stackSize];
+		const BvhNode& node = mNodes[nodeIndex];
+
+		if (node.Count <= maxCount || node.Right == 0)
+		{
+			roots.push_back(nodeIndex);
+			continue;
+		}
+
+		stack[stackSize++] = node.Right;
+		stack[stackSize++] = nodeIndex + 1;
+	}
+}
+
+uint32_t InstanceBvh::CullSubtree(const FrustumPlanes& frustum, uint32_t root, uint32_t* visible, BvhCullStats* stats) const
+{
+	BvhCullStats counts;
+	uint32_t visibleCount = 0;
+
+	if (mItems.empty())
+	{
+		return 0;
+	}
+
+	struct Entry
+	{
+		uint32_t Node;
+		uint32_t Mask;
+	};
+	Entry stack[MaxDepth + 1];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { root, 0x3f };
+
+	while (stackSize > 0)
+	{
+		Entry entry = stack[--stackSize];
+		const BvhNode& node = mNodes[entry.Node];
+		++counts.NodesVisited;
+
+		uint32_t mask = entry.Mask;
+		if (!TestPlanes(frustum, node.Center, node.Extents, mask))
+		{
+			++counts.NodesOutside;
+			continue;
+		}
+
+		if (mask == 0)
+		{
+			++counts.NodesInside;
+			memcpy(visible + visibleCount, mIndices.data() + node.First, node.Count * sizeof(uint32_t));
+			visibleCount += node.Count;
+			continue;
+		}
+
+		if (node.Right != 0)
+		{
+			stack[stackSize++] = { node.Right, mask };
+			stack[stackSize++] = { entry.Node + 1, mask };
+			continue;
+		}
+
+		for (uint32_t i = node.First; i < node.First + node.Count; ++i)
+		{
+			uint32_t instanceMask = mask;
+			visible[visibleCount] = mItems[i].Index;
+			visibleCount += TestPlanes(frustum, mItems[i].Center, mItems[i].Extents, instanceMask) ? 1 : 0;
+		}
+		counts.InstancesTested += node.Count;
+	}
+
+	if (stats)
+	{
+		stats->Add(counts);
+	}
+
+	return visibleCount;
+}
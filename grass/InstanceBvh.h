@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BatchCulling.h"
+
+using namespace std;
+
+class OcclusionBuffer;
+struct OcclusionStats;
+
+struct BvhNode
+{
+	Float3 Center;
+	// Every node covers Indices[First, First + Count), so a subtree found fully inside the
+	// frustum is accepted with one copy.
+	uint32_t First = 0;
+	Float3 Extents;
+	uint32_t Count = 0;
+	// Nodes are laid out depth first: an internal node's left child is the next node and
+	// its right child is Right. 0 for leaves (the root is never a child).
+	uint32_t Right = 0;
+};
+
+struct BvhCullStats
+{
+	uint64_t NodesVisited = 0;
+	// Subtrees accepted without visiting their children.
+	uint64_t NodesInside = 0;
+	uint64_t NodesOutside = 0;
+	// Clusters dropped because the occlusion buffer hides their box.
+	uint64_t NodesOccluded = 0;
+	// Instance boxes tested in leaves that straddle the frustum.
+	uint64_t InstancesTested = 0;
+
+	void Add(const BvhCullStats& other)
+	{
+		NodesVisited += other.NodesVisited;
+		NodesInside += other.NodesInside;
+		NodesOutside += other.NodesOutside;
+		NodesOccluded += other.NodesOccluded;
+		InstancesTested += other.InstancesTested;
+	}
+};
+
+// Bounding volume hierarchy over instance AABBs, built top-down with binned SAH. Moving
+// instances are handled by Refit, which keeps the topology and only regrows the boxes on
+// the paths above them; NeedsRebuild says when the refit tree has degraded enough to be
+// worth rebuilding.
+class InstanceBvh
+{
+public:
+	static constexpr uint32_t MaxLeafSize = 4;
+	static constexpr uint32_t BinCount = 16;
+	// Rebuild once the refit tree's SAH cost exceeds the freshly built cost by this much.
+	static constexpr float RebuildCostRatio = 1.5f;
+	// CullSubtreeOccluded tests the frustum and the occlusion buffer against subtrees of at
+	// most this many instances before their instances.
+	static constexpr uint32_t OcclusionClusterSize = 32;
+
+	void Build(const BoundsSoA& bounds);
+	// bounds must hold the same instances Build saw, at their new positions. The first
+	// overload refits every node, the second only the ancestors of the moved instances.
+	void Refit(const BoundsSoA& bounds);
+	void Refit(const BoundsSoA& bounds, const uint32_t* moved, uint32_t movedCount);
+	bool NeedsRebuild() const { return Cost() > RebuildCostRatio * mBuildCost; }
+
+	// Writes the indices of instances whose boxes touch the frustum (in tree order, not
+	// sorted) and returns how many; visible needs room for every instance.
+	uint32_t Cull(const FrustumPlanes& frustum, uint32_t* visible, BvhCullStats* stats = nullptr) const
+	{
+		return CullSubtree(frustum, 0, visible, stats);
+	}
+	// Cull restricted to the subtree under root; visible needs room for its Count instances.
+	uint32_t CullSubtree(const FrustumPlanes& frustum, uint32_t root, uint32_t* visible, BvhCullStats* stats = nullptr) const;
+	// CullSubtree followed by OcclusionBuffer::FilterVisible, with the same result. The tree is
+	// cut into clusters, the largest subtrees of at most OcclusionClusterSize instances, and
+	// their boxes are tested against the frustum and occlusion SimdWidth at a time; only the
+	// instances of visible clusters are tested after that, from the tree's own copy of their
+	// boxes. root must be a cluster or above one, as CollectSubtrees with at least
+	// OcclusionClusterSize gives. Bounds are relative to offset as for FilterVisible, and
+	// occlusionStats counts cluster and instance boxes alike.
+	uint32_t CullSubtreeOccluded(const FrustumPlanes& frustum, const OcclusionBuffer& occlusion, uint32_t root, uint32_t* visible,
+		BvhCullStats* stats = nullptr, OcclusionStats* occlusionStats = nullptr, const Float3& offset = Float3()) const;
+
+	// Splits the tree into disjoint subtrees of at most maxCount instances (or leaves),
+	// appended in depth-first order, so culling them one after another matches Cull.
+	void CollectSubtrees(uint32_t maxCount, vector<uint32_t>& roots) const;
+
+	uint32_t InstanceCount() const { return (uint32_t)mIndices.size(); }
+	const vector<BvhNode>& Nodes() const { return mNodes; }
+	// SAH cost: surface-area weighted node visits and instance tests relative to the root.
+	float Cost() const;
+
+private:
+	// An instance box in tree order.
+	struct Item
+	{
+		Float3 Center;
+		uint32_t Index;
+		Float3 Extents;
+	};
+
+	// Partitions items at the best binned SAH plane over their centroids and returns the size
+	// of the left half.
+	static uint32_t SplitNode(Item* items, uint32_t count, const Float3& centroidMin, const Float3& centroidMax);
+	void CopyItem(const BoundsSoA& bounds, uint32_t index);
+	// Recomputes a node's box from its items or children and keeps mWeightedArea current.
+	void UpdateNode(uint32_t nodeIndex);
+	void UpdateClusterBounds();
+
+	vector<BvhNode> mNodes;
+	vector<uint32_t> mParents;
+	vector<uint8_t> mDirty;
+
+	// Instance boxes are copied in tree order, so leaves read them contiguously instead of
+	// gathering from the caller's streams.
+	vector<Item> mItems;
+	vector<uint32_t> mIndices;
+	// The same boxes laid out for OcclusionBuffer::FilterVisible, by slot.
+	BoundsSoA mItemBounds;
+	// CullSubtreeOccluded's clusters in tree order, as nodes and as boxes.
+	vector<uint32_t> mClusterNodes;
+	BoundsSoA mClusterBounds;
+	// Where each instance is in mItems, and the leaf holding it, by instance index.
+	vector<uint32_t> mSlotOf;
+	vector<uint32_t> mLeafOf;
+
+	// Sum of the node terms of Cost, before dividing by the root's area.
+	double mWeightedArea = 0.0;
+	float mBuildCost = 0.0f;
+};
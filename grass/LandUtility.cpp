@@ -0,0 +1,182 @@
+#include "LandUtility.h"
+#include "AlignedAllocator.h"
+#include "SimdMath.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+	struct HillsOutput
+	{
+		float* Heights;
+		float* NormalX;
+		float* NormalY;
+		float* NormalZ;
+
+		HillsOutput Offset(size_t i) const
+		{
+			return { Heights != nullptr ? Heights + i : nullptr, NormalX != nullptr ? NormalX + i : nullptr,
+				NormalY != nullptr ? NormalY + i : nullptr, NormalZ != nullptr ? NormalZ + i : nullptr };
+		}
+	};
+
+	// GetHillsHeight and GetHillsNormal for SimdWidth points, given sin and cos of 0.1 x and 0.1 z.
+	void StoreHills(SimdFloat x, SimdFloat z, SimdFloat sinX, SimdFloat cosX, SimdFloat sinZ, SimdFloat cosZ,
+		const HillsOutput& out)
+	{
+		if (out.Heights != nullptr)
+		{
+			SimdStoreUnaligned(out.Heights, SimdSplat(0.3f) * (z * sinX + x * cosZ));
+		}
+
+		if (out.NormalX != nullptr || out.NormalY != nullptr || out.NormalZ != nullptr)
+		{
+			SimdFloat nx = SimdSplat(-0.03f) * z * cosX - SimdSplat(0.3f) * cosZ;
+			SimdFloat nz = SimdSplat(0.03f) * x * sinZ - SimdSplat(0.3f) * sinX;
+			SimdFloat invLength = SimdSplat(1.0f) / Sqrt(nx * nx + nz * nz + SimdSplat(1.0f));
+
+			if (out.NormalX != nullptr)
+			{
+				SimdStoreUnaligned(out.NormalX, nx * invLength);
+			}
+			if (out.NormalY != nullptr)
+			{
+				SimdStoreUnaligned(out.NormalY, invLength);
+			}
+			if (out.NormalZ != nullptr)
+			{
+				SimdStoreUnaligned(out.NormalZ, nz * invLength);
+			}
+		}
+	}
+
+	void EvaluateBlock(const float* x, const float* z, const HillsOutput& out)
+	{
+		SimdFloat px = SimdLoadUnaligned(x);
+		SimdFloat pz = SimdLoadUnaligned(z);
+		SimdFloat sinX;
+		SimdFloat cosX;
+		SimdFloat sinZ;
+		SimdFloat cosZ;
+		SinCos(px * SimdSplat(0.1f), sinX, cosX);
+		SinCos(pz * SimdSplat(0.1f), sinZ, cosZ);
+		StoreHills(px, pz, sinX, cosX, sinZ, cosZ, out);
+	}
+
+	// Runs the last partial vector through a padded copy so nothing past count is touched.
+	template <typename Block>
+	void EvaluateTail(size_t count, const HillsOutput& out, Block block)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+
+		float scratch[4][SimdWidth];
+		HillsOutput padded = { out.Heights != nullptr ? scratch[0] : nullptr, out.NormalX != nullptr ? scratch[1] : nullptr,
+			out.NormalY != nullptr ? scratch[2] : nullptr, out.NormalZ != nullptr ? scratch[3] : nullptr };
+		block(padded);
+
+		float* targets[4] = { out.Heights, out.NormalX, out.NormalY, out.NormalZ };
+		for (int k = 0; k < 4; ++k)
+		{
+			if (targets[k] != nullptr)
+			{
+				copy(scratch[k], scratch[k] + count, targets[k]);
+			}
+		}
+	}
+
+	void EvaluateSpan(const float* x, const float* z, size_t count, const HillsOutput& out)
+	{
+		size_t full = count / SimdWidth * SimdWidth;
+		for (size_t i = 0; i < full; i += SimdWidth)
+		{
+			EvaluateBlock(x + i, z + i, out.Offset(i));
+		}
+
+		size_t rest = count - full;
+		EvaluateTail(rest, out.Offset(full), [&](const HillsOutput& padded)
+		{
+			float px[SimdWidth] = {};
+			float pz[SimdWidth] = {};
+			copy(x + full, x + count, px);
+			copy(z + full, z + count, pz);
+			EvaluateBlock(px, pz, padded);
+		});
+	}
+}
+
+void LandUtility::GetHillsHeights(const float* x, const float* z, size_t count, float* heights)
+{
+	EvaluateSpan(x, z, count, { heights, nullptr, nullptr, nullptr });
+}
+
+void LandUtility::GetHillsNormals(const float* x, const float* z, size_t count, float* normalX, float* normalY,
+	float* normalZ)
+{
+	EvaluateSpan(x, z, count, { nullptr, normalX, normalY, normalZ });
+}
+
+void LandUtility::GetHillsGrid(float minX, float minZ, float spacing, uint32_t width, uint32_t height, float* heights,
+	float* normalX, float* normalY, float* normalZ, ThreadPool* pool)
+{
+	if (width == 0 || height == 0)
+	{
+		return;
+	}
+
+	// The x column of every row, and its trig, padded to whole vectors.
+	size_t padded = ((size_t)width + SimdWidth - 1) / SimdWidth * SimdWidth;
+	AlignedVector<float> xs(padded, 0.0f);
+	AlignedVector<float> sinX(padded);
+	AlignedVector<float> cosX(padded);
+	for (uint32_t i = 0; i < width; ++i)
+	{
+		xs[i] = minX + i * spacing;
+	}
+	for (size_t i = 0; i < padded; i += SimdWidth)
+	{
+		SimdFloat s;
+		SimdFloat c;
+		SinCos(SimdLoad(&xs[i]) * SimdSplat(0.1f), s, c);
+		SimdStore(&sinX[i], s);
+		SimdStore(&cosX[i], c);
+	}
+
+	HillsOutput grid = { heights, normalX, normalY, normalZ };
+	size_t full = width / SimdWidth * SimdWidth;
+
+	auto evaluateRow = [&](uint32_t j)
+	{
+		float rowZ = minZ + j * spacing;
+		SimdFloat z = SimdSplat(rowZ);
+		SimdFloat sinZ;
+		SimdFloat cosZ;
+		SinCos(z * SimdSplat(0.1f), sinZ, cosZ);
+
+		HillsOutput row = grid.Offset((size_t)j * width);
+		auto block = [&](size_t i, const HillsOutput& out)
+		{
+			StoreHills(SimdLoad(&xs[i]), z, SimdLoad(&sinX[i]), SimdLoad(&cosX[i]), sinZ, cosZ, out);
+		};
+
+		for (size_t i = 0; i < full; i += SimdWidth)
+		{
+			block(i, row.Offset(i));
+		}
+		EvaluateTail(width - full, row.Offset(full), [&](const HillsOutput& out) { block(full, out); });
+	};
+
+	if (pool != nullptr)
+	{
+		pool->ParallelFor(height, evaluateRow);
+	}
+	else
+	{
+		for (uint32_t j = 0; j < height; ++j)
+		{
+			evaluateRow(j);
+		}
+	}
+}
@@ -1,8 +1,23 @@
 #pragma once
-#include "D3DUtil.h"
 
-using namespace DirectX;
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "SimMath.h"
 
+using namespace std;
+
+class ThreadPool;
+
+// Terrain sources with state (HeightmapTerrain) bind through lambdas; plain functions such
+// as LandUtility::GetHillsHeight convert directly.
+typedef function<float(float, float)> TerrainHeightFunc;
+// heights[i] = height at (x[i], z[i]) for count points.
+typedef function<void(const float* x, const float* z, size_t count, float* heights)> TerrainHeightBatchFunc;
+
+// Analytic hills terrain shared by the land mesh and the grass scattering. Portable so
+// the headless tools can place blades on it too.
 class LandUtility
 {
 public:
@@ -11,15 +26,26 @@ public:
 		return 0.3f * (z * sinf(0.1f * x) + x * cosf(0.1f * z));
 	}
 
-	static XMFLOAT3 GetHillsNormal(float x, float z)
+	static Float3 GetHillsNormal(float x, float z)
 	{
-		XMFLOAT3 n(
+		Float3 n(
 			-0.03f * z * cosf(0.1f * x) - 0.3f * cosf(0.1f * z),
 			1.0f,
 			-0.3f * sinf(0.1f * x) + 0.03f * x * sinf(0.1f * z));
 
-		XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
-		XMStoreFloat3(&n, unitNormal);
-		return n;
+		return Normalize(n);
 	}
+
+	// Batch forms over SoA spans, SimdWidth points at a time with the polynomial SinCos from
+	// SimdMath.h. They agree with the scalar functions to within the polynomials' error
+	// (about 1e-7 of the amplitude for |x|, |z| < 80 km), not bit for bit.
+	static void GetHillsHeights(const float* x, const float* z, size_t count, float* heights);
+	static void GetHillsNormals(const float* x, const float* z, size_t count, float* normalX, float* normalY,
+		float* normalZ);
+
+	// A width x height grid of samples spacing apart with (minX, minZ) first, row-major.
+	// Any output may be null. Rows are spread over pool when there is one; the trig along x is
+	// shared by every row, so this is cheaper per point than the span forms.
+	static void GetHillsGrid(float minX, float minZ, float spacing, uint32_t width, uint32_t height, float* heights,
+		float* normalX, float* normalY, float* normalZ, ThreadPool* pool = nullptr);
 };
@@ -0,0 +1,186 @@
+#include "MappedFile.h"
+#include <cassert>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const string& path)
+{
+	Close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+	{
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mSize = (uint64_t)size.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mMapping != nullptr)
+	{
+		CloseHandle(mMapping);
+		mMapping = nullptr;
+	}
+	if (mFile != nullptr)
+	{
+		CloseHandle(mFile);
+		mFile = nullptr;
+	}
+	mSize = 0;
+}
+
+const void* MappedFile::Map(uint64_t offset, size_t size)
+{
+	assert(offset % ViewAlignment == 0);
+
+	if (mMapping == nullptr || size == 0 || offset + size > mSize)
+	{
+		return nullptr;
+	}
+
+	return MapViewOfFile(mMapping, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)offset, size);
+}
+
+void MappedFile::Unmap(const void* view, size_t size)
+{
+	if (view != nullptr)
+	{
+		UnmapViewOfFile(view);
+	}
+}
+
+ProcessMemoryCounters MappedFile::QueryProcessMemory()
+{
+	ProcessMemoryCounters counters;
+	PROCESS_MEMORY_COUNTERS info;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info)))
+	{
+		counters.PageFaults = info.PageFaultCount;
+		counters.ResidentBytes = info.WorkingSetSize;
+	}
+	return counters;
+}
+
+#else
+
+bool MappedFile::Open(const string& path)
+{
+	Close();
+
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size <= 0)
+	{
+		close(file);
+		return false;
+	}
+
+	mFile = file;
+	mSize = (uint64_t)info.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (mFile >= 0)
+	{
+		close(mFile);
+		mFile = -1;
+	}
+	mSize = 0;
+}
+
+const void* MappedFile::Map(uint64_t offset, size_t size)
+{
+	assert(offset % ViewAlignment == 0);
+
+	if (mFile < 0 || size == 0 || offset + size > mSize)
+	{
+		return nullptr;
+	}
+
+	void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, mFile, (off_t)offset);
+	return view != MAP_FAILED ? view : nullptr;
+}
+
+void MappedFile::Unmap(const void* view, size_t size)
+{
+	if (view != nullptr)
+	{
+		munmap(const_cast<void*>(view), size);
+	}
+}
+
+ProcessMemoryCounters MappedFile::QueryProcessMemory()
+{
+	ProcessMemoryCounters counters;
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		counters.PageFaults = (uint64_t)usage.ru_minflt + (uint64_t)usage.ru_majflt;
+	}
+
+	// Second field of statm is the resident page count; only on Linux.
+	if (FILE* statm = fopen("/proc/self/statm", "r"))
+	{
+		unsigned long long pages = 0;
+		unsigned long long resident = 0;
+		if (fscanf(statm, "%llu %llu", &pages, &resident) == 2)
+		{
+			counters.ResidentBytes = resident * (uint64_t)sysconf(_SC_PAGESIZE);
+		}
+		fclose(statm);
+	}
+
+	return counters;
+}
+
+#endif
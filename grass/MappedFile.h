@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+// Page fault and working-set figures for the whole process, from GetProcessMemoryInfo on
+// Windows and getrusage / procfs elsewhere. ResidentBytes is 0 where it can't be read.
+struct ProcessMemoryCounters
+{
+	uint64_t PageFaults = 0;
+	uint64_t ResidentBytes = 0;
+};
+
+// A read-only file mapped in views. Each view is its own mapping, so memory stays bounded
+// by what's mapped at once however large the file is; unmapping a view lets the OS drop
+// its pages from the process.
+class MappedFile
+{
+public:
+	// View offsets must be multiples of this: the allocation granularity on Windows, which
+	// covers the page size everywhere else.
+	static const uint64_t ViewAlignment = 64 * 1024;
+
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	bool Open(const string& path);
+	void Close();
+
+	bool IsOpen() const { return mSize > 0; }
+	uint64_t Size() const { return mSize; }
+
+	// Null if the range isn't inside the file or the mapping fails.
+	const void* Map(uint64_t offset, size_t size);
+	void Unmap(const void* view, size_t size);
+
+	static ProcessMemoryCounters QueryProcessMemory();
+
+private:
+#if defined(_WIN32)
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+	uint64_t mSize = 0;
+};
@@ -0,0 +1,148 @@
+#include "MeshIndexUtil.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+bool MeshIndexUtil::SplitRanges16(const vector<uint32_t>& indices, uint32_t begin, uint32_t end, uint32_t primitiveSize,
+	vector<MeshIndexRange>& ranges)
+{
+	uint32_t rangeStart = begin;
+	uint32_t rangeMin = UINT32_MAX;
+	uint32_t rangeMax = 0;
+
+	for (uint32_t i = begin; i < end; i += primitiveSize)
+	{
+		uint32_t primitiveMin = UINT32_MAX;
+		uint32_t primitiveMax = 0;
+		for (uint32_t k = i; k < min(i + primitiveSize, end); ++k)
+		{
+			primitiveMin = min(primitiveMin, indices[k]);
+			primitiveMax = max(primitiveMax, indices[k]);
+		}
+
+		if (primitiveMax - primitiveMin >= MaxVertexSpan16)
+		{
+			return false;
+		}
+
+		uint32_t newMin = min(rangeMin, primitiveMin);
+		uint32_t newMax = max(rangeMax, primitiveMax);
+
+		if (newMax - newMin >= MaxVertexSpan16)
+		{
+			ranges.push_back({ rangeStart, i - rangeStart, (int32_t)rangeMin });
+			rangeStart = i;
+			newMin = primitiveMin;
+			newMax = primitiveMax;
+		}
+
+		rangeMin = newMin;
+		rangeMax = newMax;
+	}
+
+	if (end > rangeStart)
+	{
+		ranges.push_back({ rangeStart, end - rangeStart, (int32_t)rangeMin });
+	}
+
+	return true;
+}
+
+PackedMeshIndices MeshIndexUtil::Pack(const vector<uint32_t>& indices, uint32_t primitiveSize, bool allowSplit)
+{
+	return PackSubmeshes(indices, { { 0, (uint32_t)indices.size() } }, primitiveSize, allowSplit);
+}
+
+PackedMeshIndices MeshIndexUtil::PackSubmeshes(const vector<uint32_t>& indices, const vector<pair<uint32_t, uint32_t>>& submeshes,
+	uint32_t primitiveSize, bool allowSplit)
+{
+	assert(primitiveSize > 0);
+
+	PackedMeshIndices packed;
+
+	// Try 16-bit first: every submesh has to cut into few enough ranges.
+	bool fits16 = true;
+	size_t primitiveCount = 0;
+
+	for (const auto& submesh : submeshes)
+	{
+		packed.SubmeshRanges.push_back((uint32_t)packed.Ranges.size());
+		primitiveCount += submesh.second / primitiveSize;
+
+		size_t firstRange = packed.Ranges.size();
+		if (!SplitRanges16(indices, submesh.first, submesh.first + submesh.second, primitiveSize, packed.Ranges) ||
+			(!allowSplit && packed.Ranges.size() - firstRange > 1))
+		{
+			fits16 = false;
+			break;
+		}
+	}
+
+	size_t extraRanges = packed.Ranges.size() - min(packed.Ranges.size(), submeshes.size());
+	if (fits16 && extraRanges > primitiveCount / MinPrimitivesPerRange)
+	{
+		fits16 = false;
+	}
+
+	if (fits16)
+	{
+		packed.SubmeshRanges.push_back((uint32_t)packed.Ranges.size());
+		packed.IndexSize = 2;
+		packed.Bytes.resize(indices.size() * sizeof(uint16_t));
+		uint16_t* out = reinterpret_cast<uint16_t*>(packed.Bytes.data());
+
+		for (const auto& range : packed.Ranges)
+		{
+			for (uint32_t i = range.StartIndex; i < range.StartIndex + range.IndexCount; ++i)
+			{
+				out[i] = (uint16_t)(indices[i] - (uint32_t)range.BaseVertex);
+			}
+		}
+
+		return packed;
+	}
+
+	packed.IndexSize = 4;
+	packed.Ranges.clear();
+	packed.SubmeshRanges.clear();
+
+	for (const auto& submesh : submeshes)
+	{
+		packed.SubmeshRanges.push_back((uint32_t)packed.Ranges.size());
+		packed.Ranges.push_back({ submesh.first, submesh.second, 0 });
+	}
+	packed.SubmeshRanges.push_back((uint32_t)packed.Ranges.size());
+
+	packed.Bytes.resize(indices.size() * sizeof(uint32_t));
+	memcpy(packed.Bytes.data(), indices.data(), packed.Bytes.size());
+
+	return packed;
+}
+
+vector<uint32_t> MeshIndexUtil::Unpack(const PackedMeshIndices& packed)
+{
+	vector<uint32_t> indices;
+	indices.reserve(packed.IndexCount());
+
+	for (const auto& range : packed.Ranges)
+	{
+		for (uint32_t i = range.StartIndex; i < range.StartIndex + range.IndexCount; ++i)
+		{
+			uint32_t index = 0;
+			if (packed.IndexSize == 2)
+			{
+				uint16_t index16;
+				memcpy(&index16, packed.Bytes.data() + (size_t)i * 2, sizeof(index16));
+				index = index16;
+			}
+			else
+			{
+				memcpy(&index, packed.Bytes.data() + (size_t)i * 4, sizeof(index));
+			}
+
+			indices.push_back(index + (uint32_t)range.BaseVertex);
+		}
+	}
+
+	return indices;
+}
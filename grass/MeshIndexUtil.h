@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// One draw's worth of a packed index buffer: DrawIndexedInstanced(IndexCount, ..,
+// StartIndex, BaseVertex, ..).
+struct MeshIndexRange
+{
+	uint32_t StartIndex = 0;
+	uint32_t IndexCount = 0;
+	int32_t BaseVertex = 0;
+};
+
+struct PackedMeshIndices
+{
+	// 2 (R16_UINT) or 4 (R32_UINT) bytes per index.
+	uint32_t IndexSize = 2;
+	vector<uint8_t> Bytes;
+
+	// Submesh s draws Ranges[SubmeshRanges[s]] up to Ranges[SubmeshRanges[s + 1]].
+	vector<MeshIndexRange> Ranges;
+	vector<uint32_t> SubmeshRanges;
+
+	size_t IndexCount() const { return Bytes.size() / IndexSize; }
+};
+
+// Picks the narrowest index format a mesh can use. 16-bit indices are relative to a base
+// vertex, so a mesh whose vertices span more than 65536 is cut into ranges of whole
+// primitives that each fit and drawn one range at a time. Meshes that won't cut into
+// reasonably large ranges (no vertex locality) get 32-bit indices.
+class MeshIndexUtil
+{
+public:
+	static constexpr uint32_t MaxVertexSpan16 = 65536;
+	// Below this many primitives per range on average, the extra draws cost more than the
+	// index bandwidth 16-bit saves.
+	static constexpr uint32_t MinPrimitivesPerRange = 1024;
+
+	// indices hold absolute vertex indices. Without allowSplit every submesh must be a
+	// single draw (e.g. when the shader relies on SV_PrimitiveID).
+	static PackedMeshIndices Pack(const vector<uint32_t>& indices, uint32_t primitiveSize = 3, bool allowSplit = true);
+	// submeshes are (first index, index count) spans of indices sharing one buffer and format.
+	static PackedMeshIndices PackSubmeshes(const vector<uint32_t>& indices, const vector<pair<uint32_t, uint32_t>>& submeshes,
+		uint32_t primitiveSize = 3, bool allowSplit = true);
+
+	// Absolute vertex indices of every range in order; the inverse of Pack.
+	static vector<uint32_t> Unpack(const PackedMeshIndices& packed);
+
+private:
+	// Greedily grows ranges over [begin, end) while their vertex span fits in 16 bits.
+	// Returns false if a single primitive spans too much.
+	static bool SplitRanges16(const vector<uint32_t>& indices, uint32_t begin, uint32_t end, uint32_t primitiveSize,
+		vector<MeshIndexRange>& ranges);
+};
@@ -8,6 +8,50 @@
 class MeshUtil
 {
 public:
+	// Uploads packed indices into geo and sets its index format.
+	static void SetIndices(
+		MeshGeometry* geo,
+		const PackedMeshIndices& packed,
+		ID3D12Device* d3dDevice,
+		ID3D12GraphicsCommandList* cmdList)
+	{
+		const UINT ibByteSize = (UINT)packed.Bytes.size();
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), packed.Bytes.data(), ibByteSize);
+
+		geo->IndexBufferGPU = D3DUtil::CreateDefaultBuffer(d3dDevice,
+			cmdList, packed.Bytes.data(), ibByteSize, geo->IndexBufferUploader);
+
+		geo->IndexFormat = packed.IndexSize == 2 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		geo->IndexBufferByteSize = ibByteSize;
+	}
+
+	static SubmeshGeometry GetSubmesh(const PackedMeshIndices& packed, uint32_t submeshIndex)
+	{
+		uint32_t first = packed.SubmeshRanges[submeshIndex];
+		uint32_t last = packed.SubmeshRanges[submeshIndex + 1];
+
+		SubmeshGeometry submesh;
+		if (first < last)
+		{
+			submesh.StartIndexLocation = packed.Ranges[first].StartIndex;
+			submesh.BaseVertexLocation = packed.Ranges[first].BaseVertex;
+		}
+
+		for (uint32_t i = first; i < last; ++i)
+		{
+			submesh.IndexCount += packed.Ranges[i].IndexCount;
+		}
+
+		if (last - first > 1)
+		{
+			submesh.Ranges.assign(packed.Ranges.begin() + first, packed.Ranges.begin() + last);
+		}
+
+		return submesh;
+	}
+
 	static unique_ptr<MeshGeometry> CreateMesh(
 		string name,
 		map<string, GeometryGenerator::MeshData> meshs,
@@ -16,42 +60,43 @@ public:
 	{
 		UINT vertexOffset = 0;
 		UINT indexOffset = 0;
-		UINT totalVertexCount = 0;
 
-		map<string, SubmeshGeometry> submeshs;
+		// Indices are made absolute so the packer can pick 16-bit ranges across submeshes.
+		vector<pair<uint32_t, uint32_t>> submeshs;
 
 		for (auto& meshPair : meshs)
 		{
 			auto& mesh = meshPair.second;
-			SubmeshGeometry submesh;
-			submesh.IndexCount = (UINT)mesh.Indices32.size();
-			submesh.StartIndexLocation = indexOffset;
-			submesh.BaseVertexLocation = vertexOffset;
-
-			submeshs[meshPair.first] = submesh;
+			submeshs.push_back({ indexOffset, (uint32_t)mesh.Indices32.size() });
 
 			indexOffset += (UINT)mesh.Indices32.size();
 			vertexOffset += (UINT)mesh.Vertices.size();
 		}
 
 		vector<Vertex> vertices(vertexOffset);
-		vector<uint16_t> indices;
+		vector<uint32_t> indices;
+		indices.reserve(indexOffset);
 		UINT index = 0;
 
 		for (auto& meshPair : meshs)
 		{
 			auto& mesh = meshPair.second;
+			UINT baseVertex = index;
 			for (size_t i = 0; i < mesh.Vertices.size(); ++i, ++index)
 			{
 				vertices[index].Pos = mesh.Vertices[i].Position;
 				vertices[index].Normal = mesh.Vertices[i].Normal;
 				vertices[index].TexC = mesh.Vertices[i].TexC;
 			}
-			indices.insert(indices.end(), begin(mesh.GetIndices16()), end(mesh.GetIndices16()));
+			for (uint32_t i : mesh.Indices32)
+			{
+				indices.push_back(baseVertex + i);
+			}
 		}
 
+		PackedMeshIndices packed = MeshIndexUtil::PackSubmeshes(indices, submeshs);
+
 		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-		const UINT ibByteSize = (UINT)indices.size() * sizeof(uint16_t);
 
 		auto geo = make_unique<MeshGeometry>();
 		geo->Name = name;
@@ -59,23 +104,18 @@ public:
 		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
 		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
-		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
 		geo->VertexBufferGPU = D3DUtil::CreateDefaultBuffer(d3dDevice,
 			cmdList, vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
-		geo->IndexBufferGPU = D3DUtil::CreateDefaultBuffer(d3dDevice,
-			cmdList, indices.data(), ibByteSize, geo->IndexBufferUploader);
-
 		geo->VertexByteStride = sizeof(Vertex);
 		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
-		geo->IndexBufferByteSize = ibByteSize;
 
-		for (auto& submesh : submeshs)
+		SetIndices(geo.get(), packed, d3dDevice, cmdList);
+
+		uint32_t submeshIndex = 0;
+		for (auto& meshPair : meshs)
 		{
-			geo->DrawArgs[submesh.first] = submesh.second;
+			geo->DrawArgs[meshPair.first] = GetSubmesh(packed, submeshIndex++);
 		}
 
 		return geo;
@@ -0,0 +1,721 @@
+#include "OcclusionBuffer.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+
+namespace
+{
+	// Pixel centre offsets of the lanes of one SIMD group.
+	alignas(32) const float LaneCenters[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+
+	Float4 TransformClip(const Float3& p, const Float4x4& m)
+	{
+		return Float4(
+			p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+			p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+			p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+			p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3]);
+	}
+
+	Float4 Lerp(const Float4& a, const Float4& b, float t)
+	{
+		return Float4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+	}
+}
+
+void OcclusionBuffer::Initialize(uint32_t width, uint32_t height)
+{
+	mWidth = (width + SimdWidth - 1) / SimdWidth * SimdWidth;
+	mHeight = height;
+
+	mLevels.clear();
+	uint32_t levelWidth = mWidth;
+	uint32_t levelHeight = mHeight;
+	while (true)
+	{
+		Level level;
+		level.Width = levelWidth;
+		level.Height = levelHeight;
+		level.Far.assign((size_t)levelWidth * levelHeight, 1.0f);
+		level.Near.assign((size_t)levelWidth * levelHeight, 1.0f);
+		mLevels.push_back(move(level));
+
+		if (levelWidth == 1 && levelHeight == 1)
+		{
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+}
+
+void OcclusionBuffer::BeginFrame(const Float4x4& viewProj)
+{
+	mViewProj = viewProj;
+	mOccluders.clear();
+}
+
+void OcclusionBuffer::AddOccluder(const OccluderMesh& mesh)
+{
+	mOccluders.push_back(&mesh);
+}
+
+void OcclusionBuffer::Render(ThreadPool* pool)
+{
+	auto dispatch = [pool](uint32_t count, const function<void(uint32_t)>& body)
+	{
+		if (pool && pool->ThreadCount() > 1 && count > 1)
+		{
+			pool->ParallelFor(count, body);
+			return;
+		}
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			body(i);
+		}
+	};
+
+	// Vertices to clip space.
+	size_t vertexCount = 0;
+	for (const OccluderMesh* mesh : mOccluders)
+	{
+		vertexCount += mesh->Vertices.size();
+	}
+	mClipVertices.resize(vertexCount);
+
+	size_t firstVertex = 0;
+	for (const OccluderMesh* mesh : mOccluders)
+	{
+		uint32_t meshVertices = (uint32_t)mesh->Vertices.size();
+		Float4* out = mClipVertices.data() + firstVertex;
+
+		dispatch((meshVertices + SetupChunkSize - 1) / SetupChunkSize, [&](uint32_t chunk)
+		{
+			uint32_t end = min(meshVertices, (chunk + 1) * SetupChunkSize);
+			for (uint32_t i = chunk * SetupChunkSize; i < end; ++i)
+			{
+				out[i] = TransformClip(mesh->Vertices[i], mViewProj);
+			}
+		});
+
+		firstVertex += meshVertices;
+	}
+
+	// Triangles are clipped, projected and binned into bands in chunks, each chunk with
+	// its own bins so chunks never share output. Bands then walk the chunks in order, which
+	// keeps the result independent of the thread count.
+	mSetupJobs.clear();
+	firstVertex = 0;
+	for (const OccluderMesh* mesh : mOccluders)
+	{
+		uint32_t triangleCount = (uint32_t)(mesh->Indices.size() / 3);
+		for (uint32_t first = 0; first < triangleCount; first += SetupChunkSize)
+		{
+			mSetupJobs.push_back({ mesh, firstVertex, first, min(first + SetupChunkSize, triangleCount) });
+		}
+		firstVertex += mesh->Vertices.size();
+	}
+
+	uint32_t bandCount = (mHeight + BandRows - 1) / BandRows;
+	if (mSetupChunks.size() < mSetupJobs.size())
+	{
+		mSetupChunks.resize(mSetupJobs.size());
+	}
+
+	dispatch((uint32_t)mSetupJobs.size(), [&](uint32_t j)
+	{
+		const SetupJob& job = mSetupJobs[j];
+		SetupChunk& chunk = mSetupChunks[j];
+		chunk.Triangles.clear();
+		chunk.Bands.resize(bandCount);
+		for (auto& band : chunk.Bands)
+		{
+			band.clear();
+		}
+
+		const Float4* clip = mClipVertices.data() + job.FirstVertex;
+		const uint32_t* indices = job.Mesh->Indices.data();
+		for (uint32_t t = job.Begin; t < job.End; ++t)
+		{
+			Float4 triangle[3] = { clip[indices[3 * t]], clip[indices[3 * t + 1]], clip[indices[3 * t + 2]] };
+			SetupTriangle(triangle, chunk);
+		}
+	});
+
+	dispatch(bandCount, [this](uint32_t band) { RasterizeBand(band); });
+
+	BuildPyramid();
+}
+
+void OcclusionBuffer::SetupTriangle(const Float4* clip, SetupChunk& chunk) const
+{
+	// Trivially outside one clip plane (far included: nothing there can occlude).
+	auto allOutside = [clip](auto outside) { return outside(clip[0]) && outside(clip[1]) && outside(clip[2]); };
+	if (allOutside([](const Float4& v) { return v.x > v.w; }) ||
+		allOutside([](const Float4& v) { return v.x < -v.w; }) ||
+		allOutside([](const Float4& v) { return v.y > v.w; }) ||
+		allOutside([](const Float4& v) { return v.y < -v.w; }) ||
+		allOutside([](const Float4& v) { return v.z > v.w; }) ||
+		allOutside([](const Float4& v) { return v.z < 0.0f; }))
+	{
+		return;
+	}
+
+	if (clip[0].z >= 0.0f && clip[1].z >= 0.0f && clip[2].z >= 0.0f)
+	{
+		EmitTriangle(clip[0], clip[1], clip[2], chunk);
+		return;
+	}
+
+	// Clip against the near plane z = 0, which leaves a triangle or a quad.
+	Float4 polygon[4];
+	int polygonSize = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		const Float4& a = clip[i];
+		const Float4& b = clip[(i + 1) % 3];
+
+		if (a.z >= 0.0f)
+		{
+			polygon[polygonSize++] = a;
+		}
+		if ((a.z >= 0.0f) != (b.z >= 0.0f))
+		{
+			polygon[polygonSize++] = Lerp(a, b, a.z / (a.z - b.z));
+		}
+	}
+
+	for (int i = 1; i + 1 < polygonSize; ++i)
+	{
+		EmitTriangle(polygon[0], polygon[i], polygon[i + 1], chunk);
+	}
+}
+
+void OcclusionBuffer::EmitTriangle(const Float4& a, const Float4& b, const Float4& c, SetupChunk& chunk) const
+{
+	float x[3];
+	float y[3];
+	float z[3];
+	const Float4* vertices[3] = { &a, &b, &c };
+	for (int i = 0; i < 3; ++i)
+	{
+		const Float4& v = *vertices[i];
+		float invW = 1.0f / v.w;
+		x[i] = (v.x * invW * 0.5f + 0.5f) * mWidth;
+		y[i] = (0.5f - v.y * invW * 0.5f) * mHeight;
+		z[i] = v.z * invW;
+	}
+
+	// Pixels whose centres the bounding box holds; distant triangles often hold none.
+	float minX = max(0.0f, ceilf(min(x[0], min(x[1], x[2])) - 0.5f));
+	float maxX = min((float)mWidth - 1.0f, floorf(max(x[0], max(x[1], x[2])) - 0.5f));
+	float minY = max(0.0f, ceilf(min(y[0], min(y[1], y[2])) - 0.5f));
+	float maxY = min((float)mHeight - 1.0f, floorf(max(y[0], max(y[1], y[2])) - 0.5f));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	// Counter-clockwise in pixel space, so inside is where every edge function is positive.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (fabsf(area) < 1e-6f)
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		swap(x[1], x[2]);
+		swap(y[1], y[2]);
+		swap(z[1], z[2]);
+		area = -area;
+	}
+
+	// Everything is relative to vertex 0: NDC depth of distant triangles sits just under 1,
+	// and plane equations in absolute pixel coordinates would cancel away its precision.
+	// Edge i is opposite vertex i: E(dx, dy) = A dx + B dy + C, positive inside.
+	ScreenTriangle t;
+	t.X0 = x[0];
+	t.Y0 = y[0];
+	t.Z0 = z[0];
+	for (int i = 0; i < 3; ++i)
+	{
+		int j = (i + 1) % 3;
+		int k = (i + 2) % 3;
+		t.EdgeA[i] = y[j] - y[k];
+		t.EdgeB[i] = x[k] - x[j];
+		t.EdgeC[i] = t.EdgeA[i] * (x[0] - x[j]) + t.EdgeB[i] * (y[0] - y[j]);
+	}
+
+	float invArea = 1.0f / area;
+	t.DepthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * invArea;
+	t.DepthB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) * invArea;
+
+	t.MinX = (uint32_t)minX / SimdWidth * SimdWidth;
+	t.MaxX = (uint32_t)maxX;
+	t.MinY = (uint32_t)minY;
+	t.MaxY = (uint32_t)maxY;
+
+	uint32_t index = (uint32_t)chunk.Triangles.size();
+	chunk.Triangles.push_back(t);
+	for (uint32_t band = t.MinY / BandRows; band <= t.MaxY / BandRows; ++band)
+	{
+		chunk.Bands[band].push_back(index);
+	}
+}
+
+void OcclusionBuffer::RasterizeBand(uint32_t band)
+{
+	float* depth = mLevels[0].Far.data();
+	uint32_t rowBegin = band * BandRows;
+	uint32_t rowEnd = min(mHeight, rowBegin + BandRows);
+
+	fill(depth + (size_t)rowBegin * mWidth, depth + (size_t)rowEnd * mWidth, 1.0f);
+
+	SimdFloat laneCenters = SimdLoad(LaneCenters);
+	SimdFloat zero = SimdZero();
+
+	for (size_t j = 0; j < mSetupJobs.size(); ++j)
+	{
+		const SetupChunk& chunk = mSetupChunks[j];
+		for (uint32_t index : chunk.Bands[band])
+		{
+			const ScreenTriangle& t = chunk.Triangles[index];
+			SimdFloat edgeA0 = SimdSplat(t.EdgeA[0]);
+			SimdFloat edgeA1 = SimdSplat(t.EdgeA[1]);
+			SimdFloat edgeA2 = SimdSplat(t.EdgeA[2]);
+			SimdFloat depthA = SimdSplat(t.DepthA);
+
+			uint32_t y0 = max(rowBegin, t.MinY);
+			uint32_t y1 = min(rowEnd - 1, t.MaxY);
+			for (uint32_t y = y0; y <= y1; ++y)
+			{
+				float dy = (float)y + 0.5f - t.Y0;
+				SimdFloat rowE0 = SimdSplat(t.EdgeB[0] * dy + t.EdgeC[0]);
+				SimdFloat rowE1 = SimdSplat(t.EdgeB[1] * dy + t.EdgeC[1]);
+				SimdFloat rowE2 = SimdSplat(t.EdgeB[2] * dy + t.EdgeC[2]);
+				SimdFloat rowZ = SimdSplat(t.Z0 + t.DepthB * dy);
+				float* row = depth + (size_t)y * mWidth;
+
+				for (uint32_t x = t.MinX; x <= t.MaxX; x += SimdWidth)
+				{
+					SimdFloat dx = SimdSplat((float)x - t.X0) + laneCenters;
+					SimdMask inside = (edgeA0 * dx + rowE0 >= zero) & (edgeA1 * dx + rowE1 >= zero) & (edgeA2 * dx + rowE2 >= zero);
+
+					if (MaskBits(inside) == 0)
+					{
+						continue;
+					}
+
+					SimdFloat z = depthA * dx + rowZ;
+					SimdFloat current = SimdLoad(row + x);
+					SimdStore(row + x, Select(inside, Min(z, current), current));
+				}
+			}
+		}
+	}
+}
+
+void OcclusionBuffer::BuildPyramid()
+{
+	Level& base = mLevels[0];
+	copy(base.Far.begin(), base.Far.end(), base.Near.begin());
+
+	for (size_t l = 1; l < mLevels.size(); ++l)
+	{
+		const Level& src = mLevels[l - 1];
+		Level& dst = mLevels[l];
+
+		for (uint32_t y = 0; y < dst.Height; ++y)
+		{
+			uint32_t sy0 = 2 * y;
+			uint32_t sy1 = min(2 * y + 1, src.Height - 1);
+
+			for (uint32_t x = 0; x < dst.Width; ++x)
+			{
+				uint32_t sx0 = 2 * x;
+				uint32_t sx1 = min(2 * x + 1, src.Width - 1);
+
+				size_t i00 = (size_t)sy0 * src.Width + sx0;
+				size_t i01 = (size_t)sy0 * src.Width + sx1;
+				size_t i10 = (size_t)sy1 * src.Width + sx0;
+				size_t i11 = (size_t)sy1 * src.Width + sx1;
+
+				size_t d = (size_t)y * dst.Width + x;
+				dst.Far[d] = max(max(src.Far[i00], src.Far[i01]), max(src.Far[i10], src.Far[i11]));
+				dst.Near[d] = min(min(src.Near[i00], src.Near[i01]), min(src.Near[i10], src.Near[i11]));
+			}
+		}
+	}
+}
+
+bool OcclusionBuffer::IsRectVisible(float minX, float maxX, float minY, float maxY, float minZ) const
+{
+	// In front of every occluder on screen.
+	if (minZ <= mLevels.back().Near[0])
+	{
+		return true;
+	}
+
+	// Off screen is for the frustum test to decide.
+	if (maxX < 0.0f || maxY < 0.0f || minX >= (float)mWidth || minY >= (float)mHeight)
+	{
+		return true;
+	}
+
+	// Every pixel the rectangle overlaps and one more around it: coverage is sampled at pixel
+	// centres, so a pixel on an occluder's silhouette can be partly open, and then the open
+	// side shows in the neighbour. Then the level where that is at most 2x2 texels.
+	uint32_t x0 = (uint32_t)max(0.0f, floorf(minX) - 1.0f);
+	uint32_t y0 = (uint32_t)max(0.0f, floorf(minY) - 1.0f);
+	uint32_t x1 = (uint32_t)min((float)mWidth - 1.0f, floorf(maxX) + 1.0f);
+	uint32_t y1 = (uint32_t)min((float)mHeight - 1.0f, floorf(maxY) + 1.0f);
+
+	uint32_t l = 0;
+	while ((x1 >> l) - (x0 >> l) > 1 || (y1 >> l) - (y0 >> l) > 1)
+	{
+		++l;
+	}
+
+	const Level& level = mLevels[l];
+	for (uint32_t y = y0 >> l; y <= y1 >> l; ++y)
+	{
+		for (uint32_t x = x0 >> l; x <= x1 >> l; ++x)
+		{
+			if (minZ <= level.Far[(size_t)y * level.Width + x])
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool OcclusionBuffer::IsVisible(const Float3& center, const Float3& extents) const
+{
+	float minX = FLT_MAX;
+	float maxX = -FLT_MAX;
+	float minY = FLT_MAX;
+	float maxY = -FLT_MAX;
+	float minZ = FLT_MAX;
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		Float3 p(
+			center.x + ((corner & 1) ? extents.x : -extents.x),
+			center.y + ((corner & 2) ? extents.y : -extents.y),
+			center.z + ((corner & 4) ? extents.z : -extents.z));
+		Float4 clip = TransformClip(p, mViewProj);
+
+		// Crossing the near plane: the box reaches the camera, keep it.
+		if (clip.z < 0.0f || clip.w <= 0.0f)
+		{
+			return true;
+		}
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+		float y = (0.5f - clip.y * invW * 0.5f) * mHeight;
+		minX = min(minX, x);
+		maxX = max(maxX, x);
+		minY = min(minY, y);
+		maxY = max(maxY, y);
+		minZ = min(minZ, clip.z * invW);
+	}
+
+	return IsRectVisible(minX, maxX, minY, maxY, minZ);
+}
+
+uint32_t OcclusionBuffer::FilterVisible(const BoundsSoA& bounds, uint32_t* indices, uint32_t count, OcclusionStats* stats,
+	const Float3& offset) const
+{
+	// Boxes are projected SimdWidth at a time: a corner's clip position is the centre's plus
+	// or minus each extent times its matrix row. The centre plus or minus the x term and the
+	// y term plus or minus the z term are shared, so each corner costs one add per coordinate
+	// and a divide; the corners' lowest z and w are the centre's minus the extents times the
+	// absolute rows, which settles the near plane up front.
+	SimdFloat m[4][4];
+	SimdFloat absM[3][4];
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			m[r][c] = SimdSplat(mViewProj.m[r][c]);
+			if (r < 3)
+			{
+				absM[r][c] = SimdSplat(fabsf(mViewProj.m[r][c]));
+			}
+		}
+	}
+
+	uint32_t tailIndices[SimdWidth];
+	alignas(32) float texelX0[SimdWidth];
+	alignas(32) float texelY0[SimdWidth];
+	alignas(32) float texelX1[SimdWidth];
+	alignas(32) float texelY1[SimdWidth];
+	alignas(32) float texelLevel[SimdWidth];
+	alignas(32) float nearestZ[SimdWidth];
+
+	SimdFloat zero = SimdZero();
+	SimdFloat one = SimdSplat(1.0f);
+	SimdFloat width = SimdSplat((float)mWidth);
+	SimdFloat height = SimdSplat((float)mHeight);
+	SimdFloat halfWidth = SimdSplat(0.5f * mWidth);
+	SimdFloat halfHeight = SimdSplat(0.5f * mHeight);
+	uint32_t levelCount = LevelCount();
+	int fullMask = (1 << SimdWidth) - 1;
+	uint32_t visibleCount = 0;
+
+	for (uint32_t first = 0; first < count; first += SimdWidth)
+	{
+		uint32_t lanes = min((uint32_t)SimdWidth, count - first);
+		const uint32_t* group = indices + first;
+		if (lanes < (uint32_t)SimdWidth)
+		{
+			// Spare lanes repeat the first box.
+			for (uint32_t lane = 0; lane < (uint32_t)SimdWidth; ++lane)
+			{
+				tailIndices[lane] = indices[first + (lane < lanes ? lane : 0)];
+			}
+			group = tailIndices;
+		}
+
+		SimdFloat cx = SimdGather(bounds.CenterX(), group) + SimdSplat(offset.x);
+		SimdFloat cy = SimdGather(bounds.CenterY(), group) + SimdSplat(offset.y);
+		SimdFloat cz = SimdGather(bounds.CenterZ(), group) + SimdSplat(offset.z);
+		SimdFloat ex = SimdGather(bounds.ExtentX(), group);
+		SimdFloat ey = SimdGather(bounds.ExtentY(), group);
+		SimdFloat ez = SimdGather(bounds.ExtentZ(), group);
+
+		// [0] and [1]: centre plus and minus the x term; [2] and [3]: y term plus and minus
+		// the z term.
+		SimdFloat partX[4][4];
+		SimdFloat partYZ[4][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			SimdFloat center = cx * m[0][c] + cy * m[1][c] + cz * m[2][c] + m[3][c];
+			SimdFloat axisX = ex * m[0][c];
+			SimdFloat axisY = ey * m[1][c];
+			SimdFloat axisZ = ez * m[2][c];
+			partX[c][0] = center + axisX;
+			partX[c][1] = center - axisX;
+			partYZ[c][0] = axisY + axisZ;
+			partYZ[c][1] = axisY - axisZ;
+			partYZ[c][2] = -partYZ[c][1];
+			partYZ[c][3] = -partYZ[c][0];
+		}
+
+		// Crossing the near plane: the box reaches the camera, keep it. Otherwise every
+		// corner has w > 0.
+		SimdFloat lowZ = cx * m[0][2] + cy * m[1][2] + cz * m[2][2] + m[3][2] - (ex * absM[0][2] + ey * absM[1][2] + ez * absM[2][2]);
+		SimdFloat lowW = cx * m[0][3] + cy * m[1][3] + cz * m[2][3] + m[3][3] - (ex * absM[0][3] + ey * absM[1][3] + ez * absM[2][3]);
+		SimdMask nearPlane = (lowZ < zero) | (lowW <= zero);
+
+		SimdFloat minX = SimdSplat(FLT_MAX);
+		SimdFloat maxX = SimdSplat(-FLT_MAX);
+		SimdFloat minY = SimdSplat(FLT_MAX);
+		SimdFloat maxY = SimdSplat(-FLT_MAX);
+		SimdFloat minZ = SimdSplat(FLT_MAX);
+
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			int x = corner & 1;
+			int yz = corner >> 1;
+			SimdFloat invW = one / (partX[3][x] + partYZ[3][yz]);
+			SimdFloat px = (partX[0][x] + partYZ[0][yz]) * invW;
+			SimdFloat py = (partX[1][x] + partYZ[1][yz]) * invW;
+			minX = Min(minX, px);
+			maxX = Max(maxX, px);
+			minY = Min(minY, py);
+			maxY = Max(maxY, py);
+			minZ = Min(minZ, (partX[2][x] + partYZ[2][yz]) * invW);
+		}
+
+		// NDC to pixels; y flips, so the top of the rectangle comes from the largest y.
+		SimdFloat rectMinX = (minX + one) * halfWidth;
+		SimdFloat rectMaxX = (maxX + one) * halfWidth;
+		SimdFloat rectMinY = (one - maxY) * halfHeight;
+		SimdFloat rectMaxY = (one - minY) * halfHeight;
+
+		// As IsRectVisible: off screen is for the frustum test, otherwise the pixels the
+		// rectangle overlaps and one more around, read at the first level where that is at
+		// most 2x2 texels.
+		SimdMask keep = nearPlane | (rectMaxX < zero) | (rectMaxY < zero) | (rectMinX >= width) | (rectMinY >= height);
+		// Lanes already kept read texel 0 of level 0, whatever their rectangle.
+		SimdFloat x0 = Select(keep, zero, Max(zero, Floor(rectMinX) - one));
+		SimdFloat y0 = Select(keep, zero, Max(zero, Floor(rectMinY) - one));
+		SimdFloat x1 = Select(keep, zero, Min(width - one, Floor(rectMaxX) + one));
+		SimdFloat y1 = Select(keep, zero, Min(height - one, Floor(rectMaxY) + one));
+
+		// Texel coordinates are exact small integers, so x >> l is Floor(x * 2^-l).
+		SimdFloat level = zero;
+		SimdFloat scale = one;
+		SimdMask found = (x1 - x0 <= one) & (y1 - y0 <= one);
+		SimdFloat levelScale = SimdSplat(0.5f);
+		for (uint32_t l = 1; l < levelCount && MaskBits(found) != fullMask; ++l)
+		{
+			SimdMask fits = (Floor(x1 * levelScale) - Floor(x0 * levelScale) <= one) &
+				(Floor(y1 * levelScale) - Floor(y0 * levelScale) <= one);
+			level = Select(found, level, Select(fits, SimdSplat((float)l), level));
+			scale = Select(found, scale, Select(fits, levelScale, scale));
+			found = found | fits;
+			levelScale = levelScale * SimdSplat(0.5f);
+		}
+
+		SimdStore(texelX0, Floor(x0 * scale));
+		SimdStore(texelY0, Floor(y0 * scale));
+		SimdStore(texelX1, Floor(x1 * scale));
+		SimdStore(texelY1, Floor(y1 * scale));
+		SimdStore(texelLevel, level);
+		SimdStore(nearestZ, minZ);
+		int keepBits = MaskBits(keep);
+
+		for (uint32_t lane = 0; lane < lanes; ++lane)
+		{
+			const Level& level = mLevels[(uint32_t)texelLevel[lane]];
+			const float* row0 = level.Far.data() + (size_t)texelY0[lane] * level.Width;
+			const float* row1 = level.Far.data() + (size_t)texelY1[lane] * level.Width;
+			uint32_t tx0 = (uint32_t)texelX0[lane];
+			uint32_t tx1 = (uint32_t)texelX1[lane];
+			float farthest = max(max(row0[tx0], row0[tx1]), max(row1[tx0], row1[tx1]));
+
+			bool visible = ((keepBits >> lane) & 1) != 0 || nearestZ[lane] <= farthest;
+			indices[visibleCount] = indices[first + lane];
+			visibleCount += visible ? 1 : 0;
+		}
+	}
+
+	if (stats)
+	{
+		OcclusionStats counts;
+		counts.Tested = count;
+		counts.Occluded = count - visibleCount;
+		stats->Add(counts);
+	}
+
+	return visibleCount;
+}
+
+bool OcclusionBuffer::WriteImage(const string& filename, uint32_t level, bool nearDepth) const
+{
+	const Level& source = mLevels[level];
+	const AlignedVector<float>& depth = nearDepth ? source.Near : source.Far;
+
+	// NDC depth crowds towards 1. With the far plane well beyond the near one, 1 - z is
+	// about inversely proportional to distance, so grey is the log of distance over the
+	// range the occluders cover.
+	float nearest = 1.0f;
+	float farthest = 0.0f;
+	for (float d : depth)
+	{
+		if (d < 1.0f)
+		{
+			nearest = min(nearest, d);
+			farthest = max(farthest, d);
+		}
+	}
+	float range = logf((1.0f - nearest) / max(1e-7f, 1.0f - farthest));
+	float scale = range > 0.0f ? 254.0f / range : 0.0f;
+
+	vector<uint8_t> pixels(depth.size());
+	for (size_t i = 0; i < depth.size(); ++i)
+	{
+		pixels[i] = depth[i] >= 1.0f ? 255 : (uint8_t)min(254.0f, logf((1.0f - nearest) / max(1e-7f, 1.0f - depth[i])) * scale);
+	}
+
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "P5\n%u %u\n255\n", source.Width, source.Height);
+	bool ok = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+	fclose(file);
+	return ok;
+}
+
+OccluderMesh OcclusionBuffer::BuildTerrainOccluder(const TerrainHeightFunc& height, float minX, float minZ, float maxX, float maxZ,
+	uint32_t cellsX, uint32_t cellsZ)
+{
+	uint32_t columns = cellsX + 1;
+	float cellX = (maxX - minX) / cellsX;
+	float cellZ = (maxZ - minZ) / cellsZ;
+
+	vector<float> heights((size_t)columns * (cellsZ + 1));
+	for (uint32_t j = 0; j <= cellsZ; ++j)
+	{
+		for (uint32_t i = 0; i <= cellsX; ++i)
+		{
+			heights[(size_t)j * columns + i] = height(minX + i * cellX, minZ + j * cellZ);
+		}
+	}
+
+	// Each cell is split along the (i + 1, j) - (i, j + 1) diagonal. Sample how far those
+	// triangles rise above the terrain inside the cell.
+	static const float Samples[][2] =
+	{
+		{ 0.5f, 0.5f }, { 0.5f, 0.0f }, { 0.0f, 0.5f }, { 1.0f, 0.5f }, { 0.5f, 1.0f },
+		{ 0.25f, 0.25f }, { 0.75f, 0.25f }, { 0.25f, 0.75f }, { 0.75f, 0.75f },
+	};
+	// On top of the sampled rise, for what the samples miss.
+	const float ExtraDrop = 0.05f;
+
+	vector<float> drops((size_t)columns * (cellsZ + 1), 0.0f);
+	for (uint32_t j = 0; j < cellsZ; ++j)
+	{
+		for (uint32_t i = 0; i < cellsX; ++i)
+		{
+			float h00 = heights[(size_t)j * columns + i];
+			float h10 = heights[(size_t)j * columns + i + 1];
+			float h01 = heights[(size_t)(j + 1) * columns + i];
+			float h11 = heights[(size_t)(j + 1) * columns + i + 1];
+
+			float rise = 0.0f;
+			for (const auto& sample : Samples)
+			{
+				float u = sample[0];
+				float v = sample[1];
+				float planar = u + v <= 1.0f ?
+					h00 + u * (h10 - h00) + v * (h01 - h00) :
+					h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+				rise = max(rise, planar - height(minX + (i + u) * cellX, minZ + (j + v) * cellZ));
+			}
+
+			float drop = rise + ExtraDrop;
+			for (uint32_t corner = 0; corner < 4; ++corner)
+			{
+				size_t vertex = (size_t)(j + (corner >> 1)) * columns + i + (corner & 1);
+				drops[vertex] = max(drops[vertex], drop);
+			}
+		}
+	}
+
+	OccluderMesh mesh;
+	mesh.Vertices.resize(heights.size());
+	for (uint32_t j = 0; j <= cellsZ; ++j)
+	{
+		for (uint32_t i = 0; i <= cellsX; ++i)
+		{
+			size_t vertex = (size_t)j * columns + i;
+			mesh.Vertices[vertex] = Float3(minX + i * cellX, heights[vertex] - drops[vertex], minZ + j * cellZ);
+		}
+	}
+
+	mesh.Indices.reserve((size_t)cellsX * cellsZ * 6);
+	for (uint32_t j = 0; j < cellsZ; ++j)
+	{
+		for (uint32_t i = 0; i < cellsX; ++i)
+		{
+			uint32_t v00 = j * columns + i;
+			uint32_t v10 = v00 + 1;
+			uint32_t v01 = v00 + columns;
+			uint32_t v11 = v01 + 1;
+
+			mesh.Indices.insert(mesh.Indices.end(), { v00, v01, v10, v10, v01, v11 });
+		}
+	}
+
+	return mesh;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AlignedAllocator.h"
+#include "BatchCulling.h"
+#include "LandUtility.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Triangle list in world space.
+struct OccluderMesh
+{
+	vector<Float3> Vertices;
+	vector<uint32_t> Indices;
+};
+
+struct OcclusionStats
+{
+	uint64_t Tested = 0;
+	uint64_t Occluded = 0;
+
+	void Add(const OcclusionStats& other)
+	{
+		Tested += other.Tested;
+		Occluded += other.Occluded;
+	}
+};
+
+// CPU occlusion culling. Occluder meshes are rasterized into a small depth buffer (NDC z,
+// nearest wins), then a pyramid of farthest and nearest depths per 2^k x 2^k block is built.
+// A box is occluded when its nearest point is behind the farthest occluder depth over every
+// pixel its screen rectangle touches, which takes at most 2x2 reads at the right level.
+//
+// Coverage is sampled at pixel centres, so an occluder can claim a pixel it only partly
+// covers. Tests take in one pixel around the box's rectangle for that, and occluders should
+// still sit slightly inside the real surfaces (see BuildTerrainOccluder).
+class OcclusionBuffer
+{
+public:
+	// Rows are rasterized in bands of this many, one task per band.
+	static const uint32_t BandRows = 16;
+	// Vertices transformed and triangles set up per task.
+	static const uint32_t SetupChunkSize = 4096;
+
+	// width is rounded up to a multiple of SimdWidth.
+	void Initialize(uint32_t width = 256, uint32_t height = 128);
+
+	// Starts a frame: forgets the occluders and sets the view the next Render uses.
+	void BeginFrame(const Float4x4& viewProj);
+	// The mesh must stay alive until Render.
+	void AddOccluder(const OccluderMesh& mesh);
+	// Rasterizes every occluder and builds the pyramid. With pool null everything runs on
+	// the calling thread.
+	void Render(ThreadPool* pool);
+
+	bool IsVisible(const Float3& center, const Float3& extents) const;
+	// Keeps the instances in indices[0, count) whose boxes may be visible, in order, and
+	// returns how many. The boxes are relative to offset in the view's coordinates.
+	uint32_t FilterVisible(const BoundsSoA& bounds, uint32_t* indices, uint32_t count, OcclusionStats* stats = nullptr,
+		const Float3& offset = Float3()) const;
+
+	uint32_t Width() const { return mWidth; }
+	uint32_t Height() const { return mHeight; }
+	uint32_t LevelCount() const { return (uint32_t)mLevels.size(); }
+	uint32_t LevelWidth(uint32_t level) const { return mLevels[level].Width; }
+	uint32_t LevelHeight(uint32_t level) const { return mLevels[level].Height; }
+	const float* FarDepth(uint32_t level) const { return mLevels[level].Far.data(); }
+	const float* NearDepth(uint32_t level) const { return mLevels[level].Near.data(); }
+
+	// Writes a pyramid level as a binary PGM: grey is log distance, near black and empty
+	// (depth 1) white.
+	bool WriteImage(const string& filename, uint32_t level, bool nearDepth = false) const;
+
+	// A grid over [minX, maxX] x [minZ, maxZ] with cellsX x cellsZ cells, lowered at every
+	// vertex by the most the triangles rise above the sampled height inside the cells
+	// around it, so the occluder stays under the terrain it stands for.
+	static OccluderMesh BuildTerrainOccluder(const TerrainHeightFunc& height, float minX, float minZ, float maxX, float maxZ,
+		uint32_t cellsX, uint32_t cellsZ);
+
+private:
+	// Edge functions and depth relative to vertex 0, and the pixels the triangle can cover
+	// (MinX aligned down to SimdWidth).
+	struct ScreenTriangle
+	{
+		float X0;
+		float Y0;
+		float Z0;
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA;
+		float DepthB;
+		uint32_t MinX;
+		uint32_t MaxX;
+		uint32_t MinY;
+		uint32_t MaxY;
+	};
+
+	struct SetupJob
+	{
+		const OccluderMesh* Mesh;
+		size_t FirstVertex;
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	// One setup job's triangles, and per band the ones that touch it.
+	struct SetupChunk
+	{
+		vector<ScreenTriangle> Triangles;
+		vector<vector<uint32_t>> Bands;
+	};
+
+	struct Level
+	{
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		AlignedVector<float> Far;
+		AlignedVector<float> Near;
+	};
+
+	void SetupTriangle(const Float4* clip, SetupChunk& chunk) const;
+	void EmitTriangle(const Float4& a, const Float4& b, const Float4& c, SetupChunk& chunk) const;
+	void RasterizeBand(uint32_t band);
+	void BuildPyramid();
+	// The test proper, on a box's screen rectangle (pixels) and nearest NDC depth.
+	bool IsRectVisible(float minX, float maxX, float minY, float maxY, float minZ) const;
+
+	uint32_t mWidth = 0;
+	uint32_t mHeight = 0;
+	Float4x4 mViewProj;
+
+	vector<const OccluderMesh*> mOccluders;
+	vector<Float4> mClipVertices;
+	vector<SetupJob> mSetupJobs;
+	vector<SetupChunk> mSetupChunks;
+
+	// Level 0 is the depth buffer itself.
+	vector<Level> mLevels;
+};
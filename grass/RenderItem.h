@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MathHelper.h"
+#include "SimMath.h"
 #include "UploadBuffer.h"
 
 struct RenderItem
@@ -8,6 +9,10 @@ struct RenderItem
 	RenderItem() = default;
 	RenderItem(const RenderItem& rhs) = delete;
 
+	// World (and every instance's World) places the item relative to Origin. Large worlds
+	// keep Origin near the item so the float translations stay small; each frame they are
+	// rebased onto the camera's render origin.
+	Double3 Origin;
 	XMFLOAT4X4 World = MathHelper::Identity4x4();
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
@@ -22,11 +27,15 @@ struct RenderItem
 
 	BoundingBox Bounds;
 	vector<Instance> Instances;
+	// Bump after changing Instances so culling picks up the new transforms.
+	uint32_t InstancesVersion = 0;
 
 	UINT IndexCount = 0;
 	UINT InstanceCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+	// See SubmeshGeometry::Ranges; drawn one range at a time when set.
+	vector<MeshIndexRange> IndexRanges;
 
 	bool Visible = true;
 };
@@ -37,6 +46,7 @@ enum class RenderLayer : int
 	OpaqueDynamicReflectors,
 	Sky,
 	Grass,
+	Terrain,
 	Count
 	// Mirrors,
 	// Reflected,
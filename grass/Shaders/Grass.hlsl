@@ -10,6 +10,23 @@
 #define NUM_SPOT_LIGHTS 0
 #endif
 
+// Grass field size, set from GrassFieldDesc by GrassFieldUtil::ShaderDefines.
+#ifndef BLADE_COUNT
+#define BLADE_COUNT 32
+#endif
+
+#ifndef BONES_PER_BLADE
+#define BONES_PER_BLADE 5
+#endif
+
+#ifndef GRASS_GROUP_SIZE
+#define GRASS_GROUP_SIZE 64
+#endif
+
+#ifndef GRASS_MAX_VERTEX_COUNT
+#define GRASS_MAX_VERTEX_COUNT (2 + 2 * BONES_PER_BLADE)
+#endif
+
 #include "Common.hlsl"
 #include "QuaternionUtil.hlsl"
 #include "MathUtil.hlsl"
@@ -17,7 +34,13 @@
 cbuffer cbWind : register(b2)
 {
     float3 gWindVelocity;
-    float pad0;
+    float gStepDeltaTime;
+    float gInterpolationAlpha;
+    float2 gWindGridOrigin;
+    float gWindGridInvCellSize;
+    uint gWindGridWidth;
+    uint gWindGridHeight;
+    float2 pad0;
 };
 
 struct Bone
@@ -57,7 +80,8 @@ VertexOut VS(VertexIn vin)
 {
     VertexOut vout = (VertexOut) 0.0f;
     
-    vout.CenterW = vin.PosW;
+    // Roots are in the grass field's frame; gWorld carries it to the camera's.
+    vout.CenterW = mul(float4(vin.PosW, 1.0f), gWorld).xyz;
     vout.SizeW = vin.SizeW;
 
     return vout;
@@ -66,6 +90,123 @@ VertexOut VS(VertexIn vin)
 
 RWStructuredBuffer<Bone> bones : register(u0);
 
+// Bones as they were before the last fixed step; the GS blends towards bones by gInterpolationAlpha.
+StructuredBuffer<Bone> prevBones : register(t0);
+
+// Must match GrassLod and GrassChunkDispatch in GrassSimulation.h / GrassChunks.h.
+#define GRASS_LOD_FULL 0
+#define GRASS_LOD_ROOT 1
+#define GRASS_LOD_SWAY 2
+
+struct ChunkDispatch
+{
+    uint bladeBegin;
+    uint bladeEnd;
+    uint lod;
+    uint swayIndex;
+    uint colliderBegin;
+    uint colliderCount;
+    uint pad1;
+    uint pad2;
+};
+
+// One entry per thread group, integrated chunks first and then sway chunks.
+StructuredBuffer<ChunkDispatch> chunkDispatch : register(t1);
+// BONES_PER_BLADE bones per chunk, stepped on the CPU.
+StructuredBuffer<Bone> swayBones : register(t2);
+// The first blade of every integrated chunk, laid out like swayBones. Read back so a chunk
+// entering sway LOD starts its chain from the blade's GPU state.
+RWStructuredBuffer<Bone> seedBones : register(u1);
+// 1 where every blade of the chunk ended the frame's last step settled, for
+// GrassChunkSimulation::UpdateGpuSleep. Read back like seedBones.
+RWStructuredBuffer<uint> chunkSettled : register(u2);
+
+// Must match GrassSimulation::SleepSpeed and SleepRotation.
+#define GRASS_SLEEP_SPEED 0.001f
+#define GRASS_SLEEP_ROTATION 0.001f
+
+groupshared uint gsChunkAwake;
+
+bool IsBoneSettled(Bone bone)
+{
+    return dot(bone.velocity, bone.velocity) <= GRASS_SLEEP_SPEED * GRASS_SLEEP_SPEED &&
+        dot(bone.localRotation.xyz, bone.localRotation.xyz) <= GRASS_SLEEP_ROTATION * GRASS_SLEEP_ROTATION;
+}
+
+cbuffer cbChunkDispatch : register(b3)
+{
+    uint gChunkOffset;
+};
+
+// WindField velocities: gWindGridWidth * gWindGridHeight x components, then as many z components.
+StructuredBuffer<float> windGrid : register(t3);
+
+// Bilinear and clamped like WindField::Sample.
+float3 SampleWind(float2 posXZ)
+{
+    float2 uv = (posXZ - gWindGridOrigin) * gWindGridInvCellSize;
+    uv = clamp(uv, 0.0f, float2(gWindGridWidth - 1, gWindGridHeight - 1));
+
+    uint2 node = min((uint2)uv, uint2(gWindGridWidth - 2, gWindGridHeight - 2));
+    float2 f = uv - node;
+
+    uint n00 = node.y * gWindGridWidth + node.x;
+    uint n01 = n00 + gWindGridWidth;
+    uint zPlane = gWindGridWidth * gWindGridHeight;
+
+    float x0 = lerp(windGrid[n00], windGrid[n00 + 1], f.x);
+    float x1 = lerp(windGrid[n01], windGrid[n01 + 1], f.x);
+    float z0 = lerp(windGrid[zPlane + n00], windGrid[zPlane + n00 + 1], f.x);
+    float z1 = lerp(windGrid[zPlane + n01], windGrid[zPlane + n01 + 1], f.x);
+
+    return float3(lerp(x0, x1, f.y), 0.0f, lerp(z0, z1, f.y));
+}
+
+// Must match GrassCollider in GrassColliders.h. A sphere has a == b.
+struct Collider
+{
+    float3 a;
+    float radius;
+    float3 b;
+    float pad;
+};
+
+// Colliders referenced by each chunk's colliderBegin/colliderCount range (GrassChunkSimulation::ColliderRefs).
+StructuredBuffer<Collider> colliders : register(t4);
+
+const float K_COLLISION = 200.0f;
+
+// Matches GrassSimulation::CollisionForce: a tip inside a collider is pushed out like wind.
+float3 CollisionForce(float3 tipW, uint colliderBegin, uint colliderCount)
+{
+    float3 force = float3(0.0f, 0.0f, 0.0f);
+
+    for (uint c = colliderBegin; c < colliderBegin + colliderCount; ++c)
+    {
+        Collider collider = colliders[c];
+
+        float3 ab = collider.b - collider.a;
+        float t = saturate(dot(tipW - collider.a, ab) / max(dot(ab, ab), 1e-8f));
+        float3 d = tipW - (collider.a + ab * t);
+        float distanceSq = dot(d, d);
+
+        if (distanceSq < collider.radius * collider.radius && distanceSq > 1e-8f)
+        {
+            float distance = sqrt(distanceSq);
+            force += d * ((collider.radius - distance) / distance * K_COLLISION);
+        }
+    }
+
+    return force;
+}
+
+float3 BoneTip(int boneId, float3 rootW)
+{
+    Bone bone = bones[boneId];
+    float3 upO = normalize(QuaternionRotateOptimized(bone.rotation, float3(0.0f, 1.0f, 0.0f)));
+    return rootW + bone.position + upO * bone.length;
+}
+
 const float K_RESTORE = 50.0f;
 const float K_DAMPING = 10.0f;
 
@@ -84,7 +225,7 @@ void ApplyParent(int boneId)
     bones[boneId].position = bone.position;
 }
 
-void ProcessBone(int boneId)
+void ProcessBone(int boneId, float3 wind)
 {
     Bone bone = bones[boneId];
     float3 upVec = float3(0.0f, 1.0f, 0.0f);
@@ -92,7 +233,7 @@ void ProcessBone(int boneId)
     float3 oUpVec = normalize(QuaternionRotateOptimized(bone.rotation, upVec));
     float3 tailPos = oUpVec * bone.length;
 
-    float3 baseTorque = cross(tailPos, gWindVelocity);
+    float3 baseTorque = cross(tailPos, wind);
 
     float3 restoreTorque = (-bone.localRotation.xyz * 10.0f) - (bone.velocity * 1.0f);
 
@@ -104,14 +245,14 @@ void ProcessBone(int boneId)
     // torque = I * a
     float3 a = torque / I;
 
-    bone.velocity += a * gDeltaTime;
+    bone.velocity += a * gStepDeltaTime;
     
     float speed = length(bone.velocity);
     
     if (speed > 0.001)
     {
         float3 axis = bone.velocity / speed;
-        float angle = speed * gDeltaTime;
+        float angle = speed * gStepDeltaTime;
         
         float4 deltaRotation = AxisAngleToQuaternion(axis, angle);
         bone.localRotation = normalize(QuaternionMultiply(deltaRotation, bone.localRotation));
@@ -123,27 +264,119 @@ void ProcessBone(int boneId)
     bones[boneId].velocity = bone.velocity;
 }
 
-[numthreads(32, 1, 1)]
-void CS(int3 dtid : SV_DispatchThreadID)
+// Returns whether every bone of the blade is settled.
+bool SimulateBlade(int boneId, uint lod, uint colliderBegin, uint colliderCount)
 {
-    int boneId = dtid.x;
+    // The root bone's localPosition holds the blade's world root (GrassSimulation::SetBladeRoots).
+    float3 rootW = bones[boneId].localPosition;
+    float3 wind = gWindVelocity + SampleWind(rootW.xz);
 
-    ProcessBone(boneId);
+    float3 boneWind = wind;
+    if (colliderCount > 0)
+    {
+        boneWind += CollisionForce(BoneTip(boneId, rootW), colliderBegin, colliderCount);
+    }
+
+    ProcessBone(boneId, boneWind);
     Bone bone = bones[boneId];
     bones[boneId].rotation = bone.localRotation;
+    bool settled = IsBoneSettled(bone);
+
+    float4 rootLocalRotation = bone.localRotation;
+    float3 rootVelocity = bone.velocity;
 
         [unroll]
-    for (uint j = 1; j < 5; ++j)
+    for (uint j = 1; j < BONES_PER_BLADE; ++j)
     {
-        int childBoneId = 32 * j + boneId;
+        int childBoneId = BLADE_COUNT * j + boneId;
+
+        // Root LOD: every joint bends like the root instead of being integrated.
+        if (lod == GRASS_LOD_ROOT)
+        {
+            bones[childBoneId].localRotation = rootLocalRotation;
+            bones[childBoneId].velocity = rootVelocity;
+        }
+
         ApplyParent(childBoneId);
-        ProcessBone(childBoneId);
+
+        if (lod == GRASS_LOD_FULL)
+        {
+            boneWind = wind;
+            if (colliderCount > 0)
+            {
+                boneWind += CollisionForce(BoneTip(childBoneId, rootW), colliderBegin, colliderCount);
+            }
+
+            ProcessBone(childBoneId, boneWind);
+        }
+
         bone = bones[childBoneId];
         bones[childBoneId].rotation = QuaternionMultiply(bone.rotation, bone.localRotation);
+        settled = settled && IsBoneSettled(bone);
+    }
+
+    return settled;
+}
+
+void CopySway(int boneId, uint swayIndex)
+{
+        [unroll]
+    for (uint j = 0; j < BONES_PER_BLADE; ++j)
+    {
+        Bone sway = swayBones[swayIndex * BONES_PER_BLADE + j];
+        int id = BLADE_COUNT * j + boneId;
+
+        bones[id].position = sway.position;
+        bones[id].rotation = sway.rotation;
+        bones[id].velocity = sway.velocity;
+        bones[id].localRotation = sway.localRotation;
+    }
+}
+
+[numthreads(GRASS_GROUP_SIZE, 1, 1)]
+void CS(uint3 groupId : SV_GroupID, uint3 groupThreadId : SV_GroupThreadID)
+{
+    ChunkDispatch chunk = chunkDispatch[gChunkOffset + groupId.x];
+
+    if (groupThreadId.x == 0)
+    {
+        gsChunkAwake = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint blade = chunk.bladeBegin + groupThreadId.x; blade < chunk.bladeEnd; blade += GRASS_GROUP_SIZE)
+    {
+        if (chunk.lod == GRASS_LOD_SWAY)
+        {
+            CopySway(blade, chunk.swayIndex);
+        }
+        else
+        {
+            if (!SimulateBlade(blade, chunk.lod, chunk.colliderBegin, chunk.colliderCount))
+            {
+                InterlockedOr(gsChunkAwake, 1);
+            }
+
+            if (blade == chunk.bladeBegin)
+            {
+                    [unroll]
+                for (uint j = 0; j < BONES_PER_BLADE; ++j)
+                {
+                    seedBones[chunk.swayIndex * BONES_PER_BLADE + j] = bones[BLADE_COUNT * j + blade];
+                }
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (groupThreadId.x == 0 && chunk.lod != GRASS_LOD_SWAY)
+    {
+        chunkSettled[chunk.swayIndex] = gsChunkAwake == 0 ? 1 : 0;
     }
 }
 
-[maxvertexcount(12)]
+[maxvertexcount(GRASS_MAX_VERTEX_COUNT)]
 void GS(point VertexOut gin[1],
         uint primID : SV_PrimitiveID,
         inout TriangleStream<GeoOut> triStream)
@@ -183,10 +416,13 @@ void GS(point VertexOut gin[1],
     triStream.Append(gout1);
     
     [unroll]
-    for (int i = 0; i < 5; ++i)
+    for (int i = 0; i < BONES_PER_BLADE; ++i)
     {
-        int boneIndex = i * 32 + primID;
+        int boneIndex = i * BLADE_COUNT + primID;
         Bone bone = bones[boneIndex];
+        Bone prevBone = prevBones[boneIndex];
+        bone.position = lerp(prevBone.position, bone.position, gInterpolationAlpha);
+        bone.rotation = QuaternionNlerp(prevBone.rotation, bone.rotation, gInterpolationAlpha);
 
         float3 upO = QuaternionRotateOptimized(bone.rotation, float3(0.0f, 1.0f, 0.0f));
         right = normalize(cross(upO, look));
@@ -199,8 +435,11 @@ void GS(point VertexOut gin[1],
         vRight = float4(rightPos, 1.0f);
         vLeft = float4(leftPos, 1.0f);
 
-        texCRight = float2(0.0f, 1.0f - (1 + i) * 0.2f);
-        texCLeft = float2(1.0f, 1.0f - (1 + i) * 2.0f);
+        // V runs from 1 at the root to 0 at the tip in equal steps per segment, on both edges.
+        // The left edge used to step by 2.0 (V = -1, -3, ...), a typo of the right edge's
+        // 0.2 that sampled the texture far outside [0, 1] down that side of the blade.
+        texCRight = float2(0.0f, 1.0f - (1 + i) * (1.0f / BONES_PER_BLADE));
+        texCLeft = float2(1.0f, 1.0f - (1 + i) * (1.0f / BONES_PER_BLADE));
 
         GeoOut goutRight = (GeoOut) 0.0f;
         goutRight.PosH = mul(vRight, gViewProj);
@@ -32,4 +32,10 @@ float4 QuaternionInverse(float4 quaternion)
     float magnitudeSq = dot(quaternion, quaternion);
     
     return QuaternionConjugate(quaternion) / magnitudeSq;
-}
\ No newline at end of file
+}
+
+float4 QuaternionNlerp(float4 a, float4 b, float t)
+{
+    float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+    return normalize(a + (b * sign - a) * t);
+}
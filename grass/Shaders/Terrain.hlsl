@@ -0,0 +1,66 @@
+#include "Common.hlsl"
+
+// Quadtree terrain patches (TerrainQuadtree). Every patch draws the same grid, positions
+// in [0, 1] on xz, as one instance per selected node.
+#ifndef PATCH_RESOLUTION
+#define PATCH_RESOLUTION 32
+#endif
+
+// TerrainPatch in TerrainQuadtree.h.
+struct TerrainPatch
+{
+    float X;
+    float Z;
+    float Size;
+    uint Lod;
+    float MorphStart;
+    float MorphScale;
+};
+
+StructuredBuffer<TerrainPatch> gTerrainPatches : register(t5);
+
+// LandUtility::GetHillsHeight.
+float HillsHeight(float x, float z)
+{
+    return 0.3f * (z * sin(0.1f * x) + x * cos(0.1f * z));
+}
+
+struct VertexIn
+{
+    float3 PosL : POSITION;
+};
+
+struct VertexOut
+{
+    float4 PosH : SV_POSITION;
+};
+
+// TerrainQuadtree::MorphVertex: odd grid vertices slide onto their even neighbour towards
+// the end of the patch's range, so its edges meet the next coarser level exactly.
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
+{
+    VertexOut vout = (VertexOut) 0.0f;
+
+    TerrainPatch patch = gTerrainPatches[instanceID];
+    float spacing = patch.Size / PATCH_RESOLUTION;
+    float2 grid = round(vin.PosL.xz * PATCH_RESOLUTION);
+
+    float2 posXZ = float2(patch.X, patch.Z) + grid * spacing;
+    float3 posL = float3(posXZ.x, HillsHeight(posXZ.x, posXZ.y), posXZ.y);
+
+    float3 eyeL = gEyePosW - gWorld[3].xyz;
+    float morph = saturate((distance(posL, eyeL) - patch.MorphStart) * patch.MorphScale);
+
+    posXZ -= fmod(grid, 2.0f) * spacing * morph;
+    posL = float3(posXZ.x, HillsHeight(posXZ.x, posXZ.y), posXZ.y);
+
+    float4 posW = mul(float4(posL, 1.0f), gWorld);
+    vout.PosH = mul(posW, gViewProj);
+
+    return vout;
+}
+
+float4 PS(VertexOut pin) : SV_Target
+{
+    return float4(0.7f, 0.7f, 0.7f, 1.0f);
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cmath>
+
+#if defined(_WIN32) && __has_include(<DirectXMath.h>)
+#include <DirectXMath.h>
+#define SIMMATH_DIRECTXMATH 1
+#endif
+
+// Portable float vectors used by the headless simulation code. The layout matches
+// XMFLOAT3/XMFLOAT4 (and HLSL float3/float4), so arrays of these can be copied
+// straight into GPU buffers.
+struct Float3
+{
+	Float3() = default;
+	constexpr Float3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+#ifdef SIMMATH_DIRECTXMATH
+	Float3(const DirectX::XMFLOAT3& v) : x(v.x), y(v.y), z(v.z) {}
+	operator DirectX::XMFLOAT3() const { return DirectX::XMFLOAT3(x, y, z); }
+#endif
+
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+};
+
+struct Float4
+{
+	Float4() = default;
+	constexpr Float4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+
+#ifdef SIMMATH_DIRECTXMATH
+	Float4(const DirectX::XMFLOAT4& v) : x(v.x), y(v.y), z(v.z), w(v.w) {}
+	operator DirectX::XMFLOAT4() const { return DirectX::XMFLOAT4(x, y, z, w); }
+#endif
+
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+	float w = 0.0f;
+};
+
+// A world position in large-world coordinates, where float runs out of precision a few
+// kilometres from the origin. Kept for origins (camera, tiles, render items); everything
+// near one of them is a Float3 relative to it, see RelativePosition.
+struct Double3
+{
+	Double3() = default;
+	constexpr Double3(double _x, double _y, double _z) : x(_x), y(_y), z(_z) {}
+	constexpr explicit Double3(const Float3& v) : x(v.x), y(v.y), z(v.z) {}
+
+	double x = 0.0;
+	double y = 0.0;
+	double z = 0.0;
+};
+
+// Row-major like XMFLOAT4X4, for row vectors: p' = p * M, translation in row 3.
+struct Float4x4
+{
+	Float4x4() = default;
+
+#ifdef SIMMATH_DIRECTXMATH
+	Float4x4(const DirectX::XMFLOAT4X4& m)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				this->m[i][j] = m.m[i][j];
+			}
+		}
+	}
+
+	operator DirectX::XMFLOAT4X4() const
+	{
+		DirectX::XMFLOAT4X4 r;
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				r.m[i][j] = m[i][j];
+			}
+		}
+		return r;
+	}
+#endif
+
+	static Float4x4 Identity()
+	{
+		Float4x4 r;
+		r.m[0][0] = r.m[1][1] = r.m[2][2] = r.m[3][3] = 1.0f;
+		return r;
+	}
+
+	float m[4][4] = {};
+};
+
+inline Float3 operator+(const Float3& a, const Float3& b) { return Float3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Float3 operator-(const Float3& a, const Float3& b) { return Float3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Float3 operator-(const Float3& a) { return Float3(-a.x, -a.y, -a.z); }
+inline Float3 operator*(const Float3& a, float s) { return Float3(a.x * s, a.y * s, a.z * s); }
+inline Float3 operator/(const Float3& a, float s) { return Float3(a.x / s, a.y / s, a.z / s); }
+inline Float3& operator+=(Float3& a, const Float3& b) { a = a + b; return a; }
+inline Float3& operator*=(Float3& a, float s) { a = a * s; return a; }
+
+inline Double3 operator+(const Double3& a, const Double3& b) { return Double3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Double3 operator-(const Double3& a, const Double3& b) { return Double3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Double3 operator*(const Double3& a, double s) { return Double3(a.x * s, a.y * s, a.z * s); }
+inline Double3& operator+=(Double3& a, const Double3& b) { a = a + b; return a; }
+inline bool operator==(const Double3& a, const Double3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; }
+inline bool operator!=(const Double3& a, const Double3& b) { return !(a == b); }
+
+// p seen from origin: the difference is taken in double and only then rounded, so it is as
+// precise as a float near origin can be however far both are from the world origin.
+inline Float3 RelativePosition(const Double3& p, const Double3& origin)
+{
+	return Float3((float)(p.x - origin.x), (float)(p.y - origin.y), (float)(p.z - origin.z));
+}
+
+inline float Dot(const Float3& a, const Float3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline float Dot(const Float4& a, const Float4& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+inline Float3 Cross(const Float3& a, const Float3& b)
+{
+	return Float3(
+		a.y * b.z - a.z * b.y,
+		a.z * b.x - a.x * b.z,
+		a.x * b.y - a.y * b.x);
+}
+
+inline float Length(const Float3& v)
+{
+	return sqrtf(Dot(v, v));
+}
+
+// HLSL normalize() is v * rsqrt(dot(v, v)).
+inline Float3 Normalize(const Float3& v)
+{
+	float invLength = 1.0f / sqrtf(Dot(v, v));
+	return v * invLength;
+}
+
+inline Float4 Normalize(const Float4& q)
+{
+	float invLength = 1.0f / sqrtf(Dot(q, q));
+	return Float4(q.x * invLength, q.y * invLength, q.z * invLength, q.w * invLength);
+}
+
+inline Float3 Lerp(const Float3& a, const Float3& b, float t)
+{
+	return a + (b - a) * t;
+}
+
+// The quaternion helpers below mirror Shaders/QuaternionUtil.hlsl operation for operation.
+inline Float3 QuaternionRotateOptimized(const Float4& q, const Float3& v)
+{
+	Float3 qvec(q.x, q.y, q.z);
+	Float3 uv = Cross(qvec, v);
+	Float3 uuv = Cross(qvec, uv);
+	return v + ((uv * q.w) + uuv) * 2.0f;
+}
+
+inline Float4 QuaternionMultiply(const Float4& a, const Float4& b)
+{
+	return Float4(
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
+inline Float4 AxisAngleToQuaternion(const Float3& axis, float angle)
+{
+	float halfAngle = angle * 0.5f;
+	float s = sinf(halfAngle);
+	return Float4(axis.x * s, axis.y * s, axis.z * s, cosf(halfAngle));
+}
+
+// Normalized lerp along the shorter arc; plenty for blending two consecutive steps.
+inline Float4 QuaternionNlerp(const Float4& a, const Float4& b, float t)
+{
+	float sign = Dot(a, b) < 0.0f ? -1.0f : 1.0f;
+	Float4 q(
+		a.x + (b.x * sign - a.x) * t,
+		a.y + (b.y * sign - a.y) * t,
+		a.z + (b.z * sign - a.z) * t,
+		a.w + (b.w * sign - a.w) * t);
+	return Normalize(q);
+}
+
+inline Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 r;
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+	return r;
+}
+
+inline Float3 TransformPoint(const Float3& p, const Float4x4& m)
+{
+	return Float3(
+		p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+		p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+		p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2]);
+}
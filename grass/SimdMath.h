@@ -0,0 +1,290 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Thin wrapper over the widest float vector the build targets: AVX2 (8 lanes) when the
+// compiler is allowed to emit it (/arch:AVX2, -mavx2), SSE2 (4 lanes) on any x64 build,
+// otherwise a scalar fallback. Kernels written against SimdFloat compile on all three.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2 1
+#else
+#define SIMD_SCALAR 1
+#endif
+
+#if defined(SIMD_AVX2)
+
+const int SimdWidth = 8;
+
+struct SimdFloat
+{
+	__m256 v;
+};
+
+struct SimdMask
+{
+	__m256 v;
+};
+
+inline SimdFloat SimdLoad(const float* p) { return { _mm256_load_ps(p) }; }
+inline SimdFloat SimdLoadUnaligned(const float* p) { return { _mm256_loadu_ps(p) }; }
+inline void SimdStore(float* p, SimdFloat a) { _mm256_store_ps(p, a.v); }
+inline void SimdStoreUnaligned(float* p, SimdFloat a) { _mm256_storeu_ps(p, a.v); }
+inline SimdFloat SimdSplat(float s) { return { _mm256_set1_ps(s) }; }
+inline SimdFloat SimdZero() { return { _mm256_setzero_ps() }; }
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a) { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) }; }
+
+inline SimdFloat Sqrt(SimdFloat a) { return { _mm256_sqrt_ps(a.v) }; }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline SimdFloat Abs(SimdFloat a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+inline SimdFloat Floor(SimdFloat a) { return { _mm256_floor_ps(a.v) }; }
+
+inline SimdMask operator>(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline SimdMask operator>=(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return { _mm256_and_ps(a.v, b.v) }; }
+inline SimdMask operator|(SimdMask a, SimdMask b) { return { _mm256_or_ps(a.v, b.v) }; }
+
+// Lanes of a where mask is set, b elsewhere.
+inline SimdFloat Select(SimdMask mask, SimdFloat a, SimdFloat b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+inline int MaskBits(SimdMask mask) { return _mm256_movemask_ps(mask.v); }
+// base[indices[k]] in lane k; reads SimdWidth indices.
+inline SimdFloat SimdGather(const float* base, const uint32_t* indices)
+{
+	return { _mm256_i32gather_ps(base, _mm256_loadu_si256((const __m256i*)indices), 4) };
+}
+
+// Quadrant index round(x * 2 / pi), both as an integer vector and as floats.
+inline void SimdReduceQuadrant(SimdFloat x, SimdFloat& q, __m256i& quadrant)
+{
+	quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(x.v, _mm256_set1_ps(0.636619772f)));
+	q = { _mm256_cvtepi32_ps(quadrant) };
+}
+
+// Sign bit set where bit 1 of the quadrant is set.
+inline SimdFloat SimdQuadrantSign(const __m256i& quadrant)
+{
+	__m256i sign = _mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30);
+	return { _mm256_castsi256_ps(sign) };
+}
+
+inline SimdMask SimdQuadrantOdd(const __m256i& quadrant)
+{
+	__m256i odd = _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(1)), _mm256_set1_epi32(1));
+	return { _mm256_castsi256_ps(odd) };
+}
+
+inline __m256i SimdQuadrantAdd(const __m256i& quadrant, int n) { return _mm256_add_epi32(quadrant, _mm256_set1_epi32(n)); }
+inline SimdFloat SimdXor(SimdFloat a, SimdFloat b) { return { _mm256_xor_ps(a.v, b.v) }; }
+
+typedef __m256i SimdQuadrant;
+
+#elif defined(SIMD_SSE2)
+
+const int SimdWidth = 4;
+
+struct SimdFloat
+{
+	__m128 v;
+};
+
+struct SimdMask
+{
+	__m128 v;
+};
+
+inline SimdFloat SimdLoad(const float* p) { return { _mm_load_ps(p) }; }
+inline SimdFloat SimdLoadUnaligned(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void SimdStore(float* p, SimdFloat a) { _mm_store_ps(p, a.v); }
+inline void SimdStoreUnaligned(float* p, SimdFloat a) { _mm_storeu_ps(p, a.v); }
+inline SimdFloat SimdSplat(float s) { return { _mm_set1_ps(s) }; }
+inline SimdFloat SimdZero() { return { _mm_setzero_ps() }; }
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return { _mm_add_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return { _mm_div_ps(a.v, b.v) }; }
+inline SimdFloat operator-(SimdFloat a) { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) }; }
+
+inline SimdFloat Sqrt(SimdFloat a) { return { _mm_sqrt_ps(a.v) }; }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return { _mm_min_ps(a.v, b.v) }; }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return { _mm_max_ps(a.v, b.v) }; }
+inline SimdFloat Abs(SimdFloat a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+
+inline SimdMask operator>(SimdFloat a, SimdFloat b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline SimdMask operator>=(SimdFloat a, SimdFloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return { _mm_and_ps(a.v, b.v) }; }
+inline SimdMask operator|(SimdMask a, SimdMask b) { return { _mm_or_ps(a.v, b.v) }; }
+
+inline SimdFloat Select(SimdMask mask, SimdFloat a, SimdFloat b)
+{
+	return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+
+inline int MaskBits(SimdMask mask) { return _mm_movemask_ps(mask.v); }
+inline SimdFloat SimdGather(const float* base, const uint32_t* indices)
+{
+	return { _mm_setr_ps(base[indices[0]], base[indices[1]], base[indices[2]], base[indices[3]]) };
+}
+
+// SSE2 has no round-to-floor; truncate and step down where truncation rounded up.
+inline SimdFloat Floor(SimdFloat a)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return { _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f))) };
+}
+
+inline void SimdReduceQuadrant(SimdFloat x, SimdFloat& q, __m128i& quadrant)
+{
+	quadrant = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(0.636619772f)));
+	q = { _mm_cvtepi32_ps(quadrant) };
+}
+
+inline SimdFloat SimdQuadrantSign(const __m128i& quadrant)
+{
+	__m128i sign = _mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30);
+	return { _mm_castsi128_ps(sign) };
+}
+
+inline SimdMask SimdQuadrantOdd(const __m128i& quadrant)
+{
+	__m128i odd = _mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1));
+	return { _mm_castsi128_ps(odd) };
+}
+
+inline __m128i SimdQuadrantAdd(const __m128i& quadrant, int n) { return _mm_add_epi32(quadrant, _mm_set1_epi32(n)); }
+inline SimdFloat SimdXor(SimdFloat a, SimdFloat b) { return { _mm_xor_ps(a.v, b.v) }; }
+
+typedef __m128i SimdQuadrant;
+
+#else
+
+const int SimdWidth = 1;
+
+struct SimdFloat
+{
+	float v;
+};
+
+struct SimdMask
+{
+	bool v;
+};
+
+inline SimdFloat SimdLoad(const float* p) { return { *p }; }
+inline SimdFloat SimdLoadUnaligned(const float* p) { return { *p }; }
+inline void SimdStore(float* p, SimdFloat a) { *p = a.v; }
+inline void SimdStoreUnaligned(float* p, SimdFloat a) { *p = a.v; }
+inline SimdFloat SimdSplat(float s) { return { s }; }
+inline SimdFloat SimdZero() { return { 0.0f }; }
+
+inline SimdFloat operator+(SimdFloat a, SimdFloat b) { return { a.v + b.v }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b) { return { a.v - b.v }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b) { return { a.v * b.v }; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b) { return { a.v / b.v }; }
+inline SimdFloat operator-(SimdFloat a) { return { -a.v }; }
+
+inline SimdFloat Sqrt(SimdFloat a) { return { sqrtf(a.v) }; }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return { a.v < b.v ? a.v : b.v }; }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return { a.v > b.v ? a.v : b.v }; }
+inline SimdFloat Abs(SimdFloat a) { return { fabsf(a.v) }; }
+inline SimdFloat Floor(SimdFloat a) { return { floorf(a.v) }; }
+
+inline SimdMask operator>(SimdFloat a, SimdFloat b) { return { a.v > b.v }; }
+inline SimdMask operator<(SimdFloat a, SimdFloat b) { return { a.v < b.v }; }
+inline SimdMask operator>=(SimdFloat a, SimdFloat b) { return { a.v >= b.v }; }
+inline SimdMask operator<=(SimdFloat a, SimdFloat b) { return { a.v <= b.v }; }
+inline SimdMask operator&(SimdMask a, SimdMask b) { return { a.v && b.v }; }
+inline SimdMask operator|(SimdMask a, SimdMask b) { return { a.v || b.v }; }
+
+inline SimdFloat Select(SimdMask mask, SimdFloat a, SimdFloat b) { return mask.v ? a : b; }
+inline int MaskBits(SimdMask mask) { return mask.v ? 1 : 0; }
+inline SimdFloat SimdGather(const float* base, const uint32_t* indices) { return { base[*indices] }; }
+
+typedef int SimdQuadrant;
+
+inline void SimdReduceQuadrant(SimdFloat x, SimdFloat& q, int& quadrant)
+{
+	quadrant = (int)lrintf(x.v * 0.636619772f);
+	q = { (float)quadrant };
+}
+
+inline SimdFloat SimdQuadrantSign(int quadrant) { return { (quadrant & 2) ? -0.0f : 0.0f }; }
+inline SimdMask SimdQuadrantOdd(int quadrant) { return { (quadrant & 1) != 0 }; }
+inline int SimdQuadrantAdd(int quadrant, int n) { return quadrant + n; }
+
+inline SimdFloat SimdXor(SimdFloat a, SimdFloat b)
+{
+	uint32_t ia, ib;
+	memcpy(&ia, &a.v, sizeof(float));
+	memcpy(&ib, &b.v, sizeof(float));
+	ia ^= ib;
+	memcpy(&a.v, &ia, sizeof(float));
+	return a;
+}
+
+#endif
+
+inline SimdMask AllLanes() { return SimdZero() <= SimdZero(); }
+inline SimdMask NoLanes() { return SimdZero() < SimdZero(); }
+inline bool AnyLane(SimdMask mask) { return MaskBits(mask) != 0; }
+
+// Cephes-style sin/cos: Cody-Waite reduction by pi/2 followed by minimax polynomials
+// on [-pi/4, pi/4]. Absolute error stays below 1e-7 for |x| < 8192.
+inline void SinCos(SimdFloat x, SimdFloat& s, SimdFloat& c)
+{
+	SimdFloat q;
+	SimdQuadrant quadrant;
+	SimdReduceQuadrant(x, q, quadrant);
+
+	SimdFloat r = x - q * SimdSplat(1.5703125f);
+	r = r - q * SimdSplat(4.837512969970703125e-4f);
+	r = r - q * SimdSplat(7.549789948768648e-8f);
+
+	SimdFloat r2 = r * r;
+
+	SimdFloat sinPoly = SimdSplat(-1.9515295891e-4f);
+	sinPoly = sinPoly * r2 + SimdSplat(8.3321608736e-3f);
+	sinPoly = sinPoly * r2 + SimdSplat(-1.6666654611e-1f);
+	sinPoly = sinPoly * r2 * r + r;
+
+	SimdFloat cosPoly = SimdSplat(2.443315711809948e-5f);
+	cosPoly = cosPoly * r2 + SimdSplat(-1.388731625493765e-3f);
+	cosPoly = cosPoly * r2 + SimdSplat(4.166664568298827e-2f);
+	cosPoly = cosPoly * r2 * r2 - r2 * SimdSplat(0.5f) + SimdSplat(1.0f);
+
+	// Quadrant 1 and 3 swap the polynomials; quadrants 2 and 3 negate sin, 1 and 2 negate cos.
+	SimdMask odd = SimdQuadrantOdd(quadrant);
+	s = SimdXor(Select(odd, cosPoly, sinPoly), SimdQuadrantSign(quadrant));
+	c = SimdXor(Select(odd, sinPoly, cosPoly), SimdQuadrantSign(SimdQuadrantAdd(quadrant, 1)));
+}
+
+inline SimdFloat Sin(SimdFloat x)
+{
+	SimdFloat s;
+	SimdFloat c;
+	SinCos(x, s, c);
+	return s;
+}
+
+inline SimdFloat Cos(SimdFloat x)
+{
+	SimdFloat s;
+	SimdFloat c;
+	SinCos(x, s, c);
+	return c;
+}
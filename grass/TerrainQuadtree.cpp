@@ -0,0 +1,320 @@
+#include "TerrainQuadtree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+// A level stops morphing this far (as a fraction) short of its range, so float rounding in
+// the distances can't leave a vertex on a shared edge not quite snapped.
+static const float MorphEndRatio = 0.99f;
+// The morph into the next level starts no later than this fraction of the range, so it
+// never happens over too short a distance to see.
+static const float MorphStartRatio = 0.6f;
+
+static float DistanceSqToBox(const Float3& p, const Float3& center, const Float3& extents)
+{
+	float dx = max(fabsf(p.x - center.x) - extents.x, 0.0f);
+	float dy = max(fabsf(p.y - center.y) - extents.y, 0.0f);
+	float dz = max(fabsf(p.z - center.z) - extents.z, 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+void TerrainQuadtree::Build(const TerrainQuadtreeDesc& desc, ThreadPool* pool)
+{
+	assert(desc.Height != nullptr && desc.PatchResolution >= 2 && desc.PatchResolution % 2 == 0);
+
+	mDesc = desc;
+
+	uint32_t leavesPerSide = (uint32_t)(desc.Size / desc.LeafSize + 0.5f);
+	assert(leavesPerSide > 0 && (leavesPerSide & (leavesPerSide - 1)) == 0);
+
+	mLodCount = 1;
+	while ((1u << (mLodCount - 1)) < leavesPerSide)
+	{
+		++mLodCount;
+	}
+	assert(mLodCount <= MaxLods);
+
+	// Heights on the bounds grid, a row per task.
+	uint32_t samplesPerLeaf = max(1u, (uint32_t)(desc.LeafSize / desc.BoundsSpacing + 0.5f));
+	uint32_t samplesPerSide = leavesPerSide * samplesPerLeaf + 1;
+	float spacing = desc.LeafSize / samplesPerLeaf;
+	vector<float> heights((size_t)samplesPerSide * samplesPerSide);
+
+	vector<float> sampleX(desc.HeightBatch != nullptr ? samplesPerSide : 0);
+	for (uint32_t i = 0; i < (uint32_t)sampleX.size(); ++i)
+	{
+		sampleX[i] = desc.MinX + i * spacing;
+	}
+
+	auto sampleRow = [&](uint32_t j)
+	{
+		float z = desc.MinZ + j * spacing;
+		if (desc.HeightBatch != nullptr)
+		{
+			vector<float> sampleZ(samplesPerSide, z);
+			desc.HeightBatch(sampleX.data(), sampleZ.data(), samplesPerSide, &heights[(size_t)j * samplesPerSide]);
+			return;
+		}
+
+		for (uint32_t i = 0; i < samplesPerSide; ++i)
+		{
+			heights[(size_t)j * samplesPerSide + i] = desc.Height(desc.MinX + i * spacing, z);
+		}
+	};
+
+	if (pool != nullptr)
+	{
+		pool->ParallelFor(samplesPerSide, sampleRow);
+	}
+	else
+	{
+		for (uint32_t j = 0; j < samplesPerSide; ++j)
+		{
+			sampleRow(j);
+		}
+	}
+
+	// Between samples the terrain can stray from them by about the interpolation error.
+	float padding = EstimateError(spacing);
+
+	Level& leaves = mLevels[0];
+	leaves.NodesPerSide = leavesPerSide;
+	leaves.MinHeight.assign((size_t)leavesPerSide * leavesPerSide, FLT_MAX);
+	leaves.MaxHeight.assign((size_t)leavesPerSide * leavesPerSide, -FLT_MAX);
+
+	for (uint32_t z = 0; z < leavesPerSide; ++z)
+	{
+		for (uint32_t x = 0; x < leavesPerSide; ++x)
+		{
+			float minHeight = FLT_MAX;
+			float maxHeight = -FLT_MAX;
+			for (uint32_t j = z * samplesPerLeaf; j <= (z + 1) * samplesPerLeaf; ++j)
+			{
+				const float* row = heights.data() + (size_t)j * samplesPerSide;
+				for (uint32_t i = x * samplesPerLeaf; i <= (x + 1) * samplesPerLeaf; ++i)
+				{
+					minHeight = min(minHeight, row[i]);
+					maxHeight = max(maxHeight, row[i]);
+				}
+			}
+
+			leaves.MinHeight[(size_t)z * leavesPerSide + x] = minHeight - padding;
+			leaves.MaxHeight[(size_t)z * leavesPerSide + x] = maxHeight + padding;
+		}
+	}
+
+	for (uint32_t lod = 1; lod < mLodCount; ++lod)
+	{
+		const Level& children = mLevels[lod - 1];
+		Level& level = mLevels[lod];
+		level.NodesPerSide = children.NodesPerSide / 2;
+		level.MinHeight.resize((size_t)level.NodesPerSide * level.NodesPerSide);
+		level.MaxHeight.resize((size_t)level.NodesPerSide * level.NodesPerSide);
+
+		for (uint32_t z = 0; z < level.NodesPerSide; ++z)
+		{
+			for (uint32_t x = 0; x < level.NodesPerSide; ++x)
+			{
+				size_t c0 = (size_t)(2 * z) * children.NodesPerSide + 2 * x;
+				size_t c1 = c0 + children.NodesPerSide;
+
+				level.MinHeight[(size_t)z * level.NodesPerSide + x] = min(
+					min(children.MinHeight[c0], children.MinHeight[c0 + 1]),
+					min(children.MinHeight[c1], children.MinHeight[c1 + 1]));
+				level.MaxHeight[(size_t)z * level.NodesPerSide + x] = max(
+					max(children.MaxHeight[c0], children.MaxHeight[c0 + 1]),
+					max(children.MaxHeight[c1], children.MaxHeight[c1 + 1]));
+			}
+		}
+	}
+
+	for (uint32_t lod = 0; lod < mLodCount; ++lod)
+	{
+		Level& level = mLevels[lod];
+		float size = NodeSize(lod);
+
+		float heightRange = 0.0f;
+		for (size_t n = 0; n < level.MinHeight.size(); ++n)
+		{
+			heightRange = max(heightRange, level.MaxHeight[n] - level.MinHeight[n]);
+		}
+		level.Diagonal = sqrtf(2.0f * size * size + heightRange * heightRange);
+
+		// Coarser levels are never more accurate than finer ones.
+		level.Error = EstimateError(size / desc.PatchResolution);
+		if (lod > 0)
+		{
+			level.Error = max(level.Error, mLevels[lod - 1].Error);
+		}
+	}
+}
+
+float TerrainQuadtree::EstimateError(float spacing) const
+{
+	const uint32_t Strata = 64;
+
+	float stratum = (mDesc.Size - spacing) / Strata;
+	float half = 0.5f * spacing;
+	float error = 0.0f;
+
+	for (uint32_t sz = 0; sz < Strata; ++sz)
+	{
+		for (uint32_t sx = 0; sx < Strata; ++sx)
+		{
+			// One cell per stratum, jittered by an additive recurrence so the cells don't
+			// line up with anything periodic in the terrain.
+			uint32_t k = sz * Strata + sx;
+			float jitterX = (float)fmod(0.5 + k * 0.7548776662466927, 1.0);
+			float jitterZ = (float)fmod(0.5 + k * 0.5698402909980532, 1.0);
+			float x = mDesc.MinX + (sx + jitterX) * stratum;
+			float z = mDesc.MinZ + (sz + jitterZ) * stratum;
+
+			float h00 = mDesc.Height(x, z);
+			float h10 = mDesc.Height(x + spacing, z);
+			float h01 = mDesc.Height(x, z + spacing);
+			float h11 = mDesc.Height(x + spacing, z + spacing);
+			float center = mDesc.Height(x + half, z + half);
+
+			error = max(error, fabsf(mDesc.Height(x + half, z) - 0.5f * (h00 + h10)));
+			error = max(error, fabsf(mDesc.Height(x, z + half) - 0.5f * (h00 + h01)));
+			error = max(error, fabsf(center - 0.5f * (h00 + h11)));
+			error = max(error, fabsf(center - 0.5f * (h10 + h01)));
+		}
+	}
+
+	return error;
+}
+
+void TerrainQuadtree::ComputeRanges(float screenHeight, float fovY, float* ranges) const
+{
+	// Pixels a metre spans at a distance of one metre.
+	float pixelScale = screenHeight / (2.0f * tanf(0.5f * fovY));
+
+	for (uint32_t lod = 0; lod + 1 < mLodCount; ++lod)
+	{
+		// Inside this distance the next level's error would show.
+		float range = mLevels[lod + 1].Error * pixelScale / mDesc.MaxPixelError;
+
+		// Nodes of the finer level reach at most a node diagonal past its range; the morph
+		// must not start before that, or an edge shared with them would move.
+		float morphStart = (lod > 0 ? ranges[lod - 1] : 0.0f) + mLevels[lod].Diagonal;
+		ranges[lod] = max(range, morphStart / MorphStartRatio);
+	}
+	ranges[mLodCount - 1] = FLT_MAX;
+}
+
+void TerrainQuadtree::Select(const Float3& camera, const FrustumPlanes& frustum, float screenHeight, float fovY,
+	vector<TerrainPatch>& patches, TerrainSelectStats* stats) const
+{
+	float ranges[MaxLods];
+	ComputeRanges(screenHeight, fovY, ranges);
+
+	TerrainSelectStats selectStats;
+	size_t first = patches.size();
+	SelectNode(mLodCount - 1, 0, 0, ranges, camera, frustum, patches, selectStats);
+	selectStats.Patches = (uint32_t)(patches.size() - first);
+
+	if (stats != nullptr)
+	{
+		*stats = selectStats;
+	}
+}
+
+bool TerrainQuadtree::SelectNode(uint32_t lod, uint32_t x, uint32_t z, const float* ranges, const Float3& camera,
+	const FrustumPlanes& frustum, vector<TerrainPatch>& patches, TerrainSelectStats& stats) const
+{
+	++stats.NodesVisited;
+
+	Float3 center;
+	Float3 extents;
+	NodeBox(lod, x, z, center, extents);
+
+	float distanceSq = DistanceSqToBox(camera, center, extents);
+	if (lod + 1 < mLodCount && distanceSq > ranges[lod] * ranges[lod])
+	{
+		return false;
+	}
+
+	if (!BatchCulling::IsBoxVisible(frustum, center, extents))
+	{
+		++stats.NodesCulled;
+		return true;
+	}
+
+	if (lod == 0 || distanceSq > ranges[lod - 1] * ranges[lod - 1])
+	{
+		AddPatch(lod, x, z, ranges, patches);
+		return true;
+	}
+
+	for (uint32_t child = 0; child < 4; ++child)
+	{
+		uint32_t childX = 2 * x + (child & 1);
+		uint32_t childZ = 2 * z + (child >> 1);
+
+		if (!SelectNode(lod - 1, childX, childZ, ranges, camera, frustum, patches, stats))
+		{
+			// Past the finer level's range the child is fully morphed into this level's grid,
+			// so it stands in for this quarter of the node.
+			NodeBox(lod - 1, childX, childZ, center, extents);
+			if (BatchCulling::IsBoxVisible(frustum, center, extents))
+			{
+				AddPatch(lod - 1, childX, childZ, ranges, patches);
+			}
+		}
+	}
+
+	return true;
+}
+
+void TerrainQuadtree::AddPatch(uint32_t lod, uint32_t x, uint32_t z, const float* ranges, vector<TerrainPatch>& patches) const
+{
+	TerrainPatch patch;
+	patch.Size = NodeSize(lod);
+	patch.X = mDesc.MinX + x * patch.Size;
+	patch.Z = mDesc.MinZ + z * patch.Size;
+	patch.Lod = lod;
+
+	if (lod + 1 < mLodCount)
+	{
+		// ComputeRanges keeps the start at most MorphStartRatio of the range.
+		patch.MorphStart = (lod > 0 ? ranges[lod - 1] : 0.0f) + mLevels[lod].Diagonal;
+		patch.MorphScale = 1.0f / (ranges[lod] * MorphEndRatio - patch.MorphStart);
+	}
+	else
+	{
+		// The coarsest level has nothing to morph into.
+		patch.MorphStart = FLT_MAX;
+		patch.MorphScale = 0.0f;
+	}
+
+	patches.push_back(patch);
+}
+
+void TerrainQuadtree::NodeBox(uint32_t lod, uint32_t x, uint32_t z, Float3& center, Float3& extents) const
+{
+	const Level& level = mLevels[lod];
+	float size = NodeSize(lod);
+	float minHeight = level.MinHeight[(size_t)z * level.NodesPerSide + x];
+	float maxHeight = level.MaxHeight[(size_t)z * level.NodesPerSide + x];
+
+	center = Float3(mDesc.MinX + (x + 0.5f) * size, 0.5f * (minHeight + maxHeight), mDesc.MinZ + (z + 0.5f) * size);
+	extents = Float3(0.5f * size, 0.5f * (maxHeight - minHeight), 0.5f * size);
+}
+
+Float3 TerrainQuadtree::MorphVertex(const TerrainPatch& patch, uint32_t i, uint32_t j, const Float3& camera) const
+{
+	float spacing = patch.Size / mDesc.PatchResolution;
+	float x = patch.X + i * spacing;
+	float z = patch.Z + j * spacing;
+
+	// How far to morph is decided on the unmorphed vertex, which neighbouring patches share.
+	Float3 p(x, mDesc.Height(x, z), z);
+	float morph = min(max((Length(p - camera) - patch.MorphStart) * patch.MorphScale, 0.0f), 1.0f);
+
+	x -= (i & 1) * spacing * morph;
+	z -= (j & 1) * spacing * morph;
+	return Float3(x, mDesc.Height(x, z), z);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BatchCulling.h"
+#include "LandUtility.h"
+
+using namespace std;
+
+class ThreadPool;
+
+struct TerrainQuadtreeDesc
+{
+	// The terrain covers [MinX, MinX + Size] x [MinZ, MinZ + Size]. Size / LeafSize must be
+	// a power of two.
+	float MinX = -512.0f;
+	float MinZ = -512.0f;
+	float Size = 1024.0f;
+	float LeafSize = 32.0f;
+	// Every node is drawn as the same PatchResolution x PatchResolution quad grid (even),
+	// scaled to the node, so the finest vertex spacing is LeafSize / PatchResolution.
+	uint32_t PatchResolution = 32;
+	TerrainHeightFunc Height = nullptr;
+	// Optional batch form of Height, used for the rows of the bounds grid.
+	TerrainHeightBatchFunc HeightBatch = nullptr;
+
+	// Nodes are split until their geometric error projects to at most this many pixels.
+	float MaxPixelError = 2.0f;
+	// Heights are sampled this far apart for the node bounds. Must divide LeafSize.
+	float BoundsSpacing = 8.0f;
+};
+
+// A selected node, drawn as the patch grid scaled to Size with its corner at (X, Z). Grid
+// vertices at odd positions slide onto their even neighbour as the distance from the camera
+// goes from MorphStart to 1 / MorphScale past it, which turns the patch into the next coarser
+// level's grid before the next level takes over; see TerrainQuadtree::MorphVertex. Laid out
+// for the GPU as TerrainPatch in Terrain.hlsl.
+struct TerrainPatch
+{
+	float X = 0.0f;
+	float Z = 0.0f;
+	float Size = 0.0f;
+	uint32_t Lod = 0;
+	float MorphStart = 0.0f;
+	float MorphScale = 0.0f;
+};
+
+struct TerrainSelectStats
+{
+	uint32_t NodesVisited = 0;
+	uint32_t NodesCulled = 0;
+	uint32_t Patches = 0;
+};
+
+// Chunked LOD terrain (CDLOD). A quadtree over the terrain whose nodes all share one grid
+// patch; Select picks the nodes to draw by screen-space error from the camera. Each level's
+// geometric error (estimated at Build) and the pixel budget give the distance inside which
+// the level is too coarse; ranges are then widened until a node can only touch nodes one
+// level away and the morph between two levels completes before they meet, so shared edges
+// match exactly and no skirts or stitching strips are needed.
+//
+// Positions are in the terrain's own frame (see RenderItem::Origin).
+class TerrainQuadtree
+{
+public:
+	static constexpr uint32_t MaxLods = 16;
+
+	void Build(const TerrainQuadtreeDesc& desc, ThreadPool* pool = nullptr);
+
+	// Appends the patches to draw for a camera at camera (terrain frame) with a vertical
+	// field of view fovY over screenHeight pixels. Nodes outside frustum are skipped.
+	void Select(const Float3& camera, const FrustumPlanes& frustum, float screenHeight, float fovY,
+		vector<TerrainPatch>& patches, TerrainSelectStats* stats = nullptr) const;
+
+	// Grid vertex (i, j) of a patch as Terrain.hlsl places it.
+	Float3 MorphVertex(const TerrainPatch& patch, uint32_t i, uint32_t j, const Float3& camera) const;
+
+	// Distances inside which each level is drawn at that level or finer, for a view; the
+	// coarsest level's is unbounded.
+	void ComputeRanges(float screenHeight, float fovY, float* ranges) const;
+
+	const TerrainQuadtreeDesc& Desc() const { return mDesc; }
+	uint32_t LodCount() const { return mLodCount; }
+	// Level 0 is the leaves.
+	float LevelError(uint32_t lod) const { return mLevels[lod].Error; }
+	uint32_t NodesPerSide(uint32_t lod) const { return mLevels[lod].NodesPerSide; }
+	float NodeSize(uint32_t lod) const { return mDesc.LeafSize * (float)(1u << lod); }
+
+private:
+	struct Level
+	{
+		uint32_t NodesPerSide = 0;
+		// Largest difference between the level's grid and the terrain.
+		float Error = 0.0f;
+		// Longest node box diagonal.
+		float Diagonal = 0.0f;
+		vector<float> MinHeight;
+		vector<float> MaxHeight;
+	};
+
+	// Largest difference between the terrain and its linear interpolation over a grid with
+	// this spacing, from a stratified sample of cells.
+	float EstimateError(float spacing) const;
+
+	// Returns false when the node lies outside ranges[lod], leaving it to the parent.
+	bool SelectNode(uint32_t lod, uint32_t x, uint32_t z, const float* ranges, const Float3& camera,
+		const FrustumPlanes& frustum, vector<TerrainPatch>& patches, TerrainSelectStats& stats) const;
+	void AddPatch(uint32_t lod, uint32_t x, uint32_t z, const float* ranges, vector<TerrainPatch>& patches) const;
+	void NodeBox(uint32_t lod, uint32_t x, uint32_t z, Float3& center, Float3& extents) const;
+
+	TerrainQuadtreeDesc mDesc;
+	uint32_t mLodCount = 0;
+	Level mLevels[MaxLods];
+};
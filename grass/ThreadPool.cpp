@@ -0,0 +1,239 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+	// Index of the queue owned by the current thread; 0 for threads outside the pool.
+	thread_local uint32_t tQueueIndex = 0;
+	thread_local const ThreadPool* tOwnerPool = nullptr;
+}
+
+ThreadPool::ThreadPool(uint32_t threadCount, ThreadAffinity affinity)
+{
+	if (threadCount == 0)
+	{
+		threadCount = HardwareThreadCount();
+	}
+
+	uint32_t workerCount = threadCount - 1;
+
+	for (uint32_t i = 0; i < workerCount + 1; ++i)
+	{
+		mQueues.push_back(make_unique<WorkQueue>());
+	}
+
+	if (affinity == ThreadAffinity::PinWorkers)
+	{
+		PinCurrentThread(0);
+	}
+
+	for (uint32_t i = 0; i < workerCount; ++i)
+	{
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this, i + 1, affinity);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(mSleepMutex);
+		mStopping = true;
+	}
+	mWakeCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t ThreadPool::HardwareThreadCount()
+{
+	uint32_t count = thread::hardware_concurrency();
+	return count == 0 ? 1 : count;
+}
+
+void ThreadPool::Submit(TaskGroup& group, function<void()> task)
+{
+	group.mPending.fetch_add(1, memory_order_relaxed);
+
+	mQueuedTasks.fetch_add(1, memory_order_release);
+
+	uint32_t queueIndex = tOwnerPool == this ? tQueueIndex : 0;
+	{
+		lock_guard<mutex> lock(mQueues[queueIndex]->Mutex);
+		mQueues[queueIndex]->Tasks.push_back({ move(task), &group });
+	}
+
+	if (!mWorkers.empty())
+	{
+		// Taking the lock orders this notify after a worker's predicate check.
+		{
+			lock_guard<mutex> lock(mSleepMutex);
+		}
+		mWakeCondition.notify_one();
+	}
+}
+
+void ThreadPool::Wait(TaskGroup& group)
+{
+	uint32_t queueIndex = tOwnerPool == this ? tQueueIndex : 0;
+
+	while (!group.Done())
+	{
+		if (!TryRunOne(queueIndex))
+		{
+			this_thread::yield();
+		}
+	}
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const function<void(uint32_t)>& body)
+{
+	TaskGroup group;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Submit(group, [&body, i]() { body(i); });
+	}
+
+	Wait(group);
+}
+
+void ThreadPool::ParallelForRange(uint32_t count, uint32_t grainSize, const function<void(uint32_t, uint32_t)>& body)
+{
+	grainSize = max(grainSize, 1u);
+
+	if (count <= grainSize)
+	{
+		if (count > 0)
+		{
+			body(0, count);
+		}
+		return;
+	}
+
+	TaskGroup group;
+
+	for (uint32_t begin = 0; begin < count; begin += grainSize)
+	{
+		uint32_t end = min(count - begin, grainSize) + begin;
+		Submit(group, [&body, begin, end]() { body(begin, end); });
+	}
+
+	Wait(group);
+}
+
+bool ThreadPool::PinCurrentThread(uint32_t processor)
+{
+#if defined(_WIN32)
+	return processor < 64 && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << processor) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool ThreadPool::TryPop(uint32_t queueIndex, Task& task)
+{
+	WorkQueue& queue = *mQueues[queueIndex];
+	lock_guard<mutex> lock(queue.Mutex);
+
+	if (queue.Tasks.empty())
+	{
+		return false;
+	}
+
+	task = move(queue.Tasks.back());
+	queue.Tasks.pop_back();
+	return true;
+}
+
+bool ThreadPool::TrySteal(uint32_t thiefIndex, Task& task)
+{
+	uint32_t queueCount = (uint32_t)mQueues.size();
+
+	for (uint32_t i = 1; i < queueCount; ++i)
+	{
+		WorkQueue& queue = *mQueues[(thiefIndex + i) % queueCount];
+		lock_guard<mutex> lock(queue.Mutex);
+
+		if (!queue.Tasks.empty())
+		{
+			task = move(queue.Tasks.front());
+			queue.Tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool ThreadPool::TryRunOne(uint32_t queueIndex)
+{
+	Task task;
+
+	if (TryPop(queueIndex, task) || TrySteal(queueIndex, task))
+	{
+		mQueuedTasks.fetch_sub(1, memory_order_relaxed);
+		Execute(task);
+		return true;
+	}
+
+	return false;
+}
+
+void ThreadPool::Execute(Task& task)
+{
+	task.Work();
+	task.Group->mPending.fetch_sub(1, memory_order_release);
+}
+
+void ThreadPool::WorkerLoop(uint32_t queueIndex, ThreadAffinity affinity)
+{
+	tQueueIndex = queueIndex;
+	tOwnerPool = this;
+
+	if (affinity == ThreadAffinity::PinWorkers)
+	{
+		// Workers start at queue 1; processor 0 belongs to the owner.
+		uint32_t processorCount = HardwareThreadCount();
+		PinCurrentThread(processorCount > 1 ? 1 + (queueIndex - 1) % (processorCount - 1) : 0);
+	}
+
+	while (true)
+	{
+		if (TryRunOne(queueIndex))
+		{
+			continue;
+		}
+
+		unique_lock<mutex> lock(mSleepMutex);
+		mWakeCondition.wait(lock, [this]()
+			{
+				return mStopping || mQueuedTasks.load(memory_order_acquire) > 0;
+			});
+
+		if (mStopping)
+		{
+			return;
+		}
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Counts the outstanding tasks submitted against it; ThreadPool::Wait blocks on it.
+class TaskGroup
+{
+public:
+	TaskGroup() = default;
+	TaskGroup(const TaskGroup& rhs) = delete;
+	TaskGroup& operator=(const TaskGroup& rhs) = delete;
+
+	bool Done() const { return mPending.load(memory_order_acquire) == 0; }
+
+private:
+	friend class ThreadPool;
+
+	atomic<uint32_t> mPending{ 0 };
+};
+
+enum class ThreadAffinity
+{
+	// Workers run wherever the OS puts them.
+	Any,
+	// The thread that constructs the pool is pinned to logical processor 0 and worker i to
+	// processor i, wrapping around processors 1 and up when there are more workers than
+	// processors. With a single processor everything shares processor 0.
+	PinWorkers,
+};
+
+// Work-stealing pool. Each worker owns a deque: it pushes and pops at the back (LIFO keeps
+// freshly split work hot in cache) while idle workers steal from the front of other deques.
+// The thread that calls Wait() executes tasks too, so threadCount includes the caller and a
+// pool of one runs everything inline.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(uint32_t threadCount = 0, ThreadAffinity affinity = ThreadAffinity::Any);
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+	~ThreadPool();
+
+	uint32_t ThreadCount() const { return (uint32_t)mWorkers.size() + 1; }
+
+	void Submit(TaskGroup& group, function<void()> task);
+	void Wait(TaskGroup& group);
+
+	// Runs body(i) for every i in [0, count) as individual tasks and waits for all of them.
+	void ParallelFor(uint32_t count, const function<void(uint32_t)>& body);
+	// Splits [0, count) into ranges of grainSize (the last may be shorter), runs body(begin,
+	// end) on each as a task and waits for all of them. A single range runs inline.
+	void ParallelForRange(uint32_t count, uint32_t grainSize, const function<void(uint32_t, uint32_t)>& body);
+
+	static uint32_t HardwareThreadCount();
+	// Keeps the calling thread on one logical processor. False where that isn't supported,
+	// and on Windows for processors 64 and up: processor groups aren't handled, so on such
+	// machines the workers past processor 63 are left unpinned.
+	static bool PinCurrentThread(uint32_t processor);
+
+private:
+	struct Task
+	{
+		function<void()> Work;
+		TaskGroup* Group = nullptr;
+	};
+
+	struct WorkQueue
+	{
+		mutex Mutex;
+		deque<Task> Tasks;
+	};
+
+	bool TryPop(uint32_t queueIndex, Task& task);
+	bool TrySteal(uint32_t thiefIndex, Task& task);
+	bool TryRunOne(uint32_t queueIndex);
+	void Execute(Task& task);
+	void WorkerLoop(uint32_t queueIndex, ThreadAffinity affinity);
+
+private:
+	// Queue 0 belongs to external threads; worker i owns queue i + 1.
+	vector<unique_ptr<WorkQueue>> mQueues;
+	vector<thread> mWorkers;
+
+	mutex mSleepMutex;
+	condition_variable mWakeCondition;
+	atomic<uint32_t> mQueuedTasks{ 0 };
+	atomic<bool> mStopping{ false };
+};
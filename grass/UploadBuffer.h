@@ -53,6 +53,13 @@ public:
 		memcpy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
 	}
 
+	// Only valid for structured buffers, where elements are tightly packed.
+	T* MappedData()
+	{
+		assert(!mIsConstantBuffer);
+		return reinterpret_cast<T*>(mMappedData);
+	}
+
 private:
 	ComPtr<ID3D12Resource> mUploadBuffer;
 	BYTE* mMappedData = nullptr;
@@ -1,20 +1,117 @@
 #include "Waves.h"
-#include <ppl.h>
+#include "SimdMath.h"
+#include "ThreadPool.h"
 #include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cstddef>
 
-using namespace DirectX;
+namespace
+{
+	alignas(32) const float LaneOffsets[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+
+	// Lanes of the vector starting at column j that lie on the left or right edge (or in
+	// the row padding past it).
+	SimdMask EdgeColumns(int j, int numCols)
+	{
+		SimdFloat column = SimdSplat((float)j) + SimdLoad(LaneOffsets);
+		return (column < SimdSplat(1.0f)) | (column > SimdSplat((float)(numCols - 2)));
+	}
+
+	// The row pointers below point at column 0 of the grid, wherever the row is held.
+
+	// New heights of columns [j0, j1) of one row from its previous and current heights and
+	// the current heights of the rows either side. Edge rows and columns keep their
+	// previous heights.
+	void StepRow(const float* prev, const float* up, const float* curr, const float* down, float* next, int j0, int j1,
+		bool edgeRow, int numCols, float k1, float k2, float k3)
+	{
+		if (edgeRow)
+		{
+			copy(prev + j0, prev + j1, next + j0);
+			return;
+		}
+
+		SimdFloat vk1 = SimdSplat(k1);
+		SimdFloat vk2 = SimdSplat(k2);
+		SimdFloat vk3 = SimdSplat(k3);
+
+		for (int j = j0; j < j1; j += SimdWidth)
+		{
+			SimdFloat p = SimdLoad(prev + j);
+			SimdFloat right = SimdLoadUnaligned(curr + j + 1);
+			SimdFloat left = SimdLoadUnaligned(curr + j - 1);
+			SimdFloat h = vk1 * p + vk2 * SimdLoad(curr + j) + vk3 * (SimdLoad(down + j) + SimdLoad(up + j) + right + left);
+
+			if (j == 0 || j + SimdWidth > numCols - 1)
+			{
+				h = Select(EdgeColumns(j, numCols), p, h);
+			}
+			SimdStore(next + j, h);
+		}
+	}
+
+	// Normals and tangents of columns [j0, j1) of a row from its new heights and those of
+	// the rows either side.
+	void NormalRow(const float* above, const float* centre, const float* below, float* outNormalX, float* outNormalY,
+		float* outNormalZ, float* outTangentX, float* outTangentY, int j0, int j1, int numCols, float spatialStep)
+	{
+		SimdFloat twoDx = SimdSplat(2.0f * spatialStep);
+		SimdFloat zero = SimdZero();
+		SimdFloat one = SimdSplat(1.0f);
+
+		for (int j = j0; j < j1; j += SimdWidth)
+		{
+			SimdFloat l = SimdLoadUnaligned(centre + j - 1);
+			SimdFloat r = SimdLoadUnaligned(centre + j + 1);
+			SimdFloat t = SimdLoad(above + j);
+			SimdFloat b = SimdLoad(below + j);
+
+			SimdFloat nx = l - r;
+			SimdFloat nz = b - t;
+			SimdFloat normalScale = one / Sqrt(nx * nx + twoDx * twoDx + nz * nz);
+			SimdFloat ty = r - l;
+			SimdFloat tangentScale = one / Sqrt(twoDx * twoDx + ty * ty);
+
+			SimdFloat normalX = nx * normalScale;
+			SimdFloat normalY = twoDx * normalScale;
+			SimdFloat normalZ = nz * normalScale;
+			SimdFloat tangentX = twoDx * tangentScale;
+			SimdFloat tangentY = ty * tangentScale;
+
+			if (j == 0 || j + SimdWidth > numCols - 1)
+			{
+				SimdMask edge = EdgeColumns(j, numCols);
+				normalX = Select(edge, zero, normalX);
+				normalY = Select(edge, one, normalY);
+				normalZ = Select(edge, zero, normalZ);
+				tangentX = Select(edge, one, tangentX);
+				tangentY = Select(edge, zero, tangentY);
+			}
+
+			SimdStore(outNormalX + j, normalX);
+			SimdStore(outNormalY + j, normalY);
+			SimdStore(outNormalZ + j, normalZ);
+			SimdStore(outTangentX + j, tangentX);
+			SimdStore(outTangentY + j, tangentY);
+		}
+	}
+
+	// Heights of a block and its halo for the steps of one pass, three planes with a row and
+	// a vector of padding all round.
+	thread_local AlignedVector<float> tBlockPlanes;
+}
 
 Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 {
 	mNumRows = m;
 	mNumCols = n;
+	mPitch = (n + SimdWidth - 1) / SimdWidth * SimdWidth;
 
 	mVertexCount = m * n;
 	mTriangleCount = (m - 1) * (n - 1) * 2;
 
-	mTimeStep = dt;
+	mTimestep = FixedTimestep(dt);
 	mSpatialStep = dx;
 
 	float d = damping * dt + 2.0f;
@@ -24,81 +121,243 @@ Waves::Waves(int m, int n, float dx, float dt, float speed, float damping)
 	mK2 = (4.0f - 8.0f * e) / d;
 	mK3 = (2.0f * e) / d;
 
-	mPrevSolution.resize(m * n);
-	mCurrSolution.resize(m * n);
-	mNormals.resize(m * n);
-	mTangentX.resize(m * n);
+	size_t planeSize = (size_t)m * mPitch;
+	mPrev.assign(planeSize, 0.0f);
+	mCurr.assign(planeSize, 0.0f);
+	mNext.assign(planeSize, 0.0f);
+	mNormalX.assign(planeSize, 0.0f);
+	mNormalY.assign(planeSize, 1.0f);
+	mNormalZ.assign(planeSize, 0.0f);
+	mTangentX.assign(planeSize, 1.0f);
+	mTangentY.assign(planeSize, 0.0f);
+}
+
+Waves::~Waves()
+{
+}
+
+Float3 Waves::Position(int i) const
+{
+	float halfWidth = (mNumCols - 1) * mSpatialStep * 0.5f;
+	float halfDepth = (mNumRows - 1) * mSpatialStep * 0.5f;
+	int row = i / mNumCols;
+	int col = i % mNumCols;
 
-	float halfWidth = (n - 1) * dx * 0.5f;
-	float halfDepth = (m - 1) * dx * 0.5f;
+	return Float3(-halfWidth + col * mSpatialStep, Height(i), halfDepth - row * mSpatialStep);
+}
 
-	for (int i = 0; i < m; ++i)
+Float3 Waves::Normal(int i) const
+{
+	size_t k = Index(i);
+	return Float3(mNormalX[k], mNormalY[k], mNormalZ[k]);
+}
+
+Float3 Waves::TangentX(int i) const
+{
+	size_t k = Index(i);
+	return Float3(mTangentX[k], mTangentY[k], 0.0f);
+}
+
+void Waves::UpdateRegion(int r0, int r1, int c0, int c1, int steps)
+{
+	if (steps == 1)
 	{
-		float z = halfDepth - i * dx;
-		for (int j = 0; j < n; ++j)
+		for (int c = c0; c < c1; c += TileColumns)
 		{
-			float x = -halfWidth + j * dx;
+			UpdateTile(r0, r1, c, min(c + TileColumns, c1));
+		}
+		return;
+	}
 
-			mPrevSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mCurrSolution[i * n + j] = XMFLOAT3(x, 0.0f, z);
-			mNormals[i * n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			mTangentX[i * n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+	for (int r = r0; r < r1; r += TileRows)
+	{
+		for (int c = c0; c < c1; c += BlockColumns)
+		{
+			UpdateBlock(r, min(r + TileRows, r1), c, min(c + BlockColumns, c1), steps);
 		}
 	}
 }
 
-Waves::~Waves()
+void Waves::UpdateTile(int r0, int r1, int c0, int c1)
+{
+	// The new heights of the last three rows over the tile's columns and a vector either
+	// side. Rows and columns just outside the tile are worked out here again rather than
+	// read back from the neighbouring tiles, so tiles never wait on each other.
+	const int WindowWidth = TileColumns + 2 * SimdWidth;
+	alignas(32) float window[3][WindowWidth] = {};
+	int s0 = max(c0 - SimdWidth, 0);
+	int s1 = min(c1 + SimdWidth, mPitch);
+	int windowOrigin = c0 - SimdWidth;
+
+	for (int i = max(r0 - 1, 0); i <= min(r1, mNumRows - 1); ++i)
+	{
+		float* next = window[i % 3] - windowOrigin;
+		const float* curr = &mCurr[(size_t)i * mPitch];
+		bool edgeRow = i == 0 || i == mNumRows - 1;
+
+		StepRow(&mPrev[(size_t)i * mPitch], edgeRow ? curr : curr - mPitch, curr, edgeRow ? curr : curr + mPitch, next, s0,
+			s1, edgeRow, mNumCols, mK1, mK2, mK3);
+
+		if (i >= r0 && i < r1)
+		{
+			copy(next + c0, next + c1, &mNext[(size_t)i * mPitch + c0]);
+		}
+
+		// Row i completes the neighbours of row i - 1.
+		int row = i - 1;
+		if (row < max(r0, 1) || row >= min(r1, mNumRows - 1))
+		{
+			continue;
+		}
+
+		size_t offset = (size_t)row * mPitch;
+		NormalRow(window[(i + 1) % 3] - windowOrigin, window[row % 3] - windowOrigin, next, &mNormalX[offset],
+			&mNormalY[offset], &mNormalZ[offset], &mTangentX[offset], &mTangentY[offset], c0, c1, mNumCols, mSpatialStep);
+	}
+}
+
+void Waves::UpdateBlock(int r0, int r1, int c0, int c1, int steps)
+{
+	// Each step spoils one more row and column in from the edge of what was loaded, so the
+	// block carries a halo one wider than the step count to keep its own heights and their
+	// neighbours (for the normals) exact. Halo rows that can no longer reach the block are
+	// skipped, halo columns are cheap enough to step throughout.
+	int halo = steps + 1;
+	int haloColumns = (halo + SimdWidth - 1) / SimdWidth * SimdWidth;
+	int b0 = max(r0 - halo, 0);
+	int b1 = min(r1 + halo, mNumRows);
+	int s0 = max(c0 - haloColumns, 0);
+	int s1 = min(c1 + haloColumns, mPitch);
+
+	int localPitch = s1 - s0 + 2 * SimdWidth;
+	size_t planeSize = (size_t)(b1 - b0 + 2) * localPitch;
+	if (tBlockPlanes.size() < 3 * planeSize)
+	{
+		tBlockPlanes.assign(3 * planeSize, 0.0f);
+	}
+
+	float* planes[3] = { tBlockPlanes.data(), tBlockPlanes.data() + planeSize, tBlockPlanes.data() + 2 * planeSize };
+	auto row = [&](int plane, int i)
+	{
+		return planes[plane] + (ptrdiff_t)(i - b0 + 1) * localPitch + SimdWidth - s0;
+	};
+
+	for (int i = b0; i < b1; ++i)
+	{
+		copy(&mPrev[(size_t)i * mPitch + s0], &mPrev[(size_t)i * mPitch + s1], row(0, i) + s0);
+		copy(&mCurr[(size_t)i * mPitch + s0], &mCurr[(size_t)i * mPitch + s1], row(1, i) + s0);
+	}
+
+	int prev = 0;
+	int curr = 1;
+	int next = 2;
+	for (int step = 1; step <= steps; ++step)
+	{
+		int first = b0 == 0 ? 0 : b0 + step;
+		int last = b1 == mNumRows ? mNumRows : b1 - step;
+
+		for (int i = first; i < last; ++i)
+		{
+			StepRow(row(prev, i), row(curr, i - 1), row(curr, i), row(curr, i + 1), row(next, i), s0, s1,
+				i == 0 || i == mNumRows - 1, mNumCols, mK1, mK2, mK3);
+		}
+
+		int oldPrev = prev;
+		prev = curr;
+		curr = next;
+		next = oldPrev;
+	}
+
+	for (int i = r0; i < r1; ++i)
+	{
+		copy(row(curr, i) + c0, row(curr, i) + c1, &mNext[(size_t)i * mPitch + c0]);
+		copy(row(prev, i) + c0, row(prev, i) + c1, &mScratch[(size_t)i * mPitch + c0]);
+	}
+
+	for (int i = max(r0, 1); i < min(r1, mNumRows - 1); ++i)
+	{
+		size_t offset = (size_t)i * mPitch;
+		NormalRow(row(curr, i - 1), row(curr, i), row(curr, i + 1), &mNormalX[offset], &mNormalY[offset],
+			&mNormalZ[offset], &mTangentX[offset], &mTangentY[offset], c0, c1, mNumCols, mSpatialStep);
+	}
+}
+
+int Waves::Update(float dt, ThreadPool* pool)
 {
+	int steps = (int)mTimestep.Advance(dt);
+
+	for (int done = 0; done < steps; )
+	{
+		int passSteps = min(steps - done, mStepsPerPass);
+		StepPass(passSteps, pool);
+		done += passSteps;
+	}
+
+	return steps;
 }
 
-void Waves::Update(float dt)
+void Waves::UpdateAll(Waves* const* surfaces, size_t count, float dt, ThreadPool* pool)
 {
-	static float t = 0;
+	if (pool == nullptr)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			surfaces[i]->Update(dt);
+		}
+		return;
+	}
 
-	t += dt;
+	// A task per surface; a large surface splits its own passes across the pool as well.
+	pool->ParallelFor((uint32_t)count, [&](uint32_t i)
+	{
+		surfaces[i]->Update(dt, pool);
+	});
+}
 
-	if (t >= mTimeStep)
+void Waves::StepPass(int steps, ThreadPool* pool)
+{
+	if (steps > 1 && mScratch.empty())
 	{
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					mPrevSolution[i * mNumCols + j].y =
-						mK1 * mPrevSolution[i * mNumCols + j].y +
-						mK2 * mCurrSolution[i * mNumCols + j].y +
-						mK3 * (mCurrSolution[(i + 1) * mNumCols + j].y +
-							mCurrSolution[(i - 1) * mNumCols + j].y +
-							mCurrSolution[i * mNumCols + j + 1].y +
-							mCurrSolution[i * mNumCols + j - 1].y);
-				}
-			});
-
-		std::swap(mPrevSolution, mCurrSolution);
-
-		t = 0.0f;
-
-		concurrency::parallel_for(1, mNumRows - 1, [this](int i)
-			{
-				for (int j = 1; j < mNumCols - 1; ++j)
-				{
-					float l = mCurrSolution[i * mNumCols + j - 1].y;
-					float r = mCurrSolution[i * mNumCols + j + 1].y;
-					float t = mCurrSolution[(i - 1) * mNumCols + j].y;
-					float b = mCurrSolution[(i + 1) * mNumCols + j].y;
-
-					mNormals[i * mNumCols + j].x = -r + l;
-					mNormals[i * mNumCols + j].y = 2.0f * mSpatialStep;
-					mNormals[i * mNumCols + j].z = b - t;
-
-					XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i * mNumCols + j]));
-					XMStoreFloat3(&mNormals[i * mNumCols + j], n);
-
-					mTangentX[i * mNumCols + j] = XMFLOAT3(2.0f * mSpatialStep, r - l, 0.0f);
-					XMVECTOR tan = XMVector3Normalize(XMLoadFloat3(&mTangentX[i * mNumCols + j]));
-					XMStoreFloat3(&mTangentX[i * mNumCols + j], tan);
-				}
-			});
+		mScratch.assign(mPrev.size(), 0.0f);
 	}
+
+	int threadCount = pool != nullptr ? (int)pool->ThreadCount() : 1;
+	int regionRows = mPartition == WavesPartition::Rows ? 1 :
+		mPartition == WavesPartition::Tiles ? TileRows : (mNumRows + threadCount - 1) / threadCount;
+	int regionColumns = mPartition == WavesPartition::Tiles ? TileColumns : mPitch;
+	int regionsPerRow = (mPitch + regionColumns - 1) / regionColumns;
+	int regionCount = (mNumRows + regionRows - 1) / regionRows * regionsPerRow;
+
+	auto updateRegions = [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t region = begin; region < end; ++region)
+		{
+			int r0 = (int)region / regionsPerRow * regionRows;
+			int c0 = (int)region % regionsPerRow * regionColumns;
+			UpdateRegion(r0, min(r0 + regionRows, mNumRows), c0, min(c0 + regionColumns, mPitch), steps);
+		}
+	};
+
+	if (pool != nullptr)
+	{
+		pool->ParallelForRange((uint32_t)regionCount, 1, updateRegions);
+	}
+	else
+	{
+		updateRegions(0, (uint32_t)regionCount);
+	}
+
+	// The last step becomes the current one and the one before it the previous; a single
+	// step's previous is the old current.
+	if (steps == 1)
+	{
+		std::swap(mPrev, mCurr);
+	}
+	else
+	{
+		std::swap(mPrev, mScratch);
+	}
+	std::swap(mCurr, mNext);
 }
 
 void Waves::Disturb(int i, int j, float magnitude)
@@ -108,9 +367,9 @@ void Waves::Disturb(int i, int j, float magnitude)
 
 	float halfMag = 0.5f * magnitude;
 
-	mCurrSolution[i * mNumCols + j].y += magnitude;
-	mCurrSolution[i * mNumCols + j + 1].y += halfMag;
-	mCurrSolution[i * mNumCols + j - 1].y += halfMag;
-	mCurrSolution[(i + 1) * mNumCols + j].y += halfMag;
-	mCurrSolution[(i - 1) * mNumCols + j].y += halfMag;
-}
\ No newline at end of file
+	mCurr[(size_t)i * mPitch + j] += magnitude;
+	mCurr[(size_t)i * mPitch + j + 1] += halfMag;
+	mCurr[(size_t)i * mPitch + j - 1] += halfMag;
+	mCurr[(size_t)(i + 1) * mPitch + j] += halfMag;
+	mCurr[(size_t)(i - 1) * mPitch + j] += halfMag;
+}
@@ -1,11 +1,32 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
-#include <DirectXMath.h>
+#include "AlignedAllocator.h"
+#include "FixedTimestep.h"
+#include "SimMath.h"
 
 using namespace std;
-using namespace DirectX;
 
+class ThreadPool;
+
+// How Waves::Update hands the grid to the pool. Every task works through its rows in
+// cache-sized column blocks either way; what changes is the task size and how many rows
+// around each task are stepped twice (see Waves::UpdateTile).
+enum class WavesPartition
+{
+	// A task per row.
+	Rows,
+	// A task per TileRows x TileColumns tile.
+	Tiles,
+	// One band of whole rows per pool thread.
+	Bands,
+};
+
+// Damped wave equation on an m x n grid. Heights live in their own float planes (rows
+// padded to whole SIMD vectors) and one tiled pass per step applies the 5-point stencil
+// and derives normals and tangents from the new heights, so nothing is loaded that isn't
+// used; full positions are only put together when asked for.
 class Waves
 {
 public:
@@ -21,16 +42,54 @@ public:
 	float Width() const { return mNumCols * mSpatialStep; }
 	float Depth() const { return mNumRows * mSpatialStep; }
 
-	const XMFLOAT3& Position(int i) const { return mCurrSolution[i]; }
-	const XMFLOAT3& Normal(int i) const { return mNormals[i]; }
-	const XMFLOAT3& TangentX(int i) const { return mTangentX[i]; }
+	float Height(int i) const { return mCurr[Index(i)]; }
+	Float3 Position(int i) const;
+	Float3 Normal(int i) const;
+	Float3 TangentX(int i) const;
 
-	void Update(float dt);
+	// Adds dt to the surface's own clock and takes as many fixed steps as it covers, at most
+	// MaxStepsPerUpdate (any further backlog is dropped). Returns the steps taken. Runs on
+	// the calling thread without a pool.
+	int Update(float dt, ThreadPool* pool = nullptr);
+	// Updates every surface by dt, the surfaces side by side on the pool.
+	static void UpdateAll(Waves* const* surfaces, size_t count, float dt, ThreadPool* pool = nullptr);
 	void Disturb(int i, int j, float magnitude);
 
+	WavesPartition Partition() const { return mPartition; }
+	void SetPartition(WavesPartition partition) { mPartition = partition; }
+
+	int MaxStepsPerUpdate() const { return (int)mTimestep.MaxStepsPerFrame(); }
+	void SetMaxStepsPerUpdate(int steps) { mTimestep.SetMaxStepsPerFrame((uint32_t)max(steps, 1)); }
+
+	// Steps an update takes per pass over the grid, up to MaxStepsPerPass. Past one, each
+	// block of the grid is stepped that many times while it is in cache, at the cost of
+	// stepping a halo around it again; the results are the same.
+	int StepsPerPass() const { return mStepsPerPass; }
+	void SetStepsPerPass(int steps) { mStepsPerPass = min(max(steps, 1), MaxStepsPerPass); }
+
+	// Rows and columns of grid a tile of the update covers.
+	static const int TileRows = 32;
+	static const int TileColumns = 512;
+	// Columns of a block stepped several times per pass (it has TileRows rows).
+	static const int BlockColumns = 256;
+	static const int MaxStepsPerPass = 8;
+
 private:
+	// Plane offset of vertex i (row-major over the unpadded grid).
+	size_t Index(int i) const { return (size_t)(i / mNumCols) * mPitch + i % mNumCols; }
+
+	// Takes steps steps over the whole grid in one pass.
+	void StepPass(int steps, ThreadPool* pool);
+	// Steps rows [r0, r1) x columns [c0, c1) into mNext (the step before the last into
+	// mScratch when there are several) and writes their normals and tangents, a tile or
+	// block at a time.
+	void UpdateRegion(int r0, int r1, int c0, int c1, int steps);
+	void UpdateTile(int r0, int r1, int c0, int c1);
+	void UpdateBlock(int r0, int r1, int c0, int c1, int steps);
+
 	int mNumRows = 0;
 	int mNumCols = 0;
+	int mPitch = 0;
 
 	int mVertexCount = 0;
 	int mTriangleCount = 0;
@@ -39,11 +98,25 @@ private:
 	float mK2 = 0.0f;
 	float mK3 = 0.0f;
 
-	float mTimeStep = 0.0f;
 	float mSpatialStep = 0.0f;
 
-	vector<XMFLOAT3> mPrevSolution;
-	vector<XMFLOAT3> mCurrSolution;
-	vector<XMFLOAT3> mNormals;
-	vector<XMFLOAT3> mTangentX;
+	// The surface's own clock: the time step and the time not yet stepped.
+	FixedTimestep mTimestep;
+	int mStepsPerPass = 1;
+
+	WavesPartition mPartition = WavesPartition::Tiles;
+
+	// Heights at the previous and current steps, and the step being computed; rotated after
+	// every pass. mScratch takes the step before the last of a multi-step pass. Edges stay
+	// at rest.
+	AlignedVector<float> mPrev;
+	AlignedVector<float> mCurr;
+	AlignedVector<float> mNext;
+	AlignedVector<float> mScratch;
+	AlignedVector<float> mNormalX;
+	AlignedVector<float> mNormalY;
+	AlignedVector<float> mNormalZ;
+	// Tangents along x have no z component.
+	AlignedVector<float> mTangentX;
+	AlignedVector<float> mTangentY;
 };
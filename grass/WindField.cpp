@@ -0,0 +1,211 @@
+#include "WindField.h"
+#include "SimdMath.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.1415926535f;
+
+	const float OctaveScale[] = { 1.0f, 2.3f };
+	const float OctaveAmplitude[] = { 1.0f, 0.5f };
+
+	uint32_t PadToSimd(uint32_t count)
+	{
+		return (count + SimdWidth - 1) / SimdWidth * SimdWidth;
+	}
+
+	// out[i] = sin or cos(scale * coords[i] + offset), SimdWidth at a time.
+	void EvaluateSinCos(const AlignedVector<float>& coords, float scale, float offset,
+		AlignedVector<float>* sinOut, AlignedVector<float>* cosOut)
+	{
+		SimdFloat s = SimdSplat(scale);
+		SimdFloat o = SimdSplat(offset);
+
+		for (size_t i = 0; i < coords.size(); i += SimdWidth)
+		{
+			SimdFloat sine;
+			SimdFloat cosine;
+			SinCos(SimdLoad(&coords[i]) * s + o, sine, cosine);
+
+			if (sinOut != nullptr)
+			{
+				SimdStore(&(*sinOut)[i], sine);
+			}
+			if (cosOut != nullptr)
+			{
+				SimdStore(&(*cosOut)[i], cosine);
+			}
+		}
+	}
+}
+
+void WindField::Initialize(const WindFieldDesc& desc)
+{
+	assert(desc.Width >= 2 && desc.Height >= 2);
+
+	mDesc = desc;
+
+	float directionLength = sqrtf(desc.DirectionX * desc.DirectionX + desc.DirectionZ * desc.DirectionZ);
+	mDesc.DirectionX = directionLength > 0.0f ? desc.DirectionX / directionLength : 1.0f;
+	mDesc.DirectionZ = directionLength > 0.0f ? desc.DirectionZ / directionLength : 0.0f;
+
+	mPaddedWidth = PadToSimd(desc.Width);
+	mPaddedHeight = PadToSimd(desc.Height);
+
+	mNodeX.resize(mPaddedWidth);
+	for (uint32_t i = 0; i < mPaddedWidth; ++i)
+	{
+		mNodeX[i] = desc.OriginX + i * desc.CellSize;
+	}
+
+	mNodeZ.resize(mPaddedHeight);
+	for (uint32_t j = 0; j < mPaddedHeight; ++j)
+	{
+		mNodeZ[j] = desc.OriginZ + j * desc.CellSize;
+	}
+
+	mFrontCosX.assign(mPaddedWidth, 0.0f);
+	mFrontSinX.assign(mPaddedWidth, 0.0f);
+	mFrontCosZ.assign(mPaddedHeight, 0.0f);
+	mFrontSinZ.assign(mPaddedHeight, 0.0f);
+
+	for (int o = 0; o < Octaves; ++o)
+	{
+		for (int k = 0; k < 2; ++k)
+		{
+			mTurbulenceX[o][k].assign(mPaddedWidth, 0.0f);
+			mTurbulenceZ[o][k].assign(mPaddedHeight, 0.0f);
+		}
+	}
+
+	mVelocityX.assign(NodeCount(), 0.0f);
+	mVelocityZ.assign(NodeCount(), 0.0f);
+	mMaxSpeed = 0.0f;
+}
+
+void WindField::Update(float time, float strength)
+{
+	const WindFieldDesc& d = mDesc;
+
+	// Front bands: speed * (1 - cos(2u)) / 2 with u = k * (dot(dir, p) - FrontSpeed * t).
+	// cos(2u) = cos(a(x) + b(z)) = cos a cos b - sin a sin b.
+	float frontK = 2.0f * Pi / d.FrontSpacing;
+	EvaluateSinCos(mNodeX, frontK * d.DirectionX, -frontK * d.FrontSpeed * time, &mFrontSinX, &mFrontCosX);
+	EvaluateSinCos(mNodeZ, frontK * d.DirectionZ, 0.0f, &mFrontSinZ, &mFrontCosZ);
+
+	// Turbulence octave o:
+	//   x: sin(k x + w t) * cos(k z - 0.7 w t)
+	//   z: cos(0.8 k x - w t) * sin(k z + 1.1 w t)
+	for (int o = 0; o < Octaves; ++o)
+	{
+		float k = d.TurbulenceScale * OctaveScale[o];
+		float w = d.TurbulenceSpeed * OctaveScale[o] * time;
+
+		EvaluateSinCos(mNodeX, k, w, &mTurbulenceX[o][0], nullptr);
+		EvaluateSinCos(mNodeZ, k, -0.7f * w, nullptr, &mTurbulenceZ[o][0]);
+		EvaluateSinCos(mNodeX, 0.8f * k, -w, nullptr, &mTurbulenceX[o][1]);
+		EvaluateSinCos(mNodeZ, k, 1.1f * w, &mTurbulenceZ[o][1], nullptr);
+	}
+
+	float gustWave = max(0.0f, sinf(time * d.GustFrequency));
+	float gust = 1.0f + d.GustStrength * gustWave * gustWave * gustWave * gustWave;
+
+	SimdFloat baseSpeed = SimdSplat(strength * d.BaseSpeed * gust);
+	SimdFloat halfFront = SimdSplat(0.5f * strength * d.FrontStrength);
+	SimdFloat directionX = SimdSplat(d.DirectionX);
+	SimdFloat directionZ = SimdSplat(d.DirectionZ);
+	SimdFloat maxSpeedSq = SimdZero();
+	float tailMaxSpeedSq = 0.0f;
+
+	for (uint32_t j = 0; j < d.Height; ++j)
+	{
+		SimdFloat frontCosZ = SimdSplat(mFrontCosZ[j]);
+		SimdFloat frontSinZ = SimdSplat(mFrontSinZ[j]);
+
+		SimdFloat turbulenceZ[Octaves][2];
+		for (int o = 0; o < Octaves; ++o)
+		{
+			float amplitude = strength * d.TurbulenceStrength * OctaveAmplitude[o];
+			turbulenceZ[o][0] = SimdSplat(amplitude * mTurbulenceZ[o][0][j]);
+			turbulenceZ[o][1] = SimdSplat(amplitude * mTurbulenceZ[o][1][j]);
+		}
+
+		float* rowX = &mVelocityX[(size_t)j * d.Width];
+		float* rowZ = &mVelocityZ[(size_t)j * d.Width];
+
+		// Columns are padded, so the last group may compute a few extra nodes; only the
+		// in-range lanes are stored.
+		for (uint32_t i = 0; i < d.Width; i += SimdWidth)
+		{
+			SimdFloat band = SimdSplat(1.0f) - (SimdLoad(&mFrontCosX[i]) * frontCosZ - SimdLoad(&mFrontSinX[i]) * frontSinZ);
+			SimdFloat speed = baseSpeed + halfFront * band;
+
+			SimdFloat vx = directionX * speed;
+			SimdFloat vz = directionZ * speed;
+			for (int o = 0; o < Octaves; ++o)
+			{
+				vx = vx + SimdLoad(&mTurbulenceX[o][0][i]) * turbulenceZ[o][0];
+				vz = vz + SimdLoad(&mTurbulenceX[o][1][i]) * turbulenceZ[o][1];
+			}
+
+			if (i + SimdWidth <= d.Width)
+			{
+				SimdStoreUnaligned(rowX + i, vx);
+				SimdStoreUnaligned(rowZ + i, vz);
+				maxSpeedSq = Max(maxSpeedSq, vx * vx + vz * vz);
+			}
+			else
+			{
+				alignas(32) float tailX[SimdWidth];
+				alignas(32) float tailZ[SimdWidth];
+				SimdStore(tailX, vx);
+				SimdStore(tailZ, vz);
+
+				for (uint32_t k = 0; i + k < d.Width; ++k)
+				{
+					rowX[i + k] = tailX[k];
+					rowZ[i + k] = tailZ[k];
+					tailMaxSpeedSq = max(tailMaxSpeedSq, tailX[k] * tailX[k] + tailZ[k] * tailZ[k]);
+				}
+			}
+		}
+	}
+
+	alignas(32) float lanes[SimdWidth];
+	SimdStore(lanes, maxSpeedSq);
+
+	float maxSq = tailMaxSpeedSq;
+	for (int k = 0; k < SimdWidth; ++k)
+	{
+		maxSq = max(maxSq, lanes[k]);
+	}
+	mMaxSpeed = sqrtf(maxSq);
+}
+
+Float3 WindField::Sample(float x, float z) const
+{
+	const WindFieldDesc& d = mDesc;
+	float invCellSize = 1.0f / d.CellSize;
+
+	float u = min(max((x - d.OriginX) * invCellSize, 0.0f), (float)(d.Width - 1));
+	float v = min(max((z - d.OriginZ) * invCellSize, 0.0f), (float)(d.Height - 1));
+
+	uint32_t i0 = min((uint32_t)u, d.Width - 2);
+	uint32_t j0 = min((uint32_t)v, d.Height - 2);
+	float fu = u - i0;
+	float fv = v - j0;
+
+	size_t n00 = (size_t)j0 * d.Width + i0;
+	size_t n10 = n00 + 1;
+	size_t n01 = n00 + d.Width;
+	size_t n11 = n01 + 1;
+
+	float x0 = mVelocityX[n00] + (mVelocityX[n10] - mVelocityX[n00]) * fu;
+	float x1 = mVelocityX[n01] + (mVelocityX[n11] - mVelocityX[n01]) * fu;
+	float z0 = mVelocityZ[n00] + (mVelocityZ[n10] - mVelocityZ[n00]) * fu;
+	float z1 = mVelocityZ[n01] + (mVelocityZ[n11] - mVelocityZ[n01]) * fu;
+
+	return Float3(x0 + (x1 - x0) * fv, 0.0f, z0 + (z1 - z0) * fv);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include "AlignedAllocator.h"
+#include "SimMath.h"
+
+using namespace std;
+
+struct WindFieldDesc
+{
+	// Grid nodes, (0, 0) at (OriginX, OriginZ), CellSize apart. Both sizes must be >= 2.
+	uint32_t Width = 256;
+	uint32_t Height = 256;
+	float OriginX = -128.0f;
+	float OriginZ = -128.0f;
+	float CellSize = 1.0f;
+
+	// Steady wind: xz direction (normalized on Initialize) and speed.
+	float DirectionX = 1.0f;
+	float DirectionZ = 0.0f;
+	float BaseSpeed = 6.0f;
+
+	// The whole field swells by up to GustStrength of the base speed, GustFrequency rad/s.
+	float GustStrength = 0.6f;
+	float GustFrequency = 0.7f;
+
+	// Bands of stronger wind FrontSpacing metres apart, travelling downwind.
+	float FrontStrength = 4.0f;
+	float FrontSpacing = 40.0f;
+	float FrontSpeed = 8.0f;
+
+	// Two octaves of sinusoidal turbulence; Scale is in radians per metre.
+	float TurbulenceStrength = 1.5f;
+	float TurbulenceScale = 0.15f;
+	float TurbulenceSpeed = 1.3f;
+};
+
+// Horizontal wind evaluated on a coarse grid once per frame and sampled per blade.
+// Every term is a product of a function of x and a function of z, so Update evaluates
+// the sines once per column and once per row and the per-node work is a few SIMD
+// multiply-adds.
+class WindField
+{
+public:
+	void Initialize(const WindFieldDesc& desc);
+
+	// strength scales the whole field; 0 is calm.
+	void Update(float time, float strength);
+
+	// Bilinear, clamped at the edges. Matches SampleWind in Grass.hlsl.
+	Float3 Sample(float x, float z) const;
+
+	float MaxSpeed() const { return mMaxSpeed; }
+
+	const WindFieldDesc& Desc() const { return mDesc; }
+	size_t NodeCount() const { return (size_t)mDesc.Width * mDesc.Height; }
+
+	// Row-major planes of NodeCount() floats; the GPU buffer is VelocityX followed by VelocityZ.
+	const float* VelocityX() const { return mVelocityX.data(); }
+	const float* VelocityZ() const { return mVelocityZ.data(); }
+
+private:
+	static const int Octaves = 2;
+
+	WindFieldDesc mDesc;
+	uint32_t mPaddedWidth = 0;
+	uint32_t mPaddedHeight = 0;
+
+	// Node coordinates, padded to whole SIMD groups.
+	AlignedVector<float> mNodeX;
+	AlignedVector<float> mNodeZ;
+
+	// Per-column and per-row factors of the current frame.
+	AlignedVector<float> mFrontCosX;
+	AlignedVector<float> mFrontSinX;
+	AlignedVector<float> mFrontCosZ;
+	AlignedVector<float> mFrontSinZ;
+	AlignedVector<float> mTurbulenceX[Octaves][2];
+	AlignedVector<float> mTurbulenceZ[Octaves][2];
+
+	AlignedVector<float> mVelocityX;
+	AlignedVector<float> mVelocityZ;
+	float mMaxSpeed = 0.0f;
+};